@@ -0,0 +1,127 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/include/CompactCLI.hh
+ *
+ *  @brief CLI helpers for rewriting an event list with uniform clusters,
+ *         a chosen compression and optionally fewer branches.
+ */
+#ifndef HERON_CORE_COMPACTCLI_H
+#define HERON_CORE_COMPACTCLI_H
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AppUtils.hh"
+#include "SplitCLI.hh"
+
+struct CompactArgs
+{
+    std::string event_list_path;
+    std::string output_path;
+    /// "<algorithm>:<level>", algorithm one of zlib, lzma, lz4, zstd.
+    std::string compression = "zstd:5";
+    /// Entries per cluster; <= 0 => derived from --cluster-mb and the input.
+    long long cluster_entries = 0;
+    double cluster_mb = 50.0;
+    bool sort = false;
+    /// Branch names or ROOT wildcard patterns to drop.
+    std::vector<std::string> drop;
+    int jobs = 0;
+    bool bench = true;
+};
+
+inline CompactArgs parse_compact_args(const std::vector<std::string> &args, const std::string &usage)
+{
+    CompactArgs out;
+    std::vector<std::string> positional;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        const std::string arg = trim(args[i]);
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 >= args.size())
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return trim(args[++i]);
+        };
+
+        if (arg == "--compression")
+        {
+            out.compression = value();
+        }
+        else if (arg == "--cluster-entries")
+        {
+            out.cluster_entries = std::stoll(value());
+        }
+        else if (arg == "--cluster-mb")
+        {
+            out.cluster_mb = std::stod(value());
+        }
+        else if (arg == "--sort")
+        {
+            out.sort = true;
+        }
+        else if (arg == "--drop")
+        {
+            for (const auto &b : split_csv(value()))
+            {
+                if (!b.empty())
+                {
+                    out.drop.push_back(b);
+                }
+            }
+        }
+        else if (arg == "--jobs" || arg == "-j")
+        {
+            out.jobs = std::stoi(value());
+        }
+        else if (arg == "--no-bench")
+        {
+            out.bench = false;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            throw std::runtime_error(usage);
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        throw std::runtime_error(usage);
+    }
+    out.event_list_path = positional[0];
+    out.output_path = positional[1];
+
+    if (out.event_list_path.empty() || out.output_path.empty())
+    {
+        throw std::runtime_error("Invalid arguments (empty value)");
+    }
+    if (std::filesystem::exists(out.output_path) &&
+        std::filesystem::equivalent(out.event_list_path, out.output_path))
+    {
+        throw std::runtime_error("Output must differ from the input event list");
+    }
+    if (out.cluster_entries <= 0 && !(out.cluster_mb > 0.0))
+    {
+        throw std::runtime_error("Cluster size must be positive");
+    }
+    if (out.jobs <= 0)
+    {
+        out.jobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    return out;
+}
+
+int run(const CompactArgs &compact_args, const std::string &log_prefix);
+
+#endif // HERON_CORE_COMPACTCLI_H
@@ -0,0 +1,61 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/include/MacroCache.hh
+ *
+ *  @brief Content-addressed cache of ACLiC-compiled macro libraries used by
+ *         `heron macro`, so unchanged macros skip Cling parsing entirely.
+ */
+#ifndef HERON_CORE_MACRO_CACHE_H
+#define HERON_CORE_MACRO_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class MacroCache
+{
+public:
+    /**
+     *  @param cache_dir     root of the cache (one sub-directory per macro build)
+     *  @param include_dirs  directories searched for quoted includes, both when
+     *                       hashing and when compiling
+     *  @param libraries     shared libraries the compiled macros link against;
+     *                       their size and mtime enter the key
+     */
+    MacroCache(std::filesystem::path cache_dir,
+               std::vector<std::filesystem::path> include_dirs,
+               std::vector<std::filesystem::path> libraries);
+
+    /// False when HERON_MACRO_CACHE=0 (always interpret with Cling).
+    static bool enabled();
+
+    /**
+     *  Hex key over the macro source, every quoted include reachable from it,
+     *  the ROOT version, the compiler include path and the heron libraries.
+     */
+    std::string key(const std::filesystem::path &macro_path) const;
+
+    /// Build directory holding the compiled library for @p key.
+    std::filesystem::path entry_dir(const std::filesystem::path &macro_path, const std::string &key) const;
+
+    /**
+     *  Load the compiled macro, building it first if no entry exists for the
+     *  current key; stale entries of the same macro are removed. Returns false
+     *  if ACLiC fails, in which case the caller should interpret the macro. A
+     *  failure is recorded under the key, so later calls return false without
+     *  rebuilding until the macro or its inputs change.
+     */
+    bool load(const std::filesystem::path &macro_path) const;
+
+private:
+    void hash_file(const std::filesystem::path &path,
+                   std::uint64_t &h,
+                   std::vector<std::filesystem::path> &seen) const;
+
+    std::filesystem::path cache_dir_;
+    std::vector<std::filesystem::path> include_dirs_;
+    std::vector<std::filesystem::path> libraries_;
+};
+
+#endif // HERON_CORE_MACRO_CACHE_H
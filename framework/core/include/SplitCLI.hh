@@ -0,0 +1,146 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/include/SplitCLI.hh
+ *
+ *  @brief CLI helpers for splitting an event list into reproducible
+ *         train/validation/test event lists.
+ */
+#ifndef HERON_CORE_SPLITCLI_H
+#define HERON_CORE_SPLITCLI_H
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AppUtils.hh"
+
+struct SplitArgs
+{
+    std::string event_list_path;
+    std::string output_dir;
+    std::vector<double> fractions = {0.8, 0.1, 0.1};
+    std::vector<std::string> names = {"train", "val", "test"};
+    std::uint64_t seed = 0;
+    std::string stratify;
+    std::string weight = "w_nominal";
+};
+
+inline std::vector<std::string> split_csv(const std::string &value)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        out.push_back(trim(item));
+    }
+    return out;
+}
+
+inline SplitArgs parse_split_args(const std::vector<std::string> &args, const std::string &usage)
+{
+    SplitArgs out;
+    std::vector<std::string> positional;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        const std::string arg = trim(args[i]);
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 >= args.size())
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return trim(args[++i]);
+        };
+
+        if (arg == "--fractions")
+        {
+            out.fractions.clear();
+            for (const auto &f : split_csv(value()))
+            {
+                out.fractions.push_back(std::stod(f));
+            }
+        }
+        else if (arg == "--names")
+        {
+            out.names = split_csv(value());
+        }
+        else if (arg == "--seed")
+        {
+            out.seed = std::stoull(value());
+        }
+        else if (arg == "--stratify")
+        {
+            out.stratify = value();
+        }
+        else if (arg == "--weight")
+        {
+            out.weight = value();
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            throw std::runtime_error(usage);
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        throw std::runtime_error(usage);
+    }
+    out.event_list_path = positional[0];
+    out.output_dir = positional[1];
+
+    if (out.event_list_path.empty() || out.output_dir.empty() || out.weight.empty())
+    {
+        throw std::runtime_error("Invalid arguments (empty value)");
+    }
+    if (out.fractions.empty() || out.fractions.size() != out.names.size())
+    {
+        throw std::runtime_error("Split fractions and names must have the same, non-zero length");
+    }
+
+    double total = 0.0;
+    for (size_t k = 0; k < out.fractions.size(); ++k)
+    {
+        if (!(out.fractions[k] > 0.0) || !std::isfinite(out.fractions[k]))
+        {
+            throw std::runtime_error("Split fractions must be positive");
+        }
+        if (out.names[k].empty())
+        {
+            throw std::runtime_error("Invalid arguments (empty split name)");
+        }
+        for (size_t j = 0; j < k; ++j)
+        {
+            if (out.names[j] == out.names[k])
+            {
+                throw std::runtime_error("Duplicate split name: " + out.names[k]);
+            }
+        }
+        total += out.fractions[k];
+    }
+    for (auto &f : out.fractions)
+    {
+        f /= total;
+    }
+
+    std::filesystem::path output_dir(out.output_dir);
+    if (output_dir.is_relative() && output_dir.parent_path().empty())
+    {
+        out.output_dir = (stage_output_dir("HERON_SPLIT_DIR", "split") / output_dir).string();
+    }
+
+    return out;
+}
+
+int run(const SplitArgs &split_args, const std::string &log_prefix);
+
+#endif // HERON_CORE_SPLITCLI_H
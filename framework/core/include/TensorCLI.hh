@@ -0,0 +1,120 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/include/TensorCLI.hh
+ *
+ *  @brief CLI helpers for exporting event images into memory-mappable
+ *         tensor shards for CNN training.
+ */
+#ifndef HERON_CORE_TENSORCLI_H
+#define HERON_CORE_TENSORCLI_H
+
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AppUtils.hh"
+
+struct TensorArgs
+{
+    std::string event_list_path;
+    std::string output_dir;
+    std::string selection = "true";
+    std::string label = "is_signal";
+    std::string weight = "w_nominal";
+    std::uint64_t events_per_shard = 1024;
+    std::uint32_t width = 0;
+    bool sparse = false;
+    bool semantic = true;
+};
+
+inline TensorArgs parse_tensor_args(const std::vector<std::string> &args, const std::string &usage)
+{
+    TensorArgs out;
+    std::vector<std::string> positional;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        const std::string arg = trim(args[i]);
+        auto value = [&]() -> std::string
+        {
+            if (i + 1 >= args.size())
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return trim(args[++i]);
+        };
+
+        if (arg == "--selection")
+        {
+            out.selection = value();
+        }
+        else if (arg == "--label")
+        {
+            out.label = value();
+        }
+        else if (arg == "--weight")
+        {
+            out.weight = value();
+        }
+        else if (arg == "--events-per-shard")
+        {
+            const long long n = std::stoll(value());
+            if (n <= 0)
+            {
+                throw std::runtime_error("Events per shard must be positive");
+            }
+            out.events_per_shard = static_cast<std::uint64_t>(n);
+        }
+        else if (arg == "--width")
+        {
+            const long long n = std::stoll(value());
+            if (n <= 0)
+            {
+                throw std::runtime_error("Image width must be positive");
+            }
+            out.width = static_cast<std::uint32_t>(n);
+        }
+        else if (arg == "--sparse")
+        {
+            out.sparse = true;
+        }
+        else if (arg == "--no-semantic")
+        {
+            out.semantic = false;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            throw std::runtime_error(usage);
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        throw std::runtime_error(usage);
+    }
+    out.event_list_path = positional[0];
+    out.output_dir = positional[1];
+
+    if (out.event_list_path.empty() || out.output_dir.empty() || out.selection.empty() ||
+        out.label.empty() || out.weight.empty())
+    {
+        throw std::runtime_error("Invalid arguments (empty value)");
+    }
+
+    std::filesystem::path output_dir(out.output_dir);
+    if (output_dir.is_relative() && output_dir.parent_path().empty())
+    {
+        out.output_dir = (stage_output_dir("HERON_TENSOR_DIR", "tensor") / output_dir).string();
+    }
+
+    return out;
+}
+
+int run(const TensorArgs &tensor_args, const std::string &log_prefix);
+
+#endif // HERON_CORE_TENSORCLI_H
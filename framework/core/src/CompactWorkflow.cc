@@ -0,0 +1,428 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/src/CompactWorkflow.cc
+ *
+ *  @brief Rewrite an event list with uniform clusters, a chosen compression
+ *         and optional per-sample sorting (invoked by the unified heron CLI).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include <Compression.h>
+#include <TBranch.h>
+#include <TFile.h>
+#include <TKey.h>
+#include <TObjString.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include "AppLog.hh"
+#include "AppUtils.hh"
+#include "CompactCLI.hh"
+#include "EventListIO.hh"
+#include "SnapshotService.hh"
+#include "StatusMonitor.hh"
+
+namespace
+{
+
+constexpr double kMiB = 1024.0 * 1024.0;
+
+int compression_settings(const std::string &spec)
+{
+    const size_t colon = spec.find(':');
+    const std::string name = trim(spec.substr(0, colon));
+    const int level = colon == std::string::npos ? 5 : std::stoi(spec.substr(colon + 1));
+    if (level < 0 || level > 9)
+    {
+        throw std::runtime_error("compact: compression level must be 0-9: " + spec);
+    }
+
+    using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+    if (name == "zlib")
+        return ROOT::CompressionSettings(Algorithm::kZLIB, level);
+    if (name == "lzma")
+        return ROOT::CompressionSettings(Algorithm::kLZMA, level);
+    if (name == "lz4")
+        return ROOT::CompressionSettings(Algorithm::kLZ4, level);
+    if (name == "zstd")
+        return ROOT::CompressionSettings(Algorithm::kZSTD, level);
+    throw std::runtime_error("compact: unknown compression algorithm '" + name + "' (zlib, lzma, lz4, zstd)");
+}
+
+struct TreeReport
+{
+    Long64_t entries = 0;
+    Long64_t clusters = 0;
+    int branches = 0;
+    double file_mb = 0.0;
+    double zip_mb = 0.0;
+    double raw_mb = 0.0;
+    double read_seconds = 0.0;
+};
+
+/// Sizes and cluster count of @p tree_name; with @p bench, time a full sequential read.
+TreeReport report_tree(const std::string &path, const std::string &tree_name, bool bench)
+{
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+    auto *tree = (f && !f->IsZombie()) ? dynamic_cast<TTree *>(f->Get(tree_name.c_str())) : nullptr;
+    if (!tree)
+    {
+        throw std::runtime_error("compact: missing tree " + tree_name + " in " + path);
+    }
+
+    TreeReport r;
+    r.entries = tree->GetEntries();
+    r.branches = tree->GetListOfBranches()->GetEntries();
+    r.zip_mb = static_cast<double>(tree->GetZipBytes()) / kMiB;
+    r.raw_mb = static_cast<double>(tree->GetTotBytes()) / kMiB;
+    r.file_mb = static_cast<double>(std::filesystem::file_size(path)) / kMiB;
+
+    auto clusters = tree->GetClusterIterator(0);
+    while (clusters() < r.entries)
+    {
+        ++r.clusters;
+    }
+
+    if (bench)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (Long64_t i = 0; i < r.entries; ++i)
+        {
+            tree->GetEntry(i);
+        }
+        r.read_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return r;
+}
+
+void log_report(const std::string &log_prefix, const std::string &stage, const TreeReport &r, bool bench)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "action=compact_report stage=" << stage
+        << " entries=" << r.entries
+        << " branches=" << r.branches
+        << " clusters=" << r.clusters
+        << " file_mb=" << r.file_mb
+        << " zip_mb=" << r.zip_mb
+        << " raw_mb=" << r.raw_mb;
+    if (bench && r.read_seconds > 0.0)
+    {
+        out << " read_s=" << r.read_seconds
+            << " read_mb_s=" << r.zip_mb / r.read_seconds
+            << " read_events_s=" << std::setprecision(0) << static_cast<double>(r.entries) / r.read_seconds;
+    }
+    log_info(log_prefix, out.str());
+}
+
+/// Entries of each sample, in tree order or sorted by (run, sub, evt).
+std::map<int, std::vector<Long64_t>> sample_entries(const std::string &path, const std::string &tree_name, bool sort)
+{
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+    auto *tree = (f && !f->IsZombie()) ? dynamic_cast<TTree *>(f->Get(tree_name.c_str())) : nullptr;
+    if (!tree)
+    {
+        throw std::runtime_error("compact: missing tree " + tree_name + " in " + path);
+    }
+
+    int run = 0;
+    int sub = 0;
+    int evt = 0;
+    int sample_id = -1;
+    tree->SetBranchStatus("*", false);
+    for (const char *b : {"run", "sub", "evt", "sample_id"})
+    {
+        tree->SetBranchStatus(b, true);
+    }
+    tree->SetBranchAddress("run", &run);
+    tree->SetBranchAddress("sub", &sub);
+    tree->SetBranchAddress("evt", &evt);
+    tree->SetBranchAddress("sample_id", &sample_id);
+
+    using Key = std::tuple<int, int, int, Long64_t>;
+    std::map<int, std::vector<Key>> keys;
+    const Long64_t n = tree->GetEntries();
+    for (Long64_t i = 0; i < n; ++i)
+    {
+        tree->GetEntry(i);
+        keys[sample_id].emplace_back(run, sub, evt, i);
+    }
+    tree->ResetBranchAddresses();
+
+    std::map<int, std::vector<Long64_t>> out;
+    for (auto &kv : keys)
+    {
+        if (sort)
+        {
+            std::sort(kv.second.begin(), kv.second.end());
+        }
+        auto &entries = out[kv.first];
+        entries.reserve(kv.second.size());
+        for (const auto &k : kv.second)
+        {
+            entries.push_back(std::get<3>(k));
+        }
+    }
+    return out;
+}
+
+/// Copy @p entries of the input tree into a fresh file with the new layout.
+void write_part(const std::string &in_path,
+                const std::string &part_path,
+                const std::string &tree_name,
+                const std::vector<Long64_t> &entries,
+                const CompactArgs &args,
+                int compression,
+                Long64_t cluster_entries)
+{
+    std::unique_ptr<TFile> fin(TFile::Open(in_path.c_str(), "READ"));
+    auto *tin = (fin && !fin->IsZombie()) ? dynamic_cast<TTree *>(fin->Get(tree_name.c_str())) : nullptr;
+    if (!tin)
+    {
+        throw std::runtime_error("compact: missing tree " + tree_name + " in " + in_path);
+    }
+    for (const auto &pattern : args.drop)
+    {
+        tin->SetBranchStatus(pattern.c_str(), false);
+    }
+    // The event key is needed by the index, sample ranges and every reader.
+    for (const char *b : {"run", "sub", "evt", "sample_id"})
+    {
+        tin->SetBranchStatus(b, true);
+    }
+
+    std::unique_ptr<TFile> fout(TFile::Open(part_path.c_str(), "RECREATE", "", compression));
+    if (!fout || fout->IsZombie())
+    {
+        throw std::runtime_error("compact: failed to create " + part_path);
+    }
+    fout->cd();
+
+    TTree *tout = tin->CloneTree(0);
+    tout->SetDirectory(fout.get());
+    TIter next(tout->GetListOfBranches());
+    while (auto *branch = static_cast<TBranch *>(next()))
+    {
+        branch->SetCompressionSettings(compression);
+    }
+    tout->SetAutoFlush(cluster_entries);
+
+    for (const Long64_t entry : entries)
+    {
+        tin->GetEntry(entry);
+        tout->Fill();
+    }
+    tout->Write("", TObject::kOverwrite);
+    fout->Close();
+}
+
+/// Copy the TObjString metadata (schemas, split provenance) and split_refs.
+void copy_metadata(const std::string &in_path, const std::string &out_path)
+{
+    std::unique_ptr<TFile> fin(TFile::Open(in_path.c_str(), "READ"));
+    std::unique_ptr<TFile> fout(TFile::Open(out_path.c_str(), "UPDATE"));
+    if (!fin || fin->IsZombie() || !fout || fout->IsZombie())
+    {
+        throw std::runtime_error("compact: failed to copy metadata from " + in_path + " to " + out_path);
+    }
+
+    TIter next(fin->GetListOfKeys());
+    while (auto *key = static_cast<TKey *>(next()))
+    {
+        const std::string name = key->GetName();
+        const std::string cls = key->GetClassName();
+        if (cls == "TObjString")
+        {
+            std::unique_ptr<TObject> obj(key->ReadObj());
+            fout->cd();
+            obj->Write(name.c_str(), TObject::kOverwrite);
+        }
+        else if (name == "split_refs")
+        {
+            auto *t = dynamic_cast<TTree *>(key->ReadObj());
+            if (t)
+            {
+                fout->cd();
+                std::unique_ptr<TTree> copy(t->CloneTree(-1, "fast"));
+                copy->Write(name.c_str(), TObject::kOverwrite);
+            }
+        }
+    }
+    fout->Close();
+}
+
+} // namespace
+
+int run(const CompactArgs &compact_args, const std::string &log_prefix)
+{
+    const auto start_time = std::chrono::steady_clock::now();
+    log_info(log_prefix,
+             "action=compact status=start input=" + compact_args.event_list_path +
+                 " output=" + compact_args.output_path +
+                 " compression=" + compact_args.compression +
+                 " sort=" + (compact_args.sort ? "run_sub_evt" : "none"));
+
+    StatusMonitor status_monitor(
+        log_prefix,
+        "action=compact status=running message=processing");
+
+    const int compression = compression_settings(compact_args.compression);
+    const nu::EventListIO event_list(compact_args.event_list_path);
+    const std::string tree_name = event_list.event_tree();
+
+    log_stage(log_prefix, "measure_input", "bench=" + std::string(compact_args.bench ? "1" : "0"));
+    const TreeReport before = report_tree(compact_args.event_list_path, tree_name, compact_args.bench);
+    log_report(log_prefix, "input", before, compact_args.bench);
+
+    Long64_t cluster_entries = compact_args.cluster_entries;
+    if (cluster_entries <= 0)
+    {
+        const double raw_per_entry = before.entries > 0 ? before.raw_mb / static_cast<double>(before.entries) : 0.0;
+        cluster_entries = raw_per_entry > 0.0
+                              ? std::max<Long64_t>(1, static_cast<Long64_t>(compact_args.cluster_mb / raw_per_entry))
+                              : 1000;
+    }
+
+    log_stage(log_prefix, "scan_keys", "sort=" + std::string(compact_args.sort ? "1" : "0"));
+    const std::map<int, std::vector<Long64_t>> by_sample =
+        sample_entries(compact_args.event_list_path, tree_name, compact_args.sort);
+
+    // One part per sample, written in parallel, then fast-merged in
+    // sample_id order: clusters are uniform within a sample and never
+    // straddle two samples, so sample entry ranges stay cluster-aligned.
+    const std::string part_stem = compact_args.output_path + ".part" + std::to_string(::getpid()) + "_";
+    std::vector<std::pair<int, std::string>> parts;
+    for (const auto &kv : by_sample)
+    {
+        parts.emplace_back(kv.first, part_stem + std::to_string(kv.first) + ".root");
+    }
+
+    log_stage(log_prefix,
+              "rewrite",
+              "samples=" + std::to_string(parts.size()) +
+                  " jobs=" + std::to_string(compact_args.jobs) +
+                  " cluster_entries=" + std::to_string(cluster_entries));
+
+    ROOT::EnableThreadSafety();
+    std::atomic<size_t> next_part{0};
+    std::mutex error_mutex;
+    std::string first_error;
+    std::vector<std::thread> workers;
+    const size_t n_workers = std::min(parts.size(), static_cast<size_t>(compact_args.jobs));
+    for (size_t w = 0; w < n_workers; ++w)
+    {
+        workers.emplace_back(
+            [&]()
+            {
+                for (size_t k = next_part++; k < parts.size(); k = next_part++)
+                {
+                    try
+                    {
+                        write_part(compact_args.event_list_path,
+                                   parts[k].second,
+                                   tree_name,
+                                   by_sample.at(parts[k].first),
+                                   compact_args,
+                                   compression,
+                                   cluster_entries);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (first_error.empty())
+                        {
+                            first_error = e.what();
+                        }
+                    }
+                }
+            });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    auto remove_parts = [&parts]()
+    {
+        for (const auto &part : parts)
+        {
+            std::error_code ec;
+            std::filesystem::remove(part.second, ec);
+        }
+    };
+    if (!first_error.empty())
+    {
+        remove_parts();
+        throw std::runtime_error(first_error);
+    }
+
+    int n_samples = 0;
+    for (const auto &kv : event_list.sample_refs())
+    {
+        n_samples = std::max(n_samples, kv.first + 1);
+    }
+    std::vector<nu::SampleInfo> sample_refs(static_cast<size_t>(n_samples));
+    for (const auto &kv : event_list.sample_refs())
+    {
+        sample_refs[static_cast<size_t>(kv.first)] = kv.second;
+    }
+
+    log_stage(log_prefix, "merge", "output=" + compact_args.output_path);
+    nu::EventListIO::init(compact_args.output_path, event_list.header(), sample_refs, "", "");
+    copy_metadata(compact_args.event_list_path, compact_args.output_path);
+    for (const auto &part : parts)
+    {
+        SnapshotService::append_tree(compact_args.output_path, part.second, tree_name);
+        std::error_code ec;
+        std::filesystem::remove(part.second, ec);
+    }
+
+    const nu::EventListIO compacted(compact_args.output_path);
+    compacted.build_event_index();
+    compacted.build_zone_maps(nu::EventListIO::default_zone_map_columns());
+
+    status_monitor.stop();
+
+    log_stage(log_prefix, "measure_output", "bench=" + std::string(compact_args.bench ? "1" : "0"));
+    const TreeReport after = report_tree(compact_args.output_path, tree_name, compact_args.bench);
+    log_report(log_prefix, "output", after, compact_args.bench);
+    if (after.entries != before.entries)
+    {
+        throw std::runtime_error("compact: entry count changed (" + std::to_string(before.entries) + " -> " +
+                                 std::to_string(after.entries) + ")");
+    }
+
+    const double elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start_time)
+            .count();
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "action=compact status=complete output=" << compact_args.output_path
+        << " size_ratio=" << (before.file_mb > 0.0 ? after.file_mb / before.file_mb : 0.0);
+    if (compact_args.bench && before.read_seconds > 0.0 && after.read_seconds > 0.0)
+    {
+        out << " read_speedup=" << before.read_seconds / after.read_seconds;
+    }
+    out << " elapsed_s=" << std::setprecision(1) << elapsed_seconds;
+    log_success(log_prefix, out.str());
+
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -90,6 +91,81 @@ ROOT::RDF::RNode add_event_weight_defaults(ROOT::RDF::RNode node)
     return node;
 }
 
+std::vector<std::string> encoded_weight_columns(const std::vector<std::string> &columns)
+{
+    // Opt-in: HERON_ENCODE_UNIVERSE_WEIGHTS=1 stores universe vectors compactly.
+    const char *flag = getenv_cstr("HERON_ENCODE_UNIVERSE_WEIGHTS");
+    if (!flag || std::string(flag) == "0")
+    {
+        return {};
+    }
+
+    std::vector<std::string> encoded;
+    for (const char *name : {
+             "weightsGenie", "weightsPPFX", "weightsFlux",
+             "weightsReint", "weightsGenieUp", "weightsGenieDn"})
+    {
+        if (std::find(columns.begin(), columns.end(), name) != columns.end())
+        {
+            encoded.emplace_back(name);
+        }
+    }
+    return encoded;
+}
+
+std::vector<std::string> sparse_image_columns(const std::vector<std::string> &columns)
+{
+    // Opt-in: HERON_SPARSE_IMAGES=1 stores the mostly empty images sparse.
+    const char *flag = getenv_cstr("HERON_SPARSE_IMAGES");
+    if (!flag || std::string(flag) == "0")
+    {
+        return {};
+    }
+
+    std::vector<std::string> sparse;
+    for (const auto &name : columns)
+    {
+        if (name.rfind("detector_image_", 0) == 0 || name.rfind("semantic_image_", 0) == 0)
+        {
+            sparse.push_back(name);
+        }
+    }
+    return sparse;
+}
+
+std::vector<CalibratedScoreColumn> score_calibration_columns(const std::string &log_prefix)
+{
+    // Opt-in: HERON_SCORE_CALIBRATION=<calib.root> adds calibrated columns for
+    // the first inference score from a saved LogitCalibrator.
+    const char *path = getenv_cstr("HERON_SCORE_CALIBRATION");
+    if (!path || std::string(path).empty())
+    {
+        return {};
+    }
+
+    const heron::LogitCalibrator calibrator = heron::LogitCalibrator::load_from_root(path);
+    const std::pair<const char *, CalibratedScoreKernel::Output> outputs[] = {
+        {"inf_score_0_prob", CalibratedScoreKernel::Output::kProb},
+        {"inf_score_0_llr", CalibratedScoreKernel::Output::kLLR}};
+
+    std::vector<CalibratedScoreColumn> columns;
+    for (const auto &output : outputs)
+    {
+        CalibratedScoreKernel::Config cfg;
+        cfg.output = output.second;
+
+        CalibratedScoreColumn column;
+        column.name = output.first;
+        column.input = "inf_scores";
+        column.index = 0;
+        column.kernel = std::make_shared<const CalibratedScoreKernel>(calibrator, cfg);
+        columns.push_back(std::move(column));
+    }
+
+    log_stage(log_prefix, "score_calibration", std::string("calibration=") + path);
+    return columns;
+}
+
 } // namespace
 
 int run(const EventArgs &event_args, const std::string &log_prefix)
@@ -145,6 +221,18 @@ int run(const EventArgs &event_args, const std::string &log_prefix)
                           column_provider.schema_tag());
     nu::EventListIO event_io(event_args.output_root,
                              nu::EventListIO::OpenMode::kUpdate);
+    const std::vector<std::string> encoded_columns = encoded_weight_columns(column_provider.columns());
+    const std::vector<std::string> sparse_columns = sparse_image_columns(column_provider.columns());
+
+    const std::vector<CalibratedScoreColumn> calibrated_columns = score_calibration_columns(log_prefix);
+    std::vector<std::string> snapshot_columns = column_provider.columns();
+    for (const auto &column : calibrated_columns)
+    {
+        if (std::find(snapshot_columns.begin(), snapshot_columns.end(), column.name) == snapshot_columns.end())
+        {
+            snapshot_columns.push_back(column.name);
+        }
+    }
 
     for (size_t i = 0; i < inputs.size(); ++i)
     {
@@ -180,6 +268,7 @@ int run(const EventArgs &event_args, const std::string &log_prefix)
             "sample=" + sample.sample_name);
 
         ROOT::RDF::RNode node = processor.define(rdf, proc_entry);
+        node = ColumnDerivationService::define_calibrated_scores(node, calibrated_columns);
         node = add_event_weight_defaults(node);
 
         const char *filter_stage = EventSampleFilterService::filter_stage(sample.origin);
@@ -206,9 +295,11 @@ int run(const EventArgs &event_args, const std::string &log_prefix)
             event_io.snapshot_event_list_merged(node,
                                                 sample_id,
                                                 sample.sample_name,
-                                                column_provider.columns(),
+                                                snapshot_columns,
                                                 event_args.selection,
-                                                output_event_tree);
+                                                output_event_tree,
+                                                encoded_columns,
+                                                sparse_columns);
 
         std::ostringstream log_message;
         log_message << "action=event_snapshot status=complete analysis=" << analysis.name()
@@ -223,6 +314,25 @@ int run(const EventArgs &event_args, const std::string &log_prefix)
         }
         log_success(log_prefix, log_message.str());
     }
+    log_stage(
+        log_prefix,
+        "event_index",
+        "output=" + event_args.output_root);
+    const ULong64_t n_indexed = event_io.build_event_index();
+    log_stage(
+        log_prefix,
+        "event_index",
+        "entries=" + std::to_string(n_indexed));
+    std::string zone_columns;
+    for (const auto &name : event_io.build_zone_maps(nu::EventListIO::default_zone_map_columns()))
+    {
+        zone_columns += (zone_columns.empty() ? "" : ",") + name;
+    }
+    log_stage(
+        log_prefix,
+        "zone_map",
+        "columns=" + (zone_columns.empty() ? std::string("none") : zone_columns));
+
     status_monitor.stop();
 
     const auto end_time = std::chrono::steady_clock::now();
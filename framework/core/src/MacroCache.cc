@@ -0,0 +1,271 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/src/MacroCache.cc
+ *
+ *  @brief Content-addressed cache of ACLiC-compiled macro libraries.
+ */
+
+#include "MacroCache.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include <TROOT.h>
+#include <TSystem.h>
+
+#include "AppLog.hh"
+#include "AppUtils.hh"
+
+namespace
+{
+
+constexpr std::uint64_t kFnvOffset = 1469598103934665603ULL;
+constexpr std::uint64_t kFnvPrime = 1099511628211ULL;
+
+void mix(std::uint64_t &h, const std::string &bytes)
+{
+    for (unsigned char c : bytes)
+    {
+        h = (h ^ c) * kFnvPrime;
+    }
+    // Separator so that ("ab", "c") and ("a", "bc") differ.
+    h = (h ^ 0xffu) * kFnvPrime;
+}
+
+std::string to_hex(std::uint64_t h, int digits)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return std::string(buf + 16 - digits);
+}
+
+std::string read_file(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/// Names of the quoted includes of a source file, in order.
+std::vector<std::string> quoted_includes(const std::string &source)
+{
+    std::vector<std::string> out;
+    std::istringstream in(source);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const std::string text = trim(line);
+        if (text.empty() || text[0] != '#')
+        {
+            continue;
+        }
+        const std::string directive = trim(text.substr(1));
+        if (directive.compare(0, 7, "include") != 0)
+        {
+            continue;
+        }
+        const size_t open = directive.find('"');
+        const size_t close = open == std::string::npos ? open : directive.find('"', open + 1);
+        if (close != std::string::npos)
+        {
+            out.push_back(directive.substr(open + 1, close - open - 1));
+        }
+    }
+    return out;
+}
+
+std::string stem_prefix(const std::filesystem::path &macro_path)
+{
+    std::uint64_t h = kFnvOffset;
+    std::error_code ec;
+    const auto canonical = std::filesystem::weakly_canonical(macro_path, ec);
+    mix(h, (ec ? macro_path : canonical).string());
+    return macro_path.stem().string() + "-" + to_hex(h, 8) + "-";
+}
+
+/// Written in place of a library when ACLiC fails for a key.
+constexpr const char *kFailedMarker = "failed";
+
+std::filesystem::path find_library(const std::filesystem::path &dir)
+{
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec))
+    {
+        return {};
+    }
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(dir, ec))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".so")
+        {
+            return entry.path();
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+MacroCache::MacroCache(std::filesystem::path cache_dir,
+                       std::vector<std::filesystem::path> include_dirs,
+                       std::vector<std::filesystem::path> libraries)
+    : cache_dir_(std::move(cache_dir)),
+      include_dirs_(std::move(include_dirs)),
+      libraries_(std::move(libraries))
+{
+}
+
+bool MacroCache::enabled()
+{
+    const char *value = getenv_cstr("HERON_MACRO_CACHE");
+    return value == nullptr || std::string(value) != "0";
+}
+
+void MacroCache::hash_file(const std::filesystem::path &path,
+                           std::uint64_t &h,
+                           std::vector<std::filesystem::path> &seen) const
+{
+    std::error_code ec;
+    const auto canonical = std::filesystem::weakly_canonical(path, ec);
+    const auto &id = ec ? path : canonical;
+    if (std::find(seen.begin(), seen.end(), id) != seen.end())
+    {
+        return;
+    }
+    seen.push_back(id);
+
+    const std::string source = read_file(path);
+    mix(h, id.string());
+    mix(h, source);
+
+    for (const auto &name : quoted_includes(source))
+    {
+        std::vector<std::filesystem::path> candidates{path.parent_path() / name};
+        for (const auto &dir : include_dirs_)
+        {
+            candidates.push_back(dir / name);
+        }
+        for (const auto &candidate : candidates)
+        {
+            if (std::filesystem::is_regular_file(candidate, ec))
+            {
+                hash_file(candidate, h, seen);
+                break;
+            }
+        }
+    }
+}
+
+std::string MacroCache::key(const std::filesystem::path &macro_path) const
+{
+    std::uint64_t h = kFnvOffset;
+    mix(h, gROOT->GetVersion());
+    mix(h, gROOT->GetGitCommit());
+    mix(h, gSystem->GetMakeSharedLib());
+    mix(h, gSystem->GetFlagsOpt());
+    for (const auto &dir : include_dirs_)
+    {
+        mix(h, dir.string());
+    }
+
+    for (const auto &lib : libraries_)
+    {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(lib, ec);
+        const auto mtime = std::filesystem::last_write_time(lib, ec);
+        mix(h, lib.string());
+        mix(h, std::to_string(ec ? 0 : size) + ":" +
+                   std::to_string(ec ? 0 : mtime.time_since_epoch().count()));
+    }
+
+    std::vector<std::filesystem::path> seen;
+    hash_file(macro_path, h, seen);
+    return to_hex(h, 16);
+}
+
+std::filesystem::path MacroCache::entry_dir(const std::filesystem::path &macro_path, const std::string &key) const
+{
+    return cache_dir_ / (stem_prefix(macro_path) + key);
+}
+
+bool MacroCache::load(const std::filesystem::path &macro_path) const
+{
+    const std::string cache_key = key(macro_path);
+    const std::filesystem::path entry = entry_dir(macro_path, cache_key);
+
+    std::error_code ec;
+    if (std::filesystem::exists(entry / kFailedMarker, ec))
+    {
+        log_info("heron", "action=macro_cache status=known_failure macro=" + macro_path.filename().string() +
+                              " key=" + cache_key);
+        return false;
+    }
+
+    const std::filesystem::path cached = find_library(entry);
+    if (!cached.empty())
+    {
+        if (gSystem->Load(cached.string().c_str()) >= 0)
+        {
+            log_info("heron", "action=macro_cache status=hit macro=" + macro_path.filename().string() +
+                                  " key=" + cache_key);
+            return true;
+        }
+        log_warning("heron", "action=macro_cache status=unloadable library=" + cached.string());
+    }
+
+    // Build into a private directory and publish it by rename, so concurrent
+    // invocations (e.g. `heron macro --batch`) never see a half-written entry.
+    const std::filesystem::path staging =
+        cache_dir_ / (stem_prefix(macro_path) + cache_key + ".tmp" + std::to_string(::getpid()));
+    std::filesystem::remove_all(staging, ec);
+    std::filesystem::create_directories(staging, ec);
+    if (ec)
+    {
+        log_warning("heron", "action=macro_cache status=unwritable dir=" + staging.string());
+        return false;
+    }
+
+    for (const auto &dir : include_dirs_)
+    {
+        gSystem->AddIncludePath(("-I" + dir.string()).c_str());
+    }
+
+    log_info("heron", "action=macro_cache status=build macro=" + macro_path.filename().string() +
+                          " key=" + cache_key);
+    const int ok = gSystem->CompileMacro(macro_path.string().c_str(), "kO", "", staging.string().c_str());
+    if (ok != 1)
+    {
+        // Publish a negative entry so unchanged sources go straight to the
+        // interpreter instead of failing the same build on every run.
+        std::filesystem::remove_all(staging, ec);
+        std::filesystem::create_directories(staging, ec);
+        std::ofstream(staging / kFailedMarker) << cache_key << "\n";
+    }
+
+    std::filesystem::remove_all(entry, ec);
+    std::filesystem::rename(staging, entry, ec);
+    if (ec)
+    {
+        // Another process published the same key first; keep its entry.
+        std::filesystem::remove_all(staging, ec);
+    }
+
+    const std::string prefix = stem_prefix(macro_path);
+    for (const auto &item : std::filesystem::directory_iterator(cache_dir_, ec))
+    {
+        const std::string name = item.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 && item.path() != entry &&
+            name.find(".tmp") == std::string::npos)
+        {
+            std::error_code rm_ec;
+            std::filesystem::remove_all(item.path(), rm_ec);
+        }
+    }
+    return ok == 1;
+}
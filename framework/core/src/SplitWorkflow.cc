@@ -0,0 +1,320 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/src/SplitWorkflow.cc
+ *
+ *  @brief Deterministic train/validation/test split of an event list
+ *         (invoked by the unified heron CLI).
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <TFile.h>
+#include <TH2D.h>
+#include <TKey.h>
+#include <TObjString.h>
+
+#include "AppLog.hh"
+#include "AppUtils.hh"
+#include "EventListIO.hh"
+#include "SnapshotService.hh"
+#include "SparseImageCodec.hh"
+#include "SplitCLI.hh"
+#include "StatusMonitor.hh"
+#include "UniverseWeightCodec.hh"
+
+namespace
+{
+
+constexpr std::uint64_t kHashRange = std::uint64_t{1} << 63;
+
+std::uint64_t splitmix64(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/// 63-bit hash of the event key; independent of file order, threads and
+/// whatever else is in the event list.
+std::uint64_t event_hash(std::uint64_t seed, int run, int sub, int evt, int sample_id)
+{
+    std::uint64_t h = splitmix64(seed);
+    for (int v : {run, sub, evt, sample_id})
+    {
+        h = splitmix64(h ^ static_cast<std::uint32_t>(v));
+    }
+    return h >> 1;
+}
+
+/// Upper hash bound of each split: event -> first k with hash < cuts[k].
+using SplitCuts = std::vector<std::uint64_t>;
+
+SplitCuts uniform_cuts(const std::vector<double> &fractions)
+{
+    SplitCuts cuts;
+    double cumulative = 0.0;
+    for (size_t k = 0; k + 1 < fractions.size(); ++k)
+    {
+        cumulative += fractions[k];
+        cuts.push_back(static_cast<std::uint64_t>(std::min(cumulative, 1.0) * static_cast<double>(kHashRange)));
+    }
+    cuts.push_back(std::numeric_limits<std::uint64_t>::max());
+    return cuts;
+}
+
+int assign_split(const SplitCuts &cuts, std::uint64_t hash)
+{
+    for (size_t k = 0; k < cuts.size(); ++k)
+    {
+        if (hash < cuts[k])
+        {
+            return static_cast<int>(k);
+        }
+    }
+    return static_cast<int>(cuts.size()) - 1;
+}
+
+/// Events per split of each stratum, keyed (stratum, split).
+using StratumCounts = std::map<std::pair<int, int>, ULong64_t>;
+
+std::string split_spec(const SplitArgs &args)
+{
+    std::ostringstream out;
+    out << "seed=" << args.seed << " fractions=";
+    for (size_t k = 0; k < args.fractions.size(); ++k)
+    {
+        out << (k ? "," : "") << args.names[k] << ":" << std::setprecision(6) << args.fractions[k];
+    }
+    out << " stratify=" << (args.stratify.empty() ? "none" : args.stratify)
+        << " weight=" << args.weight
+        << " hash=splitmix64(run,sub,evt,sample_id)";
+    return out.str();
+}
+
+/// Copy every event_schema* string and the encoded image and weight column
+/// lists of the input event list.
+void copy_event_schemas(const std::string &in_path, const std::string &out_path)
+{
+    std::unique_ptr<TFile> fin(TFile::Open(in_path.c_str(), "READ"));
+    std::unique_ptr<TFile> fout(TFile::Open(out_path.c_str(), "UPDATE"));
+    if (!fin || fin->IsZombie() || !fout || fout->IsZombie())
+    {
+        throw std::runtime_error("split: failed to copy event schema from " + in_path + " to " + out_path);
+    }
+
+    TIter next(fin->GetListOfKeys());
+    while (auto *key = static_cast<TKey *>(next()))
+    {
+        const std::string name = key->GetName();
+        if (name.rfind("event_schema", 0) != 0 && name != nu::SparseImageCodec::kColumnsKey &&
+            name != nu::UniverseWeightCodec::kColumnsKey)
+        {
+            continue;
+        }
+        if (auto *s = dynamic_cast<TObjString *>(key->ReadObj()))
+        {
+            fout->cd();
+            s->Write(name.c_str(), TObject::kOverwrite);
+            delete s;
+        }
+    }
+    fout->Close();
+}
+
+} // namespace
+
+int run(const SplitArgs &split_args, const std::string &log_prefix)
+{
+    ROOT::EnableImplicitMT();
+
+    const auto start_time = std::chrono::steady_clock::now();
+    log_info(log_prefix,
+             "action=split status=start input=" + split_args.event_list_path +
+                 " output=" + split_args.output_dir);
+
+    StatusMonitor status_monitor(
+        log_prefix,
+        "action=split status=running message=processing");
+
+    const nu::EventListIO event_list(split_args.event_list_path);
+    const int n_splits = static_cast<int>(split_args.names.size());
+
+    int n_samples = 0;
+    for (const auto &kv : event_list.sample_refs())
+    {
+        n_samples = std::max(n_samples, kv.first + 1);
+    }
+    if (n_samples == 0)
+    {
+        throw std::runtime_error("split: no sample_refs in " + split_args.event_list_path);
+    }
+
+    // Encoded image and weight branches are copied as stored; friend-tree
+    // columns are copied once, under their unqualified names.
+    ROOT::RDF::RNode node = event_list.rdf();
+    std::vector<std::string> columns;
+    for (const auto &c : node.GetColumnNames())
+    {
+        if (c.find('.') == std::string::npos)
+        {
+            columns.push_back(c);
+        }
+    }
+
+    // Every stratum uses the same fixed hash thresholds, so an event's split
+    // depends only on its key and the seed; --stratify reports how each
+    // stratum came out, from the same loop as the snapshots.
+    const SplitCuts cuts = uniform_cuts(split_args.fractions);
+    const std::uint64_t seed = split_args.seed;
+    node = node.Define("__split__",
+                       [seed, &cuts](int run, int sub, int evt, int sample_id)
+                       {
+                           return assign_split(cuts, event_hash(seed, run, sub, evt, sample_id));
+                       },
+                       {"run", "sub", "evt", "sample_id"});
+
+    ROOT::RDF::RResultPtr<StratumCounts> stratum_counts;
+    if (!split_args.stratify.empty())
+    {
+        log_stage(log_prefix, "stratify", "column=" + split_args.stratify);
+        auto keyed = node.Define("__split_stratum__", "static_cast<int>(" + split_args.stratify + ")")
+                         .Define("__split_stratum_key__",
+                                 [](int stratum, int split) { return std::make_pair(stratum, split); },
+                                 {"__split_stratum__", "__split__"});
+        stratum_counts = keyed.Aggregate(
+            [](StratumCounts &acc, const std::pair<int, int> &key) { ++acc[key]; },
+            [](std::vector<StratumCounts> &parts)
+            {
+                for (size_t i = 1; i < parts.size(); ++i)
+                {
+                    for (const auto &kv : parts[i])
+                    {
+                        parts[0][kv.first] += kv.second;
+                    }
+                }
+            },
+            "__split_stratum_key__", StratumCounts{});
+    }
+    node = node.Define("__split_weight__", "static_cast<double>(" + split_args.weight + ")");
+
+    // Booked on the same graph as the snapshots, so filled in the same loop.
+    const ROOT::RDF::TH2DModel model("split_bookkeeping", "",
+                                     n_splits, -0.5, n_splits - 0.5,
+                                     n_samples, -0.5, n_samples - 0.5);
+    auto counts = node.Histo2D<int, int>(model, "__split__", "sample_id");
+    auto weights = node.Histo2D<int, int, double>(model, "__split__", "sample_id", "__split_weight__");
+
+    std::vector<nu::SampleInfo> sample_refs(static_cast<size_t>(n_samples));
+    for (const auto &kv : event_list.sample_refs())
+    {
+        sample_refs[static_cast<size_t>(kv.first)] = kv.second;
+    }
+
+    std::filesystem::create_directories(split_args.output_dir);
+    std::vector<std::string> out_paths;
+    for (const auto &name : split_args.names)
+    {
+        out_paths.push_back((std::filesystem::path(split_args.output_dir) / (name + ".root")).string());
+        nu::EventListIO::init(out_paths.back(), event_list.header(), sample_refs, "", "");
+        copy_event_schemas(split_args.event_list_path, out_paths.back());
+    }
+
+    log_stage(log_prefix, "write_splits", "splits=" + std::to_string(n_splits) + " spec=" + split_spec(split_args));
+    const std::vector<ULong64_t> written =
+        SnapshotService::snapshot_event_list_splits(node, "__split__", out_paths, columns, event_list.event_tree());
+
+    const TH2D &h_counts = *counts;
+    const TH2D &h_weights = *weights;
+    const std::string spec = split_spec(split_args);
+    for (int k = 0; k < n_splits; ++k)
+    {
+        std::vector<nu::SplitSampleRef> refs;
+        for (const auto &kv : event_list.sample_refs())
+        {
+            const int sid = kv.first;
+            nu::SplitSampleRef r;
+            r.sample_id = sid;
+            for (int j = 0; j < n_splits; ++j)
+            {
+                const double n = h_counts.GetBinContent(j + 1, sid + 1);
+                const double w = h_weights.GetBinContent(j + 1, sid + 1);
+                r.n_events_total += static_cast<ULong64_t>(std::llround(n));
+                r.sum_weight_total += w;
+                if (j == k)
+                {
+                    r.n_events = static_cast<ULong64_t>(std::llround(n));
+                    r.sum_weight = w;
+                }
+            }
+            if (r.sum_weight_total != 0.0)
+            {
+                r.exposure_fraction = r.sum_weight / r.sum_weight_total;
+            }
+            else if (r.n_events_total > 0)
+            {
+                r.exposure_fraction = static_cast<double>(r.n_events) / static_cast<double>(r.n_events_total);
+            }
+            refs.push_back(r);
+        }
+
+        nu::EventListIO::write_split_refs(out_paths[k], split_args.names[k], spec, refs);
+        const nu::EventListIO split_list(out_paths[k]);
+        split_list.build_event_index();
+        split_list.build_zone_maps(nu::EventListIO::default_zone_map_columns());
+
+        log_info(log_prefix,
+                 "action=split name=" + split_args.names[k] +
+                     " events=" + format_count(static_cast<long long>(written[k])) +
+                     " output=" + out_paths[k]);
+    }
+
+    if (stratum_counts)
+    {
+        std::map<int, std::vector<ULong64_t>> by_stratum;
+        for (const auto &kv : *stratum_counts)
+        {
+            auto &row = by_stratum[kv.first.first];
+            row.resize(static_cast<size_t>(n_splits), 0);
+            row[static_cast<size_t>(kv.first.second)] = kv.second;
+        }
+        for (const auto &kv : by_stratum)
+        {
+            std::ostringstream line;
+            line << "action=split stratum=" << kv.first << " events=";
+            for (int k = 0; k < n_splits; ++k)
+            {
+                line << (k ? "," : "") << split_args.names[k] << ":" << kv.second[static_cast<size_t>(k)];
+            }
+            log_info(log_prefix, line.str());
+        }
+    }
+
+    status_monitor.stop();
+
+    const double elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start_time)
+            .count();
+
+    std::ostringstream out;
+    out << "action=split status=complete splits=" << n_splits
+        << " output=" << split_args.output_dir
+        << " elapsed_s=" << std::fixed << std::setprecision(1) << elapsed_seconds;
+    log_success(log_prefix, out.str());
+
+    return 0;
+}
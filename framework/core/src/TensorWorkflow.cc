@@ -0,0 +1,322 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/core/src/TensorWorkflow.cc
+ *
+ *  @brief Tensor shard export of event images (invoked by the unified heron CLI).
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+
+#include "AppLog.hh"
+#include "AppUtils.hh"
+#include "EventListIO.hh"
+#include "StatusMonitor.hh"
+#include "TensorCLI.hh"
+#include "TensorShardIO.hh"
+
+namespace
+{
+
+constexpr std::uint32_t kPlanes = 3;
+constexpr const char *kManifestSuffix = ".manifest";
+
+/// Shard file names listed in @p manifest, one per line; empty if it does not exist.
+std::vector<std::string> read_manifest(const std::filesystem::path &manifest)
+{
+    std::vector<std::string> names;
+    std::ifstream in(manifest);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty())
+        {
+            names.push_back(line);
+        }
+    }
+    return names;
+}
+
+void write_manifest(const std::filesystem::path &manifest, const std::vector<std::string> &names)
+{
+    const std::filesystem::path tmp = manifest.string() + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto &name : names)
+        {
+            out << name << "\n";
+        }
+        if (!out)
+        {
+            throw std::runtime_error("export-tensors: failed to write " + tmp.string());
+        }
+    }
+    std::filesystem::rename(tmp, manifest);
+}
+
+/// One shard writer per RDataFrame slot, so events stream to disk without locks.
+class ShardSink
+{
+  public:
+    ShardSink(const TensorArgs &args, std::string stem, unsigned int n_slots)
+        : m_args(args), m_stem(std::move(stem)), m_slots(n_slots)
+    {
+    }
+
+    void append(unsigned int slot,
+                const nu::TensorShardRecord &record,
+                const std::array<const ROOT::RVec<float> *, kPlanes> &images,
+                const std::array<const ROOT::RVec<int> *, kPlanes> *semantic)
+    {
+        const std::size_t n = images[0]->size();
+        for (std::uint32_t p = 0; p < kPlanes; ++p)
+        {
+            if (images[p]->size() != n || (semantic != nullptr && (*semantic)[p]->size() != n))
+            {
+                throw std::runtime_error("export-tensors: image planes differ in size for run=" +
+                                         std::to_string(record.run) + " sub=" + std::to_string(record.sub) +
+                                         " evt=" + std::to_string(record.evt));
+            }
+        }
+
+        Slot &s = m_slots[slot];
+        if (!s.writer || s.writer->full())
+        {
+            if (s.writer)
+            {
+                s.writer->close();
+            }
+            s.names.push_back(next_name(slot, s.n_shards++));
+            s.writer = std::make_unique<nu::TensorShardWriter>(
+                (std::filesystem::path(m_args.output_dir) / s.names.back()).string(), layout_for(n));
+        }
+        else if (n != m_plane_size)
+        {
+            throw std::runtime_error("export-tensors: image size " + std::to_string(n) +
+                                     " differs from " + std::to_string(m_plane_size));
+        }
+
+        std::array<const float *, kPlanes> image_ptrs{};
+        std::array<const int *, kPlanes> semantic_ptrs{};
+        for (std::uint32_t p = 0; p < kPlanes; ++p)
+        {
+            image_ptrs[p] = images[p]->data();
+            semantic_ptrs[p] = semantic != nullptr ? (*semantic)[p]->data() : nullptr;
+        }
+        s.writer->append(record, image_ptrs.data(), semantic != nullptr ? semantic_ptrs.data() : nullptr);
+        ++s.n_events;
+    }
+
+    /// Close every open shard; returns (shards, events).
+    std::pair<std::size_t, unsigned long long> close()
+    {
+        std::size_t n_shards = 0;
+        unsigned long long n_events = 0;
+        for (auto &s : m_slots)
+        {
+            if (s.writer)
+            {
+                s.writer->close();
+                s.writer.reset();
+            }
+            n_shards += s.n_shards;
+            n_events += s.n_events;
+        }
+        return {n_shards, n_events};
+    }
+
+    /// File names of every shard opened so far.
+    std::vector<std::string> names() const
+    {
+        std::vector<std::string> out;
+        for (const auto &s : m_slots)
+        {
+            out.insert(out.end(), s.names.begin(), s.names.end());
+        }
+        return out;
+    }
+
+  private:
+    struct Slot
+    {
+        std::unique_ptr<nu::TensorShardWriter> writer;
+        std::vector<std::string> names;
+        int n_shards = 0;
+        unsigned long long n_events = 0;
+    };
+
+    std::string next_name(unsigned int slot, int shard) const
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "_s%03u_%05d%s", slot, shard, nu::TensorShardReader::kShardSuffix);
+        return m_stem + name;
+    }
+
+    nu::TensorShardWriter::Layout layout_for(std::size_t plane_size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_plane_size == 0)
+        {
+            if (plane_size == 0)
+            {
+                throw std::runtime_error("export-tensors: empty detector image");
+            }
+            std::uint32_t width = m_args.width;
+            if (width == 0)
+            {
+                width = static_cast<std::uint32_t>(std::lround(std::sqrt(static_cast<double>(plane_size))));
+            }
+            if (width == 0 || plane_size % width != 0)
+            {
+                throw std::runtime_error("export-tensors: cannot infer image shape from " +
+                                         std::to_string(plane_size) + " pixels; pass --width");
+            }
+            m_plane_size = plane_size;
+            m_width = width;
+        }
+        else if (plane_size != m_plane_size)
+        {
+            throw std::runtime_error("export-tensors: image size " + std::to_string(plane_size) +
+                                     " differs from " + std::to_string(m_plane_size));
+        }
+
+        nu::TensorShardWriter::Layout layout;
+        layout.n_planes = kPlanes;
+        layout.width = m_width;
+        layout.height = static_cast<std::uint32_t>(m_plane_size / m_width);
+        layout.encoding = m_args.sparse ? nu::TensorShardWriter::Encoding::kSparse
+                                        : nu::TensorShardWriter::Encoding::kDense;
+        layout.semantic = m_args.semantic;
+        layout.capacity = m_args.events_per_shard;
+        return layout;
+    }
+
+    const TensorArgs &m_args;
+    std::string m_stem;
+    std::vector<Slot> m_slots;
+    std::mutex m_mutex;
+    std::size_t m_plane_size = 0;
+    std::uint32_t m_width = 0;
+};
+
+} // namespace
+
+int run(const TensorArgs &tensor_args, const std::string &log_prefix)
+{
+    ROOT::EnableImplicitMT();
+
+    const auto start_time = std::chrono::steady_clock::now();
+    log_info(log_prefix,
+             "action=tensor_export status=start input=" + tensor_args.event_list_path +
+                 " output=" + tensor_args.output_dir);
+
+    StatusMonitor status_monitor(
+        log_prefix,
+        "action=tensor_export status=running message=processing");
+
+    // Shards are named after the event list and listed in its manifest, so a
+    // rerun replaces only this dataset's shards in a shared output directory.
+    const std::filesystem::path output_dir(tensor_args.output_dir);
+    const std::string stem = std::filesystem::path(tensor_args.event_list_path).stem().string();
+    const std::filesystem::path manifest = output_dir / (stem + kManifestSuffix);
+    std::filesystem::create_directories(output_dir);
+    for (const auto &name : read_manifest(manifest))
+    {
+        const std::filesystem::path stale = output_dir / std::filesystem::path(name).filename();
+        if (stale.extension() == nu::TensorShardReader::kShardSuffix)
+        {
+            std::filesystem::remove(stale);
+        }
+    }
+    std::filesystem::remove(manifest);
+
+    nu::EventListIO event_list(tensor_args.event_list_path);
+    ROOT::RDF::RNode node = event_list.rdf_with_images();
+
+    log_stage(log_prefix, "select", "selection=" + tensor_args.selection);
+    node = node.Filter(tensor_args.selection, "tensor_selection")
+               .Define("__tensor_label__", "static_cast<int>(" + tensor_args.label + ")")
+               .Define("__tensor_weight__", "static_cast<float>(" + tensor_args.weight + ")");
+
+    const unsigned int n_slots = std::max(1u, ROOT::GetThreadPoolSize());
+    ShardSink sink(tensor_args, stem, n_slots);
+
+    auto make_record = [](int run, int sub, int evt, int sample_id, int label, float weight)
+    {
+        nu::TensorShardRecord r;
+        r.run = run;
+        r.sub = sub;
+        r.evt = evt;
+        r.sample_id = sample_id;
+        r.label = label;
+        r.weight = weight;
+        return r;
+    };
+
+    std::vector<std::string> columns = {"run", "sub", "evt", "sample_id", "__tensor_label__", "__tensor_weight__",
+                                        "detector_image_u", "detector_image_v", "detector_image_w"};
+
+    log_stage(log_prefix,
+              "write_shards",
+              std::string("encoding=") + (tensor_args.sparse ? "sparse" : "dense") +
+                  " events_per_shard=" + std::to_string(tensor_args.events_per_shard) +
+                  " slots=" + std::to_string(n_slots));
+
+    if (tensor_args.semantic)
+    {
+        columns.insert(columns.end(), {"semantic_image_u", "semantic_image_v", "semantic_image_w"});
+        node.ForeachSlot(
+            [&](unsigned int slot, int run, int sub, int evt, int sample_id, int label, float weight,
+                const ROOT::RVec<float> &u, const ROOT::RVec<float> &v, const ROOT::RVec<float> &w,
+                const ROOT::RVec<int> &su, const ROOT::RVec<int> &sv, const ROOT::RVec<int> &sw)
+            {
+                const std::array<const ROOT::RVec<int> *, kPlanes> semantic = {&su, &sv, &sw};
+                sink.append(slot, make_record(run, sub, evt, sample_id, label, weight), {&u, &v, &w}, &semantic);
+            },
+            columns);
+    }
+    else
+    {
+        node.ForeachSlot(
+            [&](unsigned int slot, int run, int sub, int evt, int sample_id, int label, float weight,
+                const ROOT::RVec<float> &u, const ROOT::RVec<float> &v, const ROOT::RVec<float> &w)
+            {
+                sink.append(slot, make_record(run, sub, evt, sample_id, label, weight), {&u, &v, &w}, nullptr);
+            },
+            columns);
+    }
+
+    const auto [n_shards, n_events] = sink.close();
+    write_manifest(manifest, sink.names());
+
+    status_monitor.stop();
+
+    const double elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start_time)
+            .count();
+
+    std::ostringstream out;
+    out << "action=tensor_export status=complete shards=" << n_shards
+        << " events=" << format_count(static_cast<long long>(n_events))
+        << " output=" << tensor_args.output_dir
+        << " elapsed_s=" << std::fixed << std::setprecision(1) << elapsed_seconds;
+    log_success(log_prefix, out.str());
+
+    return 0;
+}
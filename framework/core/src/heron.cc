@@ -7,10 +7,14 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -19,20 +23,35 @@
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <TInterpreter.h>
 #include <TROOT.h>
 #include <TSystem.h>
 
 #include "ArtCLI.hh"
+#include "CompactCLI.hh"
 #include "EventCLI.hh"
 #include "AppUtils.hh"
+#include "MacroCache.hh"
 #include "SampleCLI.hh"
+#include "SplitCLI.hh"
+#include "TensorCLI.hh"
 
 
 const char *kUsageMacro =
     "Usage: heron macro MACRO.C [CALL]\n"
     "       heron macro list\n"
+    "       heron macro --batch MANIFEST [--jobs N] [--threads-per-macro T]\n"
+    "\nBatch manifest: one 'MACRO.C [CALL]' per line; blank lines and '#' comments are skipped.\n"
+    "Macros run in forked workers sharing the preloaded libraries, at most N/T at a time;\n"
+    "each worker's output goes to HERON_PLOT_DIR/logs/<line>_<macro>.log.\n"
     "\nEnvironment:\n"
+    "  HERON_MACRO_JOBS   Core budget for --batch (default: hardware threads)\n"
+    "  HERON_MACRO_CACHE      Set to 0 to interpret macros instead of using compiled libraries\n"
+    "  HERON_MACRO_CACHE_DIR  Compiled macro cache (default: <repo>/build/macro-cache)\n"
     "  HERON_MACRO_LIBRARY_DIR  In-repo macro library directory (default: <repo>/macros/library)\n"
     "  HERON_MACRO_PATH         Colon-separated extra macro directories (searched after library)\n"
     "  HERON_PLOT_BASE    Plot base directory (default: <repo>/scratch/plot)\n"
@@ -40,6 +59,34 @@ const char *kUsageMacro =
     "  HERON_PLOT_FORMAT  Output extension (default: pdf)\n"
     "  HERON_SET          Workspace selector (default: out)\n";
 
+const char *kUsageExportTensors =
+    "Usage: heron export-tensors EVENT_LIST.root OUTPUT_DIR [--selection EXPR] [--label EXPR]\n"
+    "                            [--weight EXPR] [--events-per-shard N] [--width W] [--sparse] [--no-semantic]\n"
+    "\nDefaults: selection=true label=is_signal weight=w_nominal events-per-shard=1024;\n"
+    "width is inferred for square images.\n"
+    "\nEnvironment:\n"
+    "  HERON_TENSOR_DIR   Output base for bare OUTPUT_DIR names (default: <out>/<set>/tensor)\n";
+
+const char *kUsageSplit =
+    "Usage: heron split EVENT_LIST.root OUTPUT_DIR [--fractions F1,F2,...] [--names N1,N2,...]\n"
+    "                   [--seed N] [--stratify COLUMN] [--weight EXPR]\n"
+    "\nDefaults: fractions=0.8,0.1,0.1 names=train,val,test seed=0 weight=w_nominal.\n"
+    "Events are assigned by a hash of (run, sub, evt, sample_id, seed) against fixed\n"
+    "thresholds; --stratify logs the per-split counts of every value of COLUMN.\n"
+    "Writes OUTPUT_DIR/<name>.root per split in one pass over the event list.\n"
+    "\nEnvironment:\n"
+    "  HERON_SPLIT_DIR    Output base for bare OUTPUT_DIR names (default: <out>/<set>/split)\n";
+
+const char *kUsageCompact =
+    "Usage: heron compact EVENT_LIST.root OUTPUT.root [--compression ALG:LEVEL] [--cluster-entries N]\n"
+    "                     [--cluster-mb MB] [--sort] [--drop B1,B2,...] [--jobs N] [--no-bench]\n"
+    "\nDefaults: compression=zstd:5 cluster-mb=50 jobs=<hardware threads>.\n"
+    "Rewrites the event tree with uniform clusters (sized from --cluster-mb of uncompressed data\n"
+    "unless --cluster-entries is given), the chosen compression (zlib, lzma, lz4, zstd) and\n"
+    "without the --drop branches (ROOT wildcards allowed). --sort orders each sample by\n"
+    "(run, sub, evt). Samples are rewritten in parallel and stay contiguous; the event index and\n"
+    "zone maps are rebuilt. Reports size and sequential read throughput before and after.\n";
+
 bool is_help_arg(const std::string &arg)
 {
     return arg == "-h" || arg == "--help";
@@ -100,6 +147,9 @@ void print_main_help(std::ostream &out)
         << "  art         Aggregate art provenance for an input\n"
         << "  sample      Aggregate Sample ROOT files from art provenance\n"
         << "  event       Build event-level output from aggregated samples\n"
+        << "  export-tensors  Export event images into memory-mappable tensor shards\n"
+        << "  split       Split an event list into train/validation/test event lists\n"
+        << "  compact     Rewrite an event list with uniform clusters and new compression\n"
         << "  macro       Run ROOT macros (plotting or standalone)\n"
         << "  status      Log status for executable binaries\n"
         << "  paths       Print resolved workspace paths\n"
@@ -464,6 +514,32 @@ bool is_plot_macro(const std::filesystem::path &repo_root,
     return it != rel.end() && *it == "macro";
 }
 
+MacroCache make_macro_cache(const std::filesystem::path &repo_root)
+{
+    std::vector<std::filesystem::path> include_dirs{repo_root / "framework" / "core" / "include"};
+    for (const char *module : {"io", "ana", "plot", "evd"})
+    {
+        include_dirs.push_back(repo_root / "framework" / "modules" / module / "include");
+    }
+    include_dirs.push_back(macro_repo_dir(repo_root));
+
+    std::vector<std::filesystem::path> libraries;
+    const auto lib_dir = repo_root / "build" / "lib";
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(lib_dir, ec))
+    {
+        if (entry.path().extension() == ".so")
+        {
+            libraries.push_back(entry.path());
+        }
+    }
+    std::sort(libraries.begin(), libraries.end());
+
+    const auto cache_dir = path_from_env_or_default("HERON_MACRO_CACHE_DIR",
+                                                    repo_root / "build" / "macro-cache");
+    return MacroCache(cache_dir, include_dirs, libraries);
+}
+
 int exec_root_macro(const std::filesystem::path &repo_root,
                     const std::filesystem::path &macro_path,
                     const std::string &call_cmd)
@@ -481,6 +557,19 @@ int exec_root_macro(const std::filesystem::path &repo_root,
     }
 
     const bool has_call = !call_cmd.empty();
+    if (MacroCache::enabled())
+    {
+        if (make_macro_cache(repo_root).load(macro_path))
+        {
+            // Same entry point as ".x MACRO.C": the function named after the file.
+            const std::string call = has_call ? call_cmd : macro_path.stem().string() + "()";
+            const long result = gROOT->ProcessLine(call.c_str());
+            return static_cast<int>(result);
+        }
+        log_warning("heron", "action=macro_cache status=fallback macro=" + macro_path.string() +
+                                 " message=compilation failed, interpreting");
+    }
+
     if (has_call)
     {
         const std::string load_cmd = ".L " + macro_path.string();
@@ -538,6 +627,264 @@ void print_macro_list(std::ostream &out, const std::filesystem::path &repo_root)
     list_macros(macro_root / "standalone", "Standalone macros in", "standalone/");
 }
 
+struct BatchMacro
+{
+    int line = 0;
+    std::string macro;
+    std::string call;
+};
+
+struct BatchOptions
+{
+    std::string manifest;
+    int jobs = 0;
+    int threads_per_macro = 1;
+};
+
+BatchOptions parse_batch_args(const std::vector<std::string> &args)
+{
+    BatchOptions opts;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        const std::string arg = trim(args[i]);
+        auto value = [&]() -> int
+        {
+            if (i + 1 >= args.size())
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            const int n = std::stoi(args[++i]);
+            if (n <= 0)
+            {
+                throw std::runtime_error(arg + " must be positive");
+            }
+            return n;
+        };
+
+        if (arg == "--jobs" || arg == "-j")
+        {
+            opts.jobs = value();
+        }
+        else if (arg == "--threads-per-macro")
+        {
+            opts.threads_per_macro = value();
+        }
+        else if (opts.manifest.empty() && !arg.empty() && arg[0] != '-')
+        {
+            opts.manifest = arg;
+        }
+        else
+        {
+            throw std::runtime_error(kUsageMacro);
+        }
+    }
+    if (opts.manifest.empty())
+    {
+        throw std::runtime_error(kUsageMacro);
+    }
+    if (opts.jobs == 0)
+    {
+        const char *env = getenv_cstr("HERON_MACRO_JOBS");
+        opts.jobs = env ? std::max(1, std::atoi(env))
+                        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    return opts;
+}
+
+std::vector<BatchMacro> read_batch_manifest(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open macro manifest: " + path);
+    }
+
+    std::vector<BatchMacro> macros;
+    std::string raw;
+    int line = 0;
+    while (std::getline(in, raw))
+    {
+        ++line;
+        const std::string text = trim(raw);
+        if (text.empty() || text[0] == '#')
+        {
+            continue;
+        }
+        const size_t split = text.find_first_of(" \t");
+        BatchMacro m;
+        m.line = line;
+        m.macro = text.substr(0, split);
+        m.call = split == std::string::npos ? "" : trim(text.substr(split));
+        macros.push_back(std::move(m));
+    }
+    return macros;
+}
+
+std::string describe_exit_status(int status)
+{
+    if (WIFEXITED(status))
+    {
+        return "exit=" + std::to_string(WEXITSTATUS(status));
+    }
+    if (WIFSIGNALED(status))
+    {
+        return "signal=" + std::to_string(WTERMSIG(status));
+    }
+    return "status=" + std::to_string(status);
+}
+
+/// Child side of a batch worker: never returns.
+[[noreturn]] void run_batch_child(const std::filesystem::path &repo_root,
+                                  const BatchMacro &m,
+                                  const std::filesystem::path &log_path,
+                                  int threads)
+{
+    const int fd = ::open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+    {
+        ::dup2(fd, STDOUT_FILENO);
+        ::dup2(fd, STDERR_FILENO);
+        ::close(fd);
+    }
+    const std::string n_threads = std::to_string(threads);
+    // HERON_RDF_THREADS sizes macros that ask for it; ROOT_MAX_THREADS caps
+    // ROOT's pool for those that call EnableImplicitMT() without a count.
+    ::setenv("HERON_RDF_THREADS", n_threads.c_str(), 1);
+    ::setenv("ROOT_MAX_THREADS", n_threads.c_str(), 1);
+    ::setenv("OMP_NUM_THREADS", n_threads.c_str(), 1);
+
+    int rc = 1;
+    try
+    {
+        const auto macro_path = resolve_macro_path(repo_root, m.macro);
+        rc = exec_root_macro(repo_root, macro_path, m.call);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[heron macro --batch] ERROR " << e.what() << "\n";
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    // Skip ROOT teardown in the worker; the parent owns the shared state.
+    ::_exit(rc == 0 ? 0 : 1);
+}
+
+int run_macro_batch(const std::filesystem::path &repo_root, const BatchOptions &opts)
+{
+    const std::vector<BatchMacro> macros = read_batch_manifest(opts.manifest);
+    if (macros.empty())
+    {
+        log_info("heron", "action=macro_batch status=complete macros=0");
+        return 0;
+    }
+
+    const int threads = std::min(opts.threads_per_macro, opts.jobs);
+    const int workers = std::max(1, std::min(opts.jobs / threads, static_cast<int>(macros.size())));
+
+    const std::filesystem::path log_dir = plot_dir(repo_root) / "logs";
+    std::filesystem::create_directories(log_dir);
+
+    // Load everything once so forked workers start with the libraries mapped.
+    add_plot_include_paths(repo_root);
+    ensure_plot_lib_loaded(repo_root);
+
+    log_info("heron",
+             "action=macro_batch status=start manifest=" + opts.manifest +
+                 " macros=" + std::to_string(macros.size()) +
+                 " workers=" + std::to_string(workers) +
+                 " threads_per_macro=" + std::to_string(threads));
+
+    struct Running
+    {
+        size_t index = 0;
+        std::filesystem::path log_path;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::map<pid_t, Running> running;
+    std::vector<std::string> failures;
+    const auto batch_start = std::chrono::steady_clock::now();
+    size_t next = 0;
+
+    std::cout.flush();
+    std::cerr.flush();
+    while (next < macros.size() || !running.empty())
+    {
+        while (next < macros.size() && static_cast<int>(running.size()) < workers)
+        {
+            const BatchMacro &m = macros[next];
+            const std::string stem = std::filesystem::path(m.macro).stem().string();
+            const auto log_path = log_dir / (std::to_string(m.line) + "_" + stem + ".log");
+            const pid_t pid = ::fork();
+            if (pid < 0)
+            {
+                throw std::runtime_error("fork failed for macro " + m.macro);
+            }
+            if (pid == 0)
+            {
+                run_batch_child(repo_root, m, log_path, threads);
+            }
+            running.emplace(pid, Running{next, log_path, std::chrono::steady_clock::now()});
+            ++next;
+        }
+
+        int status = 0;
+        const pid_t done = ::waitpid(-1, &status, 0);
+        if (done < 0)
+        {
+            throw std::runtime_error("waitpid failed while running macro batch");
+        }
+        const auto it = running.find(done);
+        if (it == running.end())
+        {
+            continue;
+        }
+
+        const BatchMacro &m = macros[it->second.index];
+        const double elapsed =
+            std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() -
+                                                                      it->second.start)
+                .count();
+        const bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        std::ostringstream message;
+        message << "action=macro_batch macro=" << m.macro
+                << " line=" << m.line
+                << " status=" << (ok ? "ok" : "failed")
+                << " " << describe_exit_status(status)
+                << " elapsed_s=" << std::fixed << std::setprecision(1) << elapsed
+                << " log=" << it->second.log_path.string();
+        if (ok)
+        {
+            log_info("heron", message.str());
+        }
+        else
+        {
+            log_warning("heron", message.str());
+            failures.push_back(m.macro + ":" + std::to_string(m.line));
+        }
+        running.erase(it);
+    }
+
+    const double elapsed =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - batch_start)
+            .count();
+    std::ostringstream summary;
+    summary << "action=macro_batch status=complete macros=" << macros.size()
+            << " failed=" << failures.size()
+            << " elapsed_s=" << std::fixed << std::setprecision(1) << elapsed;
+    for (size_t i = 0; i < failures.size(); ++i)
+    {
+        summary << (i == 0 ? " failures=" : ",") << failures[i];
+    }
+    if (failures.empty())
+    {
+        log_success("heron", summary.str());
+        return 0;
+    }
+    log_warning("heron", summary.str());
+    return 1;
+}
+
 int handle_macro_command(const std::vector<std::string> &args)
 {
     if (args.empty())
@@ -568,6 +915,11 @@ int handle_macro_command(const std::vector<std::string> &args)
         return 0;
     }
 
+    if (verb == "--batch")
+    {
+        return run_macro_batch(repo_root, parse_batch_args(rest));
+    }
+
     if (verb == "run")
     {
         if (rest.empty() || rest.size() > 2)
@@ -656,6 +1008,39 @@ int handle_event_command(const std::vector<std::string> &args,
         });
 }
 
+int handle_export_tensors_command(const std::vector<std::string> &args)
+{
+    return run_guarded(
+        "heronTensorIOdriver",
+        [&]()
+        {
+            const TensorArgs tensor_args = parse_tensor_args(args, kUsageExportTensors);
+            return run(tensor_args, "heronTensorIOdriver");
+        });
+}
+
+int handle_split_command(const std::vector<std::string> &args)
+{
+    return run_guarded(
+        "heronSplitIOdriver",
+        [&]()
+        {
+            const SplitArgs split_args = parse_split_args(args, kUsageSplit);
+            return run(split_args, "heronSplitIOdriver");
+        });
+}
+
+int handle_compact_command(const std::vector<std::string> &args)
+{
+    return run_guarded(
+        "heronCompactIOdriver",
+        [&]()
+        {
+            const CompactArgs compact_args = parse_compact_args(args, kUsageCompact);
+            return run(compact_args, "heronCompactIOdriver");
+        });
+}
+
 struct StatusOptions
 {
     int interval_seconds = 60;
@@ -943,6 +1328,39 @@ std::vector<CommandEntry> build_command_table(const std::filesystem::path &repo_
             std::cout << "Usage: heron event SAMPLE_LIST.tsv OUTPUT.root SELECTION COLUMNS.tsv\n";
         }
     });
+    table.push_back(CommandEntry{
+        "export-tensors",
+        [](const std::vector<std::string> &args)
+        {
+            return handle_export_tensors_command(args);
+        },
+        []()
+        {
+            std::cout << kUsageExportTensors;
+        }
+    });
+    table.push_back(CommandEntry{
+        "split",
+        [](const std::vector<std::string> &args)
+        {
+            return handle_split_command(args);
+        },
+        []()
+        {
+            std::cout << kUsageSplit;
+        }
+    });
+    table.push_back(CommandEntry{
+        "compact",
+        [](const std::vector<std::string> &args)
+        {
+            return handle_compact_command(args);
+        },
+        []()
+        {
+            std::cout << kUsageCompact;
+        }
+    });
     return table;
 }
 
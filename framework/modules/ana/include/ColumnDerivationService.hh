@@ -9,10 +9,15 @@
 #ifndef HERON_ANA_COLUMN_DERIVATION_SERVICE_H
 #define HERON_ANA_COLUMN_DERIVATION_SERVICE_H
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <ROOT/RDataFrame.hxx>
 #include <ROOT/RVec.hxx>
 
 #include "AnalysisChannels.hh"
+#include "CalibratedScoreKernel.hh"
 
 enum class Type
 {
@@ -31,12 +36,27 @@ struct ProcessorEntry
     double trig_eqv = 0.0;
 };
 
+/// Calibrated score column defined from a raw score by a precompiled kernel.
+struct CalibratedScoreColumn
+{
+    std::string name;
+    /// Raw score column (float/double, or RVec<float> with index >= 0).
+    std::string input = "inf_scores";
+    int index = 0;
+    std::shared_ptr<const CalibratedScoreKernel> kernel;
+};
+
 class ColumnDerivationService
 {
   public:
     ROOT::RDF::RNode define(ROOT::RDF::RNode node, const ProcessorEntry &rec) const;
     static const ColumnDerivationService &instance();
 
+    /// Define @p columns through CalibratedScoreKernel::evaluate; throws if
+    /// an input column is missing from @p node.
+    static ROOT::RDF::RNode define_calibrated_scores(ROOT::RDF::RNode node,
+                                                     const std::vector<CalibratedScoreColumn> &columns);
+
   private:
     static const double kRecognisedPurityMin;
     static const double kRecognisedCompletenessMin;
@@ -3,15 +3,19 @@
 #define heron_ANA_LOGITCALIBRATOR_H
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstring>
 #include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <ROOT/RDataFrame.hxx>
+
 #include "TDirectory.h"
 #include "TFile.h"
 #include "TParameter.h"
@@ -26,6 +30,62 @@ class LogitCalibrator {
  public:
   enum class Method : int { kNone = 0, kPlatt = 1, kIsotonic = 2 };
 
+  /// Weighted label sums of a calibration sample in fine logit bins.
+  /// Bin 0 is the underflow and bin n_bins+1 the overflow.
+  struct ScoreBins {
+    double lo = 0.0;
+    double hi = 0.0;
+    int n_bins = 0;
+    std::vector<double> sw;
+    std::vector<double> swy;
+    std::vector<double> swx0;
+    std::vector<double> swx1;
+    std::vector<double> xmin;
+    std::vector<double> xmax;
+
+    ScoreBins() = default;
+    ScoreBins(int n, double lo_val, double hi_val)
+        : lo(lo_val), hi(hi_val), n_bins(n),
+          sw(static_cast<size_t>(n + 2), 0.0), swy(sw), swx0(sw), swx1(sw),
+          xmin(sw.size(), std::numeric_limits<double>::infinity()),
+          xmax(sw.size(), -std::numeric_limits<double>::infinity()) {}
+
+    size_t find_bin(double x) const {
+      if (x < lo) {
+        return 0;
+      }
+      if (x >= hi) {
+        return static_cast<size_t>(n_bins + 1);
+      }
+      const int i = static_cast<int>((x - lo) / (hi - lo) * n_bins);
+      return static_cast<size_t>(1 + std::min(std::max(i, 0), n_bins - 1));
+    }
+
+    void fill(double x, bool y, double w) {
+      const size_t i = find_bin(x);
+      sw[i] += w;
+      if (y) {
+        swy[i] += w;
+        swx1[i] += w * x;
+      } else {
+        swx0[i] += w * x;
+      }
+      xmin[i] = std::min(xmin[i], x);
+      xmax[i] = std::max(xmax[i], x);
+    }
+
+    void add(const ScoreBins& o) {
+      for (size_t i = 0; i < sw.size(); ++i) {
+        sw[i] += o.sw[i];
+        swy[i] += o.swy[i];
+        swx0[i] += o.swx0[i];
+        swx1[i] += o.swx1[i];
+        xmin[i] = std::min(xmin[i], o.xmin[i]);
+        xmax[i] = std::max(xmax[i], o.xmax[i]);
+      }
+    }
+  };
+
   LogitCalibrator() = default;
 
   /// Get configured calibration method.
@@ -261,77 +321,14 @@ class LogitCalibrator {
       return a_val.x < b_val.x;
     });
 
-    struct Block {
-      double w = 0.0;
-      double wy = 0.0;
-      double mean = 0.0;
-      double xmin = 0.0;
-      double xmax = 0.0;
-    };
-
     std::vector<Block> blocks;
     blocks.reserve(pts.size());
-
     for (const auto& p : pts) {
-      Block b;
-      b.w = p.w;
-      b.wy = p.w * p.y;
-      b.mean = (b.w > 0.0) ? (b.wy / b.w) : 0.0;
-      b.xmin = p.x;
-      b.xmax = p.x;
-      blocks.push_back(b);
-
-      while (blocks.size() >= 2) {
-        const Block& b2 = blocks.back();
-        const Block& b1 = blocks[blocks.size() - 2];
-        if (b1.mean <= b2.mean) {
-          break;
-        }
-
-        Block merged;
-        merged.w = b1.w + b2.w;
-        merged.wy = b1.wy + b2.wy;
-        merged.mean = (merged.w > 0.0) ? (merged.wy / merged.w) : 0.0;
-        merged.xmin = b1.xmin;
-        merged.xmax = b2.xmax;
-
-        blocks.pop_back();
-        blocks.pop_back();
-        blocks.push_back(merged);
-      }
-    }
-
-    const int n = static_cast<int>(blocks.size());
-    if (n <= 0) {
-      throw std::runtime_error("fit_isotonic: no blocks produced");
+      blocks.push_back(make_block(p.w, p.w * p.y, p.x, p.x));
     }
+    pool_adjacent_violators(blocks);
 
-    std::vector<double> edges;
-    std::vector<double> vals;
-    edges.resize(static_cast<size_t>(n + 1));
-    vals.resize(static_cast<size_t>(n));
-
-    const double neg = -1e300;
-    const double pos = 1e300;
-    edges[0] = neg;
-
-    for (int i = 0; i < n; ++i) {
-      double p = blocks[static_cast<size_t>(i)].mean;
-      p = std::max(min_prob, std::min(max_prob, p));
-      vals[static_cast<size_t>(i)] = p;
-
-      if (i < (n - 1)) {
-        const double boundary = 0.5 *
-            (blocks[static_cast<size_t>(i)].xmax + blocks[static_cast<size_t>(i + 1)].xmin);
-        edges[static_cast<size_t>(i + 1)] = boundary;
-      }
-    }
-
-    edges[static_cast<size_t>(n)] = pos;
-
-    edges_ = std::move(edges);
-    values_ = std::move(vals);
-    method_ = Method::kIsotonic;
+    set_isotonic_from_blocks(blocks, min_prob, max_prob);
   }
 
   /// Fit Platt scaling from tree expressions.
@@ -367,6 +364,128 @@ class LogitCalibrator {
     fit_isotonic(x, y, (w.empty() ? NULL : &w), min_prob, max_prob);
   }
 
+  /// Accumulate fine logit bins in one (multi-threaded) event loop.
+  /// Expressions are jitted; entries with non-finite values or w <= 0 are
+  /// skipped as for the TTree overloads. With lo >= hi the range is taken
+  /// from the data in an extra pass.
+  static ScoreBins bin_scores(ROOT::RDF::RNode node,
+                              const std::string& logit_expr,
+                              const std::string& label_expr,
+                              const std::string& weight_expr = "",
+                              int n_bins = 4096,
+                              double lo = 0.0,
+                              double hi = 0.0);
+
+  /// Fit Platt scaling from binned sufficient statistics: every bin and
+  /// label contributes one point at its weighted mean logit.
+  void fit_platt(const ScoreBins& bins,
+                 int max_iter = 60,
+                 double tol = 1e-10,
+                 double l2 = 0.0) {
+    std::vector<double> x;
+    std::vector<int> y;
+    std::vector<double> w;
+    for (size_t i = 0; i < bins.sw.size(); ++i) {
+      const double w0 = bins.sw[i] - bins.swy[i];
+      const double w1 = bins.swy[i];
+      if (w0 > 0.0) {
+        x.push_back(bins.swx0[i] / w0);
+        y.push_back(0);
+        w.push_back(w0);
+      }
+      if (w1 > 0.0) {
+        x.push_back(bins.swx1[i] / w1);
+        y.push_back(1);
+        w.push_back(w1);
+      }
+    }
+    if (x.empty()) {
+      throw std::runtime_error("fit_platt: empty score bins");
+    }
+    fit_platt(x, y, &w, max_iter, tol, l2);
+  }
+
+  /// Fit isotonic calibration on binned data; pool-adjacent-violators runs
+  /// on contiguous bin ranges in parallel before the ranges are pooled.
+  void fit_isotonic(const ScoreBins& bins,
+                    double min_prob = 1e-6,
+                    double max_prob = 1.0 - 1e-6,
+                    int n_threads = 0) {
+    if (!(min_prob > 0.0 && max_prob < 1.0 && min_prob < max_prob)) {
+      throw std::runtime_error("fit_isotonic: invalid min_prob/max_prob");
+    }
+
+    std::vector<Block> blocks;
+    double sw = 0.0;
+    double swy = 0.0;
+    for (size_t i = 0; i < bins.sw.size(); ++i) {
+      if (bins.sw[i] > 0.0) {
+        blocks.push_back(make_block(bins.sw[i], bins.swy[i], bins.xmin[i], bins.xmax[i]));
+        sw += bins.sw[i];
+        swy += bins.swy[i];
+      }
+    }
+    if (blocks.empty()) {
+      throw std::runtime_error("fit_isotonic: empty score bins");
+    }
+    pi_fit_ = clamp_prob_01(swy / sw);
+
+    if (n_threads <= 0) {
+      n_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    const size_t n_chunks = std::min(static_cast<size_t>(n_threads), blocks.size() / 256 + 1);
+    if (n_chunks > 1) {
+      std::vector<std::vector<Block>> chunks(n_chunks);
+      std::vector<std::thread> workers;
+      const size_t per_chunk = (blocks.size() + n_chunks - 1) / n_chunks;
+      for (size_t c = 0; c < n_chunks; ++c) {
+        const size_t begin = std::min(blocks.size(), c * per_chunk);
+        const size_t end = std::min(blocks.size(), begin + per_chunk);
+        chunks[c].assign(blocks.begin() + begin, blocks.begin() + end);
+        workers.emplace_back([&chunks, c]() { pool_adjacent_violators(chunks[c]); });
+      }
+      for (auto& t : workers) {
+        t.join();
+      }
+      // Pooling the chunk solutions again gives the global solution.
+      blocks.clear();
+      for (const auto& chunk : chunks) {
+        blocks.insert(blocks.end(), chunk.begin(), chunk.end());
+      }
+    }
+    pool_adjacent_violators(blocks);
+
+    set_isotonic_from_blocks(blocks, min_prob, max_prob);
+  }
+
+  /// Fit Platt scaling directly on an event list (bounded memory). A
+  /// known logit range [lo, hi) saves bin_scores() its range pass.
+  void fit_platt(ROOT::RDF::RNode node,
+                 const std::string& logit_expr,
+                 const std::string& label_expr,
+                 const std::string& weight_expr = "",
+                 int n_bins = 4096,
+                 int max_iter = 60,
+                 double tol = 1e-10,
+                 double l2 = 0.0,
+                 double lo = 0.0,
+                 double hi = 0.0) {
+    fit_platt(bin_scores(node, logit_expr, label_expr, weight_expr, n_bins, lo, hi), max_iter, tol, l2);
+  }
+
+  /// Fit isotonic calibration directly on an event list (bounded memory).
+  void fit_isotonic(ROOT::RDF::RNode node,
+                    const std::string& logit_expr,
+                    const std::string& label_expr,
+                    const std::string& weight_expr = "",
+                    int n_bins = 4096,
+                    double min_prob = 1e-6,
+                    double max_prob = 1.0 - 1e-6,
+                    double lo = 0.0,
+                    double hi = 0.0) {
+    fit_isotonic(bin_scores(node, logit_expr, label_expr, weight_expr, n_bins, lo, hi), min_prob, max_prob);
+  }
+
   /// Save calibration parameters to ROOT file.
   void save_to_root(const char* filename, const char* dir_name = "calib") const {
     if (!filename || !dir_name) {
@@ -460,6 +579,14 @@ class LogitCalibrator {
   }
 
  private:
+  struct Block {
+    double w = 0.0;
+    double wy = 0.0;
+    double mean = 0.0;
+    double xmin = 0.0;
+    double xmax = 0.0;
+  };
+
   Method method_{Method::kNone};
   double a_{1.0};
   double b_{0.0};
@@ -513,6 +640,73 @@ class LogitCalibrator {
     return std::log(p) - std::log1p(-p);
   }
 
+  /// Column name not yet used by any bin_scores() call in this process.
+  static std::string unique_column(const std::string& stem) {
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+  }
+
+  static Block make_block(double w, double wy, double xmin, double xmax) {
+    Block b;
+    b.w = w;
+    b.wy = wy;
+    b.mean = (w > 0.0) ? (wy / w) : 0.0;
+    b.xmin = xmin;
+    b.xmax = xmax;
+    return b;
+  }
+
+  /// Pool adjacent violators in place over x-ordered blocks.
+  static void pool_adjacent_violators(std::vector<Block>& blocks) {
+    size_t n = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      blocks[n++] = blocks[i];
+      while (n >= 2 && blocks[n - 2].mean > blocks[n - 1].mean) {
+        const Block& b1 = blocks[n - 2];
+        const Block& b2 = blocks[n - 1];
+        blocks[n - 2] = make_block(b1.w + b2.w, b1.wy + b2.wy, b1.xmin, b2.xmax);
+        --n;
+      }
+    }
+    blocks.resize(n);
+  }
+
+  void set_isotonic_from_blocks(const std::vector<Block>& blocks,
+                                double min_prob,
+                                double max_prob) {
+    const int n = static_cast<int>(blocks.size());
+    if (n <= 0) {
+      throw std::runtime_error("fit_isotonic: no blocks produced");
+    }
+
+    std::vector<double> edges;
+    std::vector<double> vals;
+    edges.resize(static_cast<size_t>(n + 1));
+    vals.resize(static_cast<size_t>(n));
+
+    const double neg = -1e300;
+    const double pos = 1e300;
+    edges[0] = neg;
+
+    for (int i = 0; i < n; ++i) {
+      double p = blocks[static_cast<size_t>(i)].mean;
+      p = std::max(min_prob, std::min(max_prob, p));
+      vals[static_cast<size_t>(i)] = p;
+
+      if (i < (n - 1)) {
+        const double boundary = 0.5 *
+            (blocks[static_cast<size_t>(i)].xmax + blocks[static_cast<size_t>(i + 1)].xmin);
+        edges[static_cast<size_t>(i + 1)] = boundary;
+      }
+    }
+
+    edges[static_cast<size_t>(n)] = pos;
+
+    edges_ = std::move(edges);
+    values_ = std::move(vals);
+    method_ = Method::kIsotonic;
+  }
+
   int find_isotonic_bin(double x) const {
     auto it = std::upper_bound(edges_.begin(), edges_.end(), x);
     int idx = static_cast<int>(std::distance(edges_.begin(), it)) - 1;
@@ -642,6 +836,93 @@ class LogitCalibrator {
   }
 };
 
+/** \brief RDataFrame action filling LogitCalibrator::ScoreBins per slot. */
+class LogitScoreBinsHelper
+    : public ROOT::Detail::RDF::RActionImpl<LogitScoreBinsHelper> {
+ public:
+  using Result_t = LogitCalibrator::ScoreBins;
+
+  LogitScoreBinsHelper(int n_bins, double lo, double hi, unsigned int n_slots)
+      : result_(std::make_shared<Result_t>(n_bins, lo, hi)),
+        slots_(n_slots, Result_t(n_bins, lo, hi)) {}
+
+  LogitScoreBinsHelper(LogitScoreBinsHelper&&) = default;
+  LogitScoreBinsHelper(const LogitScoreBinsHelper&) = delete;
+
+  std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+  void Initialize() {}
+  void InitTask(TTreeReader*, unsigned int) {}
+
+  void Exec(unsigned int slot, double x, double y, double w) {
+    slots_[slot].fill(x, y > 0.5, w);
+  }
+
+  void Finalize() {
+    for (const auto& s : slots_) {
+      result_->add(s);
+    }
+  }
+
+  std::string GetActionName() const { return "LogitScoreBins"; }
+
+ private:
+  std::shared_ptr<Result_t> result_;
+  std::vector<Result_t> slots_;
+};
+
+inline LogitCalibrator::ScoreBins LogitCalibrator::bin_scores(ROOT::RDF::RNode node,
+                                                              const std::string& logit_expr,
+                                                              const std::string& label_expr,
+                                                              const std::string& weight_expr,
+                                                              int n_bins,
+                                                              double lo,
+                                                              double hi) {
+  if (logit_expr.empty() || label_expr.empty()) {
+    throw std::runtime_error("bin_scores: empty expressions");
+  }
+  if (n_bins <= 0) {
+    throw std::runtime_error("bin_scores: n_bins must be > 0");
+  }
+
+  // Unique names, so several calibrations can share one node.
+  const std::string x_col = unique_column("__calib_x");
+  const std::string y_col = unique_column("__calib_y");
+  const std::string w_col = unique_column("__calib_w");
+  auto usable =
+      node.Define(x_col, "static_cast<double>(" + logit_expr + ")")
+          .Define(y_col, "static_cast<double>(" + label_expr + ")")
+          .Define(w_col, weight_expr.empty() ? std::string("1.0")
+                                             : "static_cast<double>(" + weight_expr + ")")
+          .Filter([](double x, double y, double w) {
+                    return std::isfinite(x) && std::isfinite(y) && std::isfinite(w) && w > 0.0;
+                  },
+                  {x_col, y_col, w_col});
+
+  if (!(lo < hi)) {
+    // Min and max in one action, so the range costs a single pass.
+    using Range = std::pair<double, double>;
+    auto range = usable.Aggregate(
+        [](Range r, double x) { return Range(std::min(r.first, x), std::max(r.second, x)); },
+        [](Range a, Range b) { return Range(std::min(a.first, b.first), std::max(a.second, b.second)); },
+        x_col,
+        Range(std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()));
+    lo = range->first;
+    hi = range->second;
+    if (!(lo <= hi)) {
+      throw std::runtime_error("bin_scores: no usable entries read");
+    }
+    hi = std::nextafter(hi, std::numeric_limits<double>::infinity());
+    if (!(lo < hi)) {
+      hi = lo + 1.0;
+    }
+  }
+
+  LogitScoreBinsHelper helper(n_bins, lo, hi, usable.GetNSlots());
+  auto bins = usable.Book<double, double, double>(std::move(helper), {x_col, y_col, w_col});
+  return *bins;
+}
+
 }  // namespace heron
 
 #endif
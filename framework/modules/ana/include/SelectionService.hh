@@ -11,6 +11,7 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 
 #include <ROOT/RDataFrame.hxx>
 #include <ROOT/RVec.hxx>
@@ -52,7 +53,9 @@ class SelectionService
     static const unsigned muon_required_generation;
 
     static ROOT::RDF::RNode apply(ROOT::RDF::RNode node, Preset p, SelectionEntry *selection = NULL);
-    static ROOT::RDF::RNode decorate(ROOT::RDF::RNode node);
+    /// Derived selection columns; @p encoded_weights (an event list's
+    /// encoded_weight_columns()) are decoded to their plain names first.
+    static ROOT::RDF::RNode decorate(ROOT::RDF::RNode node, const std::vector<std::string> &encoded_weights = {});
     static std::string selection_label(Preset p);
     static bool is_in_truth_volume(float x, float y, float z) noexcept;
     static bool is_in_reco_volume(float x, float y, float z) noexcept;
@@ -0,0 +1,196 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/ana/src/CalibratedScoreKernel.cc
+ *
+ *  @brief Lookup-table evaluation of LogitCalibrator outputs.
+ */
+
+#include "CalibratedScoreKernel.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+//____________________________________________________________________________
+CalibratedScoreKernel::CalibratedScoreKernel(heron::LogitCalibrator calibrator, Config cfg)
+    : m_calibrator(std::move(calibrator)), m_cfg(cfg)
+{
+    using Method = heron::LogitCalibrator::Method;
+
+    if (m_cfg.n_grid <= 0)
+        throw std::runtime_error("CalibratedScoreKernel: n_grid must be > 0");
+    if (!(m_cfg.lo < m_cfg.hi))
+        throw std::runtime_error("CalibratedScoreKernel: lo must be < hi");
+
+    if (m_calibrator.get_method() == Method::kIsotonic)
+    {
+        const auto &edges = m_calibrator.get_edges();
+        const auto &values = m_calibrator.get_values();
+        if (values.empty())
+            throw std::runtime_error("CalibratedScoreKernel: isotonic mapping is empty");
+
+        m_mode = Mode::kStep;
+        m_edges.assign(edges.begin() + 1, edges.end() - 1);
+        m_values.reserve(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+            m_values.push_back(exact(edges[i]));
+
+        if (!m_edges.empty())
+        {
+            const std::size_t n_buckets = static_cast<std::size_t>(m_cfg.n_grid);
+            const double width = (m_edges.back() - m_edges.front()) / n_buckets;
+            m_bucket_lo = m_edges.front();
+            m_bucket_inv_width = width > 0.0 ? 1.0 / width : 0.0;
+            m_bucket_first.resize(n_buckets);
+            for (std::size_t k = 0; k < n_buckets; ++k)
+            {
+                const double low = m_bucket_lo + k * width;
+                m_bucket_first[k] = static_cast<int>(
+                    std::upper_bound(m_edges.begin(), m_edges.end(), low) - m_edges.begin());
+            }
+        }
+        return;
+    }
+
+    if (m_cfg.output == Output::kLogOdds || m_cfg.output == Output::kLLR)
+    {
+        m_mode = Mode::kAffine;
+        m_slope = (m_calibrator.get_method() == Method::kPlatt) ? m_calibrator.get_a() : 1.0;
+        m_offset = exact(0.0);
+        return;
+    }
+
+    m_mode = Mode::kGrid;
+    const double step = (m_cfg.hi - m_cfg.lo) / m_cfg.n_grid;
+    m_inv_step = 1.0 / step;
+    m_grid.resize(static_cast<std::size_t>(m_cfg.n_grid) + 1);
+    for (std::size_t i = 0; i < m_grid.size(); ++i)
+        m_grid[i] = exact(m_cfg.lo + i * step);
+}
+
+//____________________________________________________________________________
+double CalibratedScoreKernel::exact(double raw_logit) const
+{
+    switch (m_cfg.output)
+    {
+    case Output::kProb:
+        return m_calibrator.prob(raw_logit);
+    case Output::kLogOdds:
+        return m_calibrator.log_odds(raw_logit);
+    case Output::kLLR:
+        return m_calibrator.llr(raw_logit);
+    case Output::kPosterior:
+        return m_calibrator.posterior(raw_logit, m_cfg.pi_target);
+    }
+    throw std::runtime_error("CalibratedScoreKernel: unknown output");
+}
+
+//____________________________________________________________________________
+double CalibratedScoreKernel::step(double raw_logit) const
+{
+    const std::size_t n_inner = m_edges.size();
+    if (n_inner == 0)
+        return m_values.front();
+    // NaN falls into the last bin, as in LogitCalibrator::prob.
+    if (!(raw_logit < m_edges.back()))
+        return m_values.back();
+    if (raw_logit < m_edges.front())
+        return m_values.front();
+
+    const double t = (raw_logit - m_bucket_lo) * m_bucket_inv_width;
+    const std::size_t k = std::min(static_cast<std::size_t>(t > 0.0 ? t : 0.0), m_bucket_first.size() - 1);
+    std::size_t idx = static_cast<std::size_t>(m_bucket_first[k]);
+    while (idx > 0 && m_edges[idx - 1] > raw_logit)
+        --idx;
+    while (idx < n_inner && m_edges[idx] <= raw_logit)
+        ++idx;
+    return m_values[idx];
+}
+
+//____________________________________________________________________________
+double CalibratedScoreKernel::operator()(double raw_logit) const
+{
+    switch (m_mode)
+    {
+    case Mode::kStep:
+        return step(raw_logit);
+    case Mode::kAffine:
+        return m_slope * raw_logit + m_offset;
+    case Mode::kGrid:
+        break;
+    }
+
+    const double t = (raw_logit - m_cfg.lo) * m_inv_step;
+    if (!(t >= 0.0 && t < m_cfg.n_grid))
+        return exact(raw_logit);
+    const std::size_t i = static_cast<std::size_t>(t);
+    const double f = t - static_cast<double>(i);
+    return m_grid[i] + f * (m_grid[i + 1] - m_grid[i]);
+}
+
+//____________________________________________________________________________
+template <class T>
+void CalibratedScoreKernel::evaluate_batch(const T *raw_logit, double *out, std::size_t n) const
+{
+    if (m_mode == Mode::kStep)
+    {
+        for (std::size_t j = 0; j < n; ++j)
+            out[j] = step(raw_logit[j]);
+        return;
+    }
+
+    if (m_mode == Mode::kAffine)
+    {
+        const double slope = m_slope;
+        const double offset = m_offset;
+        for (std::size_t j = 0; j < n; ++j)
+            out[j] = slope * static_cast<double>(raw_logit[j]) + offset;
+        return;
+    }
+
+    // Interpolate everything with a clamped index, then redo the (rare)
+    // out-of-range and non-finite scores exactly.
+    const double lo = m_cfg.lo;
+    const double inv_step = m_inv_step;
+    const double t_max = std::nextafter(static_cast<double>(m_cfg.n_grid), 0.0);
+    const double *grid = m_grid.data();
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        double t = (static_cast<double>(raw_logit[j]) - lo) * inv_step;
+        t = t > 0.0 ? t : 0.0;
+        t = t < t_max ? t : t_max;
+        const std::size_t i = static_cast<std::size_t>(t);
+        const double f = t - static_cast<double>(i);
+        out[j] = grid[i] + f * (grid[i + 1] - grid[i]);
+    }
+
+    const double hi = m_cfg.hi;
+    for (std::size_t j = 0; j < n; ++j)
+    {
+        const double x = static_cast<double>(raw_logit[j]);
+        if (!(x >= lo && x < hi))
+            out[j] = exact(x);
+    }
+}
+
+//____________________________________________________________________________
+void CalibratedScoreKernel::evaluate(const float *raw_logit, double *out, std::size_t n) const
+{
+    evaluate_batch(raw_logit, out, n);
+}
+
+//____________________________________________________________________________
+void CalibratedScoreKernel::evaluate(const double *raw_logit, double *out, std::size_t n) const
+{
+    evaluate_batch(raw_logit, out, n);
+}
+
+//____________________________________________________________________________
+ROOT::RVec<double> CalibratedScoreKernel::operator()(const ROOT::RVec<float> &raw_logits) const
+{
+    ROOT::RVec<double> out(raw_logits.size());
+    evaluate(raw_logits.data(), out.data(), raw_logits.size());
+    return out;
+}
+//____________________________________________________________________________
@@ -9,7 +9,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <ROOT/RVec.hxx>
 
@@ -264,6 +267,72 @@ ROOT::RDF::RNode ColumnDerivationService::define(ROOT::RDF::RNode node, const Pr
 }
 //____________________________________________________________________________
 
+//____________________________________________________________________________
+ROOT::RDF::RNode ColumnDerivationService::define_calibrated_scores(ROOT::RDF::RNode node,
+                                                                   const std::vector<CalibratedScoreColumn> &columns)
+{
+    for (const auto &c : columns)
+    {
+        if (c.name.empty() || c.input.empty() || !c.kernel)
+            throw std::runtime_error("ColumnDerivationService: calibrated score needs a name, input and kernel");
+
+        const auto cnames = node.GetColumnNames();
+        if (std::find(cnames.begin(), cnames.end(), c.input) == cnames.end())
+            throw std::runtime_error("ColumnDerivationService: calibrated score " + c.name +
+                                     " needs missing input column " + c.input);
+
+        // RDataFrame defines one event at a time, so whole-vector inputs are
+        // the only batches; single scores still go through the same
+        // branch-free evaluate() as a batch of one.
+        const auto kernel = c.kernel;
+        const std::string type = node.GetColumnType(c.input);
+        const bool is_vector = type.find("RVec") != std::string::npos || type.find("vector") != std::string::npos;
+        if (is_vector && c.index < 0)
+        {
+            node = node.Define(c.name, [kernel](const ROOT::RVec<float> &scores) { return (*kernel)(scores); },
+                               {c.input});
+        }
+        else if (is_vector)
+        {
+            const std::size_t index = static_cast<std::size_t>(c.index);
+            node = node.Define(
+                c.name,
+                [kernel, index](const ROOT::RVec<float> &scores) {
+                    double out = std::numeric_limits<double>::quiet_NaN();
+                    if (index < scores.size())
+                        kernel->evaluate(scores.data() + index, &out, 1);
+                    return out;
+                },
+                {c.input});
+        }
+        else if (type == "float" || type == "Float_t")
+        {
+            node = node.Define(
+                c.name,
+                [kernel](float x) {
+                    double out = 0.0;
+                    kernel->evaluate(&x, &out, 1);
+                    return out;
+                },
+                {c.input});
+        }
+        else
+        {
+            node = node.Define(
+                c.name,
+                [kernel](double x) {
+                    double out = 0.0;
+                    kernel->evaluate(&x, &out, 1);
+                    return out;
+                },
+                {c.input});
+        }
+    }
+
+    return node;
+}
+//____________________________________________________________________________
+
 //____________________________________________________________________________
 const ColumnDerivationService &ColumnDerivationService::instance()
 {
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "SampleIO.hh"
+#include "UniverseWeightCodec.hh"
 
 
 const int SelectionService::slice_required_count = 1;
@@ -113,8 +114,10 @@ ROOT::RDF::RNode SelectionService::apply(ROOT::RDF::RNode node, Preset p, Select
     return filtered;
 }
 
-ROOT::RDF::RNode SelectionService::decorate(ROOT::RDF::RNode node)
+ROOT::RDF::RNode SelectionService::decorate(ROOT::RDF::RNode node, const std::vector<std::string> &encoded_weights)
 {
+    node = nu::UniverseWeightCodec::define_decoded(node, encoded_weights);
+
     std::vector<std::string> names = node.GetColumnNames();
     auto has = [&](const std::string &name) {
         return std::find(names.begin(), names.end(), name) != names.end();
@@ -67,6 +67,9 @@ class EventDisplay
 
         bool show_legend = true;
         int legend_cols = 5;
+
+        /// Pixels per image cell for direct PNG output.
+        int raster_scale = 1;
     };
 
     using DetectorData = std::vector<float>;
@@ -107,6 +110,12 @@ class EventDisplay
 
         Mode mode = Mode::Detector;
         Options display;
+
+        /// "png" is written by the raster encoder on a worker pool; other
+        /// formats (and combined PDFs) use TCanvas on one thread.
+        bool raster_png = true;
+        int n_workers = 0;
+        std::size_t queue_depth = 32;
     };
 
     static void render_from_rdf(ROOT::RDF::RNode df, const BatchOptions &opt);
@@ -122,6 +131,9 @@ class EventDisplay
     void draw_semantic(TCanvas &c);
     void draw_semantic_legend();
 
+    template <class T>
+    static void render_pipeline(ROOT::RDF::RNode limited, const BatchOptions &opt);
+
     static std::pair<int, int> deduce_grid(int requested_w,
                                            int requested_h,
                                            std::size_t flat_size);
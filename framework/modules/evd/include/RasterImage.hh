@@ -0,0 +1,131 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/evd/include/RasterImage.hh
+ *
+ *  @brief Direct RGB raster output for event display images (colour map
+ *         lookup tables and a PNG encoder), without ROOT graphics.
+ */
+
+#ifndef HERON_EVD_RASTERIMAGE_H
+#define HERON_EVD_RASTERIMAGE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace heron {
+namespace evd {
+
+/**
+ *  \brief 8-bit RGB image, row 0 at the top.
+ *
+ *  Safe to build and write from several threads at once: nothing here touches
+ *  gPad, gStyle or any other ROOT global.
+ */
+class RasterImage
+{
+  public:
+    using RGB = std::array<std::uint8_t, 3>;
+
+    RasterImage() = default;
+    RasterImage(int width, int height, RGB fill = RGB{255, 255, 255});
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::vector<std::uint8_t> &pixels() const { return pixels_; }
+
+    void set(int x, int y, const RGB &c)
+    {
+        std::uint8_t *p = &pixels_[3 * (static_cast<std::size_t>(y) * width_ + x)];
+        p[0] = c[0];
+        p[1] = c[1];
+        p[2] = c[2];
+    }
+
+    /// Write as PNG (zlib level 1..9); throws std::runtime_error on failure.
+    void write_png(const std::string &path, int compression_level = 1) const;
+
+    /**
+     *  Colour a row-major W x H grid (row r drawn at height r from the bottom,
+     *  as for the TH2F path), each cell enlarged to @p scale x @p scale pixels.
+     *  Cells for which @p colour returns false keep the background.
+     */
+    template <class T, class F>
+    static RasterImage from_grid(const std::vector<T> &values, int grid_w, int grid_h, int scale, RGB background, F &&colour)
+    {
+        scale = scale > 0 ? scale : 1;
+        RasterImage img(grid_w * scale, grid_h * scale, background);
+        const std::size_t n = values.size();
+        RGB c{};
+        for (int r = 0; r < grid_h; ++r)
+        {
+            const int y0 = (grid_h - 1 - r) * scale;
+            for (int col = 0; col < grid_w; ++col)
+            {
+                const std::size_t idx = static_cast<std::size_t>(r) * grid_w + col;
+                if (idx >= n)
+                    break;
+                if (!colour(values[idx], c))
+                    continue;
+                for (int dy = 0; dy < scale; ++dy)
+                    for (int dx = 0; dx < scale; ++dx)
+                        img.set(col * scale + dx, y0 + dy, c);
+            }
+        }
+        return img;
+    }
+
+    /**
+     *  As from_grid for an image given by its non-zero cells only (ascending
+     *  row-major indices in @p index). Every other cell is drawn as a zero
+     *  value, so only the listed cells are visited.
+     */
+    template <class T, class F>
+    static RasterImage from_pixels(const std::vector<std::uint32_t> &index, const std::vector<T> &values,
+                                   int grid_w, int grid_h, int scale, RGB background, F &&colour)
+    {
+        scale = scale > 0 ? scale : 1;
+        RGB zero{};
+        const bool zero_drawn = colour(T{}, zero);
+        RasterImage img(grid_w * scale, grid_h * scale, zero_drawn ? zero : background);
+        const std::size_t n_cells = static_cast<std::size_t>(grid_w) * grid_h;
+        RGB c{};
+        for (std::size_t k = 0; k < index.size() && k < values.size(); ++k)
+        {
+            const std::size_t idx = index[k];
+            if (idx >= n_cells)
+                break;
+            if (!colour(values[k], c))
+            {
+                if (!zero_drawn)
+                    continue;
+                c = background;
+            }
+            const int r = static_cast<int>(idx / grid_w);
+            const int col = static_cast<int>(idx % grid_w);
+            const int y0 = (grid_h - 1 - r) * scale;
+            for (int dy = 0; dy < scale; ++dy)
+                for (int dx = 0; dx < scale; ++dx)
+                    img.set(col * scale + dx, y0 + dy, c);
+        }
+        return img;
+    }
+
+  private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<std::uint8_t> pixels_;
+};
+
+/// 256-entry colour map matching ROOT's default kBird palette.
+const std::array<RasterImage::RGB, 256> &bird_colour_map();
+
+/// Semantic class colours (index 0 is the empty background), as drawn on TCanvas.
+const std::array<RasterImage::RGB, 15> &semantic_colour_map();
+
+} // namespace evd
+} // namespace heron
+
+#endif // HERON_EVD_RASTERIMAGE_H
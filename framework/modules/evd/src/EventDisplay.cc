@@ -11,14 +11,21 @@
 #include <array>
 #include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
 #include <ROOT/RConfig.h>
@@ -28,10 +35,13 @@
 #include <TH1F.h>
 #include <TH2F.h>
 #include <TLegend.h>
+#include <TROOT.h>
 #include <TStyle.h>
 #include <nlohmann/json.hpp>
 
 #include "Plotter.hh"
+#include "RasterImage.hh"
+#include "SparseImageCodec.hh"
 
 namespace heron {
 namespace evd {
@@ -415,319 +425,490 @@ static std::string format_tag(std::string pattern,
 }
 
 //____________________________________________________________________________
-void EventDisplay::render_from_rdf(ROOT::RDF::RNode df, const BatchOptions &opt)
+namespace {
+
+/// Non-zero pixels of one plane image, in ascending index order.
+template <class T>
+struct PlanePixels
 {
-    std::error_code ec;
-    std::filesystem::create_directories(opt.out_dir, ec);
-    if (ec)
+    std::size_t size = 0;
+    std::vector<std::uint32_t> index;
+    std::vector<T> value;
+
+    void add(std::size_t i, T v)
     {
-        std::cerr << "[EventDisplay] Failed to create output directory '"
-                  << opt.out_dir << "': " << ec.message() << '\n';
+        index.push_back(static_cast<std::uint32_t>(i));
+        value.push_back(v);
     }
 
-    auto filtered = df;
-    if (!opt.selection_expr.empty())
-        filtered = filtered.Filter(opt.selection_expr);
-
-    const auto n_rows = static_cast<std::size_t>(filtered.Count().GetValue());
-    if (n_rows == 0)
+    std::vector<T> dense() const
     {
-        std::cerr << "[EventDisplay] No rows matched selection; nothing to render."
-                  << '\n';
-        return;
+        std::vector<T> out(size, T{});
+        for (std::size_t k = 0; k < index.size(); ++k)
+            out[index[k]] = value[k];
+        return out;
     }
+};
 
-    const std::size_t n_to_render =
-        (opt.n_events > 0)
-            ? std::min<std::size_t>(n_rows,
-                                    static_cast<std::size_t>(opt.n_events))
-            : n_rows;
+/// Selected event with one image per requested plane.
+template <class T>
+struct Frame
+{
+    std::size_t seq = 0;
+    int run = 0;
+    int sub = 0;
+    int evt = 0;
+    std::vector<PlanePixels<T>> planes;
+};
+
+/// Fixed-capacity hand-off between the event loop and the renderers.
+template <class T>
+class BoundedQueue
+{
+  public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(std::max<std::size_t>(1, capacity)) {}
 
-    std::clog << "[EventDisplay] Selection matched " << n_rows
-              << " rows; rendering up to " << n_to_render << " events."
-              << '\n';
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_ || closed_; });
+        if (closed_)
+            return;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
 
-    auto limited = filtered;
-    if (n_to_render < n_rows)
+    bool pop(T &item)
     {
-        if (ROOT::IsImplicitMTEnabled())
-        {
-            const auto max_entries = static_cast<ULong64_t>(n_to_render);
-            std::clog << "[EventDisplay] Implicit MT is enabled; limiting rows with rdfentry_ "
-                      << "does not guarantee original tree order." << '\n';
-            limited = filtered.Filter(
-                [max_entries](ULong64_t entry) { return entry < max_entries; },
-                {"rdfentry_"});
-        }
-        else
-        {
-            limited = filtered.Range(static_cast<ULong64_t>(n_to_render));
-        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
     }
 
-    const bool use_combined_pdf =
-        (!opt.combined_pdf.empty() && opt.image_format == "pdf");
-    std::filesystem::path combined_path;
-    std::size_t total_pages = 0;
-    if (use_combined_pdf)
+    void close()
     {
-        combined_path = std::filesystem::path(opt.out_dir) / opt.combined_pdf;
-        total_pages = n_to_render * opt.planes.size();
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
 
-        if (ROOT::IsImplicitMTEnabled())
-        {
-            std::clog << "[EventDisplay] Implicit MT is enabled while rendering a combined PDF; "
-                      << "continuing without toggling MT after RDataFrame construction." << '\n';
-        }
+  private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+struct PlaneRange
+{
+    float raw_min = 0.0f;
+    float raw_max = 0.0f;
+    float q02 = 0.0f;
+    float q999 = 0.0f;
+    std::size_t positive_pixels = 0;
+};
+
+/// Min/max and the 2% / 99.9% quantiles of the positive pixels, by selection.
+PlaneRange detector_range(const PlanePixels<float> &img, std::vector<float> &scratch)
+{
+    PlaneRange r;
+    if (img.size == 0)
+        return r;
+
+    if (!img.value.empty())
+    {
+        const auto raw_mm = std::minmax_element(img.value.begin(), img.value.end());
+        r.raw_min = *raw_mm.first;
+        r.raw_max = *raw_mm.second;
+    }
+    if (img.value.size() < img.size)
+    {
+        r.raw_min = std::min(r.raw_min, 0.0f);
+        r.raw_max = std::max(r.raw_max, 0.0f);
     }
 
-    using nlohmann::json;
-    json manifest = json::array();
-    std::mutex manifest_mutex;
+    scratch.clear();
+    for (float v : img.value)
+        if (v > 0.0f)
+            scratch.push_back(v);
+
+    r.positive_pixels = scratch.size();
+    if (scratch.empty())
+        return r;
+
+    const std::size_t n = scratch.size();
+    const std::size_t i02 = std::min(n - 1, static_cast<std::size_t>(0.02 * n));
+    const std::size_t i999 = std::min(n - 1, static_cast<std::size_t>(0.999 * n));
+    std::nth_element(scratch.begin(), scratch.begin() + i02, scratch.end());
+    r.q02 = scratch[i02];
+    if (i999 > i02)
+        std::nth_element(scratch.begin() + i02 + 1, scratch.begin() + i999, scratch.end());
+    r.q999 = scratch[i999];
+    return r;
+}
+
+RasterImage detector_raster(const PlanePixels<float> &img, int grid_w, int grid_h, const EventDisplay::Options &o)
+{
+    const auto &lut = bird_colour_map();
+    const double lo = o.det_min;
+    const double hi = std::max(o.det_max, o.det_min);
+    const bool log_z = o.use_log_z && lo > 0.0;
+    const double l_lo = log_z ? std::log(lo) : lo;
+    const double span = (log_z ? std::log(hi) : hi) - l_lo;
+    const double to_index = span > 0.0 ? 255.0 / span : 0.0;
+
+    // As in the TCanvas path, log z clamps pixels at or below det_min (the
+    // unstored zeros included) to det_min; linear z leaves them blank.
+    const RasterImage::RGB background = log_z ? lut[0] : RasterImage::RGB{255, 255, 255};
+    return RasterImage::from_pixels(
+        img.index, img.value, grid_w, grid_h, o.raster_scale, background,
+        [&](float v, RasterImage::RGB &c) {
+            if (!(v > lo))
+            {
+                if (!log_z)
+                    return false;
+                c = lut[0];
+                return true;
+            }
+            const double z = log_z ? std::log(std::min<double>(v, hi)) : std::min<double>(v, hi);
+            c = lut[static_cast<std::size_t>(std::clamp((z - l_lo) * to_index, 0.0, 255.0))];
+            return true;
+        });
+}
+
+RasterImage semantic_raster(const PlanePixels<int> &img, int grid_w, int grid_h, const EventDisplay::Options &o)
+{
+    const auto &lut = semantic_colour_map();
+    return RasterImage::from_pixels(
+        img.index, img.value, grid_w, grid_h, o.raster_scale, lut[0],
+        [&](int v, RasterImage::RGB &c) {
+            if (v < 0 || v >= static_cast<int>(lut.size()))
+                return false;
+            c = lut[static_cast<std::size_t>(v)];
+            return true;
+        });
+}
+
+} // namespace
+
+//____________________________________________________________________________
+template <class T>
+void EventDisplay::render_pipeline(ROOT::RDF::RNode limited, const BatchOptions &opt)
+{
+    constexpr bool is_detector = std::is_same<T, float>::value;
+    using FrameT = Frame<T>;
+
+    const bool use_combined_pdf =
+        (!opt.combined_pdf.empty() && opt.image_format == "pdf");
+    const bool use_raster = !use_combined_pdf && opt.raster_png && opt.image_format == "png";
+    const std::filesystem::path combined_path =
+        use_combined_pdf ? std::filesystem::path(opt.out_dir) / opt.combined_pdf : std::filesystem::path();
 
     auto display_opts = opt.display;
     display_opts.out_dir = opt.out_dir;
 
-    if (opt.mode == Mode::Detector)
+    struct ManifestEntry
     {
-        const std::vector<std::string> cols{
-            opt.cols.run,
-            opt.cols.sub,
-            opt.cols.evt,
-            opt.cols.det_u,
-            opt.cols.det_v,
-            opt.cols.det_w};
-
-        std::atomic<std::size_t> page_idx{0};
-        limited.Foreach(
-            [&](int run,
-                int sub,
-                int evt,
-                const ROOT::VecOps::RVec<float> &det_u,
-                const ROOT::VecOps::RVec<float> &det_v,
-                const ROOT::VecOps::RVec<float> &det_w)
+        std::size_t seq;
+        std::size_t plane;
+        nlohmann::json row;
+    };
+    std::vector<ManifestEntry> manifest;
+    std::mutex manifest_mutex;
+    std::mutex log_mutex;
+    std::size_t n_pages = 0;
+
+    // Stage two: colour, quantiles and output for one frame.
+    auto render = [&](const FrameT &f) {
+        std::vector<float> scratch;
+        for (std::size_t p = 0; p < opt.planes.size(); ++p)
+        {
+            const std::string &plane = opt.planes[p];
+            const PlanePixels<T> &img = f.planes[p];
+
+            auto plane_opts = display_opts;
+            std::ostringstream log;
+            log << "[EventDisplay] Rendering " << (is_detector ? "detector" : "semantic") << " images for "
+                << "run=" << f.run << " sub=" << f.sub << " evt=" << f.evt << " plane=" << plane << '\n';
+            if constexpr (is_detector)
+            {
+                const PlaneRange r = detector_range(img, scratch);
+                if (r.positive_pixels > 0)
+                {
+                    plane_opts.det_min = std::max(r.q02, 1e-4f);
+                    // Keep a robust upper bound while reducing colour saturation
+                    // on bright detector features.
+                    plane_opts.det_max = r.q999;
+                }
+                log << "[EventDisplay] Plane range summary "
+                    << "run=" << f.run << " sub=" << f.sub << " evt=" << f.evt << " plane=" << plane
+                    << " raw_min=" << r.raw_min << " raw_max=" << r.raw_max
+                    << " positive_pixels=" << r.positive_pixels
+                    << " q02=" << r.q02 << " q999=" << r.q999
+                    << " display_min=" << plane_opts.det_min << " display_max=" << plane_opts.det_max
+                    << '\n';
+            }
             {
-                std::clog << "[EventDisplay] Rendering detector images for "
-                          << "run=" << run
-                          << " sub=" << sub
-                          << " evt=" << evt
-                          << '\n';
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::clog << log.str();
+            }
 
-                auto pick = [&](const std::string &plane) -> const ROOT::VecOps::RVec<float> &
+            const std::string tag = format_tag(opt.file_pattern, plane, f.run, f.sub, f.evt);
+            std::string file;
+            if (use_raster)
+            {
+                const auto [W, H] = deduce_grid(0, 0, img.size);
+                RasterImage raster;
+                if constexpr (is_detector)
+                    raster = detector_raster(img, W, H, plane_opts);
+                else
+                    raster = semantic_raster(img, W, H, plane_opts);
+                file = (std::filesystem::path(opt.out_dir) / (nu::Plotter::sanitise(tag) + ".png")).string();
+                raster.write_png(file);
+            }
+            else
+            {
+                const std::string title =
+                    std::string(is_detector ? "Detector" : "Semantic") + " Image, Plane " + plane +
+                    " - Run " + std::to_string(f.run) +
+                    ", Subrun " + std::to_string(f.sub) +
+                    ", Event " + std::to_string(f.evt);
+                EventDisplay::Spec spec{tag, title, opt.mode};
+                EventDisplay ed(spec, plane_opts, img.dense());
+                if (use_combined_pdf)
                 {
-                    if (plane == "U")
-                        return det_u;
-                    else if (plane == "V")
-                        return det_v;
-                    else
-                        return det_w;
-                };
-
-                for (const auto &plane : opt.planes)
+                    std::string target = combined_path.string();
+                    if (n_pages++ == 0)
+                        target += "(";
+                    ed.draw_and_save("pdf", target);
+                    file = combined_path.string();
+                }
+                else
                 {
-                    const auto &img = pick(plane);
-
-                    auto plane_opts = display_opts;
-                    float raw_min = 0.0f;
-                    float raw_max = 0.0f;
-                    float q02 = 0.0f;
-                    float q999 = 0.0f;
-                    std::size_t positive_pixels = 0;
-                    if (!img.empty())
-                    {
-                        const auto raw_mm = std::minmax_element(img.begin(), img.end());
-                        raw_min = *raw_mm.first;
-                        raw_max = *raw_mm.second;
-
-                        std::vector<float> vals;
-                        vals.reserve(img.size());
-                        for (float v : img)
-                            if (v > 0.0f)
-                                vals.push_back(v);
-
-                        positive_pixels = vals.size();
-                        if (!vals.empty())
-                        {
-                            std::sort(vals.begin(), vals.end());
-                            auto q = [&](double f) -> float
-                            {
-                                std::size_t idx = std::min(vals.size() - 1,
-                                                           static_cast<std::size_t>(f * vals.size()));
-                                return vals[idx];
-                            };
-
-                            q02 = q(0.02);
-                            // Keep a robust upper bound while reducing colour saturation
-                            // on bright detector features.
-                            q999 = q(0.999);
-
-                            plane_opts.det_min = std::max(q02, 1e-4f);
-                            plane_opts.det_max = q999;
-                        }
-                    }
-
-                    std::clog << "[EventDisplay] Plane range summary "
-                              << "run=" << run
-                              << " sub=" << sub
-                              << " evt=" << evt
-                              << " plane=" << plane
-                              << " raw_min=" << raw_min
-                              << " raw_max=" << raw_max
-                              << " positive_pixels=" << positive_pixels
-                              << " q02=" << q02
-                              << " q999=" << q999
-                              << " display_min=" << plane_opts.det_min
-                              << " display_max=" << plane_opts.det_max
-                              << '\n';
-
-                    const std::string tag = format_tag(opt.file_pattern, plane, run, sub, evt);
-                    const std::string title =
-                        "Detector Image, Plane " + plane +
-                        " - Run " + std::to_string(run) +
-                        ", Subrun " + std::to_string(sub) +
-                        ", Event " + std::to_string(evt);
-
-                    EventDisplay::Spec spec{tag, title, Mode::Detector};
-                    EventDisplay::DetectorData det_data(img.begin(), img.end());
-                    EventDisplay ed(spec, plane_opts, std::move(det_data));
-
-                    if (use_combined_pdf)
-                    {
-                        const std::size_t idx = page_idx++;
-                        std::string target = combined_path.string();
-                        if (idx == 0)
-                            target += "(";
-                        else if (idx + 1 == total_pages)
-                            target += ")";
-                        ed.draw_and_save("pdf", target);
-                        if (!opt.manifest_path.empty())
-                        {
-                            std::lock_guard<std::mutex> lock(manifest_mutex);
-                            manifest.push_back({{"run", run},
-                                                {"sub", sub},
-                                                {"evt", evt},
-                                                {"plane", plane},
-                                                {"file", combined_path.string()}});
-                        }
-                    }
-                    else
-                    {
-                        ed.draw_and_save(opt.image_format);
-                        if (!opt.manifest_path.empty())
-                        {
-                            const std::string file =
-                                (std::filesystem::path(opt.out_dir) /
-                                 (nu::Plotter::sanitise(tag) + "." + opt.image_format))
-                                    .string();
-                            std::lock_guard<std::mutex> lock(manifest_mutex);
-                            manifest.push_back({{"run", run},
-                                                {"sub", sub},
-                                                {"evt", evt},
-                                                {"plane", plane},
-                                                {"file", file}});
-                        }
-                    }
+                    ed.draw_and_save(opt.image_format);
+                    file = (std::filesystem::path(opt.out_dir) /
+                            (nu::Plotter::sanitise(tag) + "." + opt.image_format))
+                               .string();
                 }
-            },
-            cols);
+            }
+
+            if (!opt.manifest_path.empty())
+            {
+                std::lock_guard<std::mutex> lock(manifest_mutex);
+                manifest.push_back({f.seq, p, {{"run", f.run}, {"sub", f.sub}, {"evt", f.evt}, {"plane", plane}, {"file", file}}});
+            }
+        }
+    };
+
+    // Stage one: the event loop copies the non-zero pixels of each selected
+    // image once into the queue, straight from sparse-encoded branches when
+    // the event list has them.
+    BoundedQueue<FrameT> queue(opt.queue_depth);
+    std::exception_ptr producer_error;
+    std::vector<std::string> image_cols = is_detector
+        ? std::vector<std::string>{opt.cols.det_u, opt.cols.det_v, opt.cols.det_w}
+        : std::vector<std::string>{opt.cols.sem_u, opt.cols.sem_v, opt.cols.sem_w};
+
+    const auto names = limited.GetColumnNames();
+    bool sparse_input = true;
+    for (const auto &col : image_cols)
+    {
+        const std::string encoded = nu::SparseImageCodec::encoded_column(col, !is_detector);
+        sparse_input = sparse_input && std::find(names.begin(), names.end(), encoded) != names.end();
     }
-    else
+    if (sparse_input)
     {
-        const std::vector<std::string> cols{
-            opt.cols.run,
-            opt.cols.sub,
-            opt.cols.evt,
-            opt.cols.sem_u,
-            opt.cols.sem_v,
-            opt.cols.sem_w};
-
-        std::atomic<std::size_t> page_idx{0};
-        limited.Foreach(
-            [&](int run,
-                int sub,
-                int evt,
-                const ROOT::VecOps::RVec<int> &sem_u,
-                const ROOT::VecOps::RVec<int> &sem_v,
-                const ROOT::VecOps::RVec<int> &sem_w)
+        for (auto &col : image_cols)
+            col = nu::SparseImageCodec::encoded_column(col, !is_detector);
+    }
+    std::vector<std::string> cols = {opt.cols.run, opt.cols.sub, opt.cols.evt};
+    cols.insert(cols.end(), image_cols.begin(), image_cols.end());
+
+    std::atomic<std::size_t> seq{0};
+    auto push_frame = [&](int run, int sub, int evt, auto &&fill_plane) {
+        FrameT f;
+        f.seq = seq++;
+        f.run = run;
+        f.sub = sub;
+        f.evt = evt;
+        for (const auto &plane : opt.planes)
+        {
+            PlanePixels<T> pixels;
+            fill_plane((plane == "U") ? 0 : ((plane == "V") ? 1 : 2), pixels);
+            f.planes.push_back(std::move(pixels));
+        }
+        queue.push(std::move(f));
+    };
+
+    // The producer's event loop and the render side both touch gROOT,
+    // gDirectory and the global lists, so ROOT must lock them.
+    ROOT::EnableThreadSafety();
+    std::thread producer([&] {
+        try
+        {
+            if (sparse_input)
+            {
+                using Blob = ROOT::VecOps::RVec<unsigned char>;
+                limited.Foreach(
+                    [&](int run, int sub, int evt, const Blob &blob_u, const Blob &blob_v, const Blob &blob_w) {
+                        const Blob *blobs[3] = {&blob_u, &blob_v, &blob_w};
+                        push_frame(run, sub, evt, [&](int i, PlanePixels<T> &pixels) {
+                            const Blob &blob = *blobs[i];
+                            pixels.size = nu::SparseImageCodec::for_each_nonzero<T>(
+                                blob.data(), blob.size(), [&](std::size_t k, T v) { pixels.add(k, v); });
+                        });
+                    },
+                    cols);
+            }
+            else
             {
-                std::clog << "[EventDisplay] Rendering semantic images for "
-                          << "run=" << run
-                          << " sub=" << sub
-                          << " evt=" << evt
-                          << '\n';
+                using Image = ROOT::VecOps::RVec<T>;
+                limited.Foreach(
+                    [&](int run, int sub, int evt, const Image &img_u, const Image &img_v, const Image &img_w) {
+                        const Image *images[3] = {&img_u, &img_v, &img_w};
+                        push_frame(run, sub, evt, [&](int i, PlanePixels<T> &pixels) {
+                            const Image &img = *images[i];
+                            pixels.size = img.size();
+                            for (std::size_t k = 0; k < img.size(); ++k)
+                                if (img[k] != T{})
+                                    pixels.add(k, img[k]);
+                        });
+                    },
+                    cols);
+            }
+        }
+        catch (...)
+        {
+            producer_error = std::current_exception();
+        }
+        queue.close();
+    });
 
-                auto pick = [&](const std::string &plane) -> const ROOT::VecOps::RVec<int> &
-                {
-                    if (plane == "U")
-                        return sem_u;
-                    else if (plane == "V")
-                        return sem_v;
-                    else
-                        return sem_w;
-                };
-
-                for (const auto &plane : opt.planes)
+    std::exception_ptr render_error;
+    if (use_raster)
+    {
+        unsigned int n_workers = opt.n_workers > 0 ? static_cast<unsigned int>(opt.n_workers)
+                                                   : std::max(1u, std::thread::hardware_concurrency());
+        std::mutex error_mutex;
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < n_workers; ++w)
+        {
+            workers.emplace_back([&] {
+                FrameT f;
+                while (queue.pop(f))
                 {
-                    const auto &img = pick(plane);
-                    const std::string tag = format_tag(opt.file_pattern, plane, run, sub, evt);
-                    const std::string title =
-                        "Semantic Image, Plane " + plane +
-                        " - Run " + std::to_string(run) +
-                        ", Subrun " + std::to_string(sub) +
-                        ", Event " + std::to_string(evt);
-
-                    EventDisplay::Spec spec{tag, title, Mode::Semantic};
-                    EventDisplay::SemanticData sem_data(img.begin(), img.end());
-                    EventDisplay ed(spec, display_opts, std::move(sem_data));
-
-                    if (use_combined_pdf)
+                    try
                     {
-                        const std::size_t idx = page_idx++;
-                        std::string target = combined_path.string();
-                        if (idx == 0)
-                            target += "(";
-                        else if (idx + 1 == total_pages)
-                            target += ")";
-                        ed.draw_and_save("pdf", target);
-                        if (!opt.manifest_path.empty())
-                        {
-                            std::lock_guard<std::mutex> lock(manifest_mutex);
-                            manifest.push_back({{"run", run},
-                                                {"sub", sub},
-                                                {"evt", evt},
-                                                {"plane", plane},
-                                                {"file", combined_path.string()}});
-                        }
+                        render(f);
                     }
-                    else
+                    catch (...)
                     {
-                        ed.draw_and_save(opt.image_format);
-                        if (!opt.manifest_path.empty())
-                        {
-                            const std::string file =
-                                (std::filesystem::path(opt.out_dir) /
-                                 (nu::Plotter::sanitise(tag) + "." + opt.image_format))
-                                    .string();
-                            std::lock_guard<std::mutex> lock(manifest_mutex);
-                            manifest.push_back({{"run", run},
-                                                {"sub", sub},
-                                                {"evt", evt},
-                                                {"plane", plane},
-                                                {"file", file}});
-                        }
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!render_error)
+                            render_error = std::current_exception();
                     }
                 }
-            },
-            cols);
+            });
+        }
+        for (auto &t : workers)
+            t.join();
     }
+    else
+    {
+        // ROOT graphics stay on this thread.
+        FrameT f;
+        while (queue.pop(f))
+        {
+            try
+            {
+                render(f);
+            }
+            catch (...)
+            {
+                if (!render_error)
+                    render_error = std::current_exception();
+            }
+        }
+        if (use_combined_pdf && n_pages > 0)
+        {
+            TCanvas closer("c_evd_close", "", 10, 10);
+            closer.Print((combined_path.string() + "]").c_str());
+        }
+    }
+    producer.join();
+
+    if (producer_error)
+        std::rethrow_exception(producer_error);
+    if (render_error)
+        std::rethrow_exception(render_error);
+
+    std::clog << "[EventDisplay] Rendered " << seq.load() << " events." << '\n';
+
     if (!opt.manifest_path.empty())
     {
+        std::sort(manifest.begin(), manifest.end(), [](const ManifestEntry &a, const ManifestEntry &b) {
+            return a.seq != b.seq ? a.seq < b.seq : a.plane < b.plane;
+        });
+        nlohmann::json out = nlohmann::json::array();
+        for (auto &e : manifest)
+            out.push_back(std::move(e.row));
         std::ofstream ofs(opt.manifest_path);
-        ofs << manifest.dump(2);
+        ofs << out.dump(2);
         std::clog << "[EventDisplay] Wrote event display manifest: "
                   << opt.manifest_path << '\n';
     }
 }
 
+//____________________________________________________________________________
+void EventDisplay::render_from_rdf(ROOT::RDF::RNode df, const BatchOptions &opt)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(opt.out_dir, ec);
+    if (ec)
+    {
+        std::cerr << "[EventDisplay] Failed to create output directory '"
+                  << opt.out_dir << "': " << ec.message() << '\n';
+    }
+
+    auto filtered = df;
+    if (!opt.selection_expr.empty())
+        filtered = filtered.Filter(opt.selection_expr);
+
+    // Take the first n_events selected rows without a separate Count() pass.
+    auto limited = filtered;
+    if (opt.n_events > 0)
+    {
+        const auto max_events = static_cast<std::size_t>(opt.n_events);
+        if (ROOT::IsImplicitMTEnabled())
+        {
+            std::clog << "[EventDisplay] Implicit MT is enabled; the first " << max_events
+                      << " selected rows are not guaranteed to follow tree order." << '\n';
+            auto taken = std::make_shared<std::atomic<std::size_t>>(0);
+            limited = filtered.Filter([taken, max_events]() { return (*taken)++ < max_events; });
+        }
+        else
+        {
+            limited = filtered.Range(static_cast<ULong64_t>(max_events));
+        }
+    }
+
+    std::clog << "[EventDisplay] Rendering up to "
+              << (opt.n_events > 0 ? std::to_string(opt.n_events) : std::string("all"))
+              << " selected events." << '\n';
+
+    if (opt.mode == Mode::Detector)
+        render_pipeline<float>(limited, opt);
+    else
+        render_pipeline<int>(limited, opt);
+}
+
 } // namespace evd
 } // namespace heron
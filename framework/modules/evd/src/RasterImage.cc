@@ -0,0 +1,152 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/evd/src/RasterImage.cc
+ *
+ *  @brief PNG encoding and colour maps for direct raster event displays.
+ */
+
+#include "RasterImage.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace heron {
+namespace evd {
+
+namespace {
+
+void put_u32(std::vector<std::uint8_t> &out, std::uint32_t v)
+{
+    out.push_back(static_cast<std::uint8_t>(v >> 24));
+    out.push_back(static_cast<std::uint8_t>(v >> 16));
+    out.push_back(static_cast<std::uint8_t>(v >> 8));
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+void put_chunk(std::vector<std::uint8_t> &out, const char type[4], const std::uint8_t *data, std::size_t n)
+{
+    put_u32(out, static_cast<std::uint32_t>(n));
+    const std::size_t type_pos = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + n);
+    const uLong crc = crc32(0L, &out[type_pos], static_cast<uInt>(n + 4));
+    put_u32(out, static_cast<std::uint32_t>(crc));
+}
+
+RasterImage::RGB hex_colour(unsigned int rgb)
+{
+    return RasterImage::RGB{static_cast<std::uint8_t>((rgb >> 16) & 0xff),
+                            static_cast<std::uint8_t>((rgb >> 8) & 0xff),
+                            static_cast<std::uint8_t>(rgb & 0xff)};
+}
+
+} // namespace
+
+//____________________________________________________________________________
+RasterImage::RasterImage(int width, int height, RGB fill)
+    : width_(std::max(0, width)),
+      height_(std::max(0, height)),
+      pixels_(3 * static_cast<std::size_t>(width_) * height_)
+{
+    for (std::size_t i = 0; i < pixels_.size(); i += 3)
+    {
+        pixels_[i] = fill[0];
+        pixels_[i + 1] = fill[1];
+        pixels_[i + 2] = fill[2];
+    }
+}
+
+//____________________________________________________________________________
+void RasterImage::write_png(const std::string &path, int compression_level) const
+{
+    if (width_ <= 0 || height_ <= 0)
+        throw std::runtime_error("RasterImage: cannot write an empty image to " + path);
+
+    // Scanlines with filter type 0 (none).
+    const std::size_t stride = 3 * static_cast<std::size_t>(width_);
+    std::vector<std::uint8_t> raw((stride + 1) * height_);
+    for (int y = 0; y < height_; ++y)
+    {
+        std::uint8_t *row = &raw[(stride + 1) * y];
+        row[0] = 0;
+        std::copy_n(&pixels_[stride * y], stride, row + 1);
+    }
+
+    uLongf zsize = compressBound(static_cast<uLong>(raw.size()));
+    std::vector<std::uint8_t> zdata(zsize);
+    const int level = std::clamp(compression_level, 1, 9);
+    if (compress2(zdata.data(), &zsize, raw.data(), static_cast<uLong>(raw.size()), level) != Z_OK)
+        throw std::runtime_error("RasterImage: zlib compression failed for " + path);
+
+    std::vector<std::uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<std::uint8_t> ihdr;
+    put_u32(ihdr, static_cast<std::uint32_t>(width_));
+    put_u32(ihdr, static_cast<std::uint32_t>(height_));
+    ihdr.push_back(8); // bit depth
+    ihdr.push_back(2); // truecolour RGB
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+    put_chunk(png, "IHDR", ihdr.data(), ihdr.size());
+    put_chunk(png, "IDAT", zdata.data(), zsize);
+    put_chunk(png, "IEND", nullptr, 0);
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!out)
+        throw std::runtime_error("RasterImage: failed to write " + path);
+}
+
+//____________________________________________________________________________
+const std::array<RasterImage::RGB, 256> &bird_colour_map()
+{
+    static const std::array<RasterImage::RGB, 256> lut = [] {
+        // kBird stops, as in TColor::SetPalette.
+        const double red[9] = {0.2082, 0.0592, 0.0780, 0.0232, 0.1802, 0.5301, 0.8186, 0.9956, 0.9764};
+        const double green[9] = {0.1664, 0.3599, 0.5041, 0.6419, 0.7178, 0.7492, 0.7328, 0.7862, 0.9832};
+        const double blue[9] = {0.5293, 0.8684, 0.8385, 0.7914, 0.6425, 0.4662, 0.3499, 0.1968, 0.0539};
+
+        std::array<RasterImage::RGB, 256> out{};
+        for (int i = 0; i < 256; ++i)
+        {
+            const double t = 8.0 * i / 255.0;
+            const int k = std::min(7, static_cast<int>(t));
+            const double f = t - k;
+            auto mix = [&](const double *c) {
+                return static_cast<std::uint8_t>(std::lround(255.0 * (c[k] + f * (c[k + 1] - c[k]))));
+            };
+            out[static_cast<std::size_t>(i)] = RasterImage::RGB{mix(red), mix(green), mix(blue)};
+        }
+        return out;
+    }();
+    return lut;
+}
+
+//____________________________________________________________________________
+const std::array<RasterImage::RGB, 15> &semantic_colour_map()
+{
+    static const std::array<RasterImage::RGB, 15> lut = {
+        RasterImage::RGB{230, 230, 230},
+        hex_colour(0x666666),
+        hex_colour(0xe41a1c),
+        hex_colour(0x377eb8),
+        hex_colour(0x4daf4a),
+        hex_colour(0xff7f00),
+        hex_colour(0x984ea3),
+        hex_colour(0xffff33),
+        hex_colour(0x1b9e77),
+        hex_colour(0xf781bf),
+        hex_colour(0xa65628),
+        hex_colour(0x66a61e),
+        hex_colour(0xe6ab02),
+        hex_colour(0xa6cee3),
+        hex_colour(0xb15928)};
+    return lut;
+}
+
+} // namespace evd
+} // namespace heron
@@ -0,0 +1,151 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/include/ColumnCache.hh
+ *
+ *  @brief Local cache of event-list columns as uncompressed, memory-mappable
+ *         per-column files, read back through an RDataFrame data source.
+ */
+
+#ifndef HERON_IO_COLUMN_CACHE_H
+#define HERON_IO_COLUMN_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RDataSource.hxx>
+
+namespace nu
+{
+
+/// Element type of a cached column (scalars only).
+enum class CachedColumnType : std::uint32_t
+{
+    kBool = 0,
+    kInt8,
+    kUInt8,
+    kInt16,
+    kUInt16,
+    kInt32,
+    kUInt32,
+    kInt64,
+    kUInt64,
+    kFloat,
+    kDouble
+};
+
+/**
+ *  @brief On-disk column header (version 1), followed at data_offset by
+ *         n_entries native values of element_size bytes (bool as one byte).
+ *
+ *  source_key identifies the event list (and friends) the column was
+ *  computed from; a file whose key differs is stale and rewritten.
+ */
+struct CachedColumnHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t type;
+    std::uint64_t n_entries;
+    std::uint64_t element_size;
+    std::uint64_t data_offset;
+    std::uint64_t source_key;
+    std::uint8_t reserved[16];
+};
+static_assert(sizeof(CachedColumnHeader) == 64, "CachedColumnHeader must stay 64 bytes");
+
+/// Cached type of a RDataFrame column type name ("int", "Float_t", ...); throws if unsupported.
+CachedColumnType cached_column_type(const std::string &type_name);
+std::size_t cached_column_size(CachedColumnType type);
+/// C++ type name RDataFrame sees for a cached column.
+std::string cached_column_type_name(CachedColumnType type);
+
+/**
+ *  @brief Write one column file; the file appears atomically (written
+ *         under a temporary name, then renamed).
+ */
+void write_cached_column(const std::string &path,
+                         CachedColumnType type,
+                         const void *data,
+                         std::uint64_t n_entries,
+                         std::uint64_t source_key);
+
+/**
+ *  @brief Read-only mapping of one column file; values are used in place.
+ */
+class CachedColumn
+{
+  public:
+    explicit CachedColumn(const std::string &path);
+    ~CachedColumn();
+
+    CachedColumn(CachedColumn &&other) noexcept;
+    CachedColumn(const CachedColumn &) = delete;
+    CachedColumn &operator=(const CachedColumn &) = delete;
+    CachedColumn &operator=(CachedColumn &&) = delete;
+
+    const CachedColumnHeader &header() const noexcept { return *m_header; }
+    std::uint64_t size() const noexcept { return m_header->n_entries; }
+    CachedColumnType type() const noexcept { return static_cast<CachedColumnType>(m_header->type); }
+    std::uint64_t source_key() const noexcept { return m_header->source_key; }
+    const std::uint8_t *data() const noexcept { return m_base + m_header->data_offset; }
+
+    /// True when @p path is a readable column file for @p source_key.
+    static bool valid(const std::string &path, std::uint64_t source_key);
+
+  private:
+    const std::uint8_t *m_base = nullptr;
+    std::size_t m_size = 0;
+    const CachedColumnHeader *m_header = nullptr;
+};
+
+/**
+ *  @brief RDataFrame data source over mapped column files of equal length.
+ *
+ *  SetEntry() only moves per-slot pointers into the mappings, so an event
+ *  loop is bound by memory bandwidth rather than decompression.
+ */
+class CachedColumnSource final : public ROOT::RDF::RDataSource
+{
+  public:
+    /// (column name, column file) pairs.
+    explicit CachedColumnSource(const std::vector<std::pair<std::string, std::string>> &columns);
+
+    void SetNSlots(unsigned int n_slots) final;
+    const std::vector<std::string> &GetColumnNames() const final { return m_names; }
+    bool HasColumn(std::string_view name) const final;
+    std::string GetTypeName(std::string_view name) const final;
+    std::vector<std::pair<ULong64_t, ULong64_t>> GetEntryRanges() final;
+    bool SetEntry(unsigned int slot, ULong64_t entry) final;
+    void Initialize() final;
+    std::string GetLabel() final { return "HeronColumnCache"; }
+
+  protected:
+    Record_t GetColumnReadersImpl(std::string_view name, const std::type_info &type) final;
+
+  private:
+    std::size_t column_index(std::string_view name) const;
+
+    std::vector<std::string> m_names;
+    std::vector<CachedColumn> m_columns;
+    std::uint64_t m_n_entries = 0;
+    unsigned int m_n_slots = 1;
+    bool m_ranges_served = false;
+    /// Current value pointer per (column, slot); readers point at these.
+    std::vector<std::vector<const void *>> m_current;
+};
+
+/// HERON_COLUMN_CACHE != "0".
+bool column_cache_enabled();
+/// HERON_COLUMN_CACHE_DIR, or <temp dir>/heron-column-cache.
+std::filesystem::path column_cache_dir();
+
+}
+
+#endif
@@ -10,15 +10,21 @@
 #define HERON_IO_EVENT_LIST_IO_H
 
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <ROOT/RDataFrame.hxx>
 
 #include "SampleIO.hh"
 
+class TChain;
+class TEntryList;
+
 namespace nu
 {
 struct EventListHeader
@@ -31,6 +37,141 @@ struct EventListHeader
     std::string event_output_dir;
 };
 
+/// Row of the persistent (run, sub, evt) -> event-tree entry index.
+struct EventIndexEntry
+{
+    int run = 0;
+    int sub = 0;
+    int evt = 0;
+    int sample_id = -1;
+    Long64_t entry = -1;
+};
+
+/**
+ *  @brief Copy of selected event-tree entries in a scratch file, readable
+ *         with RDataFrame (including under implicit MT). The file is
+ *         removed when the subset is destroyed.
+ */
+class EventSubset
+{
+  public:
+    EventSubset(std::string path, std::string tree_name, ULong64_t n_entries);
+    ~EventSubset();
+
+    EventSubset(EventSubset &&other) noexcept;
+    EventSubset(const EventSubset &) = delete;
+    EventSubset &operator=(const EventSubset &) = delete;
+    EventSubset &operator=(EventSubset &&) = delete;
+
+    ULong64_t size() const noexcept { return m_n_entries; }
+    ROOT::RDataFrame rdf() const;
+
+  private:
+    std::string m_path;
+    std::string m_tree_name;
+    ULong64_t m_n_entries = 0;
+};
+
+/// Half-open event-tree entry range [first, second).
+using EntryRange = std::pair<Long64_t, Long64_t>;
+
+/**
+ *  @brief Entry-aligned side tree registered with an event list (see
+ *         EventListIO::write_friend); its columns are readable as
+ *         "<name>.<column>" or, when unambiguous, as "<column>".
+ */
+struct FriendTreeRef
+{
+    std::string name;
+    /// Side file, resolved against the event list's directory.
+    std::string path;
+    std::string tree;
+    Long64_t n_entries = 0;
+};
+
+/// Friend-tree column: a name and an RDataFrame expression over rdf().
+struct FriendColumn
+{
+    std::string name;
+    std::string expr;
+};
+
+/**
+ *  @brief Event tree restricted to some entry ranges, readable with
+ *         RDataFrame (including under implicit MT); rows outside the ranges
+ *         are never read. An optional sample mask is applied as a sample_id
+ *         filter (used when sample entry ranges are unknown). The view must
+ *         outlive every node built from rdf().
+ */
+class EventListView
+{
+  public:
+    /// @p ranges are clipped to the tree; covering it entirely means no entry list.
+    EventListView(std::string path,
+                  std::string tree_name,
+                  const std::vector<EntryRange> &ranges,
+                  std::shared_ptr<const std::vector<char>> mask,
+                  const std::vector<FriendTreeRef> &friends = {});
+    ~EventListView();
+
+    EventListView(EventListView &&other) noexcept;
+    EventListView(const EventListView &) = delete;
+    EventListView &operator=(const EventListView &) = delete;
+    EventListView &operator=(EventListView &&) = delete;
+
+    /// True when only part of the tree is read.
+    bool restricted() const noexcept { return m_entry_list != nullptr; }
+    /// Entries visited by the event loop (before the sample_id filter).
+    ULong64_t size() const noexcept { return m_n_entries; }
+    ROOT::RDF::RNode rdf() const;
+
+  private:
+    std::string m_path;
+    std::string m_tree_name;
+    std::vector<std::unique_ptr<TChain>> m_friends;
+    std::unique_ptr<TChain> m_chain;
+    std::unique_ptr<TEntryList> m_entry_list;
+    std::shared_ptr<const std::vector<char>> m_mask;
+    ULong64_t m_n_entries = 0;
+};
+
+/// Column summarised per cluster in the "zone_map" tree: a name and a
+/// TTreeFormula expression over the event tree (e.g. "inf_scores[0]").
+struct ZoneMapColumn
+{
+    std::string name;
+    std::string expr;
+};
+
+/**
+ *  @brief Rows that may satisfy lo <= column <= hi; booleans are 0/1.
+ *         Zone maps only skip clusters, so the selection must still be
+ *         applied to the rows that are read.
+ */
+struct ZonePredicate
+{
+    std::string column;
+    double lo = -std::numeric_limits<double>::infinity();
+    double hi = std::numeric_limits<double>::infinity();
+
+    static ZonePredicate at_least(std::string column, double cut);
+    static ZonePredicate at_most(std::string column, double cut);
+    static ZonePredicate equal(std::string column, double value);
+    static ZonePredicate is_true(std::string column);
+};
+
+/// Per-sample bookkeeping of one split written by `heron split`.
+struct SplitSampleRef
+{
+    int sample_id = -1;
+    ULong64_t n_events = 0;
+    ULong64_t n_events_total = 0;
+    double sum_weight = 0.0;
+    double sum_weight_total = 0.0;
+    /// Share of the sample's weight in this split; sample_refs POT is scaled by it.
+    double exposure_fraction = 0.0;
+};
+
 struct SampleInfo
 {
     std::string sample_name;
@@ -40,6 +181,13 @@ struct SampleInfo
     double subrun_pot_sum = 0.0;
     double db_tortgt_pot_sum = 0.0;
     double db_tor101_pot_sum = 0.0;
+    /// Rows of this sample in the event tree, [entry_begin, entry_end);
+    /// -1 when unknown or not contiguous (set by build_event_index()).
+    Long64_t entry_begin = -1;
+    Long64_t entry_end = -1;
+    /// Order-sensitive digest of the sample's (run, sub, evt) rows in tree
+    /// order, used to validate friend trees; 0 when unknown.
+    ULong64_t key_checksum = 0;
 };
 
 class EventListIO
@@ -57,6 +205,13 @@ class EventListIO
                      const std::string &event_schema_tsv,
                      const std::string &schema_tag);
 
+    /// Record split provenance ("split_name", "split_spec") and the
+    /// "split_refs" tree in an initialised event list.
+    static void write_split_refs(const std::string &out_path,
+                                 const std::string &split_name,
+                                 const std::string &split_spec,
+                                 const std::vector<SplitSampleRef> &refs);
+
     static EventListIO read(std::string path);
 
     explicit EventListIO(std::string path, OpenMode mode = OpenMode::kRead);
@@ -68,13 +223,95 @@ class EventListIO
 
     std::string event_tree() const;
 
+    /// Event tree with every registered friend tree attached.
     ROOT::RDataFrame rdf() const;
 
+    /**
+     *  Only @p columns ("name" or "name=expr" over rdf()), read from the local
+     *  column cache (ColumnCache.hh): missing columns are materialised in one
+     *  pass, keyed by the event list's identity, and later calls map them
+     *  uncompressed. With HERON_COLUMN_CACHE=0 they are defined on rdf().
+     */
+    ROOT::RDF::RNode rdf(const std::vector<std::string> &columns) const;
+
+    /// rdf() with plain image columns (detector_image_*, ...) defined over
+    /// their sparse-encoded branches; pixels are expanded only when read.
+    ROOT::RDF::RNode rdf_with_images() const;
+
+    /// Same expansion for any node over this event list's tree (e.g.
+    /// EventSubset::rdf()), for the branches in encoded_image_columns().
+    ROOT::RDF::RNode expand_images(ROOT::RDF::RNode node) const;
+
+    /// Sparse-encoded image branches recorded when the event list was written.
+    const std::vector<std::string> &encoded_image_columns() const noexcept { return m_encoded_image_columns; }
+
+    /// Plain universe weight columns (weightsGenie, ...) defined on @p node
+    /// over the branches in encoded_weight_columns(), decoded when read.
+    ROOT::RDF::RNode decode_weights(ROOT::RDF::RNode node) const;
+
+    /// Compact universe weight branches recorded when the event list was written.
+    const std::vector<std::string> &encoded_weight_columns() const noexcept { return m_encoded_weight_columns; }
+
     std::shared_ptr<const std::vector<char>> mask_for_origin(SampleIO::SampleOrigin origin) const;
     std::shared_ptr<const std::vector<char>> mask_for_mc_like() const;
     std::shared_ptr<const std::vector<char>> mask_for_data() const;
     std::shared_ptr<const std::vector<char>> mask_for_ext() const;
 
+    /// True when every sample has a contiguous entry range in sample_refs.
+    bool has_entry_ranges() const;
+    /// Merged entry ranges of the masked samples; throws if one is unknown.
+    std::vector<EntryRange> entry_ranges(const std::vector<char> &mask) const;
+
+    /// Views reading only the rows of the masked samples (see EventListView).
+    EventListView view(std::shared_ptr<const std::vector<char>> mask) const;
+    EventListView view_for_origin(SampleIO::SampleOrigin origin) const;
+    EventListView view_for_mc_like() const;
+    EventListView view_for_data() const;
+    EventListView view_for_ext() const;
+    EventListView view_for_sample(int sample_id) const;
+
+    /**
+     *  Per-cluster min/max of @p columns over the event tree, written as the
+     *  "zone_map" tree (run after the last snapshot). Columns whose
+     *  expression does not compile are skipped; returns those written.
+     */
+    std::vector<std::string> build_zone_maps(const std::vector<ZoneMapColumn> &columns) const;
+    /// inf_score_0, sel_muon, analysis_channels and is_signal, or the
+    /// comma-separated name[=expr] list in HERON_ZONE_MAP_COLUMNS.
+    static std::vector<ZoneMapColumn> default_zone_map_columns();
+    /// Columns with a zone map.
+    std::vector<std::string> zone_map_columns() const;
+
+    /// Clusters that may satisfy every predicate (those without a zone map
+    /// are ignored), as merged entry ranges.
+    std::vector<EntryRange> zone_ranges(const std::vector<ZonePredicate> &where) const;
+    /// View over zone_ranges(where), optionally limited to the masked samples.
+    EventListView view_where(const std::vector<ZonePredicate> &where,
+                             std::shared_ptr<const std::vector<char>> mask = nullptr) const;
+
+    /**
+     *  Write @p columns of define(rdf()), which may add Defines but must not
+     *  filter, as the entry-aligned friend tree @p name in @p side_path
+     *  (default: <event list stem>.<name>.friend.root beside the event list)
+     *  and register it, replacing a friend of the same name. Only the new
+     *  columns are written. Requires implicit MT to be disabled, since the
+     *  rows must stay aligned; throws otherwise.
+     *  Returns the number of entries written.
+     */
+    ULong64_t write_friend(const std::string &name,
+                           const std::vector<std::string> &columns,
+                           const std::function<ROOT::RDF::RNode(ROOT::RDF::RNode)> &define,
+                           const std::string &side_path = "") const;
+    ULong64_t write_friend(const std::string &name,
+                           const std::vector<FriendColumn> &columns,
+                           const std::string &side_path = "") const;
+    /// Unregister friend @p name (the side file is kept).
+    void detach_friend(const std::string &name) const;
+    /// Registered friend trees, validated against the event tree by entry
+    /// count and per-sample key checksum; throws if one is stale. The result
+    /// is reused until the size or mtime of a file involved changes.
+    std::vector<FriendTreeRef> friends() const;
+
     double total_pot_data() const;
     double total_pot_mc() const;
 
@@ -95,14 +332,45 @@ class EventListIO
                                          const std::string &sample_name,
                                          const std::vector<std::string> &columns,
                                          const std::string &selection,
-                                         const std::string &tree_name = "events") const;
+                                         const std::string &tree_name = "events",
+                                         const std::vector<std::string> &encoded_columns = {},
+                                         const std::vector<std::string> &sparse_image_columns = {}) const;
+
+    /// Write the sorted "event_index" tree for the merged event tree and the
+    /// per-sample entry ranges in sample_refs (run after the last snapshot);
+    /// returns the number of indexed entries.
+    ULong64_t build_event_index() const;
+    bool has_event_index() const;
+
+    /// Index rows for (run, sub, evt), one per sample containing the event.
+    std::vector<EventIndexEntry> find_events(int run, int sub, int evt) const;
+    std::vector<EventIndexEntry> find_events(const std::vector<EventIndexEntry> &keys) const;
+
+    /// Random-access copy of the given event-tree entries (in the given order).
+    EventSubset fetch_entries(const std::vector<Long64_t> &entries) const;
+    /// Index lookup then fetch; keys with sample_id >= 0 match that sample only.
+    EventSubset fetch_events(const std::vector<EventIndexEntry> &keys) const;
 
   private:
+    ROOT::RDataFrame make_rdf(const std::vector<FriendTreeRef> &friends) const;
+    std::vector<FriendTreeRef> registered_friends() const;
+    /// Hash of the event list and friend files (path, size, mtime).
+    std::uint64_t source_key(const std::vector<FriendTreeRef> &friends) const;
+    /// Per-sample key checksums from sample_refs, or scanned when unknown.
+    std::unordered_map<int, ULong64_t> key_checksums() const;
+
     std::string m_path;
     OpenMode m_mode;
     EventListHeader m_header{};
     std::unordered_map<int, SampleInfo> m_sample_refs;
     int m_max_sample_id = -1;
+    std::vector<std::string> m_encoded_image_columns;
+    std::vector<std::string> m_encoded_weight_columns;
+
+    /// Last friends() result and the source_key it was validated for.
+    mutable std::vector<FriendTreeRef> m_friends;
+    mutable std::uint64_t m_friends_key = 0;
+    mutable bool m_friends_valid = false;
 };
 }
 
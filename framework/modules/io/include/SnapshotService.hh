@@ -33,7 +33,28 @@ class SnapshotService final
                                                 const std::string &sample_name,
                                                 const std::vector<std::string> &columns,
                                                 const std::string &selection,
-                                                const std::string &tree_name = "events");
+                                                const std::string &tree_name = "events",
+                                                const std::vector<std::string> &encoded_columns = {},
+                                                const std::vector<std::string> &sparse_image_columns = {});
+
+    /// Fast-append (basket copy, no recompression) tree @p tree_name of
+    /// @p in_path to the same tree of @p out_path, creating it if absent.
+    static void append_tree(const std::string &out_path,
+                            const std::string &in_path,
+                            const std::string &tree_name = "events");
+
+    /**
+     *  Write every event of @p node to out_paths[k], where k is the value of
+     *  the int column @p split_column, appending to tree @p tree_name of each
+     *  (already initialised) output. All splits are written in one event loop,
+     *  which also fills any other actions already booked on @p node. Returns
+     *  the number of events written per split.
+     */
+    static std::vector<ULong64_t> snapshot_event_list_splits(ROOT::RDF::RNode node,
+                                                             const std::string &split_column,
+                                                             const std::vector<std::string> &out_paths,
+                                                             const std::vector<std::string> &columns,
+                                                             const std::string &tree_name = "events");
 };
 
 
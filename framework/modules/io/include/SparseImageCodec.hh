@@ -0,0 +1,154 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/include/SparseImageCodec.hh
+ *
+ *  @brief Lossless sparse encoding for flattened detector and semantic
+ *         image columns (detector_image_*, semantic_image_*).
+ */
+
+#ifndef HERON_IO_SPARSE_IMAGE_CODEC_H
+#define HERON_IO_SPARSE_IMAGE_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+
+namespace nu
+{
+
+/**
+ *  @brief Per-event blob codec for RVec<float> / RVec<int> images.
+ *
+ *  Layout (version 1), all integers little-endian / LEB128 varints:
+ *
+ *      u8      version
+ *      u8      value type            (0: float32, 1: int32)
+ *      varint  n pixels
+ *      varint  n runs, then (gap, length) varint pairs
+ *      values  one per pixel inside the runs: raw float32, or zigzag varint
+ *
+ *  A run is a maximal stretch of non-zero pixels; gap counts the zero pixels
+ *  since the previous run. Tracks and showers light up short runs along the
+ *  drift direction, so an image costs a few bytes per lit pixel instead of
+ *  four bytes per pixel. Float pixels compare bitwise, so -0.f is kept.
+ *
+ *  Encoded branches carry kFloatSuffix or kIntSuffix next to the plain name
+ *  and are listed, one per line, in the event list's kColumnsKey string.
+ */
+class SparseImageCodec
+{
+  public:
+    static constexpr unsigned char kFormatVersion = 1;
+    static constexpr const char *kFloatSuffix = "_spf";
+    static constexpr const char *kIntSuffix = "_spi";
+    static constexpr const char *kColumnsKey = "sparse_image_columns";
+
+    static std::string encoded_column(const std::string &column, bool integer);
+
+    /// Plain column name for an encoded branch, or empty if @p column is not encoded.
+    static std::string plain_column(const std::string &column);
+
+    /// Encoded branch list as stored under kColumnsKey, and back.
+    static std::string format_columns(const std::vector<std::string> &encoded);
+    static std::vector<std::string> parse_columns(const std::string &recorded);
+
+    static void encode(const float *values, std::size_t n, std::vector<unsigned char> &out);
+    static void encode(const int *values, std::size_t n, std::vector<unsigned char> &out);
+    static ROOT::RVec<unsigned char> encode(const ROOT::RVec<float> &values);
+    static ROOT::RVec<unsigned char> encode(const ROOT::RVec<int> &values);
+
+    /// Number of pixels stored in a blob (header only).
+    static std::size_t decoded_size(const unsigned char *blob, std::size_t n_bytes);
+
+    /// Decode into @p out (capacity >= decoded_size); returns the number of pixels written.
+    static std::size_t decode(const unsigned char *blob, std::size_t n_bytes, float *out, std::size_t capacity);
+    static std::size_t decode(const unsigned char *blob, std::size_t n_bytes, int *out, std::size_t capacity);
+    static ROOT::RVec<float> decode_float(const ROOT::RVec<unsigned char> &blob);
+    static ROOT::RVec<int> decode_int(const ROOT::RVec<unsigned char> &blob);
+
+    /**
+     *  Call f(index, value) for every stored pixel in increasing index order,
+     *  without expanding the image. Returns the number of pixels in the image.
+     */
+    template <class T, class F>
+    static std::size_t for_each_nonzero(const unsigned char *blob, std::size_t n_bytes, F &&f)
+    {
+        const unsigned char *p = blob;
+        const unsigned char *end = blob + n_bytes;
+        const bool integer = read_header(p, end);
+        const std::size_t n = static_cast<std::size_t>(read_varint(p, end));
+        const std::size_t n_runs = static_cast<std::size_t>(read_varint(p, end));
+
+        const unsigned char *runs = p;
+        for (std::size_t r = 0; r < 2 * n_runs; ++r)
+            read_varint(p, end);
+
+        std::size_t index = 0;
+        for (std::size_t r = 0; r < n_runs; ++r)
+        {
+            index += static_cast<std::size_t>(read_varint(runs, end));
+            const std::size_t length = static_cast<std::size_t>(read_varint(runs, end));
+            if (index + length > n)
+                throw std::runtime_error("SparseImageCodec: run exceeds image size");
+            for (std::size_t k = 0; k < length; ++k, ++index)
+            {
+                if (integer)
+                {
+                    const std::uint32_t z = static_cast<std::uint32_t>(read_varint(p, end));
+                    f(index, static_cast<T>(static_cast<std::int32_t>(z >> 1) ^ -static_cast<std::int32_t>(z & 1u)));
+                }
+                else
+                {
+                    if (end - p < 4)
+                        throw std::runtime_error("SparseImageCodec: truncated pixel values");
+                    float v;
+                    std::memcpy(&v, p, sizeof(v));
+                    p += sizeof(v);
+                    f(index, static_cast<T>(v));
+                }
+            }
+        }
+        return n;
+    }
+
+    /// Define "<col>_spf" / "<col>_spi" for each of @p columns present on @p node.
+    static ROOT::RDF::RNode define_encoded(ROOT::RDF::RNode node, const std::vector<std::string> &columns);
+
+    /// Define the plain column for each of the @p encoded branches (as
+    /// recorded under kColumnsKey) present on @p node whose plain name is absent.
+    static ROOT::RDF::RNode define_decoded(ROOT::RDF::RNode node, const std::vector<std::string> &encoded);
+
+  private:
+    /// Validate version and return true for int32 values.
+    static bool read_header(const unsigned char *&p, const unsigned char *end)
+    {
+        if (end - p < 2 || p[0] != kFormatVersion || p[1] > 1)
+            throw std::runtime_error("SparseImageCodec: unsupported or empty blob");
+        const bool integer = p[1] == 1;
+        p += 2;
+        return integer;
+    }
+
+    static std::uint64_t read_varint(const unsigned char *&p, const unsigned char *end)
+    {
+        std::uint64_t v = 0;
+        for (unsigned shift = 0; shift < 64 && p != end; shift += 7)
+        {
+            const unsigned char b = *p++;
+            v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        throw std::runtime_error("SparseImageCodec: truncated or malformed varint");
+    }
+};
+
+}
+
+#endif
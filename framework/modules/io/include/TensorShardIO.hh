@@ -0,0 +1,200 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/include/TensorShardIO.hh
+ *
+ *  @brief Fixed-capacity, memory-mappable tensor shards holding detector
+ *         and semantic images plus a label/weight table for CNN training.
+ */
+
+#ifndef HERON_IO_TENSOR_SHARD_IO_H
+#define HERON_IO_TENSOR_SHARD_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nu
+{
+
+/**
+ *  @brief On-disk shard header (version 1).
+ *
+ *  All values are native little-endian and every section starts on a
+ *  kSectionAlignment boundary, so a loader can map the file and view each
+ *  section as a plain array (numpy.memmap, torch.from_file, mmap + cast):
+ *
+ *      header                                    128 bytes
+ *      TensorShardRecord  records[capacity]
+ *    dense (encoding 0):
+ *      float              image[capacity][n_planes][height * width]
+ *      uint8              semantic[capacity][n_planes][height * width]
+ *    sparse (encoding 1), pixels with a non-zero image or semantic value:
+ *      uint64             pixel_offsets[n_events * n_planes + 1]
+ *      uint32             pixel_index[n_pixels]     (row * width + column)
+ *      float              image[n_pixels]
+ *      uint8              semantic[n_pixels]
+ *
+ *  Only the first n_events rows of a dense shard are filled; the tail of a
+ *  last, partially filled shard is left as a file hole.
+ */
+struct TensorShardHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t encoding;
+    std::uint32_t n_planes;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t has_semantic;
+    std::uint64_t n_events;
+    std::uint64_t capacity;
+    std::uint64_t n_pixels;
+    std::uint64_t records_offset;
+    std::uint64_t pixel_offsets_offset;
+    std::uint64_t pixel_index_offset;
+    std::uint64_t image_offset;
+    std::uint64_t semantic_offset;
+    std::uint64_t file_size;
+    std::uint8_t reserved[24];
+};
+static_assert(sizeof(TensorShardHeader) == 128, "TensorShardHeader must stay 128 bytes");
+
+/// One row of the label/weight table.
+struct TensorShardRecord
+{
+    std::int32_t run = 0;
+    std::int32_t sub = 0;
+    std::int32_t evt = 0;
+    std::int32_t sample_id = -1;
+    std::int32_t label = 0;
+    float weight = 1.f;
+};
+static_assert(sizeof(TensorShardRecord) == 24, "TensorShardRecord must stay 24 bytes");
+
+/**
+ *  @brief Streams events into one shard file.
+ *
+ *  Dense images are written in place as they arrive; records and sparse
+ *  pixels are buffered and written on close(). Not thread-safe: use one
+ *  writer per thread.
+ */
+class TensorShardWriter
+{
+  public:
+    enum class Encoding : std::uint32_t
+    {
+        kDense = 0,
+        kSparse = 1
+    };
+
+    struct Layout
+    {
+        std::uint32_t n_planes = 3;
+        std::uint32_t height = 0;
+        std::uint32_t width = 0;
+        Encoding encoding = Encoding::kDense;
+        bool semantic = true;
+        std::uint64_t capacity = 1024;
+    };
+
+    TensorShardWriter(std::string path, const Layout &layout);
+    ~TensorShardWriter();
+
+    TensorShardWriter(const TensorShardWriter &) = delete;
+    TensorShardWriter &operator=(const TensorShardWriter &) = delete;
+
+    const std::string &path() const noexcept { return m_path; }
+    std::uint64_t size() const noexcept { return m_records.size(); }
+    bool full() const noexcept { return m_records.size() >= m_layout.capacity; }
+
+    /**
+     *  Append one event. @p images and @p semantic hold n_planes pointers to
+     *  height * width values each; @p semantic is ignored when the layout has
+     *  no semantic images. Semantic labels must fit in [0, 255].
+     */
+    void append(const TensorShardRecord &record,
+                const float *const *images,
+                const int *const *semantic);
+
+    /// Write the header and buffered sections; further appends throw.
+    void close();
+
+  private:
+    void write_at(std::uint64_t offset, const void *data, std::size_t n_bytes);
+
+    std::string m_path;
+    Layout m_layout;
+    int m_fd = -1;
+    std::uint64_t m_plane_size = 0;
+    std::uint64_t m_image_offset = 0;
+    std::uint64_t m_semantic_offset = 0;
+    std::vector<TensorShardRecord> m_records;
+    std::vector<std::uint8_t> m_semantic_row;
+    std::vector<std::uint64_t> m_pixel_offsets;
+    std::vector<std::uint32_t> m_pixel_index;
+    std::vector<float> m_pixel_value;
+    std::vector<std::uint8_t> m_pixel_semantic;
+};
+
+/**
+ *  @brief Read-only mapping of a shard; every accessor returns a pointer into
+ *         the mapping, nothing is copied or decoded.
+ */
+class TensorShardReader
+{
+  public:
+    struct SparsePlane
+    {
+        const std::uint32_t *index = nullptr;
+        const float *image = nullptr;
+        const std::uint8_t *semantic = nullptr;
+        std::size_t n_pixels = 0;
+    };
+
+    explicit TensorShardReader(const std::string &path);
+    ~TensorShardReader();
+
+    TensorShardReader(TensorShardReader &&other) noexcept;
+    TensorShardReader(const TensorShardReader &) = delete;
+    TensorShardReader &operator=(const TensorShardReader &) = delete;
+    TensorShardReader &operator=(TensorShardReader &&) = delete;
+
+    const TensorShardHeader &header() const noexcept { return *m_header; }
+    std::uint64_t size() const noexcept { return m_header->n_events; }
+    bool sparse() const noexcept { return m_header->encoding == 1; }
+    bool has_semantic() const noexcept { return m_header->has_semantic != 0; }
+    std::size_t plane_size() const noexcept
+    {
+        return static_cast<std::size_t>(m_header->height) * m_header->width;
+    }
+
+    const TensorShardRecord &record(std::uint64_t event) const;
+
+    /// Dense shards only; semantic() is nullptr without semantic images.
+    const float *image(std::uint64_t event, std::uint32_t plane) const;
+    const std::uint8_t *semantic(std::uint64_t event, std::uint32_t plane) const;
+
+    /// Sparse shards only.
+    SparsePlane sparse_plane(std::uint64_t event, std::uint32_t plane) const;
+
+    /// Expand one plane of either encoding into plane_size() values;
+    /// @p semantic may be nullptr.
+    void decode(std::uint64_t event, std::uint32_t plane, float *image, std::uint8_t *semantic) const;
+
+    /// Shard files (suffix kShardSuffix) in @p directory, sorted by name.
+    static std::vector<std::string> find_shards(const std::string &directory);
+
+    static constexpr const char *kShardSuffix = ".htsr";
+
+  private:
+    std::size_t dense_index(std::uint64_t event, std::uint32_t plane) const;
+
+    const std::uint8_t *m_base = nullptr;
+    std::size_t m_size = 0;
+    const TensorShardHeader *m_header = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/include/UniverseWeightCodec.hh
+ *
+ *  @brief Lossless compact encoding for packed universe weight vectors
+ *         (weightsGenie, weightsPPFX, ...) stored as weight * 1000 in ushort.
+ */
+
+#ifndef HERON_IO_UNIVERSE_WEIGHT_CODEC_H
+#define HERON_IO_UNIVERSE_WEIGHT_CODEC_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+
+namespace nu
+{
+
+/**
+ *  @brief Per-event blob codec for RVec<unsigned short> universe vectors.
+ *
+ *  Layout (version 1), all integers little-endian / LEB128 varints:
+ *
+ *      u8      version
+ *      u8      mode << 5 | width     (mode 0: zigzag(v - 1000), mode 1: raw v)
+ *      varint  n values
+ *      varint  n unity runs, then (gap, length) varint pairs
+ *      planes  values outside the unity runs, bit-packed in groups of eight
+ *
+ *  Runs of at least kMinUnityRun exact-unity entries (packed 1000) are stored
+ *  only as (gap, length), so default/unweighted vectors cost a few bytes.
+ *  Widths above 8 bits are split into a byte plane and a (width - 8) bit plane
+ *  so every group of eight decodes from at most one 64-bit word.
+ *
+ *  Encoded branches carry the suffix kEncodedSuffix next to the plain name
+ *  and are listed, one per line, in the event list's kColumnsKey string.
+ */
+class UniverseWeightCodec
+{
+  public:
+    static constexpr unsigned short kUnity = 1000;
+    static constexpr unsigned char kFormatVersion = 1;
+    static constexpr std::size_t kMinUnityRun = 8;
+    static constexpr const char *kEncodedSuffix = "_uwq";
+    static constexpr const char *kColumnsKey = "universe_weight_columns";
+
+    static std::string encoded_column(const std::string &column);
+
+    /// Plain column name for an encoded branch, or empty if @p column is not encoded.
+    static std::string plain_column(const std::string &column);
+
+    /// Encoded branch list as stored under kColumnsKey, and back.
+    static std::string format_columns(const std::vector<std::string> &encoded);
+    static std::vector<std::string> parse_columns(const std::string &recorded);
+
+    static void encode(const unsigned short *values, std::size_t n, std::vector<unsigned char> &out);
+    static ROOT::RVec<unsigned char> encode(const ROOT::RVec<unsigned short> &values);
+
+    /// Number of values stored in a blob (header only).
+    static std::size_t decoded_size(const unsigned char *blob, std::size_t n_bytes);
+
+    /// Decode into @p out (capacity >= decoded_size); returns the number of values written.
+    static std::size_t decode(const unsigned char *blob,
+                              std::size_t n_bytes,
+                              unsigned short *out,
+                              std::size_t capacity);
+    static ROOT::RVec<unsigned short> decode(const ROOT::RVec<unsigned char> &blob);
+
+    /// Define "<col>_uwq" for each of @p columns present on @p node.
+    static ROOT::RDF::RNode define_encoded(ROOT::RDF::RNode node, const std::vector<std::string> &columns);
+
+    /// Define the plain column for each of the @p encoded branches (as
+    /// recorded under kColumnsKey) present on @p node whose plain name is absent.
+    static ROOT::RDF::RNode define_decoded(ROOT::RDF::RNode node, const std::vector<std::string> &encoded);
+};
+
+}
+
+#endif
@@ -0,0 +1,367 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/src/ColumnCache.cc
+ *
+ *  @brief Implementation of the column cache files and their data source.
+ */
+
+#include "ColumnCache.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <TSystem.h>
+
+namespace
+{
+constexpr char kMagic[8] = {'H', 'E', 'R', 'O', 'N', 'C', 'O', 'L'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint64_t kDataOffset = 64;
+
+std::string errno_message()
+{
+    return std::strerror(errno);
+}
+
+const std::type_info &cached_type_id(nu::CachedColumnType type)
+{
+    switch (type)
+    {
+    case nu::CachedColumnType::kBool:
+        return typeid(bool);
+    case nu::CachedColumnType::kInt8:
+        return typeid(char);
+    case nu::CachedColumnType::kUInt8:
+        return typeid(unsigned char);
+    case nu::CachedColumnType::kInt16:
+        return typeid(short);
+    case nu::CachedColumnType::kUInt16:
+        return typeid(unsigned short);
+    case nu::CachedColumnType::kInt32:
+        return typeid(int);
+    case nu::CachedColumnType::kUInt32:
+        return typeid(unsigned int);
+    case nu::CachedColumnType::kInt64:
+        return typeid(Long64_t);
+    case nu::CachedColumnType::kUInt64:
+        return typeid(ULong64_t);
+    case nu::CachedColumnType::kFloat:
+        return typeid(float);
+    case nu::CachedColumnType::kDouble:
+        return typeid(double);
+    }
+    throw std::runtime_error("ColumnCache: unknown column type");
+}
+
+void write_all(int fd, const void *data, std::size_t n_bytes, const std::string &path)
+{
+    const auto *p = static_cast<const char *>(data);
+    while (n_bytes > 0)
+    {
+        const ssize_t n = ::write(fd, p, n_bytes);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("ColumnCache: write failed for " + path + ": " + errno_message());
+        }
+        p += n;
+        n_bytes -= static_cast<std::size_t>(n);
+    }
+}
+} // namespace
+
+namespace nu
+{
+
+CachedColumnType cached_column_type(const std::string &type_name)
+{
+    static const std::vector<std::pair<CachedColumnType, std::vector<std::string>>> names = {
+        {CachedColumnType::kBool, {"bool", "Bool_t"}},
+        {CachedColumnType::kInt8, {"char", "signed char", "Char_t", "int8_t", "std::int8_t"}},
+        {CachedColumnType::kUInt8, {"unsigned char", "UChar_t", "uint8_t", "std::uint8_t"}},
+        {CachedColumnType::kInt16, {"short", "short int", "Short_t", "int16_t", "std::int16_t"}},
+        {CachedColumnType::kUInt16, {"unsigned short", "unsigned short int", "UShort_t", "uint16_t", "std::uint16_t"}},
+        {CachedColumnType::kInt32, {"int", "Int_t", "int32_t", "std::int32_t"}},
+        {CachedColumnType::kUInt32, {"unsigned int", "unsigned", "UInt_t", "uint32_t", "std::uint32_t"}},
+        {CachedColumnType::kInt64,
+         {"long", "long int", "long long", "long long int", "Long_t", "Long64_t", "int64_t", "std::int64_t"}},
+        {CachedColumnType::kUInt64,
+         {"unsigned long", "unsigned long int", "unsigned long long", "ULong_t", "ULong64_t", "uint64_t",
+          "std::uint64_t", "size_t", "std::size_t"}},
+        {CachedColumnType::kFloat, {"float", "Float_t", "Float16_t"}},
+        {CachedColumnType::kDouble, {"double", "Double_t", "Double32_t"}},
+    };
+    for (const auto &entry : names)
+    {
+        if (std::find(entry.second.begin(), entry.second.end(), type_name) != entry.second.end())
+            return entry.first;
+    }
+    throw std::runtime_error("ColumnCache: unsupported column type " + type_name + " (scalars only)");
+}
+
+std::size_t cached_column_size(CachedColumnType type)
+{
+    switch (type)
+    {
+    case CachedColumnType::kBool:
+    case CachedColumnType::kInt8:
+    case CachedColumnType::kUInt8:
+        return 1;
+    case CachedColumnType::kInt16:
+    case CachedColumnType::kUInt16:
+        return 2;
+    case CachedColumnType::kInt32:
+    case CachedColumnType::kUInt32:
+    case CachedColumnType::kFloat:
+        return 4;
+    case CachedColumnType::kInt64:
+    case CachedColumnType::kUInt64:
+    case CachedColumnType::kDouble:
+        return 8;
+    }
+    throw std::runtime_error("ColumnCache: unknown column type");
+}
+
+std::string cached_column_type_name(CachedColumnType type)
+{
+    switch (type)
+    {
+    case CachedColumnType::kBool:
+        return "bool";
+    case CachedColumnType::kInt8:
+        return "char";
+    case CachedColumnType::kUInt8:
+        return "unsigned char";
+    case CachedColumnType::kInt16:
+        return "short";
+    case CachedColumnType::kUInt16:
+        return "unsigned short";
+    case CachedColumnType::kInt32:
+        return "int";
+    case CachedColumnType::kUInt32:
+        return "unsigned int";
+    case CachedColumnType::kInt64:
+        return "Long64_t";
+    case CachedColumnType::kUInt64:
+        return "ULong64_t";
+    case CachedColumnType::kFloat:
+        return "float";
+    case CachedColumnType::kDouble:
+        return "double";
+    }
+    throw std::runtime_error("ColumnCache: unknown column type");
+}
+
+void write_cached_column(const std::string &path,
+                         CachedColumnType type,
+                         const void *data,
+                         std::uint64_t n_entries,
+                         std::uint64_t source_key)
+{
+    CachedColumnHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.type = static_cast<std::uint32_t>(type);
+    h.n_entries = n_entries;
+    h.element_size = cached_column_size(type);
+    h.data_offset = kDataOffset;
+    h.source_key = source_key;
+
+    const std::string tmp_path = path + ".tmp" + std::to_string(::getpid());
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("ColumnCache: cannot create " + tmp_path + ": " + errno_message());
+    try
+    {
+        write_all(fd, &h, sizeof(h), tmp_path);
+        write_all(fd, data, static_cast<std::size_t>(n_entries * h.element_size), tmp_path);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        ::unlink(tmp_path.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    // Concurrent writers of the same column produce identical files.
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        const std::string why = errno_message();
+        ::unlink(tmp_path.c_str());
+        throw std::runtime_error("ColumnCache: cannot publish " + path + ": " + why);
+    }
+}
+
+CachedColumn::CachedColumn(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("CachedColumn: cannot open " + path + ": " + errno_message());
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CachedColumnHeader)))
+    {
+        ::close(fd);
+        throw std::runtime_error("CachedColumn: not a column file: " + path);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    void *mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("CachedColumn: mmap failed for " + path + ": " + errno_message());
+    m_base = static_cast<const std::uint8_t *>(mapped);
+    m_header = reinterpret_cast<const CachedColumnHeader *>(m_base);
+
+    const CachedColumnHeader &h = *m_header;
+    const bool ok = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+                    h.type <= static_cast<std::uint32_t>(CachedColumnType::kDouble) &&
+                    h.element_size == cached_column_size(static_cast<CachedColumnType>(h.type)) &&
+                    h.data_offset >= sizeof(CachedColumnHeader) &&
+                    h.data_offset + h.n_entries * h.element_size <= m_size;
+    if (!ok)
+    {
+        ::munmap(const_cast<std::uint8_t *>(m_base), m_size);
+        throw std::runtime_error("CachedColumn: corrupt or unsupported column file: " + path);
+    }
+    // Event loops read the whole column front to back.
+    ::madvise(const_cast<std::uint8_t *>(m_base), m_size, MADV_SEQUENTIAL);
+}
+
+CachedColumn::~CachedColumn()
+{
+    if (m_base != nullptr)
+        ::munmap(const_cast<std::uint8_t *>(m_base), m_size);
+}
+
+CachedColumn::CachedColumn(CachedColumn &&other) noexcept
+    : m_base(std::exchange(other.m_base, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_header(std::exchange(other.m_header, nullptr))
+{
+}
+
+bool CachedColumn::valid(const std::string &path, std::uint64_t source_key)
+{
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return false;
+    try
+    {
+        return CachedColumn(path).source_key() == source_key;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+CachedColumnSource::CachedColumnSource(const std::vector<std::pair<std::string, std::string>> &columns)
+{
+    for (const auto &c : columns)
+    {
+        m_names.push_back(c.first);
+        m_columns.emplace_back(c.second);
+        if (m_columns.size() == 1)
+            m_n_entries = m_columns.front().size();
+        else if (m_columns.back().size() != m_n_entries)
+            throw std::runtime_error("CachedColumnSource: column " + c.first + " has " +
+                                     std::to_string(m_columns.back().size()) + " entries, expected " +
+                                     std::to_string(m_n_entries));
+    }
+    m_current.assign(m_columns.size(), std::vector<const void *>(1, nullptr));
+}
+
+void CachedColumnSource::SetNSlots(unsigned int n_slots)
+{
+    m_n_slots = std::max(1u, n_slots);
+    m_current.assign(m_columns.size(), std::vector<const void *>(m_n_slots, nullptr));
+}
+
+bool CachedColumnSource::HasColumn(std::string_view name) const
+{
+    return std::find(m_names.begin(), m_names.end(), name) != m_names.end();
+}
+
+std::string CachedColumnSource::GetTypeName(std::string_view name) const
+{
+    return cached_column_type_name(m_columns[column_index(name)].type());
+}
+
+void CachedColumnSource::Initialize()
+{
+    m_ranges_served = false;
+}
+
+std::vector<std::pair<ULong64_t, ULong64_t>> CachedColumnSource::GetEntryRanges()
+{
+    std::vector<std::pair<ULong64_t, ULong64_t>> ranges;
+    if (m_ranges_served)
+        return ranges;
+    m_ranges_served = true;
+
+    // A few ranges per slot keeps the threads balanced.
+    const std::uint64_t n_ranges = std::max<std::uint64_t>(1, std::min<std::uint64_t>(m_n_entries, 4ull * m_n_slots));
+    const std::uint64_t step = (m_n_entries + n_ranges - 1) / n_ranges;
+    for (std::uint64_t begin = 0; begin < m_n_entries; begin += step)
+        ranges.emplace_back(begin, std::min(m_n_entries, begin + step));
+    return ranges;
+}
+
+bool CachedColumnSource::SetEntry(unsigned int slot, ULong64_t entry)
+{
+    for (std::size_t c = 0; c < m_columns.size(); ++c)
+        m_current[c][slot] = m_columns[c].data() + entry * m_columns[c].header().element_size;
+    return true;
+}
+
+CachedColumnSource::Record_t CachedColumnSource::GetColumnReadersImpl(std::string_view name,
+                                                                      const std::type_info &type)
+{
+    const std::size_t c = column_index(name);
+    if (type != cached_type_id(m_columns[c].type()))
+        throw std::runtime_error("CachedColumnSource: column " + std::string(name) + " is " +
+                                 cached_column_type_name(m_columns[c].type()) + ", requested as " + type.name());
+
+    Record_t readers;
+    for (unsigned int slot = 0; slot < m_n_slots; ++slot)
+        readers.push_back(static_cast<void *>(&m_current[c][slot]));
+    return readers;
+}
+
+std::size_t CachedColumnSource::column_index(std::string_view name) const
+{
+    const auto it = std::find(m_names.begin(), m_names.end(), name);
+    if (it == m_names.end())
+        throw std::runtime_error("CachedColumnSource: no column " + std::string(name));
+    return static_cast<std::size_t>(it - m_names.begin());
+}
+
+bool column_cache_enabled()
+{
+    const char *value = std::getenv("HERON_COLUMN_CACHE");
+    return value == nullptr || std::string(value) != "0";
+}
+
+std::filesystem::path column_cache_dir()
+{
+    const char *value = std::getenv("HERON_COLUMN_CACHE_DIR");
+    if (value != nullptr && *value != '\0')
+        return value;
+    return std::filesystem::path(gSystem->TempDirectory()) / "heron-column-cache";
+}
+
+}
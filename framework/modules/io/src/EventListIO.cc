@@ -1,21 +1,41 @@
 #include "EventListIO.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <filesystem>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include <TChain.h>
+#include <TEntryList.h>
+#include <TError.h>
 #include <TFile.h>
+#include <ROOT/RDF/RDatasetSpec.hxx>
 #include <TObjString.h>
+#include <TROOT.h>
+#include <TSystem.h>
 #include <TTree.h>
+#include <TTreeFormula.h>
 
+#include "ColumnCache.hh"
 #include "PlottingHelper.hh"
 #include "SampleIO.hh"
 #include "SnapshotService.hh"
+#include "SparseImageCodec.hh"
+#include "UniverseWeightCodec.hh"
 
 namespace
 {
@@ -28,6 +48,325 @@ std::string read_objstring_optional(TFile &f, const char *key)
     return s->GetString().Data();
 }
 
+constexpr const char *kEventIndexTree = "event_index";
+constexpr const char *kFriendRefsTree = "friend_refs";
+constexpr const char *kFriendChecksumsTree = "friend_checksums";
+
+constexpr std::uint64_t kKeyDigestSeed = 0x9e3779b97f4a7c15ULL;
+
+std::uint64_t splitmix64(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/// Running, order-sensitive digest of one sample's (run, sub, evt) rows.
+std::uint64_t digest_key(std::uint64_t h, int run, int sub, int evt)
+{
+    for (int v : {run, sub, evt})
+        h = splitmix64(h ^ static_cast<std::uint32_t>(v));
+    return h;
+}
+
+bool key_less(const nu::EventIndexEntry &a, const nu::EventIndexEntry &b)
+{
+    if (a.run != b.run)
+        return a.run < b.run;
+    if (a.sub != b.sub)
+        return a.sub < b.sub;
+    if (a.evt != b.evt)
+        return a.evt < b.evt;
+    return a.sample_id < b.sample_id;
+}
+
+bool same_event(const nu::EventIndexEntry &a, const nu::EventIndexEntry &b)
+{
+    return a.run == b.run && a.sub == b.sub && a.evt == b.evt;
+}
+
+/// Sorted index tree opened for binary search by entry number.
+struct IndexReader
+{
+    std::unique_ptr<TFile> file;
+    TTree *tree = nullptr;
+    nu::EventIndexEntry row;
+
+    explicit IndexReader(const std::string &path)
+        : file(TFile::Open(path.c_str(), "READ"))
+    {
+        if (!file || file->IsZombie())
+            throw std::runtime_error("EventListIO: failed to open " + path);
+        tree = dynamic_cast<TTree *>(file->Get(kEventIndexTree));
+        if (!tree)
+            throw std::runtime_error("EventListIO: missing event_index tree in " + path +
+                                     " (run EventListIO::build_event_index)");
+        tree->SetBranchAddress("run", &row.run);
+        tree->SetBranchAddress("sub", &row.sub);
+        tree->SetBranchAddress("evt", &row.evt);
+        tree->SetBranchAddress("sample_id", &row.sample_id);
+        tree->SetBranchAddress("entry", &row.entry);
+    }
+
+    const nu::EventIndexEntry &at(Long64_t i)
+    {
+        tree->GetEntry(i);
+        return row;
+    }
+
+    void append_matches(const nu::EventIndexEntry &key, std::vector<nu::EventIndexEntry> &out)
+    {
+        nu::EventIndexEntry lo_key = key;
+        lo_key.sample_id = std::numeric_limits<int>::min();
+
+        Long64_t lo = 0;
+        Long64_t hi = tree->GetEntries();
+        while (lo < hi)
+        {
+            const Long64_t mid = lo + (hi - lo) / 2;
+            if (key_less(at(mid), lo_key))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (Long64_t i = lo; i < tree->GetEntries(); ++i)
+        {
+            const auto &r = at(i);
+            if (!same_event(r, key))
+                break;
+            if (key.sample_id < 0 || r.sample_id == key.sample_id)
+                out.push_back(r);
+        }
+    }
+};
+
+/// Write the "sample_refs" tree into the current directory.
+void write_sample_refs_tree(const std::vector<std::pair<int, nu::SampleInfo>> &rows)
+{
+    TTree tref("sample_refs", "Sample references (source + POT/triggers)");
+    int sample_id = -1;
+    std::string sample_name;
+    std::string sample_rootio_path;
+    int sample_origin = -1;
+    int beam_mode = -1;
+    double subrun_pot_sum = 0.0;
+    double db_tortgt_pot_sum = 0.0;
+    double db_tor101_pot_sum = 0.0;
+    Long64_t entry_begin = -1;
+    Long64_t entry_end = -1;
+    ULong64_t key_checksum = 0;
+
+    tref.Branch("sample_id", &sample_id);
+    tref.Branch("sample_name", &sample_name);
+    tref.Branch("sample_rootio_path", &sample_rootio_path);
+    tref.Branch("sample_origin", &sample_origin);
+    tref.Branch("beam_mode", &beam_mode);
+    tref.Branch("subrun_pot_sum", &subrun_pot_sum);
+    tref.Branch("db_tortgt_pot_sum", &db_tortgt_pot_sum);
+    tref.Branch("db_tor101_pot_sum", &db_tor101_pot_sum);
+    tref.Branch("entry_begin", &entry_begin);
+    tref.Branch("entry_end", &entry_end);
+    tref.Branch("key_checksum", &key_checksum);
+
+    for (const auto &row : rows)
+    {
+        const auto &r = row.second;
+        sample_id = row.first;
+        sample_name = r.sample_name;
+        sample_rootio_path = r.sample_rootio_path;
+        sample_origin = r.sample_origin;
+        beam_mode = r.beam_mode;
+        subrun_pot_sum = r.subrun_pot_sum;
+        db_tortgt_pot_sum = r.db_tortgt_pot_sum;
+        db_tor101_pot_sum = r.db_tor101_pot_sum;
+        entry_begin = r.entry_begin;
+        entry_end = r.entry_end;
+        key_checksum = r.key_checksum;
+        tref.Fill();
+    }
+
+    tref.Write("", TObject::kOverwrite);
+}
+
+/// Write the "friend_refs" tree into the current directory; side files in
+/// @p list_dir are recorded by file name so the pair can be moved together.
+void write_friend_refs_tree(const std::vector<nu::FriendTreeRef> &refs, const std::filesystem::path &list_dir)
+{
+    TTree tfriends(kFriendRefsTree, "Entry-aligned friend trees (name, side file, tree)");
+    std::string friend_name;
+    std::string friend_path;
+    std::string friend_tree;
+    Long64_t n_entries = 0;
+    tfriends.Branch("friend_name", &friend_name);
+    tfriends.Branch("friend_path", &friend_path);
+    tfriends.Branch("friend_tree", &friend_tree);
+    tfriends.Branch("n_entries", &n_entries);
+
+    std::error_code ec;
+    const auto dir = std::filesystem::weakly_canonical(list_dir.empty() ? "." : list_dir, ec);
+    for (const auto &r : refs)
+    {
+        const std::filesystem::path side(r.path);
+        const auto side_dir = std::filesystem::weakly_canonical(side.parent_path().empty() ? "." : side.parent_path(), ec);
+        friend_name = r.name;
+        friend_path = (side_dir == dir) ? side.filename().string() : r.path;
+        friend_tree = r.tree;
+        n_entries = r.n_entries;
+        tfriends.Fill();
+    }
+    tfriends.Write("", TObject::kOverwrite);
+}
+
+std::uint64_t mix_string(std::uint64_t h, const std::string &bytes)
+{
+    for (unsigned char c : bytes)
+        h = (h ^ c) * 1099511628211ULL;
+    return (h ^ 0xffu) * 1099511628211ULL;
+}
+
+std::string to_hex(std::uint64_t h)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+/// Remove the column cache directories beside @p keep whose names are
+/// @p prefix followed by a source key, i.e. other generations of the same
+/// event list, once nobody has used them for @p grace. Another process with
+/// a different friend set may be reading a younger sibling right now.
+/// Failures only leave a stale directory behind.
+void prune_column_cache(const std::filesystem::path &keep,
+                        const std::string &prefix,
+                        std::filesystem::file_time_type::duration grace)
+{
+    std::error_code ec;
+    const auto cutoff = std::filesystem::file_time_type::clock::now() - grace;
+    std::filesystem::directory_iterator it(keep.parent_path(), ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+    {
+        const std::string name = it->path().filename().string();
+        if (it->path() == keep || name.size() != prefix.size() + 16 || name.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        std::error_code rm_ec;
+        const auto used = std::filesystem::last_write_time(it->path(), rm_ec);
+        if (rm_ec || used > cutoff)
+            continue;
+        std::filesystem::remove_all(it->path(), rm_ec);
+    }
+}
+
+/// Lazily collect @p column (already cast to the cached type) and return
+/// the step that writes it once the event loop has run. Take keeps the
+/// processing order, which is not entry order under implicit MT, so every
+/// value is placed by its entry number from @p entries.
+template <typename T>
+std::function<void()> book_cached_column(ROOT::RDF::RNode &node,
+                                         const std::string &column,
+                                         nu::CachedColumnType type,
+                                         const std::string &path,
+                                         std::uint64_t source,
+                                         ROOT::RDF::RResultPtr<std::vector<ULong64_t>> entries)
+{
+    using Stored = std::conditional_t<std::is_same_v<T, bool>, std::uint8_t, T>;
+    auto values = node.Take<T>(column);
+    return [values, entries, type, path, source]() mutable {
+        const std::vector<T> &v = *values;
+        const std::vector<ULong64_t> &e = *entries;
+        if (e.size() != v.size())
+            throw std::runtime_error("EventListIO: column cache entry numbers do not match " + path);
+        std::vector<Stored> ordered(v.size());
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            if (e[i] >= ordered.size())
+                throw std::runtime_error("EventListIO: column cache entry out of range for " + path);
+            ordered[e[i]] = static_cast<Stored>(v[i]);
+        }
+        nu::write_cached_column(path, type, ordered.data(), ordered.size(), source);
+    };
+}
+
+std::function<void()> book_cached_column(ROOT::RDF::RNode &node,
+                                         const std::string &column,
+                                         nu::CachedColumnType type,
+                                         const std::string &path,
+                                         std::uint64_t source,
+                                         ROOT::RDF::RResultPtr<std::vector<ULong64_t>> entries)
+{
+    using nu::CachedColumnType;
+    switch (type)
+    {
+    case CachedColumnType::kBool:
+        return book_cached_column<bool>(node, column, type, path, source, entries);
+    case CachedColumnType::kInt8:
+        return book_cached_column<char>(node, column, type, path, source, entries);
+    case CachedColumnType::kUInt8:
+        return book_cached_column<unsigned char>(node, column, type, path, source, entries);
+    case CachedColumnType::kInt16:
+        return book_cached_column<short>(node, column, type, path, source, entries);
+    case CachedColumnType::kUInt16:
+        return book_cached_column<unsigned short>(node, column, type, path, source, entries);
+    case CachedColumnType::kInt32:
+        return book_cached_column<int>(node, column, type, path, source, entries);
+    case CachedColumnType::kUInt32:
+        return book_cached_column<unsigned int>(node, column, type, path, source, entries);
+    case CachedColumnType::kInt64:
+        return book_cached_column<Long64_t>(node, column, type, path, source, entries);
+    case CachedColumnType::kUInt64:
+        return book_cached_column<ULong64_t>(node, column, type, path, source, entries);
+    case CachedColumnType::kFloat:
+        return book_cached_column<float>(node, column, type, path, source, entries);
+    case CachedColumnType::kDouble:
+        return book_cached_column<double>(node, column, type, path, source, entries);
+    }
+    throw std::runtime_error("EventListIO: unknown cached column type");
+}
+
+constexpr const char *kZoneMapTree = "zone_map";
+
+bool sample_ranges_known(const std::unordered_map<int, nu::SampleInfo> &refs, const std::vector<char> &mask)
+{
+    for (const auto &kv : refs)
+    {
+        const int sid = kv.first;
+        if (sid < 0 || sid >= static_cast<int>(mask.size()) || !mask[static_cast<size_t>(sid)])
+            continue;
+        if (kv.second.entry_begin < 0 || kv.second.entry_end < kv.second.entry_begin)
+            return false;
+    }
+    return true;
+}
+
+/// Intersection of two sorted, disjoint range lists.
+std::vector<nu::EntryRange> intersect_ranges(const std::vector<nu::EntryRange> &a, const std::vector<nu::EntryRange> &b)
+{
+    std::vector<nu::EntryRange> out;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        const Long64_t lo = std::max(a[i].first, b[j].first);
+        const Long64_t hi = std::min(a[i].second, b[j].second);
+        if (lo < hi)
+            out.emplace_back(lo, hi);
+        if (a[i].second < b[j].second)
+            ++i;
+        else
+            ++j;
+    }
+    return out;
+}
+
+std::string trim_copy(const std::string &s)
+{
+    const auto b = s.find_first_not_of(" \t");
+    if (b == std::string::npos)
+        return {};
+    const auto e = s.find_last_not_of(" \t");
+    return s.substr(b, e - b + 1);
+}
+
 }
 
 namespace nu
@@ -77,40 +416,70 @@ void EventListIO::init(const std::string &out_path,
         TObjString(event_schema_tsv.c_str()).Write(key.c_str());
     }
 
-    TTree tref("sample_refs", "Sample references (source + POT/triggers)");
-    int sample_id = -1;
-    std::string sample_name;
-    std::string sample_rootio_path;
-    int sample_origin = -1;
-    int beam_mode = -1;
-    double subrun_pot_sum = 0.0;
-    double db_tortgt_pot_sum = 0.0;
-    double db_tor101_pot_sum = 0.0;
+    // The event tree is still empty; ranges are filled by build_event_index().
+    std::vector<std::pair<int, SampleInfo>> rows;
+    for (size_t i = 0; i < sample_refs.size(); ++i)
+    {
+        rows.emplace_back(static_cast<int>(i), sample_refs[i]);
+        rows.back().second.entry_begin = -1;
+        rows.back().second.entry_end = -1;
+        rows.back().second.key_checksum = 0;
+    }
+    write_sample_refs_tree(rows);
+    fout->Close();
+}
 
-    tref.Branch("sample_id", &sample_id);
-    tref.Branch("sample_name", &sample_name);
-    tref.Branch("sample_rootio_path", &sample_rootio_path);
-    tref.Branch("sample_origin", &sample_origin);
-    tref.Branch("beam_mode", &beam_mode);
-    tref.Branch("subrun_pot_sum", &subrun_pot_sum);
-    tref.Branch("db_tortgt_pot_sum", &db_tortgt_pot_sum);
-    tref.Branch("db_tor101_pot_sum", &db_tor101_pot_sum);
+void EventListIO::write_split_refs(const std::string &out_path,
+                                   const std::string &split_name,
+                                   const std::string &split_spec,
+                                   const std::vector<SplitSampleRef> &refs)
+{
+    std::vector<std::pair<int, SampleInfo>> scaled;
+    {
+        const EventListIO existing(out_path);
+        for (const auto &r : refs)
+        {
+            auto it = existing.sample_refs().find(r.sample_id);
+            if (it == existing.sample_refs().end())
+                continue;
+            SampleInfo info = it->second;
+            info.subrun_pot_sum *= r.exposure_fraction;
+            info.db_tortgt_pot_sum *= r.exposure_fraction;
+            info.db_tor101_pot_sum *= r.exposure_fraction;
+            scaled.emplace_back(r.sample_id, std::move(info));
+        }
+    }
 
-    for (size_t i = 0; i < sample_refs.size(); ++i)
+    std::unique_ptr<TFile> fout(TFile::Open(out_path.c_str(), "UPDATE"));
+    if (!fout || fout->IsZombie())
+        throw std::runtime_error("EventListIO::write_split_refs: failed to open " + out_path);
+    fout->cd();
+
+    fout->Delete("sample_refs;*");
+    write_sample_refs_tree(scaled);
+
+    TObjString(split_name.c_str()).Write("split_name", TObject::kOverwrite);
+    TObjString(split_spec.c_str()).Write("split_spec", TObject::kOverwrite);
+
+    TTree tsplit("split_refs", "Per-sample split bookkeeping (events, weights, exposure)");
+    SplitSampleRef row;
+    double weight_scale = 0.0;
+    tsplit.Branch("sample_id", &row.sample_id);
+    tsplit.Branch("n_events", &row.n_events);
+    tsplit.Branch("n_events_total", &row.n_events_total);
+    tsplit.Branch("sum_weight", &row.sum_weight);
+    tsplit.Branch("sum_weight_total", &row.sum_weight_total);
+    tsplit.Branch("exposure_fraction", &row.exposure_fraction);
+    tsplit.Branch("weight_scale", &weight_scale);
+
+    for (const auto &r : refs)
     {
-        const auto &r = sample_refs[i];
-        sample_id = static_cast<int>(i);
-        sample_name = r.sample_name;
-        sample_rootio_path = r.sample_rootio_path;
-        sample_origin = r.sample_origin;
-        beam_mode = r.beam_mode;
-        subrun_pot_sum = r.subrun_pot_sum;
-        db_tortgt_pot_sum = r.db_tortgt_pot_sum;
-        db_tor101_pot_sum = r.db_tor101_pot_sum;
-        tref.Fill();
+        row = r;
+        weight_scale = r.exposure_fraction > 0.0 ? 1.0 / r.exposure_fraction : 0.0;
+        tsplit.Fill();
     }
 
-    tref.Write();
+    tsplit.Write("", TObject::kOverwrite);
     fout->Close();
 }
 
@@ -133,6 +502,10 @@ EventListIO::EventListIO(std::string path, OpenMode mode)
     m_header.sample_list_source = read_objstring_optional(*fin, "sample_list_source");
     m_header.heron_set = read_objstring_optional(*fin, "heron_set");
     m_header.event_output_dir = read_objstring_optional(*fin, "event_output_dir");
+    m_encoded_image_columns =
+        SparseImageCodec::parse_columns(read_objstring_optional(*fin, SparseImageCodec::kColumnsKey));
+    m_encoded_weight_columns =
+        UniverseWeightCodec::parse_columns(read_objstring_optional(*fin, UniverseWeightCodec::kColumnsKey));
 
     auto *t = dynamic_cast<TTree *>(fin->Get("sample_refs"));
     if (!t)
@@ -146,6 +519,9 @@ EventListIO::EventListIO(std::string path, OpenMode mode)
     double subrun_pot_sum = 0.0;
     double db_tortgt_pot_sum = 0.0;
     double db_tor101_pot_sum = 0.0;
+    Long64_t entry_begin = -1;
+    Long64_t entry_end = -1;
+    ULong64_t key_checksum = 0;
 
     t->SetBranchAddress("sample_id", &sample_id);
     t->SetBranchAddress("sample_name", &sample_name);
@@ -155,6 +531,14 @@ EventListIO::EventListIO(std::string path, OpenMode mode)
     t->SetBranchAddress("subrun_pot_sum", &subrun_pot_sum);
     t->SetBranchAddress("db_tortgt_pot_sum", &db_tortgt_pot_sum);
     t->SetBranchAddress("db_tor101_pot_sum", &db_tor101_pot_sum);
+    // Absent in event lists written before entry ranges were recorded.
+    if (t->GetBranch("entry_begin") && t->GetBranch("entry_end"))
+    {
+        t->SetBranchAddress("entry_begin", &entry_begin);
+        t->SetBranchAddress("entry_end", &entry_end);
+    }
+    if (t->GetBranch("key_checksum"))
+        t->SetBranchAddress("key_checksum", &key_checksum);
 
     const Long64_t n = t->GetEntries();
     for (Long64_t i = 0; i < n; ++i)
@@ -171,6 +555,9 @@ EventListIO::EventListIO(std::string path, OpenMode mode)
         info.subrun_pot_sum = subrun_pot_sum;
         info.db_tortgt_pot_sum = db_tortgt_pot_sum;
         info.db_tor101_pot_sum = db_tor101_pot_sum;
+        info.entry_begin = entry_begin;
+        info.entry_end = entry_end;
+        info.key_checksum = key_checksum;
 
         m_sample_refs.emplace(sample_id, std::move(info));
         if (sample_id > m_max_sample_id)
@@ -197,7 +584,9 @@ ULong64_t EventListIO::snapshot_event_list_merged(ROOT::RDF::RNode node,
                                                   const std::string &sample_name,
                                                   const std::vector<std::string> &columns,
                                                   const std::string &selection,
-                                                  const std::string &tree_name_in) const
+                                                  const std::string &tree_name_in,
+                                                  const std::vector<std::string> &encoded_columns,
+                                                  const std::vector<std::string> &sparse_image_columns) const
 {
     return SnapshotService::snapshot_event_list_merged(std::move(node),
                                                        m_path,
@@ -205,7 +594,9 @@ ULong64_t EventListIO::snapshot_event_list_merged(ROOT::RDF::RNode node,
                                                        sample_name,
                                                        columns,
                                                        selection,
-                                                       tree_name_in);
+                                                       tree_name_in,
+                                                       encoded_columns,
+                                                       sparse_image_columns);
 }
 
 ULong64_t EventListIO::snapshot_event_list(ROOT::RDF::RNode node,
@@ -226,7 +617,137 @@ ULong64_t EventListIO::snapshot_event_list(ROOT::RDF::RNode node,
 
 ROOT::RDataFrame EventListIO::rdf() const
 {
-    return ROOT::RDataFrame(event_tree(), m_path);
+    return make_rdf(friends());
+}
+
+ROOT::RDF::RNode EventListIO::rdf(const std::vector<std::string> &columns) const
+{
+    std::vector<FriendColumn> specs;
+    for (const auto &item : columns)
+    {
+        const size_t eq = item.find('=');
+        FriendColumn c;
+        c.name = trim_copy(item.substr(0, eq));
+        c.expr = eq == std::string::npos ? c.name : trim_copy(item.substr(eq + 1));
+        if (c.name.empty() || c.expr.empty())
+            throw std::runtime_error("EventListIO::rdf: invalid column '" + item + "' (expected name[=expr])");
+        specs.push_back(std::move(c));
+    }
+    if (specs.empty())
+        throw std::runtime_error("EventListIO::rdf: empty column list");
+
+    const std::vector<FriendTreeRef> attached = friends();
+    if (!column_cache_enabled())
+    {
+        ROOT::RDF::RNode node = make_rdf(attached);
+        for (const auto &c : specs)
+        {
+            if (c.expr != c.name)
+                node = node.Define(c.name, c.expr);
+        }
+        return node;
+    }
+
+    // <stem>-<path hash>-<source key>: a rewrite of the event list or a
+    // friend gives a new key, and the first call under it drops the
+    // directories of the same event list that have sat unused for a day.
+    // Every call stamps its directory so a live sibling is never taken.
+    const std::uint64_t source = source_key(attached);
+    std::error_code ec;
+    const auto canonical = std::filesystem::weakly_canonical(m_path, ec);
+    const std::string prefix = std::filesystem::path(m_path).stem().string() + "-" +
+                               to_hex(mix_string(0xcbf29ce484222325ULL, ec ? m_path : canonical.string())) + "-";
+    const std::filesystem::path dir = column_cache_dir() / (prefix + to_hex(source));
+    const bool fresh = !std::filesystem::exists(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+        throw std::runtime_error("EventListIO::rdf: cannot create column cache " + dir.string() + " (" +
+                                 ec.message() + ")");
+    std::filesystem::last_write_time(dir, std::filesystem::file_time_type::clock::now(), ec);
+    if (fresh)
+        prune_column_cache(dir, prefix, std::chrono::hours(24));
+
+    std::vector<std::pair<std::string, std::string>> files;
+    std::vector<size_t> missing;
+    for (size_t k = 0; k < specs.size(); ++k)
+    {
+        const std::string file = (dir / (SnapshotService::sanitise_root_key(specs[k].name) + "-" +
+                                         to_hex(mix_string(0xcbf29ce484222325ULL, specs[k].expr)) + ".hcol"))
+                                     .string();
+        files.emplace_back(specs[k].name, file);
+        if (!CachedColumn::valid(file, source))
+            missing.push_back(k);
+    }
+
+    if (!missing.empty())
+    {
+        ROOT::RDF::RNode node = make_rdf(attached);
+        auto entries = node.Take<ULong64_t>("rdfentry_");
+        std::vector<std::function<void()>> writers;
+        for (const size_t k : missing)
+        {
+            const std::string probe = "__heron_cache_probe_" + std::to_string(k);
+            const std::string value = "__heron_cache_" + std::to_string(k);
+            const CachedColumnType type = cached_column_type(node.Define(probe, specs[k].expr).GetColumnType(probe));
+            node = node.Define(value, "static_cast<" + cached_column_type_name(type) + ">(" + specs[k].expr + ")");
+            writers.push_back(book_cached_column(node, value, type, files[k].second, source, entries));
+        }
+        // The first writer runs the event loop for all of them.
+        for (auto &write : writers)
+            write();
+    }
+
+    return ROOT::RDataFrame(std::make_unique<CachedColumnSource>(files));
+}
+
+std::uint64_t EventListIO::source_key(const std::vector<FriendTreeRef> &friends) const
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix_file = [&h](const std::string &path) {
+        std::error_code ec;
+        const auto canonical = std::filesystem::weakly_canonical(path, ec);
+        h = mix_string(h, ec ? path : canonical.string());
+        const auto size = std::filesystem::file_size(path, ec);
+        h = mix_string(h, std::to_string(ec ? 0 : size));
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        h = mix_string(h, std::to_string(ec ? 0 : mtime.time_since_epoch().count()));
+    };
+
+    mix_file(m_path);
+    h = mix_string(h, event_tree());
+    for (const auto &f : friends)
+    {
+        mix_file(f.path);
+        h = mix_string(h, f.name + ":" + f.tree);
+    }
+    return h;
+}
+
+ROOT::RDataFrame EventListIO::make_rdf(const std::vector<FriendTreeRef> &friends) const
+{
+    if (friends.empty())
+        return ROOT::RDataFrame(event_tree(), m_path);
+
+    ROOT::RDF::Experimental::RDatasetSpec spec;
+    spec.AddSample({"events", event_tree(), m_path});
+    for (const auto &f : friends)
+        spec.WithGlobalFriends(f.tree, f.path, f.name);
+    return ROOT::RDataFrame(spec);
+}
+
+ROOT::RDF::RNode EventListIO::rdf_with_images() const
+{
+    return expand_images(rdf());
+}
+
+ROOT::RDF::RNode EventListIO::expand_images(ROOT::RDF::RNode node) const
+{
+    return SparseImageCodec::define_decoded(std::move(node), m_encoded_image_columns);
+}
+
+ROOT::RDF::RNode EventListIO::decode_weights(ROOT::RDF::RNode node) const
+{
+    return UniverseWeightCodec::define_decoded(std::move(node), m_encoded_weight_columns);
 }
 
 std::shared_ptr<const std::vector<char>> EventListIO::mask_for_origin(SampleIO::SampleOrigin origin) const
@@ -270,6 +791,598 @@ std::shared_ptr<const std::vector<char>> EventListIO::mask_for_mc_like() const
     return mask;
 }
 
+bool EventListIO::has_entry_ranges() const
+{
+    for (const auto &kv : m_sample_refs)
+    {
+        if (kv.second.entry_begin < 0 || kv.second.entry_end < kv.second.entry_begin)
+            return false;
+    }
+    return !m_sample_refs.empty();
+}
+
+std::vector<EntryRange> EventListIO::entry_ranges(const std::vector<char> &mask) const
+{
+    std::vector<EntryRange> ranges;
+    for (const auto &kv : m_sample_refs)
+    {
+        const int sid = kv.first;
+        if (sid < 0 || sid >= static_cast<int>(mask.size()) || !mask[static_cast<size_t>(sid)])
+            continue;
+        const SampleInfo &info = kv.second;
+        if (info.entry_begin < 0 || info.entry_end < info.entry_begin)
+            throw std::runtime_error("EventListIO::entry_ranges: no entry range for sample " + info.sample_name +
+                                     " in " + m_path + " (run EventListIO::build_event_index)");
+        if (info.entry_end > info.entry_begin)
+            ranges.emplace_back(info.entry_begin, info.entry_end);
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<EntryRange> merged;
+    for (const auto &r : ranges)
+    {
+        if (!merged.empty() && r.first <= merged.back().second)
+            merged.back().second = std::max(merged.back().second, r.second);
+        else
+            merged.push_back(r);
+    }
+    return merged;
+}
+
+EventListView EventListIO::view(std::shared_ptr<const std::vector<char>> mask) const
+{
+    if (!mask)
+        throw std::runtime_error("EventListIO::view: null sample mask");
+
+    if (!sample_ranges_known(m_sample_refs, *mask))
+        return EventListView(m_path,
+                             event_tree(),
+                             {{0, std::numeric_limits<Long64_t>::max()}},
+                             std::move(mask),
+                             friends());
+    return EventListView(m_path, event_tree(), entry_ranges(*mask), nullptr, friends());
+}
+
+EventListView EventListIO::view_for_origin(SampleIO::SampleOrigin origin) const
+{
+    return view(mask_for_origin(origin));
+}
+
+EventListView EventListIO::view_for_mc_like() const
+{
+    return view(mask_for_mc_like());
+}
+
+EventListView EventListIO::view_for_data() const
+{
+    return view(mask_for_data());
+}
+
+EventListView EventListIO::view_for_ext() const
+{
+    return view(mask_for_ext());
+}
+
+EventListView EventListIO::view_for_sample(int sample_id) const
+{
+    if (m_sample_refs.find(sample_id) == m_sample_refs.end())
+        throw std::runtime_error("EventListIO::view_for_sample: unknown sample_id " + std::to_string(sample_id));
+    auto mask = std::make_shared<std::vector<char>>(static_cast<size_t>(m_max_sample_id + 1), 0);
+    (*mask)[static_cast<size_t>(sample_id)] = 1;
+    return view(std::move(mask));
+}
+
+ZonePredicate ZonePredicate::at_least(std::string column, double cut)
+{
+    ZonePredicate p;
+    p.column = std::move(column);
+    p.lo = cut;
+    return p;
+}
+
+ZonePredicate ZonePredicate::at_most(std::string column, double cut)
+{
+    ZonePredicate p;
+    p.column = std::move(column);
+    p.hi = cut;
+    return p;
+}
+
+ZonePredicate ZonePredicate::equal(std::string column, double value)
+{
+    ZonePredicate p;
+    p.column = std::move(column);
+    p.lo = value;
+    p.hi = value;
+    return p;
+}
+
+ZonePredicate ZonePredicate::is_true(std::string column)
+{
+    return at_least(std::move(column), 0.5);
+}
+
+std::vector<ZoneMapColumn> EventListIO::default_zone_map_columns()
+{
+    const char *env = std::getenv("HERON_ZONE_MAP_COLUMNS");
+    if (env == nullptr || *env == '\0')
+    {
+        return {{"inf_score_0", "inf_scores[0]"},
+                {"sel_muon", "sel_muon"},
+                {"analysis_channels", "analysis_channels"},
+                {"is_signal", "is_signal"}};
+    }
+
+    std::vector<ZoneMapColumn> out;
+    std::istringstream in(env);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        item = trim_copy(item);
+        if (item.empty())
+            continue;
+        const auto eq = item.find('=');
+        if (eq == std::string::npos)
+            out.push_back({item, item});
+        else
+            out.push_back({trim_copy(item.substr(0, eq)), trim_copy(item.substr(eq + 1))});
+    }
+    return out;
+}
+
+std::vector<std::string> EventListIO::build_zone_maps(const std::vector<ZoneMapColumn> &columns) const
+{
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "UPDATE"));
+    if (!f || f->IsZombie())
+        throw std::runtime_error("EventListIO::build_zone_maps: failed to open " + m_path);
+
+    auto *events = dynamic_cast<TTree *>(f->Get(event_tree().c_str()));
+    if (!events)
+        throw std::runtime_error("EventListIO::build_zone_maps: missing tree " + event_tree() + " in " + m_path);
+
+    // Columns absent from this event list are expected; keep TTreeFormula quiet.
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<TTreeFormula>> formulas;
+    {
+        const Int_t saved_level = gErrorIgnoreLevel;
+        gErrorIgnoreLevel = kFatal;
+        for (const auto &c : columns)
+        {
+            auto formula = std::make_unique<TTreeFormula>(("zone_" + c.name).c_str(), c.expr.c_str(), events);
+            if (formula->GetNdim() == 0)
+                continue;
+            names.push_back(c.name);
+            formulas.push_back(std::move(formula));
+        }
+        gErrorIgnoreLevel = saved_level;
+    }
+
+    struct Zone
+    {
+        Long64_t begin = 0;
+        Long64_t end = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        Long64_t n_unknown = 0;
+    };
+    std::vector<std::vector<Zone>> zones(formulas.size());
+
+    // Only the branches the formulas use are read (LoadTree, not GetEntry).
+    const Long64_t n = events->GetEntries();
+    auto clusters = events->GetClusterIterator(0);
+    Long64_t begin = 0;
+    while (!formulas.empty() && (begin = clusters()) < n)
+    {
+        const Long64_t end = std::min(clusters.GetNextEntry(), n);
+        for (auto &z : zones)
+        {
+            z.emplace_back();
+            z.back().begin = begin;
+            z.back().end = end;
+        }
+        for (Long64_t e = begin; e < end; ++e)
+        {
+            events->LoadTree(e);
+            for (size_t k = 0; k < formulas.size(); ++k)
+            {
+                Zone &z = zones[k].back();
+                if (formulas[k]->GetNdata() < 1)
+                {
+                    // e.g. an empty inf_scores: no value to compare, never skip.
+                    ++z.n_unknown;
+                    continue;
+                }
+                const double v = formulas[k]->EvalInstance(0);
+                // NaN fails every range predicate, so it cannot keep a cluster.
+                if (std::isnan(v))
+                    continue;
+                z.min = std::min(z.min, v);
+                z.max = std::max(z.max, v);
+            }
+        }
+    }
+    formulas.clear();
+
+    f->cd();
+    TTree tzone(kZoneMapTree, "Per-cluster min/max of selected event columns");
+    std::string column;
+    Zone row;
+    tzone.Branch("column", &column);
+    tzone.Branch("entry_begin", &row.begin);
+    tzone.Branch("entry_end", &row.end);
+    tzone.Branch("min", &row.min);
+    tzone.Branch("max", &row.max);
+    tzone.Branch("n_unknown", &row.n_unknown);
+    for (size_t k = 0; k < names.size(); ++k)
+    {
+        column = names[k];
+        for (const auto &z : zones[k])
+        {
+            row = z;
+            tzone.Fill();
+        }
+    }
+    tzone.Write(nullptr, TObject::kOverwrite);
+    f->Close();
+
+    return names;
+}
+
+std::vector<std::string> EventListIO::zone_map_columns() const
+{
+    std::vector<std::string> out;
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "READ"));
+    auto *t = (f && !f->IsZombie()) ? dynamic_cast<TTree *>(f->Get(kZoneMapTree)) : nullptr;
+    if (!t)
+        return out;
+
+    std::string *column = nullptr;
+    t->SetBranchAddress("column", &column);
+    for (Long64_t i = 0; i < t->GetEntries(); ++i)
+    {
+        t->GetEntry(i);
+        if (column && (out.empty() || out.back() != *column))
+            out.push_back(*column);
+    }
+    return out;
+}
+
+std::vector<EntryRange> EventListIO::zone_ranges(const std::vector<ZonePredicate> &where) const
+{
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "READ"));
+    if (!f || f->IsZombie())
+        throw std::runtime_error("EventListIO::zone_ranges: failed to open " + m_path);
+    auto *events = dynamic_cast<TTree *>(f->Get(event_tree().c_str()));
+    if (!events)
+        throw std::runtime_error("EventListIO::zone_ranges: missing tree " + event_tree() + " in " + m_path);
+
+    std::vector<EntryRange> kept{{0, events->GetEntries()}};
+    auto *t = dynamic_cast<TTree *>(f->Get(kZoneMapTree));
+    if (!t || where.empty())
+        return kept;
+
+    std::string *column = nullptr;
+    Long64_t entry_begin = 0;
+    Long64_t entry_end = 0;
+    double min = 0.0;
+    double max = 0.0;
+    Long64_t n_unknown = 0;
+    t->SetBranchAddress("column", &column);
+    t->SetBranchAddress("entry_begin", &entry_begin);
+    t->SetBranchAddress("entry_end", &entry_end);
+    t->SetBranchAddress("min", &min);
+    t->SetBranchAddress("max", &max);
+    t->SetBranchAddress("n_unknown", &n_unknown);
+
+    std::vector<std::vector<EntryRange>> per_predicate(where.size());
+    std::vector<char> mapped(where.size(), 0);
+    for (Long64_t i = 0; i < t->GetEntries(); ++i)
+    {
+        t->GetEntry(i);
+        if (!column)
+            continue;
+        for (size_t k = 0; k < where.size(); ++k)
+        {
+            if (where[k].column != *column)
+                continue;
+            mapped[k] = 1;
+            if (n_unknown == 0 && !(max >= where[k].lo && min <= where[k].hi))
+                continue;
+            auto &ranges = per_predicate[k];
+            if (!ranges.empty() && ranges.back().second == entry_begin)
+                ranges.back().second = entry_end;
+            else
+                ranges.emplace_back(entry_begin, entry_end);
+        }
+    }
+
+    for (size_t k = 0; k < where.size(); ++k)
+    {
+        if (mapped[k])
+            kept = intersect_ranges(kept, per_predicate[k]);
+    }
+    return kept;
+}
+
+EventListView EventListIO::view_where(const std::vector<ZonePredicate> &where,
+                                      std::shared_ptr<const std::vector<char>> mask) const
+{
+    std::vector<EntryRange> ranges = zone_ranges(where);
+    if (mask && sample_ranges_known(m_sample_refs, *mask))
+    {
+        ranges = intersect_ranges(ranges, entry_ranges(*mask));
+        mask.reset();
+    }
+    return EventListView(m_path, event_tree(), ranges, std::move(mask), friends());
+}
+
+ULong64_t EventListIO::write_friend(const std::string &name,
+                                    const std::vector<std::string> &columns,
+                                    const std::function<ROOT::RDF::RNode(ROOT::RDF::RNode)> &define,
+                                    const std::string &side_path) const
+{
+    if (name.empty() || columns.empty())
+        throw std::runtime_error("EventListIO::write_friend: empty friend name or column list");
+    // RDataFrame snapshots under implicit MT do not keep entry order.
+    if (ROOT::IsImplicitMTEnabled())
+        throw std::runtime_error("EventListIO::write_friend: requires implicit MT to be disabled "
+                                 "(call ROOT::DisableImplicitMT() first) so friend rows stay aligned");
+
+    const std::filesystem::path list_path(m_path);
+    const std::string tree_name = SnapshotService::sanitise_root_key(name);
+    const std::filesystem::path side =
+        side_path.empty() ? list_path.parent_path() / (list_path.stem().string() + "." + tree_name + ".friend.root")
+                          : std::filesystem::path(side_path);
+    std::error_code ec;
+    if (std::filesystem::equivalent(side, list_path, ec))
+        throw std::runtime_error("EventListIO::write_friend: side file must differ from " + m_path);
+
+    Long64_t n_events = 0;
+    {
+        std::unique_ptr<TFile> fin(TFile::Open(m_path.c_str(), "READ"));
+        auto *events = (fin && !fin->IsZombie()) ? dynamic_cast<TTree *>(fin->Get(event_tree().c_str())) : nullptr;
+        if (!events)
+            throw std::runtime_error("EventListIO::write_friend: missing tree " + event_tree() + " in " + m_path);
+        n_events = events->GetEntries();
+    }
+    const std::unordered_map<int, ULong64_t> checksums = key_checksums();
+
+    // Other friends stay attached, so new columns may build on theirs.
+    std::vector<FriendTreeRef> others;
+    for (const auto &f : friends())
+    {
+        if (f.name != name)
+            others.push_back(f);
+    }
+
+    const std::string tmp_path = side.string() + ".tmp" + std::to_string(gSystem->GetPid());
+    {
+        ROOT::RDataFrame base = make_rdf(others);
+        const auto existing = base.GetColumnNames();
+        for (const auto &c : columns)
+        {
+            if (std::find(existing.begin(), existing.end(), c) != existing.end())
+                throw std::runtime_error("EventListIO::write_friend: column " + c + " already exists in " + m_path);
+        }
+        define(base).Snapshot(tree_name, tmp_path, columns);
+    }
+
+    std::unique_ptr<TFile> fout(TFile::Open(tmp_path.c_str(), "UPDATE"));
+    auto *written = (fout && !fout->IsZombie()) ? dynamic_cast<TTree *>(fout->Get(tree_name.c_str())) : nullptr;
+    if (!written || written->GetEntries() != n_events)
+    {
+        const std::string got = written ? std::to_string(written->GetEntries()) : "none";
+        fout.reset();
+        std::filesystem::remove(tmp_path, ec);
+        throw std::runtime_error("EventListIO::write_friend: friend " + name + " has " + got + " entries, expected " +
+                                 std::to_string(n_events) + " (define() must not filter)");
+    }
+
+    fout->cd();
+    TTree tsums(kFriendChecksumsTree, "Per-sample key checksums of the event list the friend was written for");
+    int sample_id = -1;
+    ULong64_t key_checksum = 0;
+    tsums.Branch("sample_id", &sample_id);
+    tsums.Branch("key_checksum", &key_checksum);
+    for (const auto &kv : checksums)
+    {
+        sample_id = kv.first;
+        key_checksum = kv.second;
+        tsums.Fill();
+    }
+    tsums.Write("", TObject::kOverwrite);
+    fout->Close();
+    fout.reset();
+
+    std::filesystem::rename(tmp_path, side);
+
+    std::vector<FriendTreeRef> refs = registered_friends();
+    refs.erase(std::remove_if(refs.begin(), refs.end(), [&name](const FriendTreeRef &r) { return r.name == name; }),
+               refs.end());
+    refs.push_back(FriendTreeRef{name, side.string(), tree_name, n_events});
+
+    std::unique_ptr<TFile> flist(TFile::Open(m_path.c_str(), "UPDATE"));
+    if (!flist || flist->IsZombie())
+        throw std::runtime_error("EventListIO::write_friend: failed to open " + m_path);
+    flist->cd();
+    flist->Delete((std::string(kFriendRefsTree) + ";*").c_str());
+    write_friend_refs_tree(refs, list_path.parent_path());
+    flist->Close();
+
+    return static_cast<ULong64_t>(n_events);
+}
+
+ULong64_t EventListIO::write_friend(const std::string &name,
+                                    const std::vector<FriendColumn> &columns,
+                                    const std::string &side_path) const
+{
+    std::vector<std::string> names;
+    for (const auto &c : columns)
+        names.push_back(c.name);
+    return write_friend(
+        name,
+        names,
+        [&columns](ROOT::RDF::RNode node) {
+            for (const auto &c : columns)
+                node = node.Define(c.name, c.expr);
+            return node;
+        },
+        side_path);
+}
+
+void EventListIO::detach_friend(const std::string &name) const
+{
+    std::vector<FriendTreeRef> refs = registered_friends();
+    const auto it = std::remove_if(refs.begin(), refs.end(), [&name](const FriendTreeRef &r) { return r.name == name; });
+    if (it == refs.end())
+        throw std::runtime_error("EventListIO::detach_friend: no friend " + name + " in " + m_path);
+    refs.erase(it, refs.end());
+
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "UPDATE"));
+    if (!f || f->IsZombie())
+        throw std::runtime_error("EventListIO::detach_friend: failed to open " + m_path);
+    f->cd();
+    f->Delete((std::string(kFriendRefsTree) + ";*").c_str());
+    if (!refs.empty())
+        write_friend_refs_tree(refs, std::filesystem::path(m_path).parent_path());
+    f->Close();
+}
+
+std::vector<FriendTreeRef> EventListIO::registered_friends() const
+{
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "READ"));
+    if (!f || f->IsZombie())
+        throw std::runtime_error("EventListIO: failed to open " + m_path);
+    auto *t = dynamic_cast<TTree *>(f->Get(kFriendRefsTree));
+    if (!t)
+        return {};
+
+    std::string *friend_name = nullptr;
+    std::string *friend_path = nullptr;
+    std::string *friend_tree = nullptr;
+    Long64_t n_entries = 0;
+    t->SetBranchAddress("friend_name", &friend_name);
+    t->SetBranchAddress("friend_path", &friend_path);
+    t->SetBranchAddress("friend_tree", &friend_tree);
+    t->SetBranchAddress("n_entries", &n_entries);
+
+    const std::filesystem::path list_dir = std::filesystem::path(m_path).parent_path();
+    std::vector<FriendTreeRef> out;
+    for (Long64_t i = 0; i < t->GetEntries(); ++i)
+    {
+        t->GetEntry(i);
+        if (!friend_name || !friend_path || !friend_tree)
+            throw std::runtime_error("EventListIO: friend_refs missing string branches in " + m_path);
+        const std::filesystem::path p(*friend_path);
+        out.push_back(FriendTreeRef{*friend_name, p.is_absolute() ? p.string() : (list_dir / p).string(), *friend_tree,
+                                    n_entries});
+    }
+    t->ResetBranchAddresses();
+    return out;
+}
+
+std::vector<FriendTreeRef> EventListIO::friends() const
+{
+    std::vector<FriendTreeRef> refs = registered_friends();
+    if (refs.empty())
+        return refs;
+
+    // The key covers size and mtime of the event list and every side file,
+    // so a rewrite of any of them revalidates.
+    const std::uint64_t key = source_key(refs);
+    if (m_friends_valid && key == m_friends_key)
+        return m_friends;
+
+    Long64_t n_events = 0;
+    {
+        std::unique_ptr<TFile> fin(TFile::Open(m_path.c_str(), "READ"));
+        auto *events = (fin && !fin->IsZombie()) ? dynamic_cast<TTree *>(fin->Get(event_tree().c_str())) : nullptr;
+        if (!events)
+            throw std::runtime_error("EventListIO: missing tree " + event_tree() + " in " + m_path);
+        n_events = events->GetEntries();
+    }
+    const std::unordered_map<int, ULong64_t> checksums = key_checksums();
+
+    for (const auto &r : refs)
+    {
+        auto stale = [&](const std::string &why) {
+            return std::runtime_error("EventListIO: friend " + r.name + " (" + r.path + ") does not match " + m_path +
+                                      ": " + why + " (rewrite it with write_friend or detach_friend)");
+        };
+
+        std::unique_ptr<TFile> fside(TFile::Open(r.path.c_str(), "READ"));
+        if (!fside || fside->IsZombie())
+            throw stale("side file not readable");
+        auto *t = dynamic_cast<TTree *>(fside->Get(r.tree.c_str()));
+        if (!t)
+            throw stale("missing tree " + r.tree);
+        if (t->GetEntries() != n_events)
+            throw stale(std::to_string(t->GetEntries()) + " entries, event tree has " + std::to_string(n_events));
+
+        auto *sums = dynamic_cast<TTree *>(fside->Get(kFriendChecksumsTree));
+        if (!sums)
+            throw stale("missing " + std::string(kFriendChecksumsTree));
+        int sample_id = -1;
+        ULong64_t key_checksum = 0;
+        sums->SetBranchAddress("sample_id", &sample_id);
+        sums->SetBranchAddress("key_checksum", &key_checksum);
+        if (sums->GetEntries() != static_cast<Long64_t>(checksums.size()))
+            throw stale("sample count changed");
+        for (Long64_t i = 0; i < sums->GetEntries(); ++i)
+        {
+            sums->GetEntry(i);
+            const auto it = checksums.find(sample_id);
+            if (it == checksums.end() || it->second != key_checksum)
+                throw stale("event keys of sample_id " + std::to_string(sample_id) + " changed");
+        }
+    }
+
+    m_friends = refs;
+    m_friends_key = key;
+    m_friends_valid = true;
+    return refs;
+}
+
+std::unordered_map<int, ULong64_t> EventListIO::key_checksums() const
+{
+    std::unordered_map<int, ULong64_t> out;
+    bool known = !m_sample_refs.empty();
+    for (const auto &kv : m_sample_refs)
+    {
+        out[kv.first] = kv.second.key_checksum;
+        known = known && kv.second.key_checksum != 0;
+    }
+    if (known)
+        return out;
+
+    // Event lists indexed before checksums were recorded: scan the keys.
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "READ"));
+    auto *events = (f && !f->IsZombie()) ? dynamic_cast<TTree *>(f->Get(event_tree().c_str())) : nullptr;
+    if (!events)
+        throw std::runtime_error("EventListIO: missing tree " + event_tree() + " in " + m_path);
+
+    EventIndexEntry row;
+    events->SetBranchStatus("*", false);
+    for (const char *b : {"run", "sub", "evt", "sample_id"})
+        events->SetBranchStatus(b, true);
+    events->SetBranchAddress("run", &row.run);
+    events->SetBranchAddress("sub", &row.sub);
+    events->SetBranchAddress("evt", &row.evt);
+    events->SetBranchAddress("sample_id", &row.sample_id);
+
+    for (auto &kv : out)
+        kv.second = kKeyDigestSeed;
+    const Long64_t n = events->GetEntries();
+    for (Long64_t i = 0; i < n; ++i)
+    {
+        events->GetEntry(i);
+        auto &h = out.try_emplace(row.sample_id, kKeyDigestSeed).first->second;
+        h = digest_key(h, row.run, row.sub, row.evt);
+    }
+    events->ResetBranchAddresses();
+    return out;
+}
+
 double EventListIO::total_pot_data() const
 {
     const int data_id = static_cast<int>(SampleIO::SampleOrigin::kData);
@@ -317,4 +1430,261 @@ std::string EventListIO::beamline_label() const
     return "unknown";
 }
 
+ULong64_t EventListIO::build_event_index() const
+{
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "UPDATE"));
+    if (!f || f->IsZombie())
+        throw std::runtime_error("EventListIO::build_event_index: failed to open " + m_path);
+
+    auto *events = dynamic_cast<TTree *>(f->Get(event_tree().c_str()));
+    if (!events)
+        throw std::runtime_error("EventListIO::build_event_index: missing tree " + event_tree() + " in " + m_path);
+
+    EventIndexEntry row;
+    events->SetBranchStatus("*", false);
+    for (const char *b : {"run", "sub", "evt", "sample_id"})
+        events->SetBranchStatus(b, true);
+    events->SetBranchAddress("run", &row.run);
+    events->SetBranchAddress("sub", &row.sub);
+    events->SetBranchAddress("evt", &row.evt);
+    events->SetBranchAddress("sample_id", &row.sample_id);
+
+    const Long64_t n = events->GetEntries();
+    std::vector<EventIndexEntry> rows;
+    rows.reserve(static_cast<std::size_t>(n));
+    std::unordered_map<int, std::uint64_t> digests;
+    for (Long64_t i = 0; i < n; ++i)
+    {
+        events->GetEntry(i);
+        row.entry = i;
+        rows.push_back(row);
+        auto &h = digests.try_emplace(row.sample_id, kKeyDigestSeed).first->second;
+        h = digest_key(h, row.run, row.sub, row.evt);
+    }
+    events->ResetBranchAddresses();
+
+    std::sort(rows.begin(), rows.end(), [](const EventIndexEntry &a, const EventIndexEntry &b) {
+        return key_less(a, b) || (!key_less(b, a) && a.entry < b.entry);
+    });
+
+    TTree index(kEventIndexTree, "Sorted (run, sub, evt, sample_id) -> event tree entry");
+    index.Branch("run", &row.run);
+    index.Branch("sub", &row.sub);
+    index.Branch("evt", &row.evt);
+    index.Branch("sample_id", &row.sample_id);
+    index.Branch("entry", &row.entry);
+    for (const auto &r : rows)
+    {
+        row = r;
+        index.Fill();
+    }
+    index.Write(nullptr, TObject::kOverwrite);
+
+    // Samples are appended one at a time, so each normally owns one
+    // contiguous block of rows; record it so views can skip the others.
+    struct Span
+    {
+        Long64_t first = -1;
+        Long64_t last = -1;
+        Long64_t count = 0;
+    };
+    std::unordered_map<int, Span> spans;
+    for (const auto &r : rows)
+    {
+        Span &sp = spans[r.sample_id];
+        sp.first = (sp.count == 0) ? r.entry : std::min(sp.first, r.entry);
+        sp.last = std::max(sp.last, r.entry);
+        ++sp.count;
+    }
+
+    std::vector<std::pair<int, SampleInfo>> refs(m_sample_refs.begin(), m_sample_refs.end());
+    std::sort(refs.begin(), refs.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (auto &ref : refs)
+    {
+        const auto digest = digests.find(ref.first);
+        ref.second.key_checksum = digest != digests.end() ? digest->second : kKeyDigestSeed;
+
+        const auto it = spans.find(ref.first);
+        if (it == spans.end())
+        {
+            ref.second.entry_begin = 0;
+            ref.second.entry_end = 0;
+        }
+        else if (it->second.last - it->second.first + 1 == it->second.count)
+        {
+            ref.second.entry_begin = it->second.first;
+            ref.second.entry_end = it->second.last + 1;
+        }
+        else
+        {
+            ref.second.entry_begin = -1;
+            ref.second.entry_end = -1;
+        }
+    }
+    f->cd();
+    f->Delete("sample_refs;*");
+    write_sample_refs_tree(refs);
+    f->Close();
+
+    return static_cast<ULong64_t>(rows.size());
+}
+
+bool EventListIO::has_event_index() const
+{
+    std::unique_ptr<TFile> f(TFile::Open(m_path.c_str(), "READ"));
+    return f && !f->IsZombie() && dynamic_cast<TTree *>(f->Get(kEventIndexTree)) != nullptr;
+}
+
+std::vector<EventIndexEntry> EventListIO::find_events(int run, int sub, int evt) const
+{
+    EventIndexEntry key;
+    key.run = run;
+    key.sub = sub;
+    key.evt = evt;
+    return find_events(std::vector<EventIndexEntry>{key});
+}
+
+std::vector<EventIndexEntry> EventListIO::find_events(const std::vector<EventIndexEntry> &keys) const
+{
+    std::vector<EventIndexEntry> sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end(), key_less);
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end(),
+                                  [](const EventIndexEntry &a, const EventIndexEntry &b) {
+                                      return same_event(a, b) && a.sample_id == b.sample_id;
+                                  }),
+                      sorted_keys.end());
+
+    IndexReader reader(m_path);
+    std::vector<EventIndexEntry> out;
+    for (const auto &key : sorted_keys)
+        reader.append_matches(key, out);
+    return out;
+}
+
+EventSubset EventListIO::fetch_entries(const std::vector<Long64_t> &entries) const
+{
+    std::unique_ptr<TFile> fin(TFile::Open(m_path.c_str(), "READ"));
+    if (!fin || fin->IsZombie())
+        throw std::runtime_error("EventListIO::fetch_entries: failed to open " + m_path);
+    auto *events = dynamic_cast<TTree *>(fin->Get(event_tree().c_str()));
+    if (!events)
+        throw std::runtime_error("EventListIO::fetch_entries: missing tree " + event_tree() + " in " + m_path);
+
+    static std::atomic<unsigned int> counter{0};
+    const std::string path = std::string(gSystem->TempDirectory()) + "/heron_event_subset_" +
+                             std::to_string(gSystem->GetPid()) + "_" + std::to_string(counter++) + ".root";
+
+    std::unique_ptr<TFile> fout(TFile::Open(path.c_str(), "RECREATE"));
+    if (!fout || fout->IsZombie())
+        throw std::runtime_error("EventListIO::fetch_entries: failed to create " + path);
+
+    TTree *subset = events->CloneTree(0);
+    const Long64_t n = events->GetEntries();
+    for (Long64_t entry : entries)
+    {
+        if (entry < 0 || entry >= n)
+            throw std::runtime_error("EventListIO::fetch_entries: entry out of range: " + std::to_string(entry));
+        events->GetEntry(entry);
+        subset->Fill();
+    }
+    subset->Write();
+    fout->Close();
+
+    return EventSubset(path, event_tree(), static_cast<ULong64_t>(entries.size()));
+}
+
+EventSubset EventListIO::fetch_events(const std::vector<EventIndexEntry> &keys) const
+{
+    std::vector<Long64_t> entries;
+    for (const auto &r : find_events(keys))
+        entries.push_back(r.entry);
+    std::sort(entries.begin(), entries.end());
+    return fetch_entries(entries);
+}
+
+EventSubset::EventSubset(std::string path, std::string tree_name, ULong64_t n_entries)
+    : m_path(std::move(path)), m_tree_name(std::move(tree_name)), m_n_entries(n_entries)
+{
+}
+
+EventSubset::EventSubset(EventSubset &&other) noexcept
+    : m_path(std::move(other.m_path)), m_tree_name(std::move(other.m_tree_name)), m_n_entries(other.m_n_entries)
+{
+    other.m_path.clear();
+}
+
+EventSubset::~EventSubset()
+{
+    if (!m_path.empty())
+    {
+        std::error_code ec;
+        std::filesystem::remove(m_path, ec);
+    }
+}
+
+ROOT::RDataFrame EventSubset::rdf() const
+{
+    return ROOT::RDataFrame(m_tree_name, m_path);
+}
+
+EventListView::EventListView(std::string path,
+                             std::string tree_name,
+                             const std::vector<EntryRange> &ranges,
+                             std::shared_ptr<const std::vector<char>> mask,
+                             const std::vector<FriendTreeRef> &friends)
+    : m_path(std::move(path)), m_tree_name(std::move(tree_name)), m_mask(std::move(mask))
+{
+    m_chain = std::make_unique<TChain>(m_tree_name.c_str());
+    m_chain->Add(m_path.c_str());
+    // Friends are read at the same entry numbers, so the entry list applies to them too.
+    for (const auto &f : friends)
+    {
+        m_friends.push_back(std::make_unique<TChain>(f.tree.c_str()));
+        m_friends.back()->Add(f.path.c_str());
+        m_chain->AddFriend(m_friends.back().get(), f.name.c_str());
+    }
+    const Long64_t n = m_chain->GetEntries();
+
+    std::vector<EntryRange> clipped;
+    for (const auto &r : ranges)
+    {
+        const Long64_t lo = std::max<Long64_t>(0, r.first);
+        const Long64_t hi = std::min(n, r.second);
+        if (lo < hi)
+            clipped.emplace_back(lo, hi);
+    }
+
+    if (clipped.size() == 1 && clipped.front().first == 0 && clipped.front().second == n)
+    {
+        m_n_entries = static_cast<ULong64_t>(n);
+        return;
+    }
+
+    m_entry_list = std::make_unique<TEntryList>("heron_view", "", m_tree_name.c_str(), m_path.c_str());
+    for (const auto &r : clipped)
+    {
+        for (Long64_t e = r.first; e < r.second; ++e)
+            m_entry_list->Enter(e);
+        m_n_entries += static_cast<ULong64_t>(r.second - r.first);
+    }
+    m_chain->SetEntryList(m_entry_list.get());
+}
+
+EventListView::~EventListView() = default;
+
+EventListView::EventListView(EventListView &&other) noexcept = default;
+
+ROOT::RDF::RNode EventListView::rdf() const
+{
+    ROOT::RDF::RNode node = ROOT::RDataFrame(*m_chain);
+    if (!m_mask)
+        return node;
+
+    auto mask = m_mask;
+    return node.Filter(
+        [mask](int sid) {
+            return sid >= 0 && sid < static_cast<int>(mask->size()) && (*mask)[static_cast<size_t>(sid)];
+        },
+        {"sample_id"});
+}
 }
@@ -28,10 +28,14 @@
 #include <TBranch.h>
 #include <TFile.h>
 #include <TObjArray.h>
+#include <TObjString.h>
 #include <TFileMerger.h>
 #include <TObject.h>
 #include <TTree.h>
 
+#include "SparseImageCodec.hh"
+#include "UniverseWeightCodec.hh"
+
 
 std::string SnapshotService::sanitise_root_key(std::string s)
 {
@@ -146,6 +150,28 @@ void append_tree_fast(const std::string &out_path,
     fin->Close();
 }
 
+/// Add @p encoded to the branches recorded under Codec::kColumnsKey.
+template <typename Codec>
+void record_encoded_columns(const std::string &out_path, const std::vector<std::string> &encoded)
+{
+    std::unique_ptr<TFile> fout(TFile::Open(out_path.c_str(), "UPDATE"));
+    if (!fout || fout->IsZombie())
+        throw std::runtime_error("SnapshotService: failed to open output to record encoded columns: " + out_path);
+
+    std::vector<std::string> recorded;
+    if (auto *s = dynamic_cast<TObjString *>(fout->Get(Codec::kColumnsKey)))
+        recorded = Codec::parse_columns(s->GetString().Data());
+    for (const auto &column : encoded)
+    {
+        if (std::find(recorded.begin(), recorded.end(), column) == recorded.end())
+            recorded.push_back(column);
+    }
+
+    fout->cd();
+    TObjString(Codec::format_columns(recorded).c_str()).Write(Codec::kColumnsKey, TObject::kOverwrite);
+    fout->Close();
+}
+
 std::filesystem::path snapshot_scratch_dir()
 {
     const char *user = std::getenv("USER");
@@ -156,13 +182,22 @@ std::filesystem::path snapshot_scratch_dir()
 }
 } // namespace
 
+void SnapshotService::append_tree(const std::string &out_path,
+                                  const std::string &in_path,
+                                  const std::string &tree_name)
+{
+    append_tree_fast(out_path, in_path, tree_name);
+}
+
 ULong64_t SnapshotService::snapshot_event_list_merged(ROOT::RDF::RNode node,
                                                       const std::string &out_path,
                                                       int sample_id,
                                                       const std::string &sample_name,
                                                       const std::vector<std::string> &columns,
                                                       const std::string &selection,
-                                                      const std::string &tree_name_in)
+                                                      const std::string &tree_name_in,
+                                                      const std::vector<std::string> &encoded_columns,
+                                                      const std::vector<std::string> &sparse_image_columns)
 {
     ROOT::RDF::RNode filtered = std::move(node);
     if (!selection.empty() && selection != "true")
@@ -176,6 +211,60 @@ ULong64_t SnapshotService::snapshot_event_list_merged(ROOT::RDF::RNode node,
     if (std::find(snapshot_cols.begin(), snapshot_cols.end(), "sample_id") == snapshot_cols.end())
         snapshot_cols.push_back("sample_id");
 
+    std::vector<std::string> encoded_weights;
+    if (!encoded_columns.empty())
+    {
+        // Universe vectors are written only in their compact form, recorded in
+        // the event list; readers recover the plain column with
+        // UniverseWeightCodec::define_decoded or feed the blobs to the fills.
+        filtered = nu::UniverseWeightCodec::define_encoded(filtered, encoded_columns);
+        const auto defined = filtered.GetColumnNames();
+        for (auto &col : snapshot_cols)
+        {
+            const std::string encoded = nu::UniverseWeightCodec::encoded_column(col);
+            if (std::find(encoded_columns.begin(), encoded_columns.end(), col) != encoded_columns.end() &&
+                std::find(defined.begin(), defined.end(), encoded) != defined.end())
+            {
+                std::cerr << "[SnapshotService] stage=encode_column"
+                          << " sample=" << sample_name
+                          << " column=" << col
+                          << " branch=" << encoded
+                          << "\n";
+                col = encoded;
+                encoded_weights.push_back(encoded);
+            }
+        }
+    }
+
+    std::vector<std::string> encoded_images;
+    if (!sparse_image_columns.empty())
+    {
+        // Images are likewise written only as sparse blobs, recorded in the
+        // event list; readers recover them with SparseImageCodec::define_decoded
+        // or iterate the blobs.
+        filtered = nu::SparseImageCodec::define_encoded(filtered, sparse_image_columns);
+        const auto defined = filtered.GetColumnNames();
+        for (auto &col : snapshot_cols)
+        {
+            if (std::find(sparse_image_columns.begin(), sparse_image_columns.end(), col) == sparse_image_columns.end())
+                continue;
+            for (const bool integer : {false, true})
+            {
+                const std::string encoded = nu::SparseImageCodec::encoded_column(col, integer);
+                if (std::find(defined.begin(), defined.end(), encoded) == defined.end())
+                    continue;
+                std::cerr << "[SnapshotService] stage=encode_column"
+                          << " sample=" << sample_name
+                          << " column=" << col
+                          << " branch=" << encoded
+                          << "\n";
+                col = encoded;
+                encoded_images.push_back(encoded);
+                break;
+            }
+        }
+    }
+
     std::filesystem::path scratch_dir = snapshot_scratch_dir();
     {
         std::error_code ec;
@@ -233,6 +322,10 @@ ULong64_t SnapshotService::snapshot_event_list_merged(ROOT::RDF::RNode node,
               << " tree=" << tree_name
               << "\n";
     append_tree_fast(out_path, scratch_file, tree_name);
+    if (!encoded_weights.empty())
+        record_encoded_columns<nu::UniverseWeightCodec>(out_path, encoded_weights);
+    if (!encoded_images.empty())
+        record_encoded_columns<nu::SparseImageCodec>(out_path, encoded_images);
     std::cerr << "[SnapshotService] stage=append_done sample=" << sample_name << "\n";
 
     {
@@ -361,3 +454,85 @@ ULong64_t SnapshotService::snapshot_event_list(ROOT::RDF::RNode node,
               << "\n";
     return count.GetValue();
 }
+
+std::vector<ULong64_t> SnapshotService::snapshot_event_list_splits(ROOT::RDF::RNode node,
+                                                                   const std::string &split_column,
+                                                                   const std::vector<std::string> &out_paths,
+                                                                   const std::vector<std::string> &columns,
+                                                                   const std::string &tree_name_in)
+{
+    const std::string tree_name = sanitise_root_key(tree_name_in.empty() ? "events" : tree_name_in);
+
+    std::filesystem::path scratch_dir = snapshot_scratch_dir();
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(scratch_dir, ec);
+        if (ec)
+        {
+            throw std::runtime_error(
+                "SnapshotService: failed to create scratch directory: "
+                + scratch_dir.string()
+                + " (" + ec.message() + ")");
+        }
+    }
+
+    ROOT::RDF::RSnapshotOptions options;
+    options.fMode = "RECREATE";
+    options.fOverwriteIfExists = false;
+    options.fLazy = true;
+    options.fCompressionAlgorithm = ROOT::kLZ4;
+    options.fCompressionLevel = 1;
+    options.fAutoFlush = -50LL * 1024 * 1024;
+    options.fSplitLevel = 0;
+
+    std::vector<std::string> scratch_files;
+    std::vector<ROOT::RDF::RResultPtr<ULong64_t>> counts;
+    std::vector<ROOT::RDF::RResultHandle> handles;
+    for (std::size_t k = 0; k < out_paths.size(); ++k)
+    {
+        const int split = static_cast<int>(k);
+        ROOT::RDF::RNode part = node.Filter([split](int s) { return s == split; },
+                                            {split_column},
+                                            "split_" + std::to_string(k));
+        scratch_files.push_back(
+            (scratch_dir / ("heron_split_" + tree_name + "_" + std::to_string(k) + "_"
+                            + std::to_string(::getpid()) + ".root"))
+                .string());
+        counts.push_back(part.Count());
+        handles.emplace_back(counts.back());
+        handles.emplace_back(part.Snapshot(tree_name, scratch_files.back(), columns, options));
+    }
+
+    std::cerr << "[SnapshotService] stage=split_snapshot_run"
+              << " splits=" << out_paths.size()
+              << " tree=" << tree_name
+              << "\n";
+    const auto start_time = std::chrono::steady_clock::now();
+    ROOT::RDF::RunGraphs(handles);
+    const double elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::vector<ULong64_t> written;
+    for (std::size_t k = 0; k < out_paths.size(); ++k)
+    {
+        written.push_back(counts[k].GetValue());
+        std::cerr << "[SnapshotService] stage=split_append"
+                  << " split=" << k
+                  << " events=" << written.back()
+                  << " out_file=" << out_paths[k]
+                  << "\n";
+        append_tree_fast(out_paths[k], scratch_files[k], tree_name);
+
+        std::error_code ec;
+        std::filesystem::remove(scratch_files[k], ec);
+        if (ec)
+            std::cerr << "[SnapshotService] warning=failed_to_remove_scratch_file path=" << scratch_files[k]
+                      << " err=" << ec.message() << "\n";
+    }
+
+    std::cerr << "[SnapshotService] stage=split_snapshot_complete"
+              << " splits=" << out_paths.size()
+              << " elapsed_seconds=" << elapsed_seconds
+              << "\n";
+    return written;
+}
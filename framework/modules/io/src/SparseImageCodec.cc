@@ -0,0 +1,290 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/src/SparseImageCodec.cc
+ *
+ *  @brief Implementation of the sparse image column codec.
+ */
+
+#include "SparseImageCodec.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Codec = nu::SparseImageCodec;
+
+void put_varint(std::vector<unsigned char> &out, std::uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+inline bool is_zero(float v)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits == 0;
+}
+
+inline bool is_zero(int v)
+{
+    return v == 0;
+}
+
+inline void put_value(std::vector<unsigned char> &out, float v)
+{
+    unsigned char bytes[sizeof(float)];
+    std::memcpy(bytes, &v, sizeof(v));
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+inline void put_value(std::vector<unsigned char> &out, int v)
+{
+    const std::int32_t d = static_cast<std::int32_t>(v);
+    put_varint(out, (static_cast<std::uint32_t>(d) << 1) ^ static_cast<std::uint32_t>(d >> 31));
+}
+
+template <class T>
+void encode_image(const T *values, std::size_t n, std::vector<unsigned char> &out, unsigned char type)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    std::size_t n_stored = 0;
+    for (std::size_t i = 0; i < n;)
+    {
+        if (is_zero(values[i]))
+        {
+            ++i;
+            continue;
+        }
+        const std::size_t begin = i;
+        while (i < n && !is_zero(values[i]))
+            ++i;
+        runs.emplace_back(begin, i - begin);
+        n_stored += i - begin;
+    }
+
+    out.clear();
+    out.reserve(16 + 4 * runs.size() + 4 * n_stored);
+    out.push_back(Codec::kFormatVersion);
+    out.push_back(type);
+    put_varint(out, n);
+    put_varint(out, runs.size());
+    std::size_t cursor = 0;
+    for (const auto &run : runs)
+    {
+        put_varint(out, run.first - cursor);
+        put_varint(out, run.second);
+        cursor = run.first + run.second;
+    }
+    for (const auto &run : runs)
+    {
+        for (std::size_t i = run.first; i < run.first + run.second; ++i)
+            put_value(out, values[i]);
+    }
+}
+
+template <class T>
+std::size_t decode_image(const unsigned char *blob, std::size_t n_bytes, T *out, std::size_t capacity)
+{
+    const std::size_t n = Codec::decoded_size(blob, n_bytes);
+    if (capacity < n)
+        throw std::runtime_error("SparseImageCodec: output buffer too small");
+    std::fill(out, out + n, T{});
+    Codec::for_each_nonzero<T>(blob, n_bytes, [out](std::size_t index, T v) { out[index] = v; });
+    return n;
+}
+
+/// Element type of "RVec<T>" / "vector<T>" (any namespace), or empty.
+std::string vector_element_type(const std::string &type)
+{
+    const std::size_t open = type.find('<');
+    const std::size_t close = type.rfind('>');
+    if (open == std::string::npos || close == std::string::npos || close < open)
+        return {};
+    std::string outer = type.substr(0, open);
+    const std::size_t ns = outer.rfind("::");
+    if (ns != std::string::npos)
+        outer = outer.substr(ns + 2);
+    if (outer != "RVec" && outer != "vector")
+        return {};
+    std::string element = type.substr(open + 1, close - open - 1);
+    const std::size_t b = element.find_first_not_of(' ');
+    const std::size_t e = element.find_last_not_of(' ');
+    return b == std::string::npos ? std::string() : element.substr(b, e - b + 1);
+}
+
+bool has_suffix(const std::string &value, const std::string &suffix)
+{
+    return value.size() > suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+namespace nu
+{
+
+std::string SparseImageCodec::encoded_column(const std::string &column, bool integer)
+{
+    return column + (integer ? kIntSuffix : kFloatSuffix);
+}
+
+std::string SparseImageCodec::plain_column(const std::string &column)
+{
+    for (const std::string suffix : {kFloatSuffix, kIntSuffix})
+    {
+        if (has_suffix(column, suffix))
+            return column.substr(0, column.size() - suffix.size());
+    }
+    return {};
+}
+
+std::string SparseImageCodec::format_columns(const std::vector<std::string> &encoded)
+{
+    std::string out;
+    for (const auto &column : encoded)
+        out += column + "\n";
+    return out;
+}
+
+std::vector<std::string> SparseImageCodec::parse_columns(const std::string &recorded)
+{
+    std::vector<std::string> out;
+    std::size_t begin = 0;
+    while (begin < recorded.size())
+    {
+        std::size_t end = recorded.find('\n', begin);
+        if (end == std::string::npos)
+            end = recorded.size();
+        if (end > begin)
+            out.push_back(recorded.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return out;
+}
+
+void SparseImageCodec::encode(const float *values, std::size_t n, std::vector<unsigned char> &out)
+{
+    encode_image(values, n, out, 0);
+}
+
+void SparseImageCodec::encode(const int *values, std::size_t n, std::vector<unsigned char> &out)
+{
+    encode_image(values, n, out, 1);
+}
+
+ROOT::RVec<unsigned char> SparseImageCodec::encode(const ROOT::RVec<float> &values)
+{
+    std::vector<unsigned char> buffer;
+    encode(values.data(), values.size(), buffer);
+    return ROOT::RVec<unsigned char>(buffer.begin(), buffer.end());
+}
+
+ROOT::RVec<unsigned char> SparseImageCodec::encode(const ROOT::RVec<int> &values)
+{
+    std::vector<unsigned char> buffer;
+    encode(values.data(), values.size(), buffer);
+    return ROOT::RVec<unsigned char>(buffer.begin(), buffer.end());
+}
+
+std::size_t SparseImageCodec::decoded_size(const unsigned char *blob, std::size_t n_bytes)
+{
+    const unsigned char *p = blob;
+    const unsigned char *end = blob + n_bytes;
+    read_header(p, end);
+    return static_cast<std::size_t>(read_varint(p, end));
+}
+
+std::size_t SparseImageCodec::decode(const unsigned char *blob, std::size_t n_bytes, float *out, std::size_t capacity)
+{
+    return decode_image(blob, n_bytes, out, capacity);
+}
+
+std::size_t SparseImageCodec::decode(const unsigned char *blob, std::size_t n_bytes, int *out, std::size_t capacity)
+{
+    return decode_image(blob, n_bytes, out, capacity);
+}
+
+ROOT::RVec<float> SparseImageCodec::decode_float(const ROOT::RVec<unsigned char> &blob)
+{
+    ROOT::RVec<float> out(decoded_size(blob.data(), blob.size()));
+    decode(blob.data(), blob.size(), out.data(), out.size());
+    return out;
+}
+
+ROOT::RVec<int> SparseImageCodec::decode_int(const ROOT::RVec<unsigned char> &blob)
+{
+    ROOT::RVec<int> out(decoded_size(blob.data(), blob.size()));
+    decode(blob.data(), blob.size(), out.data(), out.size());
+    return out;
+}
+
+ROOT::RDF::RNode SparseImageCodec::define_encoded(ROOT::RDF::RNode node, const std::vector<std::string> &columns)
+{
+    const auto names = node.GetColumnNames();
+    for (const auto &column : columns)
+    {
+        if (std::find(names.begin(), names.end(), column) == names.end())
+            continue;
+
+        const std::string type = node.GetColumnType(column);
+        const std::string element = vector_element_type(type);
+        if (element == "float" || element == "Float_t")
+        {
+            node = node.Define(encoded_column(column, false),
+                               [](const ROOT::RVec<float> &v) { return encode(v); },
+                               {column});
+        }
+        else if (element == "int" || element == "Int_t")
+        {
+            node = node.Define(encoded_column(column, true),
+                               [](const ROOT::RVec<int> &v) { return encode(v); },
+                               {column});
+        }
+        else
+        {
+            throw std::runtime_error("SparseImageCodec: unsupported image column type '" + type +
+                                     "' for " + column);
+        }
+    }
+    return node;
+}
+
+ROOT::RDF::RNode SparseImageCodec::define_decoded(ROOT::RDF::RNode node, const std::vector<std::string> &encoded)
+{
+    const auto names = node.GetColumnNames();
+    for (const auto &name : encoded)
+    {
+        const std::string plain = plain_column(name);
+        if (plain.empty())
+            throw std::runtime_error("SparseImageCodec: recorded column " + name + " has no encoded suffix");
+        if (std::find(names.begin(), names.end(), name) == names.end() ||
+            std::find(names.begin(), names.end(), plain) != names.end())
+            continue;
+        if (has_suffix(name, kIntSuffix))
+        {
+            node = node.Define(plain,
+                               [](const ROOT::RVec<unsigned char> &blob) { return decode_int(blob); },
+                               {name});
+        }
+        else
+        {
+            node = node.Define(plain,
+                               [](const ROOT::RVec<unsigned char> &blob) { return decode_float(blob); },
+                               {name});
+        }
+    }
+    return node;
+}
+
+}
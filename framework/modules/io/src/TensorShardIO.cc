@@ -0,0 +1,374 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/src/TensorShardIO.cc
+ *
+ *  @brief Implementation of the tensor shard writer and mmap reader.
+ */
+
+#include "TensorShardIO.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char kMagic[8] = {'H', 'E', 'R', 'O', 'N', 'T', 'S', 'R'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint64_t kSectionAlignment = 64;
+
+std::uint64_t align_up(std::uint64_t offset)
+{
+    return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+std::string errno_message()
+{
+    return std::strerror(errno);
+}
+} // namespace
+
+namespace nu
+{
+
+TensorShardWriter::TensorShardWriter(std::string path, const Layout &layout)
+    : m_path(std::move(path)), m_layout(layout)
+{
+    if (m_layout.n_planes == 0 || m_layout.height == 0 || m_layout.width == 0)
+        throw std::runtime_error("TensorShardWriter: empty image layout for " + m_path);
+    if (m_layout.capacity == 0)
+        throw std::runtime_error("TensorShardWriter: capacity must be > 0 for " + m_path);
+
+    m_plane_size = static_cast<std::uint64_t>(m_layout.height) * m_layout.width;
+    const std::uint64_t records_end = align_up(sizeof(TensorShardHeader)) +
+                                      m_layout.capacity * sizeof(TensorShardRecord);
+    if (m_layout.encoding == Encoding::kDense)
+    {
+        m_image_offset = align_up(records_end);
+        m_semantic_offset = align_up(m_image_offset +
+                                     m_layout.capacity * m_layout.n_planes * m_plane_size * sizeof(float));
+        if (m_layout.semantic)
+            m_semantic_row.resize(m_plane_size);
+    }
+    else
+    {
+        m_pixel_offsets.reserve(m_layout.capacity * m_layout.n_planes + 1);
+        m_pixel_offsets.push_back(0);
+    }
+    m_records.reserve(m_layout.capacity);
+
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+        throw std::runtime_error("TensorShardWriter: cannot create " + m_path + ": " + errno_message());
+}
+
+TensorShardWriter::~TensorShardWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void TensorShardWriter::write_at(std::uint64_t offset, const void *data, std::size_t n_bytes)
+{
+    const char *p = static_cast<const char *>(data);
+    while (n_bytes > 0)
+    {
+        const ssize_t n = ::pwrite(m_fd, p, n_bytes, static_cast<off_t>(offset));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("TensorShardWriter: write failed for " + m_path + ": " + errno_message());
+        }
+        p += n;
+        offset += static_cast<std::uint64_t>(n);
+        n_bytes -= static_cast<std::size_t>(n);
+    }
+}
+
+void TensorShardWriter::append(const TensorShardRecord &record,
+                               const float *const *images,
+                               const int *const *semantic)
+{
+    if (m_fd < 0)
+        throw std::runtime_error("TensorShardWriter: append after close for " + m_path);
+    if (full())
+        throw std::runtime_error("TensorShardWriter: shard is full: " + m_path);
+
+    const bool with_semantic = m_layout.semantic && semantic != nullptr;
+    if (m_layout.semantic && semantic == nullptr)
+        throw std::runtime_error("TensorShardWriter: semantic images required for " + m_path);
+
+    const std::uint64_t event = m_records.size();
+    for (std::uint32_t plane = 0; plane < m_layout.n_planes; ++plane)
+    {
+        const float *image = images[plane];
+        const int *labels = with_semantic ? semantic[plane] : nullptr;
+        if (labels != nullptr)
+        {
+            for (std::uint64_t k = 0; k < m_plane_size; ++k)
+            {
+                if (labels[k] < 0 || labels[k] > 255)
+                    throw std::runtime_error("TensorShardWriter: semantic label " + std::to_string(labels[k]) +
+                                             " outside [0, 255] in " + m_path);
+            }
+        }
+
+        if (m_layout.encoding == Encoding::kDense)
+        {
+            const std::uint64_t row = event * m_layout.n_planes + plane;
+            write_at(m_image_offset + row * m_plane_size * sizeof(float), image, m_plane_size * sizeof(float));
+            if (labels != nullptr)
+            {
+                std::transform(labels, labels + m_plane_size, m_semantic_row.begin(),
+                               [](int v) { return static_cast<std::uint8_t>(v); });
+                write_at(m_semantic_offset + row * m_plane_size, m_semantic_row.data(), m_plane_size);
+            }
+            continue;
+        }
+
+        for (std::uint64_t k = 0; k < m_plane_size; ++k)
+        {
+            const int label = labels != nullptr ? labels[k] : 0;
+            if (image[k] == 0.f && label == 0)
+                continue;
+            m_pixel_index.push_back(static_cast<std::uint32_t>(k));
+            m_pixel_value.push_back(image[k]);
+            m_pixel_semantic.push_back(static_cast<std::uint8_t>(label));
+        }
+        m_pixel_offsets.push_back(m_pixel_index.size());
+    }
+    m_records.push_back(record);
+}
+
+void TensorShardWriter::close()
+{
+    if (m_fd < 0)
+        return;
+
+    TensorShardHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.encoding = static_cast<std::uint32_t>(m_layout.encoding);
+    header.n_planes = m_layout.n_planes;
+    header.height = m_layout.height;
+    header.width = m_layout.width;
+    header.has_semantic = m_layout.semantic ? 1u : 0u;
+    header.n_events = m_records.size();
+    header.capacity = m_layout.capacity;
+    header.records_offset = align_up(sizeof(TensorShardHeader));
+
+    const std::uint64_t records_end = header.records_offset + m_layout.capacity * sizeof(TensorShardRecord);
+    if (m_layout.encoding == Encoding::kDense)
+    {
+        header.image_offset = m_image_offset;
+        header.semantic_offset = m_layout.semantic ? m_semantic_offset : 0;
+        header.file_size = m_layout.semantic
+                               ? m_semantic_offset + m_layout.capacity * m_layout.n_planes * m_plane_size
+                               : m_image_offset + m_layout.capacity * m_layout.n_planes * m_plane_size * sizeof(float);
+    }
+    else
+    {
+        const std::uint64_t n_pixels = m_pixel_index.size();
+        header.n_pixels = n_pixels;
+        header.pixel_offsets_offset = align_up(records_end);
+        header.pixel_index_offset =
+            align_up(header.pixel_offsets_offset + m_pixel_offsets.size() * sizeof(std::uint64_t));
+        header.image_offset = align_up(header.pixel_index_offset + n_pixels * sizeof(std::uint32_t));
+        header.semantic_offset = m_layout.semantic ? align_up(header.image_offset + n_pixels * sizeof(float)) : 0;
+        header.file_size = m_layout.semantic ? header.semantic_offset + n_pixels
+                                             : header.image_offset + n_pixels * sizeof(float);
+
+        write_at(header.pixel_offsets_offset, m_pixel_offsets.data(), m_pixel_offsets.size() * sizeof(std::uint64_t));
+        write_at(header.pixel_index_offset, m_pixel_index.data(), n_pixels * sizeof(std::uint32_t));
+        write_at(header.image_offset, m_pixel_value.data(), n_pixels * sizeof(float));
+        if (m_layout.semantic)
+            write_at(header.semantic_offset, m_pixel_semantic.data(), n_pixels);
+    }
+
+    write_at(header.records_offset, m_records.data(), m_records.size() * sizeof(TensorShardRecord));
+    write_at(0, &header, sizeof(header));
+
+    const int fd = m_fd;
+    m_fd = -1;
+    if (::ftruncate(fd, static_cast<off_t>(header.file_size)) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("TensorShardWriter: cannot size " + m_path + ": " + errno_message());
+    }
+    if (::close(fd) != 0)
+        throw std::runtime_error("TensorShardWriter: close failed for " + m_path + ": " + errno_message());
+
+    std::vector<std::uint64_t>().swap(m_pixel_offsets);
+    std::vector<std::uint32_t>().swap(m_pixel_index);
+    std::vector<float>().swap(m_pixel_value);
+    std::vector<std::uint8_t>().swap(m_pixel_semantic);
+}
+
+TensorShardReader::TensorShardReader(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("TensorShardReader: cannot open " + path + ": " + errno_message());
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(TensorShardHeader)))
+    {
+        ::close(fd);
+        throw std::runtime_error("TensorShardReader: not a tensor shard: " + path);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    void *mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("TensorShardReader: mmap failed for " + path + ": " + errno_message());
+    m_base = static_cast<const std::uint8_t *>(mapped);
+    m_header = reinterpret_cast<const TensorShardHeader *>(m_base);
+
+    const TensorShardHeader &h = *m_header;
+    const std::uint64_t n_rows = h.n_events * h.n_planes;
+    const std::uint64_t plane = static_cast<std::uint64_t>(h.height) * h.width;
+    bool ok = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+              h.encoding <= 1 && h.n_events <= h.capacity && h.file_size <= m_size &&
+              h.records_offset + h.n_events * sizeof(TensorShardRecord) <= h.file_size;
+    if (ok && h.encoding == 0)
+    {
+        ok = h.image_offset + n_rows * plane * sizeof(float) <= h.file_size &&
+             (!h.has_semantic || h.semantic_offset + n_rows * plane <= h.file_size);
+    }
+    else if (ok)
+    {
+        const auto *offsets = reinterpret_cast<const std::uint64_t *>(m_base + h.pixel_offsets_offset);
+        ok = h.pixel_offsets_offset + (n_rows + 1) * sizeof(std::uint64_t) <= h.file_size &&
+             h.pixel_index_offset + h.n_pixels * sizeof(std::uint32_t) <= h.file_size &&
+             h.image_offset + h.n_pixels * sizeof(float) <= h.file_size &&
+             (!h.has_semantic || h.semantic_offset + h.n_pixels <= h.file_size) &&
+             offsets[n_rows] == h.n_pixels;
+    }
+    if (!ok)
+    {
+        ::munmap(const_cast<std::uint8_t *>(m_base), m_size);
+        throw std::runtime_error("TensorShardReader: corrupt or unsupported shard: " + path);
+    }
+}
+
+TensorShardReader::~TensorShardReader()
+{
+    if (m_base != nullptr)
+        ::munmap(const_cast<std::uint8_t *>(m_base), m_size);
+}
+
+TensorShardReader::TensorShardReader(TensorShardReader &&other) noexcept
+    : m_base(std::exchange(other.m_base, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_header(std::exchange(other.m_header, nullptr))
+{
+}
+
+const TensorShardRecord &TensorShardReader::record(std::uint64_t event) const
+{
+    if (event >= size())
+        throw std::out_of_range("TensorShardReader: event out of range");
+    return reinterpret_cast<const TensorShardRecord *>(m_base + m_header->records_offset)[event];
+}
+
+std::size_t TensorShardReader::dense_index(std::uint64_t event, std::uint32_t plane) const
+{
+    if (sparse())
+        throw std::runtime_error("TensorShardReader: dense access to a sparse shard");
+    if (event >= size() || plane >= m_header->n_planes)
+        throw std::out_of_range("TensorShardReader: event or plane out of range");
+    return static_cast<std::size_t>((event * m_header->n_planes + plane) * plane_size());
+}
+
+const float *TensorShardReader::image(std::uint64_t event, std::uint32_t plane) const
+{
+    const std::size_t idx = dense_index(event, plane);
+    return reinterpret_cast<const float *>(m_base + m_header->image_offset) + idx;
+}
+
+const std::uint8_t *TensorShardReader::semantic(std::uint64_t event, std::uint32_t plane) const
+{
+    const std::size_t idx = dense_index(event, plane);
+    return has_semantic() ? m_base + m_header->semantic_offset + idx : nullptr;
+}
+
+TensorShardReader::SparsePlane TensorShardReader::sparse_plane(std::uint64_t event, std::uint32_t plane) const
+{
+    if (!sparse())
+        throw std::runtime_error("TensorShardReader: sparse access to a dense shard");
+    if (event >= size() || plane >= m_header->n_planes)
+        throw std::out_of_range("TensorShardReader: event or plane out of range");
+
+    const auto *offsets = reinterpret_cast<const std::uint64_t *>(m_base + m_header->pixel_offsets_offset);
+    const std::uint64_t row = event * m_header->n_planes + plane;
+    const std::uint64_t begin = offsets[row];
+
+    SparsePlane out;
+    out.n_pixels = static_cast<std::size_t>(offsets[row + 1] - begin);
+    out.index = reinterpret_cast<const std::uint32_t *>(m_base + m_header->pixel_index_offset) + begin;
+    out.image = reinterpret_cast<const float *>(m_base + m_header->image_offset) + begin;
+    out.semantic = has_semantic() ? m_base + m_header->semantic_offset + begin : nullptr;
+    return out;
+}
+
+void TensorShardReader::decode(std::uint64_t event, std::uint32_t plane, float *image, std::uint8_t *semantic) const
+{
+    const std::size_t n = plane_size();
+    if (!sparse())
+    {
+        std::memcpy(image, this->image(event, plane), n * sizeof(float));
+        if (semantic != nullptr)
+        {
+            const std::uint8_t *labels = this->semantic(event, plane);
+            if (labels != nullptr)
+                std::memcpy(semantic, labels, n);
+            else
+                std::memset(semantic, 0, n);
+        }
+        return;
+    }
+
+    const SparsePlane p = sparse_plane(event, plane);
+    std::fill(image, image + n, 0.f);
+    for (std::size_t k = 0; k < p.n_pixels; ++k)
+        image[p.index[k]] = p.image[k];
+    if (semantic != nullptr)
+    {
+        std::memset(semantic, 0, n);
+        if (p.semantic != nullptr)
+        {
+            for (std::size_t k = 0; k < p.n_pixels; ++k)
+                semantic[p.index[k]] = p.semantic[k];
+        }
+    }
+}
+
+std::vector<std::string> TensorShardReader::find_shards(const std::string &directory)
+{
+    std::vector<std::string> out;
+    for (const auto &entry : std::filesystem::directory_iterator(directory))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == kShardSuffix)
+            out.push_back(entry.path().string());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+}
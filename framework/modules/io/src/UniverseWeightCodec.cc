@@ -0,0 +1,386 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/io/src/UniverseWeightCodec.cc
+ *
+ *  @brief Implementation of the compact universe weight vector codec.
+ */
+
+#include "UniverseWeightCodec.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using Codec = nu::UniverseWeightCodec;
+
+constexpr unsigned kModeZigzag = 0;
+constexpr unsigned kModeRaw = 1;
+constexpr std::size_t kGroup = 8;
+
+struct BlobHeader
+{
+    unsigned mode = kModeZigzag;
+    unsigned width = 0;
+    std::size_t n = 0;
+    std::size_t n_stored = 0;
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    const unsigned char *payload = nullptr;
+};
+
+void put_varint(std::vector<unsigned char> &out, std::uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+std::uint64_t get_varint(const unsigned char *&p, const unsigned char *end)
+{
+    std::uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (p == end)
+            break;
+        const unsigned char b = *p++;
+        v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    throw std::runtime_error("UniverseWeightCodec: truncated or malformed varint");
+}
+
+unsigned bit_width(std::uint32_t v)
+{
+    unsigned w = 0;
+    while (v)
+    {
+        ++w;
+        v >>= 1;
+    }
+    return w;
+}
+
+inline std::uint32_t zigzag(std::int32_t d)
+{
+    return (static_cast<std::uint32_t>(d) << 1) ^ static_cast<std::uint32_t>(d >> 31);
+}
+
+inline std::int32_t unzigzag(std::uint32_t z)
+{
+    return static_cast<std::int32_t>(z >> 1) ^ -static_cast<std::int32_t>(z & 1u);
+}
+
+void pack_plane(const std::uint32_t *vals,
+                std::size_t n_groups,
+                unsigned k,
+                unsigned shift,
+                std::vector<unsigned char> &out)
+{
+    const std::uint64_t mask = (1ULL << k) - 1ULL;
+    for (std::size_t g = 0; g < n_groups; ++g, vals += kGroup)
+    {
+        std::uint64_t acc = 0;
+        for (std::size_t i = 0; i < kGroup; ++i)
+            acc |= ((static_cast<std::uint64_t>(vals[i]) >> shift) & mask) << (i * k);
+        for (unsigned j = 0; j < k; ++j)
+            out.push_back(static_cast<unsigned char>(acc >> (8 * j)));
+    }
+}
+
+// K is a compile-time width so the shifts/masks unroll into straight-line
+// word operations with no per-value branches.
+template <unsigned K>
+void unpack_plane_k(const unsigned char *src, std::size_t n_groups, unsigned shift, std::uint32_t *dst)
+{
+    constexpr std::uint64_t mask = (1ULL << K) - 1ULL;
+    for (std::size_t g = 0; g < n_groups; ++g, src += K, dst += kGroup)
+    {
+        std::uint64_t acc = 0;
+        for (unsigned j = 0; j < K; ++j)
+            acc |= static_cast<std::uint64_t>(src[j]) << (8 * j);
+        for (std::size_t i = 0; i < kGroup; ++i)
+            dst[i] |= static_cast<std::uint32_t>((acc >> (i * K)) & mask) << shift;
+    }
+}
+
+void unpack_plane(const unsigned char *src, std::size_t n_groups, unsigned k, unsigned shift, std::uint32_t *dst)
+{
+    switch (k)
+    {
+    case 1: unpack_plane_k<1>(src, n_groups, shift, dst); break;
+    case 2: unpack_plane_k<2>(src, n_groups, shift, dst); break;
+    case 3: unpack_plane_k<3>(src, n_groups, shift, dst); break;
+    case 4: unpack_plane_k<4>(src, n_groups, shift, dst); break;
+    case 5: unpack_plane_k<5>(src, n_groups, shift, dst); break;
+    case 6: unpack_plane_k<6>(src, n_groups, shift, dst); break;
+    case 7: unpack_plane_k<7>(src, n_groups, shift, dst); break;
+    case 8: unpack_plane_k<8>(src, n_groups, shift, dst); break;
+    default: break;
+    }
+}
+
+BlobHeader parse_header(const unsigned char *blob, std::size_t n_bytes, bool with_runs)
+{
+    if (!blob || n_bytes < 2)
+        throw std::runtime_error("UniverseWeightCodec: blob too short");
+    if (blob[0] != Codec::kFormatVersion)
+        throw std::runtime_error("UniverseWeightCodec: unsupported format version " + std::to_string(blob[0]));
+
+    BlobHeader h;
+    h.mode = blob[1] >> 5;
+    h.width = blob[1] & 0x1f;
+    if (h.mode > kModeRaw || h.width > 16)
+        throw std::runtime_error("UniverseWeightCodec: corrupt blob header");
+
+    const unsigned char *p = blob + 2;
+    const unsigned char *end = blob + n_bytes;
+    h.n = static_cast<std::size_t>(get_varint(p, end));
+    if (!with_runs)
+        return h;
+
+    const std::size_t n_runs = static_cast<std::size_t>(get_varint(p, end));
+    if (n_runs > h.n)
+        throw std::runtime_error("UniverseWeightCodec: corrupt unity-run table");
+    h.runs.reserve(n_runs);
+
+    std::size_t pos = 0;
+    std::size_t n_unity = 0;
+    for (std::size_t r = 0; r < n_runs; ++r)
+    {
+        const std::size_t start = pos + static_cast<std::size_t>(get_varint(p, end));
+        const std::size_t len = static_cast<std::size_t>(get_varint(p, end));
+        if (start < pos || len > h.n || start > h.n - len)
+            throw std::runtime_error("UniverseWeightCodec: unity run out of range");
+        h.runs.emplace_back(start, len);
+        pos = start + len;
+        n_unity += len;
+    }
+
+    h.n_stored = h.n - n_unity;
+    const std::size_t n_groups = (h.n_stored + kGroup - 1) / kGroup;
+    if (static_cast<std::size_t>(end - p) < n_groups * h.width)
+        throw std::runtime_error("UniverseWeightCodec: truncated value planes");
+    h.payload = p;
+    return h;
+}
+
+} // namespace
+
+namespace nu
+{
+
+std::string UniverseWeightCodec::encoded_column(const std::string &column)
+{
+    return column + kEncodedSuffix;
+}
+
+std::string UniverseWeightCodec::plain_column(const std::string &column)
+{
+    const std::string suffix = kEncodedSuffix;
+    if (column.size() <= suffix.size() ||
+        column.compare(column.size() - suffix.size(), suffix.size(), suffix) != 0)
+        return {};
+    return column.substr(0, column.size() - suffix.size());
+}
+
+std::string UniverseWeightCodec::format_columns(const std::vector<std::string> &encoded)
+{
+    std::string out;
+    for (const auto &column : encoded)
+        out += column + "\n";
+    return out;
+}
+
+std::vector<std::string> UniverseWeightCodec::parse_columns(const std::string &recorded)
+{
+    std::vector<std::string> out;
+    std::size_t begin = 0;
+    while (begin < recorded.size())
+    {
+        std::size_t end = recorded.find('\n', begin);
+        if (end == std::string::npos)
+            end = recorded.size();
+        if (end > begin)
+            out.push_back(recorded.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return out;
+}
+
+void UniverseWeightCodec::encode(const unsigned short *values, std::size_t n, std::vector<unsigned char> &out)
+{
+    out.clear();
+
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    std::vector<std::uint32_t> stored;
+    stored.reserve(n + kGroup);
+
+    std::uint32_t max_zigzag = 0;
+    std::uint32_t max_raw = 0;
+    for (std::size_t i = 0; i < n;)
+    {
+        if (values[i] == kUnity)
+        {
+            std::size_t j = i;
+            while (j < n && values[j] == kUnity)
+                ++j;
+            if (j - i >= kMinUnityRun)
+            {
+                runs.emplace_back(i, j - i);
+                i = j;
+                continue;
+            }
+        }
+        const std::uint32_t raw = values[i];
+        max_raw = std::max(max_raw, raw);
+        max_zigzag = std::max(max_zigzag, zigzag(static_cast<std::int32_t>(raw) - kUnity));
+        stored.push_back(raw);
+        ++i;
+    }
+
+    // Residuals about unity fit 16 bits unless a weight exceeds ~33.8; fall back to raw values then.
+    const unsigned mode = (max_zigzag > 0xFFFFu) ? kModeRaw : kModeZigzag;
+    if (mode == kModeZigzag)
+    {
+        for (auto &v : stored)
+            v = zigzag(static_cast<std::int32_t>(v) - kUnity);
+    }
+    const unsigned width = bit_width(mode == kModeRaw ? max_raw : max_zigzag);
+
+    const std::size_t n_stored = stored.size();
+    const std::size_t n_groups = (n_stored + kGroup - 1) / kGroup;
+    stored.resize(n_groups * kGroup, 0u);
+
+    out.reserve(8 + 4 * runs.size() + n_groups * width);
+    out.push_back(kFormatVersion);
+    out.push_back(static_cast<unsigned char>((mode << 5) | width));
+    put_varint(out, n);
+    put_varint(out, runs.size());
+    std::size_t pos = 0;
+    for (const auto &run : runs)
+    {
+        put_varint(out, run.first - pos);
+        put_varint(out, run.second);
+        pos = run.first + run.second;
+    }
+
+    if (width <= 8)
+    {
+        if (width > 0)
+            pack_plane(stored.data(), n_groups, width, 0, out);
+    }
+    else
+    {
+        pack_plane(stored.data(), n_groups, 8, 0, out);
+        pack_plane(stored.data(), n_groups, width - 8, 8, out);
+    }
+}
+
+ROOT::RVec<unsigned char> UniverseWeightCodec::encode(const ROOT::RVec<unsigned short> &values)
+{
+    std::vector<unsigned char> blob;
+    encode(values.data(), values.size(), blob);
+    return ROOT::RVec<unsigned char>(blob.begin(), blob.end());
+}
+
+std::size_t UniverseWeightCodec::decoded_size(const unsigned char *blob, std::size_t n_bytes)
+{
+    if (n_bytes == 0)
+        return 0;
+    return parse_header(blob, n_bytes, false).n;
+}
+
+std::size_t UniverseWeightCodec::decode(const unsigned char *blob,
+                                        std::size_t n_bytes,
+                                        unsigned short *out,
+                                        std::size_t capacity)
+{
+    if (n_bytes == 0)
+        return 0;
+
+    const BlobHeader h = parse_header(blob, n_bytes, true);
+    if (h.n > capacity)
+        throw std::runtime_error("UniverseWeightCodec: output buffer too small");
+
+    const std::size_t n_groups = (h.n_stored + kGroup - 1) / kGroup;
+    thread_local std::vector<std::uint32_t> scratch;
+    scratch.assign(n_groups * kGroup, 0u);
+
+    if (h.width <= 8)
+    {
+        unpack_plane(h.payload, n_groups, h.width, 0, scratch.data());
+    }
+    else
+    {
+        unpack_plane(h.payload, n_groups, 8, 0, scratch.data());
+        unpack_plane(h.payload + n_groups * 8, n_groups, h.width - 8, 8, scratch.data());
+    }
+
+    if (h.mode == kModeZigzag)
+    {
+        for (std::size_t i = 0; i < h.n_stored; ++i)
+            scratch[i] = static_cast<std::uint32_t>(unzigzag(scratch[i]) + kUnity);
+    }
+
+    const std::uint32_t *src = scratch.data();
+    std::size_t pos = 0;
+    for (const auto &run : h.runs)
+    {
+        for (; pos < run.first; ++pos)
+            out[pos] = static_cast<unsigned short>(*src++);
+        std::fill(out + pos, out + pos + run.second, kUnity);
+        pos += run.second;
+    }
+    for (; pos < h.n; ++pos)
+        out[pos] = static_cast<unsigned short>(*src++);
+
+    return h.n;
+}
+
+ROOT::RVec<unsigned short> UniverseWeightCodec::decode(const ROOT::RVec<unsigned char> &blob)
+{
+    ROOT::RVec<unsigned short> out(decoded_size(blob.data(), blob.size()));
+    decode(blob.data(), blob.size(), out.data(), out.size());
+    return out;
+}
+
+ROOT::RDF::RNode UniverseWeightCodec::define_encoded(ROOT::RDF::RNode node, const std::vector<std::string> &columns)
+{
+    const auto names = node.GetColumnNames();
+    for (const auto &column : columns)
+    {
+        if (std::find(names.begin(), names.end(), column) == names.end())
+            continue;
+        node = node.Define(encoded_column(column),
+                           [](const ROOT::RVec<unsigned short> &v) { return encode(v); },
+                           {column});
+    }
+    return node;
+}
+
+ROOT::RDF::RNode UniverseWeightCodec::define_decoded(ROOT::RDF::RNode node, const std::vector<std::string> &encoded)
+{
+    const auto names = node.GetColumnNames();
+    for (const auto &name : encoded)
+    {
+        const std::string plain = plain_column(name);
+        if (plain.empty() || std::find(names.begin(), names.end(), name) == names.end() ||
+            std::find(names.begin(), names.end(), plain) != names.end())
+            continue;
+        node = node.Define(plain,
+                           [](const ROOT::RVec<unsigned char> &blob) { return decode(blob); },
+                           {name});
+    }
+    return node;
+}
+
+}
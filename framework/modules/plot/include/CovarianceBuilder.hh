@@ -0,0 +1,112 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/CovarianceBuilder.hh
+ *
+ *  @brief Streaming (Welford-style) covariance accumulator over systematic
+ *         universes, optionally joint across several variables or channels.
+ */
+
+#ifndef HERON_PLOT_COVARIANCE_BUILDER_H
+#define HERON_PLOT_COVARIANCE_BUILDER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <TMatrixDSym.h>
+
+#include "PlotDescriptors.hh"
+
+
+namespace nu
+{
+
+class UniverseHist;
+
+/**
+ *  @brief Accumulates mean and covariance of per-universe bin contents one
+ *         universe at a time, using O(bins^2) memory independent of the
+ *         number of universes.
+ *
+ *  Several blocks (variables, channels, ...) may be declared to build a joint
+ *  block covariance; a universe is then the concatenation of all blocks.
+ */
+class CovarianceBuilder
+{
+  public:
+    enum class Reference
+    {
+        kMean,         ///< spread about the universe mean
+        kCentralValue  ///< spread about the central value (requires set_central_value)
+    };
+
+    CovarianceBuilder() = default;
+    explicit CovarianceBuilder(int n_bins);
+
+    /// Declare a block; returns its offset in the joint bin vector.
+    int add_block(const std::string &name, int n_bins);
+
+    int n_bins() const noexcept { return n_bins_; }
+    long long n_universes() const noexcept { return n_; }
+    int block_offset(const std::string &name) const;
+
+    /// Central-value contents of the joint bin vector (used for kCentralValue and fractional output).
+    void set_central_value(const std::vector<double> &cv);
+    void set_central_value(const std::string &block, const std::vector<double> &cv);
+
+    /// Add one universe given as the full joint bin vector.
+    void add_universe(const std::vector<double> &values);
+    void add_universe(const double *values, std::size_t n);
+
+    /// Add every universe of a UniverseHist (visible bins only) as a single-block builder.
+    void add(const UniverseHist &hist);
+
+    /// Add universes jointly from one UniverseHist per declared block (same universe count).
+    void add(const std::vector<const UniverseHist *> &blocks);
+
+    /// Merge the statistics of another builder over a disjoint set of universes.
+    void merge(const CovarianceBuilder &other);
+
+    const std::vector<double> &mean() const noexcept { return mean_; }
+    const std::vector<double> &central_value() const noexcept { return cv_; }
+
+    /// Covariance; divides by N (universe average) or N - 1 when @p unbiased.
+    TMatrixDSym covariance(Reference ref = Reference::kCentralValue, bool unbiased = false) const;
+    TMatrixDSym fractional_covariance(Reference ref = Reference::kCentralValue, bool unbiased = false) const;
+
+    /// Sub-block of the joint covariance.
+    TMatrixDSym block_covariance(const std::string &block,
+                                 Reference ref = Reference::kCentralValue,
+                                 bool unbiased = false) const;
+
+    /// Set Options::total_cov to a new matrix holding its previous value (if any)
+    /// plus this covariance; a matrix shared with other Options is left untouched.
+    void apply_to(Options &opt, Reference ref = Reference::kCentralValue, bool unbiased = false) const;
+
+  private:
+    struct Block
+    {
+        std::string name;
+        int offset = 0;
+        int n_bins = 0;
+    };
+
+    void resize(int n_bins);
+    const Block &find_block(const std::string &name) const;
+    double cell(int i, int j, Reference ref, bool unbiased) const;
+
+    int n_bins_ = 0;
+    long long n_ = 0;
+    std::vector<Block> blocks_;
+    std::vector<double> mean_;
+    std::vector<double> cv_;
+    // Packed lower triangle of the centred second moment (row-major, i >= j).
+    std::vector<double> m2_;
+    std::vector<double> delta_;
+};
+
+} // namespace nu
+
+
+#endif // HERON_PLOT_COVARIANCE_BUILDER_H
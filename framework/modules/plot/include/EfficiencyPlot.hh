@@ -15,6 +15,7 @@
 #include <vector>
 
 #include <ROOT/RDataFrame.hxx>
+#include <ROOT/RDFHelpers.hxx>
 #include <TEfficiency.h>
 #include <TGraphAsymmErrors.h>
 #include <TH1D.h>
@@ -84,6 +85,30 @@ class EfficiencyPlot
                 const std::string &pass_sel,
                 const std::string &extra_sel = "true");
 
+    /**
+     *  Book the counts and histograms on the given nodes without running the
+     *  event loop; run the returned handles (e.g. with RunGraphs, together with
+     *  any other actions) and then call finalise(). With auto_x_range each
+     *  slot keeps a fixed-size summary (the first values exactly, then a fine
+     *  power-of-two grid that coarsens as the range grows), binned once the
+     *  loop has seen the full range, so the range costs no extra pass.
+     */
+    std::vector<ROOT::RDF::RResultHandle> book(ROOT::RDF::RNode denom_node, ROOT::RDF::RNode pass_node);
+
+    /// Build the histograms and efficiency graph from the booked results.
+    int finalise();
+
+    /// Book every plot on the same nodes and fill them all in one event loop.
+    static int compute_all(std::vector<EfficiencyPlot> &plots,
+                           ROOT::RDF::RNode denom_node,
+                           ROOT::RDF::RNode pass_node);
+
+    static int compute_all(std::vector<EfficiencyPlot> &plots,
+                           ROOT::RDF::RNode base,
+                           const std::string &denom_sel,
+                           const std::string &pass_sel,
+                           const std::string &extra_sel = "true");
+
     int draw_and_save(const std::string &file_stem,
                       const std::string &format = "") const;
 
@@ -110,6 +135,9 @@ class EfficiencyPlot
 
     bool ready_ = false;
 
+    struct Booked;
+    std::shared_ptr<Booked> booked_;
+
     static std::string sanitise_(const std::string &s);
 };
 
@@ -0,0 +1,127 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/QuantileSketch.hh
+ *
+ *  @brief Mergeable weighted quantile sketch (merging t-digest) with an
+ *         RDataFrame action, for quantiles and robust ranges taken from
+ *         the same pass that fills the plots.
+ */
+
+#ifndef HERON_PLOT_QUANTILE_SKETCH_H
+#define HERON_PLOT_QUANTILE_SKETCH_H
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+
+
+namespace nu
+{
+
+/**
+ *  @brief Weighted quantile summary of a stream of values.
+ *
+ *  Values are buffered and periodically merged into at most ~compression
+ *  centroids, sized by the arcsine scale function so that the tails keep
+ *  single values while the bulk is summarised coarsely; quantile errors are
+ *  therefore smallest near q = 0 and q = 1. Sketches from different threads
+ *  or files merge into one without loss beyond their own resolution. The
+ *  exact minimum and maximum are kept. Non-finite values and zero or
+ *  non-finite weights are counted in entries() but not summarised; a negative
+ *  weight throws, since a quantile of a signed measure is not defined.
+ */
+class QuantileSketch
+{
+  public:
+    explicit QuantileSketch(double compression = 200.0);
+
+    void add(double x, double w = 1.0);
+    void merge(const QuantileSketch &other);
+
+    /// Weighted q-quantile (q in [0, 1]); NaN for an empty sketch.
+    double quantile(double q) const;
+    /// Weighted fraction of values <= x.
+    double cdf(double x) const;
+
+    /// [quantile(q_lo), quantile(q_hi)], widened by @p pad_fraction of its span.
+    std::pair<double, double> robust_range(double q_lo, double q_hi, double pad_fraction = 0.0) const;
+
+    double min() const noexcept { return min_; }
+    double max() const noexcept { return max_; }
+    double total_weight() const noexcept { return total_weight_ + buffer_weight_; }
+    ULong64_t entries() const noexcept { return entries_; }
+    bool empty() const noexcept { return centroids_.empty() && buffer_.empty(); }
+
+    /// Number of centroids after merging the buffer.
+    std::size_t size() const;
+
+  private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    /// Fold the buffer into the centroids. Logically const: queries flush first.
+    void compress() const;
+
+    double compression_;
+    mutable std::vector<Centroid> centroids_;
+    mutable std::vector<Centroid> buffer_;
+    mutable double total_weight_ = 0.0;
+    mutable double buffer_weight_ = 0.0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    ULong64_t entries_ = 0;
+};
+
+/**
+ *  @brief RDataFrame action filling one QuantileSketch per slot and merging
+ *         them in Finalize(). Columns: value (double), weight (double).
+ */
+class QuantileSketchHelper : public ROOT::Detail::RDF::RActionImpl<QuantileSketchHelper>
+{
+  public:
+    using Result_t = QuantileSketch;
+
+    QuantileSketchHelper(double compression, unsigned int n_slots);
+
+    QuantileSketchHelper(QuantileSketchHelper &&) = default;
+    QuantileSketchHelper(const QuantileSketchHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, double x, double w) { slots_[slot].add(x, w); }
+
+    void Finalize();
+
+    std::string GetActionName() const { return "QuantileSketch"; }
+
+  private:
+    std::shared_ptr<Result_t> result_;
+    std::vector<QuantileSketch> slots_;
+};
+
+/**
+ *  @brief Book a lazy weighted sketch of @p expr (empty @p weight => unit
+ *         weights). Book it next to the histograms it is meant to bin and run
+ *         them together with RunGraphs. The event loop throws on a negative
+ *         weight; yields that must include them belong in a histogram.
+ */
+ROOT::RDF::RResultPtr<QuantileSketch> book_quantile_sketch(ROOT::RDF::RNode node,
+                                                           const std::string &expr,
+                                                           const std::string &weight = "",
+                                                           double compression = 200.0);
+
+} // namespace nu
+
+
+#endif // HERON_PLOT_QUANTILE_SKETCH_H
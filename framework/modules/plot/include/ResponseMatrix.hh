@@ -0,0 +1,222 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/ResponseMatrix.hh
+ *
+ *  @brief Single-pass truth x reco x universe response matrices with sparse
+ *         cell storage, for unfolding and forward folding.
+ */
+
+#ifndef HERON_PLOT_RESPONSE_MATRIX_H
+#define HERON_PLOT_RESPONSE_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+#include <TH2D.h>
+#include <TMatrixD.h>
+
+#include "CovarianceBuilder.hh"
+
+class TemplateBinningBlock;
+
+
+namespace nu
+{
+
+/**
+ *  @brief Flat bin numbering of a TemplateBinningBlock: x bins for a 1D
+ *         block, (x, y) cells x-major for a 2D block.
+ */
+class BlockBinning
+{
+  public:
+    BlockBinning() = default;
+    explicit BlockBinning(const TemplateBinningBlock &block);
+
+    int n_bins() const noexcept { return n_bins_; }
+    bool is_2d() const noexcept { return !y_edges_.empty(); }
+
+    /// Flat index of (x, y), or -1 outside the block (y ignored for 1D blocks).
+    int find(double x, double y = 0.0) const;
+
+  private:
+    std::vector<double> x_edges_;
+    std::vector<std::vector<double>> y_edges_;
+    std::vector<int> offsets_;
+    int n_bins_ = 0;
+};
+
+/**
+ *  @brief Nominal + N-universe joint truth/reco yields.
+ *
+ *  Truth index t runs over the truth block bins, with t = n_truth() for
+ *  events outside the truth definition (background). Reco index r runs over
+ *  the reco block bins, with r = n_reco() for events that are not selected
+ *  (inefficiency). Only occupied cells are stored, each as one contiguous
+ *  row of {sumw, sumw2, universe 0..N-1}.
+ */
+class ResponseMatrix
+{
+  public:
+    ResponseMatrix() = default;
+    ResponseMatrix(std::string name, int n_truth, int n_reco, int n_universes);
+
+    const std::string &name() const noexcept { return name_; }
+    int n_truth() const noexcept { return n_truth_; }
+    int n_reco() const noexcept { return n_reco_; }
+    int n_universes() const noexcept { return n_universes_; }
+
+    /// Number of occupied cells, including background and inefficiency cells.
+    std::size_t n_cells() const noexcept { return keys_.size(); }
+
+    /// Weighted yield of cell (t, r) in universe @p u (u < 0 => nominal).
+    double get(int truth, int reco, int u = -1) const;
+    double sumw2(int truth, int reco) const;
+
+    /// Per truth bin, selected or not (signal only).
+    std::vector<double> truth_totals(int u = -1) const;
+    /// Per reco bin, signal and background.
+    std::vector<double> reco_totals(int u = -1) const;
+    /// Per reco bin, events outside the truth definition.
+    std::vector<double> background(int u = -1) const;
+    /// Per truth bin, fraction selected in any reco bin.
+    std::vector<double> efficiency(int u = -1) const;
+
+    /**
+     *  Smearing matrix S(r, t) = P(selected in reco bin r | truth bin t),
+     *  n_reco x n_truth; columns sum to the efficiency. Forward folding is
+     *  reco_signal = S * truth.
+     */
+    TMatrixD smearing(int u = -1) const;
+
+    /// Joint yields with truth on x (last bin = background) and reco on y (last bin = not selected).
+    std::unique_ptr<TH2D> joint_hist(int u = -1, const std::string &hist_name = "") const;
+
+    /// Occupied signal cells (t < n_truth, r < n_reco) in (t, r) order.
+    std::vector<std::pair<int, int>> smearing_cells() const;
+
+    /**
+     *  Universe covariance with blocks "smearing" (the smearing_cells()
+     *  elements of S), "efficiency" and "background"; the central value is
+     *  the nominal. Empty blocks are omitted.
+     */
+    CovarianceBuilder covariance() const;
+
+    /// Sum a compatible matrix (same shape and universe count) into this one.
+    void add(const ResponseMatrix &other);
+
+  private:
+    friend class ResponseMatrixHelper;
+
+    std::size_t stride() const noexcept { return 2 + static_cast<std::size_t>(n_universes_); }
+    std::uint64_t key(int truth, int reco) const;
+    const double *find_row(int truth, int reco) const;
+    double *row(std::uint64_t key);
+    /// Grow to @p n_universes, crediting new universes with each cell's nominal sum.
+    void widen(int n_universes);
+
+    std::string name_;
+    int n_truth_ = 0;
+    int n_reco_ = 0;
+    int n_universes_ = 0;
+
+    std::unordered_map<std::uint64_t, std::size_t> index_;
+    std::vector<std::uint64_t> keys_;
+    std::vector<double> rows_;
+};
+
+/**
+ *  @brief RDataFrame action filling a ResponseMatrix in one event loop.
+ *
+ *  Columns: truth bin (int, -1 => background), reco bin (int, -1 => not
+ *  selected), weight (double) and, with universes, the packed universe
+ *  vector and CV factor as for UniverseFillHelper (including sizing by the
+ *  longest vector when n_universes <= 0). Each slot keeps its own sparse
+ *  matrix; they are summed in Finalize().
+ */
+class ResponseMatrixHelper : public ROOT::Detail::RDF::RActionImpl<ResponseMatrixHelper>
+{
+  public:
+    using Result_t = ResponseMatrix;
+
+    ResponseMatrixHelper(std::string name, int n_truth, int n_reco, int n_universes, unsigned int n_slots);
+
+    ResponseMatrixHelper(ResponseMatrixHelper &&) = default;
+    ResponseMatrixHelper(const ResponseMatrixHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, int truth, int reco, double w);
+    void Exec(unsigned int slot,
+              int truth,
+              int reco,
+              double w,
+              const ROOT::RVec<unsigned short> &packed,
+              double cv);
+    void Exec(unsigned int slot,
+              int truth,
+              int reco,
+              double w,
+              const ROOT::RVec<unsigned char> &encoded,
+              double cv);
+
+    void Finalize();
+
+    std::string GetActionName() const { return "ResponseMatrix"; }
+
+  private:
+    void fill(unsigned int slot,
+              int truth,
+              int reco,
+              double w,
+              const unsigned short *packed,
+              std::size_t n_packed,
+              double cv);
+
+    std::shared_ptr<Result_t> result_;
+    bool sized_by_data_ = false;
+    std::vector<ResponseMatrix> slot_matrices_;
+    std::vector<std::vector<unsigned short>> slot_decoded_;
+};
+
+struct ResponseMatrixSpec
+{
+    std::string name;
+    /// Truth-axis expressions; truth_y only for a 2D truth block. The truth
+    /// block's selection defines the signal (empty => every event).
+    std::string truth_x;
+    std::string truth_y;
+    /// Reco-axis expressions; the reco block's selection defines "selected".
+    std::string reco_x;
+    std::string reco_y;
+    std::string weight = "w_nominal";
+    /// Optional universes, as in UniverseHistSpec; empty => nominal only.
+    std::string universe_column;
+    std::string cv_column;
+    int n_universes = -1;
+};
+
+/**
+ *  @brief Book a lazy response matrix binned by @p truth and @p reco.
+ *         Matrices for several universe sets (GENIE, PPFX, ...) booked on the
+ *         same RDataFrame run in one loop with RunGraphs.
+ */
+ROOT::RDF::RResultPtr<ResponseMatrix> book_response_matrix(ROOT::RDF::RNode node,
+                                                           const TemplateBinningBlock &truth,
+                                                           const TemplateBinningBlock &reco,
+                                                           const ResponseMatrixSpec &spec);
+
+} // namespace nu
+
+
+#endif // HERON_PLOT_RESPONSE_MATRIX_H
@@ -21,6 +21,13 @@ class TemplateBinningBlock : public TNamed
                          const std::vector<double> &edges,
                          const std::string &selection,
                          int bin_type);
+    /// 2D block: x edges and, for every x bin, its own y edges.
+    TemplateBinningBlock(const std::string &name,
+                         const std::string &title,
+                         const std::vector<double> &x_edges,
+                         const std::vector<std::vector<double>> &y_edges,
+                         const std::string &selection,
+                         int bin_type);
     virtual ~TemplateBinningBlock() = default;
 
     int GetNBinsX() const;
@@ -75,10 +82,12 @@ class TemplateBinningBlock : public TNamed
     std::string m_name;
     std::string m_title;
     std::vector<double> m_edges;
+    std::vector<std::vector<double>> m_y_edges;
     std::string m_selection;
     int m_bin_type = 0;
 
     std::vector<std::string> m_bin_def;
+    std::vector<std::vector<std::string>> m_bin_def_y;
 
     std::string m_x_name;
     std::string m_x_name_unit;
@@ -32,6 +32,19 @@ class TemplateBinningBlock;
 class TemplateBinningOptimizer1D final
 {
   public:
+    /// Merge search used by optimise().
+    enum class Strategy
+    {
+        /// Re-score every adjacent merge with a full inversion per iteration.
+        kExhaustive,
+        /// Keep the POI covariance current with low-rank (Woodbury) updates and
+        /// a priority queue of merge costs (see Config::rescore_interval).
+        kIncremental,
+        /// Dynamic programming over fine-bin boundaries; exact for the
+        /// unprofiled objective, bounded for the profiled one (see Result).
+        kDynamicProgramming
+    };
+
     struct Parameter
     {
         std::string name;
@@ -77,6 +90,29 @@ class TemplateBinningOptimizer1D final
         /// Optional small preference against wide bins (tie-breaker).
         double width_penalty = 0.0;
 
+        /// Search strategy and worker threads for candidate scoring (0 => all cores).
+        Strategy strategy = Strategy::kExhaustive;
+        int n_threads = 0;
+
+        /// kIncremental: 0 re-scores only the neighbours of each merge (other
+        /// stale costs when they reach the top of the queue), which is fastest
+        /// but can settle on slightly different edges. N > 0 also re-scores
+        /// every queued merge each N merges; 1 reproduces the kExhaustive choices.
+        int rescore_interval = 0;
+
+        /// kDynamicProgramming: longest range of fine bins in one output bin
+        /// and passes re-deriving the profiled direction. 0 => unlimited, which
+        /// costs O(n^2) time and memory in the fine bins and is refused above
+        /// 2048 of them. width_penalty is not used by this strategy.
+        int dp_max_fine_per_bin = 0;
+        int dp_iterations = 4;
+
+        /// Event input: candidate edges at this many |weight| quantiles of the
+        /// pooled events (0 => at every distinct value). Greedy strategies
+        /// can snowball on very fine grids; prefer kDynamicProgramming there,
+        /// with dp_max_fine_per_bin set.
+        int n_event_quantiles = 200;
+
         /// Diagnostics.
         bool verbose = false;
         std::ostream *p_log = nullptr;
@@ -97,6 +133,9 @@ class TemplateBinningOptimizer1D final
     {
         std::vector<double> edges;
         double expected_sigma_poi = std::numeric_limits<double>::infinity();
+        /// kDynamicProgramming: no binning satisfying the constraints reaches a
+        /// smaller sigma than this (0 for the greedy strategies).
+        double sigma_poi_lower_bound = 0.0;
         std::vector<BinReport> bins;
 
         std::shared_ptr<TemplateBinningBlock> make_block(const std::string &name,
@@ -105,6 +144,41 @@ class TemplateBinningOptimizer1D final
                                                          int bin_type = 1) const;
     };
 
+    /**
+     *  Fine expectations in the optimiser's own layout, for inputs that are not
+     *  TH1s. n_fine = edges.size() - 1; mu/var are [c * n_fine + i] and dmu is
+     *  [(c * n_parameter + p) * n_fine + i] with one derivative per parameter.
+     */
+    struct FineTemplates
+    {
+        std::vector<double> edges;
+        std::vector<std::string> parameter_names;
+        std::vector<double> prior_sigmas;
+        int poi_index = 0;
+        int n_channel = 0;
+
+        std::vector<double> mu;
+        std::vector<double> var;
+        std::vector<double> dmu;
+    };
+
+    /// Event-level inputs, e.g. columns taken straight from the event list.
+    struct EventParameter
+    {
+        std::string name;
+        double prior_sigma = 0.0;
+        bool is_poi = false;
+    };
+
+    struct EventChannel
+    {
+        std::string name;
+        std::vector<double> value;
+        std::vector<double> weight;
+        /// d weight / d parameter per event, one vector per EventParameter.
+        std::vector<std::vector<double>> dweight;
+    };
+
     explicit TemplateBinningOptimizer1D(Config cfg);
 
     /// Optimise using a single channel.
@@ -113,6 +187,19 @@ class TemplateBinningOptimizer1D final
     /// Optimise using multiple channels and return shared edges.
     Result optimise(const std::vector<Channel> &channels) const;
 
+    /// Optimise pre-tabulated fine templates.
+    Result optimise(const FineTemplates &templates) const;
+
+    /// Objective for @p templates binned as given (no merging).
+    double expected_sigma_poi(const FineTemplates &templates) const;
+
+    /// Optimise weighted events; candidate edges sit on event quantiles.
+    Result optimise(const std::vector<EventChannel> &channels, const std::vector<EventParameter> &parameters) const;
+
+    /// Fine templates between the event-quantile candidate edges.
+    FineTemplates tabulate_events(const std::vector<EventChannel> &channels,
+                                  const std::vector<EventParameter> &parameters) const;
+
   private:
     Config m_cfg;
 };
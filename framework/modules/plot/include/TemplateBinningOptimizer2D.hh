@@ -0,0 +1,76 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/TemplateBinningOptimizer2D.hh
+ *
+ *  @brief Recursive slice partitioning of 2D reco-space templates into a
+ *         block binning (x bins, each with its own y edges).
+ */
+
+#ifndef HERON_PLOT_TEMPLATE_BINNING_OPTIMIZER_2D_H
+#define HERON_PLOT_TEMPLATE_BINNING_OPTIMIZER_2D_H
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TemplateBinningOptimizer1D.hh"
+
+class TemplateBinningBlock;
+
+/**
+ *  @brief Template-based 2D block binning optimiser.
+ *
+ *  The fine TH2 templates are projected onto x and partitioned with the 1D
+ *  optimiser; every resulting x slice is then projected onto y and
+ *  partitioned on its own (slices run in parallel). Objective, constraints and
+ *  strategy are those of TemplateBinningOptimizer1D, so every output block
+ *  bin satisfies mu_min/rel_mc_max whenever its slice can.
+ */
+class TemplateBinningOptimizer2D final
+{
+  public:
+    /// As for 1D, with TH2 nominal/derivative/up/down histograms.
+    using Parameter = TemplateBinningOptimizer1D::Parameter;
+    using Channel = TemplateBinningOptimizer1D::Channel;
+
+    struct Config
+    {
+        /// Objective, constraints and search strategy for every 1D partition.
+        TemplateBinningOptimizer1D::Config base;
+
+        /// Bin limits along x and per x slice along y (<= 0 => unlimited).
+        int max_bins_x = -1;
+        int max_bins_y = -1;
+
+        /// Slices optimised concurrently (0 => hardware concurrency).
+        int n_threads = 0;
+    };
+
+    struct Result
+    {
+        std::vector<double> x_edges;
+        /// y edges for each x bin.
+        std::vector<std::vector<double>> y_edges;
+        /// Objective over all block bins together.
+        double expected_sigma_poi = std::numeric_limits<double>::infinity();
+
+        TemplateBinningOptimizer1D::Result x_partition;
+        std::vector<TemplateBinningOptimizer1D::Result> slices;
+
+        std::shared_ptr<TemplateBinningBlock> make_block(const std::string &name,
+                                                         const std::string &title,
+                                                         const std::string &selection = "",
+                                                         int bin_type = 2) const;
+    };
+
+    explicit TemplateBinningOptimizer2D(Config cfg);
+
+    Result optimise(const Channel &channel) const;
+    Result optimise(const std::vector<Channel> &channels) const;
+
+  private:
+    Config m_cfg;
+};
+
+#endif // HERON_PLOT_TEMPLATE_BINNING_OPTIMIZER_2D_H
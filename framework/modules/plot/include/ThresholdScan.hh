@@ -0,0 +1,264 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/ThresholdScan.hh
+ *
+ *  @brief One-pass score threshold scan: efficiency, purity, background
+ *         rejection and ROC for arbitrary cut values from prefix sums.
+ */
+
+#ifndef HERON_PLOT_THRESHOLD_SCAN_H
+#define HERON_PLOT_THRESHOLD_SCAN_H
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+
+
+namespace nu
+{
+
+struct ThresholdCount
+{
+    double sumw = 0.0;
+    double sumw2 = 0.0;
+    ULong64_t raw = 0;
+};
+
+/**
+ *  @brief Weighted/w^2/raw score distributions per (channel, signal flag),
+ *         answered as "score >= threshold" tail sums.
+ *
+ *  In binned mode the score axis is a fine grid of cut edges; a threshold is
+ *  resolved to the first edge at or above it (edges().front() for one below
+ *  the grid), so queries are exact on the grid. In unbinned mode every
+ *  distinct score becomes an edge and every query is exact. Events with
+ *  non-finite scores are kept in a cell of their own: they count in the
+ *  totals but never pass a cut.
+ */
+class ThresholdScan
+{
+  public:
+    enum class Class
+    {
+        kSignal,
+        kBackground,
+        kAll
+    };
+
+    /// Envelope and RMS of a metric across universes, about its nominal value.
+    struct Band
+    {
+        double nominal = 0.0;
+        double lo = 0.0;
+        double hi = 0.0;
+        double rms = 0.0;
+    };
+
+    struct Point
+    {
+        double threshold = 0.0;
+        double efficiency = 0.0;
+        double efficiency_err = 0.0;
+        double purity = 0.0;
+        double purity_err = 0.0;
+        double rejection = 0.0;
+        double rejection_err = 0.0;
+    };
+
+    static constexpr int kAllChannels = std::numeric_limits<int>::min();
+
+    ThresholdScan() = default;
+    ThresholdScan(std::string name, std::vector<double> edges, std::vector<int> channels, int n_universes = 0);
+
+    /// Evenly spaced cut grid (n points from lo to hi inclusive).
+    static std::vector<double> uniform_grid(int n, double lo, double hi);
+
+    const std::string &name() const noexcept { return name_; }
+    const std::vector<double> &edges() const noexcept { return edges_; }
+    const std::vector<int> &channels() const noexcept { return channels_; }
+    int n_universes() const noexcept { return n_universes_; }
+
+    /// Totals over all scores (including those below the grid).
+    ThresholdCount total(Class cls = Class::kAll, int channel = kAllChannels) const;
+    ThresholdCount pass(double threshold, Class cls = Class::kAll, int channel = kAllChannels) const;
+
+    /// Weighted signal efficiency S_pass / S_total and its sumw2 uncertainty.
+    double efficiency(double threshold) const;
+    double efficiency_error(double threshold) const;
+
+    /// Weighted purity S_pass / (S_pass + B_pass).
+    double purity(double threshold) const;
+    double purity_error(double threshold) const;
+
+    /// 1 - pass/total for @p cls (background by default), optionally in one channel.
+    double rejection(double threshold, Class cls = Class::kBackground, int channel = kAllChannels) const;
+    double rejection_error(double threshold, Class cls = Class::kBackground, int channel = kAllChannels) const;
+
+    /// Efficiency/purity/rejection at each threshold; rejection uses @p channel (all classes) if given.
+    std::vector<Point> scan(const std::vector<double> &thresholds, int channel = kAllChannels) const;
+
+    /// Universe spread of efficiency/purity (requires universes at booking).
+    Band efficiency_band(double threshold) const;
+    Band purity_band(double threshold) const;
+
+    /// Sum a compatible scan (same edges, channels, universes) into this one.
+    void add(const ThresholdScan &other);
+
+  private:
+    friend class ThresholdScanHelper;
+
+    // Cell 0 holds non-finite scores, cell 1 scores below the grid, cell
+    // i + 2 scores in [edges_[i], edges_[i + 1]).
+    static constexpr std::size_t kNonFiniteCell = 0;
+    static constexpr std::size_t kUnderflowCell = 1;
+
+    std::size_t n_cells() const noexcept { return edges_.size() + 2; }
+    std::size_t n_streams() const noexcept { return 2 * (channels_.size() + 1); }
+    std::size_t channel_index(int channel) const;
+    std::size_t find_cell(double score) const;
+    std::size_t first_cell(double threshold) const;
+    bool stream_selected(std::size_t stream, Class cls, int channel) const;
+    ThresholdCount tail(std::size_t cell, Class cls, int channel) const;
+
+    void fill(double score, double w, int channel, bool signal);
+    void fill(double score, double w, int channel, bool signal, const unsigned short *packed, std::size_t n_packed, double cv);
+    void build_prefix();
+    /// Grow to @p n universes, crediting new ones with the nominal weight so far.
+    void widen_universes(std::size_t n);
+
+    double universe_pass(int u, bool signal, std::size_t cell) const;
+
+    std::string name_;
+    std::vector<double> edges_;
+    std::vector<int> channels_;
+    int n_universes_ = 0;
+
+    // Per stream (2 * channel index + signal), per cell.
+    std::vector<double> sumw_;
+    std::vector<double> sumw2_;
+    std::vector<double> raw_;
+
+    // Tail sums: tail_*[stream * (n_cells + 1) + cell] = sum over cells >= cell.
+    std::vector<double> tail_sumw_;
+    std::vector<double> tail_sumw2_;
+    std::vector<double> tail_raw_;
+
+    // Universe sums for signal/background (cell-major), and their tails.
+    std::vector<double> universes_;
+    std::vector<double> tail_universes_;
+};
+
+/**
+ *  @brief RDataFrame action filling a ThresholdScan in one event loop.
+ *
+ *  Columns: score (double), weight (double), channel (int), signal (bool) and,
+ *  with universes, the packed universe vector (RVec<unsigned short>, or its
+ *  UniverseWeightCodec blob) and CV factor (double) as for UniverseFillHelper;
+ *  n_universes < 0 sizes the universes from the data. With an empty edge list the
+ *  helper keeps (score, weight, stream) per slot and builds an exact
+ *  unbinned scan in Finalize().
+ */
+class ThresholdScanHelper : public ROOT::Detail::RDF::RActionImpl<ThresholdScanHelper>
+{
+  public:
+    using Result_t = ThresholdScan;
+
+    ThresholdScanHelper(std::string name,
+                        std::vector<double> edges,
+                        std::vector<int> channels,
+                        int n_universes,
+                        unsigned int n_slots);
+
+    ThresholdScanHelper(ThresholdScanHelper &&) = default;
+    ThresholdScanHelper(const ThresholdScanHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, double score, double w, int channel, bool signal);
+    void Exec(unsigned int slot,
+              double score,
+              double w,
+              int channel,
+              bool signal,
+              const ROOT::RVec<unsigned short> &packed,
+              double cv);
+    void Exec(unsigned int slot,
+              double score,
+              double w,
+              int channel,
+              bool signal,
+              const ROOT::RVec<unsigned char> &encoded,
+              double cv);
+
+    void Finalize();
+
+    std::string GetActionName() const { return "ThresholdScan"; }
+
+  private:
+    struct Entry
+    {
+        double score;
+        double w;
+        int channel;
+        bool signal;
+    };
+
+    void fill_packed(unsigned int slot,
+                     double score,
+                     double w,
+                     int channel,
+                     bool signal,
+                     const unsigned short *packed,
+                     std::size_t n_packed,
+                     double cv);
+
+    std::shared_ptr<Result_t> result_;
+    std::string name_;
+    std::vector<int> channels_;
+    bool unbinned_ = false;
+    bool sized_by_data_ = false;
+
+    std::vector<ThresholdScan> slot_scans_;
+    std::vector<std::vector<Entry>> slot_entries_;
+    std::vector<std::vector<unsigned short>> slot_decoded_;
+};
+
+struct ThresholdScanSpec
+{
+    std::string name;
+    /// Score expression (e.g. "inf_score_0").
+    std::string score;
+    /// Weight expression; empty => unit weight.
+    std::string weight;
+    /// Boolean signal expression; empty => every event is background.
+    std::string signal;
+    /// Integer channel column (e.g. "analysis_channels"); empty => no channel split.
+    std::string channel_column;
+    /// Channels kept separately; others are pooled (still counted in kAllChannels).
+    std::vector<int> channels;
+    /// Fine cut grid; empty => exact unbinned scan.
+    std::vector<double> edges;
+    /// Optional universe bands (binned mode only), as in UniverseHistSpec.
+    std::string universe_column;
+    std::string cv_column;
+    int n_universes = -1;
+};
+
+/**
+ *  @brief Book a lazy ThresholdScan. Several scans on the same RDataFrame
+ *         (different scores or selections) run in one loop with RunGraphs.
+ */
+ROOT::RDF::RResultPtr<ThresholdScan> book_threshold_scan(ROOT::RDF::RNode node, const ThresholdScanSpec &spec);
+
+} // namespace nu
+
+
+#endif // HERON_PLOT_THRESHOLD_SCAN_H
@@ -0,0 +1,180 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/include/UniverseHist.hh
+ *
+ *  @brief Single-pass multi-universe histogram filling for packed systematic
+ *         weight vectors (weightsGenie, weightsPPFX, weightsFlux, ...).
+ */
+
+#ifndef HERON_PLOT_UNIVERSE_HIST_H
+#define HERON_PLOT_UNIVERSE_HIST_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+#include <TH1D.h>
+
+#include "PlotDescriptors.hh"
+
+
+namespace nu
+{
+
+/// Packed universe vectors store weight * kUniversePackScale in unsigned short.
+inline constexpr double kUniversePackScale = 1000.0;
+
+/**
+ *  @brief Nominal + N-universe histogram produced in one event loop.
+ *
+ *  Storage is bin-major (one contiguous row of universes per bin, including
+ *  under/overflow) so that the per-event inner loop runs over contiguous memory.
+ */
+class UniverseHist
+{
+  public:
+    UniverseHist() = default;
+    UniverseHist(std::string name, std::vector<double> edges, int n_universes);
+
+    const std::string &name() const noexcept { return name_; }
+    const std::vector<double> &edges() const noexcept { return edges_; }
+
+    int n_bins() const noexcept { return static_cast<int>(edges_.size()) - 1; }
+    int n_universes() const noexcept { return n_universes_; }
+
+    /// ROOT-style bin index: 0 = underflow, 1..n_bins, n_bins + 1 = overflow.
+    double nominal(int bin) const { return nominal_.at(static_cast<std::size_t>(bin)); }
+    double nominal_sumw2(int bin) const { return nominal_w2_.at(static_cast<std::size_t>(bin)); }
+    double universe(int u, int bin) const;
+
+    std::unique_ptr<TH1D> nominal_hist(const std::string &hist_name = "") const;
+    std::unique_ptr<TH1D> universe_hist(int u, const std::string &hist_name = "") const;
+
+    /// Direct access for downstream accumulators (covariance, envelopes).
+    const std::vector<double> &nominal_data() const noexcept { return nominal_; }
+    const std::vector<double> &universe_data() const noexcept { return universes_; }
+
+    /// Sum another (compatible) UniverseHist into this one.
+    void add(const UniverseHist &other);
+
+  private:
+    friend class UniverseFillHelper;
+
+    std::string name_;
+    std::vector<double> edges_;
+    int n_universes_ = 0;
+
+    std::vector<double> nominal_;
+    std::vector<double> nominal_w2_;
+    std::vector<double> universes_;
+};
+
+/**
+ *  @brief RDataFrame action filling a UniverseHist from packed universe weights.
+ *
+ *  Columns (in order): x (double), nominal weight (double), packed universe
+ *  vector (RVec<unsigned short>), CV component (double). Universe weights are
+ *
+ *      w_u = w_nominal * (packed[u] / 1000) / cv
+ *
+ *  where cv is the central-value factor already contained in w_nominal
+ *  (e.g. weightTune or ppfx_cv). A non-finite or non-positive cv is treated
+ *  as 1. Universes missing from a short (or empty) vector are filled with the
+ *  nominal weight, so samples without variations do not bias the spread.
+ *  With n_universes <= 0 the count is taken from the longest vector seen,
+ *  growing the per-slot rows during the fill.
+ */
+class UniverseFillHelper : public ROOT::Detail::RDF::RActionImpl<UniverseFillHelper>
+{
+  public:
+    using Result_t = UniverseHist;
+
+    UniverseFillHelper(std::string name,
+                       std::vector<double> edges,
+                       int n_universes,
+                       unsigned int n_slots);
+
+    UniverseFillHelper(UniverseFillHelper &&) = default;
+    UniverseFillHelper(const UniverseFillHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot,
+              double x,
+              double w,
+              const ROOT::RVec<unsigned short> &packed,
+              double cv);
+
+    /// Same as above for a UniverseWeightCodec blob, decoded into per-slot scratch.
+    void Exec(unsigned int slot,
+              double x,
+              double w,
+              const ROOT::RVec<unsigned char> &encoded,
+              double cv);
+
+    /// Entry point for callers that decode universe weights themselves.
+    void fill_packed(unsigned int slot,
+                     double x,
+                     double w,
+                     const unsigned short *packed,
+                     std::size_t n_packed,
+                     double cv);
+
+    void Finalize();
+
+    std::string GetActionName() const { return "UniverseFill"; }
+
+  private:
+    int find_bin(double x) const;
+    /// Widen the universe rows of @p slot to @p stride, crediting the new
+    /// universes with the nominal weight already filled (as for short vectors).
+    void widen(unsigned int slot, std::size_t stride);
+
+    std::shared_ptr<Result_t> result_;
+    std::vector<double> edges_;
+    int n_universes_ = 0;
+    bool sized_by_data_ = false;
+
+    // Per-slot accumulators, merged once in Finalize().
+    std::vector<std::size_t> slot_stride_;
+    std::vector<std::vector<double>> slot_nominal_;
+    std::vector<std::vector<double>> slot_nominal_w2_;
+    std::vector<std::vector<double>> slot_universes_;
+    std::vector<std::vector<unsigned short>> slot_decoded_;
+};
+
+struct UniverseHistSpec
+{
+    std::string name;
+    /// Packed universe branch (e.g. "weightsGenie", "weightsPPFX"); an encoded
+    /// "<column>_uwq" branch is read directly when present.
+    std::string universe_column;
+    /// CV factor to divide out of the nominal weight; empty => no division.
+    std::string cv_column;
+    /// Number of universes; <= 0 => the longest vector seen during the fill.
+    int n_universes = -1;
+};
+
+/**
+ *  @brief Book a lazy multi-universe fill using the binning/expression/weight of @p spec.
+ *
+ *  Several calls on nodes sharing the same RDataFrame (e.g. GENIE, PPFX, flux,
+ *  reint) run in the same event loop when triggered together (RunGraphs).
+ */
+ROOT::RDF::RResultPtr<UniverseHist> book_universe_hist(ROOT::RDF::RNode node,
+                                                       const TH1DModel &spec,
+                                                       const UniverseHistSpec &universes);
+
+/// Scan for the universe count of a packed vector column (runs its own event loop).
+int count_universes(ROOT::RDF::RNode node, const std::string &universe_column);
+
+} // namespace nu
+
+
+#endif // HERON_PLOT_UNIVERSE_HIST_H
@@ -0,0 +1,311 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/CovarianceBuilder.cc
+ *
+ *  @brief Implementation of the streaming universe covariance accumulator.
+ */
+
+#include "CovarianceBuilder.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UniverseHist.hh"
+
+
+namespace nu
+{
+
+namespace
+{
+
+inline std::size_t tri_index(int i, int j)
+{
+    if (j > i)
+        std::swap(i, j);
+    return static_cast<std::size_t>(i) * (static_cast<std::size_t>(i) + 1) / 2 + static_cast<std::size_t>(j);
+}
+
+} // namespace
+
+CovarianceBuilder::CovarianceBuilder(int n_bins)
+{
+    add_block("all", n_bins);
+}
+
+void CovarianceBuilder::resize(int n_bins)
+{
+    if (n_ > 0)
+        throw std::runtime_error("CovarianceBuilder: cannot change binning after universes were added");
+
+    n_bins_ = n_bins;
+    const std::size_t n = static_cast<std::size_t>(n_bins_);
+    mean_.assign(n, 0.0);
+    delta_.assign(n, 0.0);
+    m2_.assign(n * (n + 1) / 2, 0.0);
+    cv_.clear();
+}
+
+int CovarianceBuilder::add_block(const std::string &name, int n_bins)
+{
+    if (n_bins <= 0)
+        throw std::runtime_error("CovarianceBuilder: block '" + name + "' needs a positive bin count");
+    for (const auto &b : blocks_)
+    {
+        if (b.name == name)
+            throw std::runtime_error("CovarianceBuilder: duplicate block '" + name + "'");
+    }
+
+    Block block;
+    block.name = name;
+    block.offset = n_bins_;
+    block.n_bins = n_bins;
+    blocks_.push_back(block);
+
+    resize(n_bins_ + n_bins);
+    return block.offset;
+}
+
+const CovarianceBuilder::Block &CovarianceBuilder::find_block(const std::string &name) const
+{
+    for (const auto &b : blocks_)
+    {
+        if (b.name == name)
+            return b;
+    }
+    throw std::runtime_error("CovarianceBuilder: unknown block '" + name + "'");
+}
+
+int CovarianceBuilder::block_offset(const std::string &name) const
+{
+    return find_block(name).offset;
+}
+
+void CovarianceBuilder::set_central_value(const std::vector<double> &cv)
+{
+    if (static_cast<int>(cv.size()) != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: central value size does not match joint bin count");
+    cv_ = cv;
+}
+
+void CovarianceBuilder::set_central_value(const std::string &block, const std::vector<double> &cv)
+{
+    const Block &b = find_block(block);
+    if (static_cast<int>(cv.size()) != b.n_bins)
+        throw std::runtime_error("CovarianceBuilder: central value size does not match block '" + block + "'");
+    if (cv_.empty())
+        cv_.assign(static_cast<std::size_t>(n_bins_), 0.0);
+    std::copy(cv.begin(), cv.end(), cv_.begin() + b.offset);
+}
+
+void CovarianceBuilder::add_universe(const std::vector<double> &values)
+{
+    add_universe(values.data(), values.size());
+}
+
+void CovarianceBuilder::add_universe(const double *values, std::size_t n)
+{
+    if (static_cast<int>(n) != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: universe size does not match joint bin count");
+
+    ++n_;
+    const double inv_n = 1.0 / static_cast<double>(n_);
+    const double shrink = static_cast<double>(n_ - 1) * inv_n;
+
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        delta_[i] = values[i] - mean_[i];
+        mean_[i] += delta_[i] * inv_n;
+    }
+
+    // M2 += (x - mean_old)(x - mean_new)^T = (n - 1)/n * delta delta^T
+    double *m2 = m2_.data();
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        const double di = shrink * delta_[i];
+        for (int j = 0; j <= i; ++j)
+            *m2++ += di * delta_[j];
+    }
+}
+
+void CovarianceBuilder::add(const UniverseHist &hist)
+{
+    if (blocks_.empty())
+        add_block(hist.name().empty() ? "all" : hist.name(), hist.n_bins());
+    add(std::vector<const UniverseHist *>{&hist});
+}
+
+void CovarianceBuilder::add(const std::vector<const UniverseHist *> &blocks)
+{
+    if (blocks.size() != blocks_.size())
+        throw std::runtime_error("CovarianceBuilder: need one UniverseHist per declared block");
+
+    int n_universes = -1;
+    for (std::size_t b = 0; b < blocks.size(); ++b)
+    {
+        if (!blocks[b])
+            throw std::runtime_error("CovarianceBuilder: null UniverseHist for block '" + blocks_[b].name + "'");
+        if (blocks[b]->n_bins() != blocks_[b].n_bins)
+            throw std::runtime_error("CovarianceBuilder: bin count mismatch for block '" + blocks_[b].name + "'");
+        if (n_universes >= 0 && blocks[b]->n_universes() != n_universes)
+            throw std::runtime_error("CovarianceBuilder: blocks have different universe counts");
+        n_universes = blocks[b]->n_universes();
+    }
+
+    if (cv_.empty())
+    {
+        cv_.assign(static_cast<std::size_t>(n_bins_), 0.0);
+        for (std::size_t b = 0; b < blocks.size(); ++b)
+        {
+            for (int i = 0; i < blocks_[b].n_bins; ++i)
+                cv_[blocks_[b].offset + i] = blocks[b]->nominal(i + 1);
+        }
+    }
+
+    std::vector<double> joint(static_cast<std::size_t>(n_bins_), 0.0);
+    for (int u = 0; u < n_universes; ++u)
+    {
+        for (std::size_t b = 0; b < blocks.size(); ++b)
+        {
+            for (int i = 0; i < blocks_[b].n_bins; ++i)
+                joint[blocks_[b].offset + i] = blocks[b]->universe(u, i + 1);
+        }
+        add_universe(joint);
+    }
+}
+
+void CovarianceBuilder::merge(const CovarianceBuilder &other)
+{
+    if (other.n_bins_ != n_bins_)
+        throw std::runtime_error("CovarianceBuilder::merge: joint bin count mismatch");
+    if (other.n_ == 0)
+        return;
+    if (n_ == 0)
+    {
+        n_ = other.n_;
+        mean_ = other.mean_;
+        m2_ = other.m2_;
+        if (cv_.empty())
+            cv_ = other.cv_;
+        return;
+    }
+
+    const double na = static_cast<double>(n_);
+    const double nb = static_cast<double>(other.n_);
+    const double n = na + nb;
+
+    for (int i = 0; i < n_bins_; ++i)
+        delta_[i] = other.mean_[i] - mean_[i];
+
+    double *m2 = m2_.data();
+    const double *m2_other = other.m2_.data();
+    const double w = na * nb / n;
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        for (int j = 0; j <= i; ++j)
+            *m2++ += *m2_other++ + w * delta_[i] * delta_[j];
+    }
+
+    for (int i = 0; i < n_bins_; ++i)
+        mean_[i] += delta_[i] * nb / n;
+
+    n_ += other.n_;
+}
+
+double CovarianceBuilder::cell(int i, int j, Reference ref, bool unbiased) const
+{
+    const double denom = unbiased ? static_cast<double>(n_ - 1) : static_cast<double>(n_);
+    if (!(denom > 0.0))
+        return 0.0;
+
+    double sum = m2_[tri_index(i, j)];
+    if (ref == Reference::kCentralValue)
+        sum += static_cast<double>(n_) * (mean_[i] - cv_[i]) * (mean_[j] - cv_[j]);
+    return sum / denom;
+}
+
+TMatrixDSym CovarianceBuilder::covariance(Reference ref, bool unbiased) const
+{
+    if (ref == Reference::kCentralValue && static_cast<int>(cv_.size()) != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: central value not set");
+
+    TMatrixDSym cov(n_bins_);
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        for (int j = 0; j <= i; ++j)
+        {
+            const double c = cell(i, j, ref, unbiased);
+            cov(i, j) = c;
+            cov(j, i) = c;
+        }
+    }
+    return cov;
+}
+
+TMatrixDSym CovarianceBuilder::fractional_covariance(Reference ref, bool unbiased) const
+{
+    if (static_cast<int>(cv_.size()) != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: fractional covariance requires a central value");
+
+    TMatrixDSym frac(n_bins_);
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        for (int j = 0; j <= i; ++j)
+        {
+            const double norm = cv_[i] * cv_[j];
+            const double f = (norm != 0.0 && std::isfinite(norm)) ? cell(i, j, ref, unbiased) / norm : 0.0;
+            frac(i, j) = f;
+            frac(j, i) = f;
+        }
+    }
+    return frac;
+}
+
+TMatrixDSym CovarianceBuilder::block_covariance(const std::string &block, Reference ref, bool unbiased) const
+{
+    if (ref == Reference::kCentralValue && static_cast<int>(cv_.size()) != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: central value not set");
+
+    const Block &b = find_block(block);
+    TMatrixDSym cov(b.n_bins);
+    for (int i = 0; i < b.n_bins; ++i)
+    {
+        for (int j = 0; j <= i; ++j)
+        {
+            const double c = cell(b.offset + i, b.offset + j, ref, unbiased);
+            cov(i, j) = c;
+            cov(j, i) = c;
+        }
+    }
+    return cov;
+}
+
+void CovarianceBuilder::apply_to(Options &opt, Reference ref, bool unbiased) const
+{
+    const TMatrixDSym cov = covariance(ref, unbiased);
+    if (!opt.total_cov)
+    {
+        opt.total_cov = std::make_shared<TMatrixDSym>(cov);
+        return;
+    }
+
+    if (opt.total_cov->GetNrows() != n_bins_)
+        throw std::runtime_error("CovarianceBuilder: Options::total_cov has a different dimension");
+
+    // Options are copied freely, so total_cov may be shared with other
+    // plots: sum into a fresh matrix rather than the one it points at.
+    auto total = std::make_shared<TMatrixDSym>(*opt.total_cov);
+    for (int i = 0; i < n_bins_; ++i)
+    {
+        for (int j = 0; j < n_bins_; ++j)
+            (*total)(i, j) += cov(i, j);
+    }
+    opt.total_cov = std::move(total);
+}
+
+} // namespace nu
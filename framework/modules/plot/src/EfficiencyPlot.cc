@@ -8,12 +8,16 @@
 #include "EfficiencyPlot.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <TCanvas.h>
 #include <TColor.h>
@@ -96,8 +100,304 @@ void set_global_style_like_plotter()
     gROOT->ForceStyle();
 }
 
+std::string unique_column(const std::string &stem)
+{
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+}
+
+/// Floor of a / 2^shift for signed lattice indices.
+long long shift_floor(long long a, int shift)
+{
+    return a >= 0 ? (a >> shift) : -((-a - 1) >> shift) - 1;
+}
+
+/**
+ *  Bounded summary of an auto-ranged variable: the first kExactValues (x, w)
+ *  pairs exactly, then kFineBins bins of a global power-of-two lattice
+ *  (bin k covers [k, k + 1) * 2^exponent). The lattice coarsens by factors of
+ *  two as the range grows, so summaries from different slots and different
+ *  nodes can always be brought to one exponent and binned identically.
+ */
+class AutoRangeValues
+{
+  public:
+    static constexpr std::size_t kExactValues = 4096;
+    static constexpr long long kFineBins = 4096;
+
+    struct Bin
+    {
+        double sumw = 0.0;
+        double sumw2 = 0.0;
+        ULong64_t n = 0;
+    };
+
+    void add(double x, double w)
+    {
+        if (!std::isfinite(x))
+        {
+            Bin &b = x < 0.0 ? below_ : above_;
+            b.sumw += w;
+            b.sumw2 += w * w;
+            ++b.n;
+            return;
+        }
+        xmin_ = std::min(xmin_, x);
+        xmax_ = std::max(xmax_, x);
+        if (!lattice())
+        {
+            exact_.emplace_back(x, w);
+            if (exact_.size() >= kExactValues)
+            {
+                to_lattice(initial_exponent());
+            }
+            return;
+        }
+        deposit(x, w);
+    }
+
+    void merge(const AutoRangeValues &other)
+    {
+        xmin_ = std::min(xmin_, other.xmin_);
+        xmax_ = std::max(xmax_, other.xmax_);
+        for (Bin *b : {&below_, &above_})
+        {
+            const Bin &o = (b == &below_) ? other.below_ : other.above_;
+            b->sumw += o.sumw;
+            b->sumw2 += o.sumw2;
+            b->n += o.n;
+        }
+        if (other.lattice())
+        {
+            if (!lattice())
+            {
+                to_lattice(other.exponent_);
+            }
+            for (long long i = 0; i < kFineBins; ++i)
+            {
+                const Bin &b = other.bins_[static_cast<std::size_t>(i)];
+                if (b.n > 0)
+                {
+                    deposit_bin(other.exponent_, other.k0_ + i, b);
+                }
+            }
+        }
+        for (const auto &xw : other.exact_)
+        {
+            add(xw.first, xw.second);
+        }
+    }
+
+    bool lattice() const noexcept { return !bins_.empty(); }
+    int exponent() const noexcept { return exponent_; }
+    double xmin() const noexcept { return xmin_; }
+    double xmax() const noexcept { return xmax_; }
+
+    /// Move to a lattice at least as coarse as 2^@p exponent.
+    void to_lattice(int exponent)
+    {
+        if (!lattice())
+        {
+            exponent_ = exponent;
+            k0_ = std::isfinite(xmin_) ? index(xmin_) : 0;
+            bins_.assign(static_cast<std::size_t>(kFineBins), Bin{});
+            std::vector<std::pair<double, double>> exact;
+            exact.swap(exact_);
+            for (const auto &xw : exact)
+            {
+                deposit(xw.first, xw.second);
+            }
+        }
+        while (exponent_ < exponent)
+        {
+            coarsen();
+        }
+    }
+
+    /// Fill @p h, with the bin-indexed sum of w^2 in @p sumw2. Lattice bins
+    /// go whole into the output bin holding their centre, clamped to the
+    /// shared data range [@p lo, @p hi], so summaries on one lattice agree.
+    void fill(TH1D &h, std::vector<double> &sumw2, double lo, double hi) const
+    {
+        auto add_to = [&](int bin, double w, double w2)
+        {
+            h.AddBinContent(bin, w);
+            sumw2[static_cast<std::size_t>(bin)] += w2;
+        };
+        add_to(0, below_.sumw, below_.sumw2);
+        add_to(h.GetNbinsX() + 1, above_.sumw, above_.sumw2);
+        for (const auto &xw : exact_)
+        {
+            add_to(h.FindFixBin(xw.first), xw.second, xw.second * xw.second);
+        }
+        if (!lattice())
+        {
+            return;
+        }
+        for (long long i = 0; i < kFineBins; ++i)
+        {
+            const Bin &b = bins_[static_cast<std::size_t>(i)];
+            if (b.n == 0)
+            {
+                continue;
+            }
+            double centre = std::ldexp(static_cast<double>(k0_ + i) + 0.5, exponent_);
+            if (std::isfinite(lo) && std::isfinite(hi))
+            {
+                centre = std::min(std::max(centre, lo), hi);
+            }
+            add_to(h.FindFixBin(centre), b.sumw, b.sumw2);
+        }
+    }
+
+  private:
+    long long index(double x) const { return static_cast<long long>(std::floor(std::ldexp(x, -exponent_))); }
+
+    int initial_exponent() const
+    {
+        const double span = xmax_ - xmin_;
+        if (span > 0.0)
+        {
+            return std::ilogb(span / static_cast<double>(kFineBins / 2)) + 1;
+        }
+        return std::ilogb(std::max(std::abs(xmin_), 1.0e-300)) - 30;
+    }
+
+    void deposit(double x, double w)
+    {
+        Bin b;
+        b.sumw = w;
+        b.sumw2 = w * w;
+        b.n = 1;
+        deposit_bin(exponent_, static_cast<long long>(std::floor(std::ldexp(x, -exponent_))), b);
+    }
+
+    /// Add bin @p k of the 2^@p exponent lattice, coarsening first if that lattice is coarser.
+    void deposit_bin(int exponent, long long k, const Bin &b)
+    {
+        while (exponent_ < exponent)
+        {
+            coarsen();
+        }
+        for (;;)
+        {
+            const long long kk = shift_floor(k, exponent_ - exponent);
+            const long long lo = occupied_ ? std::min(occ_lo_, kk) : kk;
+            const long long hi = occupied_ ? std::max(occ_hi_, kk) : kk;
+            if (hi - lo >= kFineBins)
+            {
+                coarsen();
+                continue;
+            }
+            if (lo < k0_ || hi >= k0_ + kFineBins)
+            {
+                relayout(exponent_, lo);
+            }
+
+            Bin &dst = bins_[static_cast<std::size_t>(kk - k0_)];
+            dst.sumw += b.sumw;
+            dst.sumw2 += b.sumw2;
+            dst.n += b.n;
+            occ_lo_ = lo;
+            occ_hi_ = hi;
+            occupied_ = true;
+            return;
+        }
+    }
+
+    void coarsen()
+    {
+        relayout(exponent_ + 1, shift_floor(occupied_ ? occ_lo_ : k0_, 1));
+    }
+
+    void relayout(int exponent, long long k0)
+    {
+        const int shift = exponent - exponent_;
+        std::vector<Bin> bins(static_cast<std::size_t>(kFineBins), Bin{});
+        for (long long i = 0; i < kFineBins; ++i)
+        {
+            const Bin &b = bins_[static_cast<std::size_t>(i)];
+            if (b.n == 0)
+            {
+                continue;
+            }
+            Bin &dst = bins[static_cast<std::size_t>(shift_floor(k0_ + i, shift) - k0)];
+            dst.sumw += b.sumw;
+            dst.sumw2 += b.sumw2;
+            dst.n += b.n;
+        }
+        bins_.swap(bins);
+        if (occupied_)
+        {
+            occ_lo_ = shift_floor(occ_lo_, shift);
+            occ_hi_ = shift_floor(occ_hi_, shift);
+        }
+        exponent_ = exponent;
+        k0_ = k0;
+    }
+
+    std::vector<std::pair<double, double>> exact_;
+    std::vector<Bin> bins_;
+    Bin below_;
+    Bin above_;
+    int exponent_ = 0;
+    long long k0_ = 0;
+    long long occ_lo_ = 0;
+    long long occ_hi_ = 0;
+    bool occupied_ = false;
+    double xmin_ = std::numeric_limits<double>::infinity();
+    double xmax_ = -std::numeric_limits<double>::infinity();
+};
+
+/// Fills one AutoRangeValues per slot and merges them in Finalize().
+class AutoRangeValuesHelper : public ROOT::Detail::RDF::RActionImpl<AutoRangeValuesHelper>
+{
+  public:
+    using Result_t = AutoRangeValues;
+
+    explicit AutoRangeValuesHelper(unsigned int n_slots)
+        : result_(std::make_shared<Result_t>()), slots_(n_slots)
+    {
+    }
+
+    AutoRangeValuesHelper(AutoRangeValuesHelper &&) = default;
+    AutoRangeValuesHelper(const AutoRangeValuesHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, double x, double w) { slots_[slot].add(x, w); }
+
+    void Finalize()
+    {
+        for (const auto &v : slots_)
+        {
+            result_->merge(v);
+        }
+        slots_.clear();
+    }
+
+    std::string GetActionName() const { return "AutoRangeValues"; }
+
+  private:
+    std::shared_ptr<Result_t> result_;
+    std::vector<Result_t> slots_;
+};
+
 } // namespace
 
+struct EfficiencyPlot::Booked
+{
+    ROOT::RDF::RResultPtr<ULong64_t> n_denom;
+    ROOT::RDF::RResultPtr<ULong64_t> n_pass;
+    ROOT::RDF::RResultPtr<TH1D> h_total;
+    ROOT::RDF::RResultPtr<TH1D> h_passed;
+    ROOT::RDF::RResultPtr<AutoRangeValues> v_total;
+    ROOT::RDF::RResultPtr<AutoRangeValues> v_passed;
+};
+
 EfficiencyPlot::EfficiencyPlot(TH1DModel spec, Options opt)
     : EfficiencyPlot(std::move(spec), std::move(opt), Config())
 {
@@ -160,6 +460,61 @@ int EfficiencyPlot::compute(ROOT::RDF::RNode base,
 }
 
 int EfficiencyPlot::compute(ROOT::RDF::RNode denom_node, ROOT::RDF::RNode pass_node)
+{
+    ROOT::RDF::RunGraphs(book(std::move(denom_node), std::move(pass_node)));
+    return finalise();
+}
+
+int EfficiencyPlot::compute_all(std::vector<EfficiencyPlot> &plots,
+                                ROOT::RDF::RNode denom_node,
+                                ROOT::RDF::RNode pass_node)
+{
+    std::vector<ROOT::RDF::RResultHandle> handles;
+    for (auto &plot : plots)
+    {
+        auto booked = plot.book(denom_node, pass_node);
+        handles.insert(handles.end(), booked.begin(), booked.end());
+    }
+    ROOT::RDF::RunGraphs(handles);
+
+    int rc = 0;
+    for (auto &plot : plots)
+    {
+        const int plot_rc = plot.finalise();
+        if (rc == 0)
+        {
+            rc = plot_rc;
+        }
+    }
+    return rc;
+}
+
+int EfficiencyPlot::compute_all(std::vector<EfficiencyPlot> &plots,
+                                ROOT::RDF::RNode base,
+                                const std::string &denom_sel,
+                                const std::string &pass_sel,
+                                const std::string &extra_sel)
+{
+    ROOT::RDF::RNode denom = base;
+    if (!extra_sel.empty())
+    {
+        denom = denom.Filter(extra_sel);
+    }
+    if (!denom_sel.empty())
+    {
+        denom = denom.Filter(denom_sel);
+    }
+
+    ROOT::RDF::RNode numer = denom;
+    if (!pass_sel.empty())
+    {
+        numer = numer.Filter(pass_sel);
+    }
+
+    return compute_all(plots, denom, numer);
+}
+
+std::vector<ROOT::RDF::RResultHandle> EfficiencyPlot::book(ROOT::RDF::RNode denom_node, ROOT::RDF::RNode pass_node)
 {
     ready_ = false;
     h_total_.reset();
@@ -167,28 +522,87 @@ int EfficiencyPlot::compute(ROOT::RDF::RNode denom_node, ROOT::RDF::RNode pass_n
     g_eff_.reset();
     n_denom_ = 0;
     n_pass_ = 0;
+    booked_ = std::make_shared<Booked>();
 
     const std::string nan_guard = spec_.expr + " == " + spec_.expr;
     ROOT::RDF::RNode denom_finite = denom_node.Filter(nan_guard);
     ROOT::RDF::RNode pass_finite = pass_node.Filter(nan_guard);
 
-    n_denom_ = denom_finite.Count().GetValue();
+    booked_->n_denom = denom_finite.Count();
+    booked_->n_pass = pass_finite.Count();
+    std::vector<ROOT::RDF::RResultHandle> handles{booked_->n_denom, booked_->n_pass};
+
+    if (cfg_.auto_x_range)
+    {
+        const std::string x_col = unique_column("__eff_x");
+        const std::string w_col = unique_column("__eff_w");
+        const std::string x_expr = "static_cast<double>(" + spec_.expr + ")";
+        const std::string w_expr = spec_.weight.empty() ? std::string("1.0")
+                                                        : "static_cast<double>(" + spec_.weight + ")";
+        auto book_values = [&](ROOT::RDF::RNode node)
+        {
+            ROOT::RDF::RNode defined = node.Define(x_col, x_expr).Define(w_col, w_expr);
+            return defined.Book<double, double>(AutoRangeValuesHelper(defined.GetNSlots()), {x_col, w_col});
+        };
+        booked_->v_total = book_values(denom_finite);
+        booked_->v_passed = book_values(pass_finite);
+        handles.emplace_back(booked_->v_total);
+        handles.emplace_back(booked_->v_passed);
+        return handles;
+    }
+
+    const std::string tag = sanitise_(spec_.expr);
+    const std::string htot_name = "h_eff_total_" + tag;
+    const std::string hpas_name = "h_eff_passed_" + tag;
+    const ROOT::RDF::TH1DModel tot_model(htot_name.c_str(), "", spec_.nbins, spec_.xmin, spec_.xmax);
+    const ROOT::RDF::TH1DModel pas_model(hpas_name.c_str(), "", spec_.nbins, spec_.xmin, spec_.xmax);
+
+    if (!spec_.weight.empty())
+    {
+        booked_->h_total = denom_finite.Histo1D(tot_model, spec_.expr, spec_.weight);
+        booked_->h_passed = pass_finite.Histo1D(pas_model, spec_.expr, spec_.weight);
+    }
+    else
+    {
+        booked_->h_total = denom_finite.Histo1D(tot_model, spec_.expr);
+        booked_->h_passed = pass_finite.Histo1D(pas_model, spec_.expr);
+    }
+    handles.emplace_back(booked_->h_total);
+    handles.emplace_back(booked_->h_passed);
+    return handles;
+}
+
+int EfficiencyPlot::finalise()
+{
+    if (!booked_)
+    {
+        std::cerr << "[EfficiencyPlot] finalise called before book() for " << spec_.expr << "\n";
+        return 1;
+    }
+    const std::shared_ptr<Booked> booked = std::move(booked_);
+
+    n_denom_ = booked->n_denom.GetValue();
     if (n_denom_ == 0)
     {
         std::cout << "[EfficiencyPlot] skip " << spec_.expr
                   << " (no denom entries after selection)\n";
         return 0;
     }
-    n_pass_ = pass_finite.Count().GetValue();
+    n_pass_ = booked->n_pass.GetValue();
 
-    int nbins = spec_.nbins;
-    double xmin = spec_.xmin;
-    double xmax = spec_.xmax;
+    const std::string tag = sanitise_(spec_.expr);
+    const std::string htot_name = "h_eff_total_" + tag;
+    const std::string hpas_name = "h_eff_passed_" + tag;
 
     if (cfg_.auto_x_range)
     {
-        const double vmin = static_cast<double>(denom_finite.Min(spec_.expr).GetValue());
-        const double vmax = static_cast<double>(denom_finite.Max(spec_.expr).GetValue());
+        AutoRangeValues &tot = *booked->v_total;
+        AutoRangeValues &pas = *booked->v_passed;
+
+        double xmin = spec_.xmin;
+        double xmax = spec_.xmax;
+        const double vmin = tot.xmin();
+        const double vmax = tot.xmax();
         if (std::isfinite(vmin) && std::isfinite(vmax) && vmax > vmin)
         {
             const double span = vmax - vmin;
@@ -196,48 +610,60 @@ int EfficiencyPlot::compute(ROOT::RDF::RNode denom_node, ROOT::RDF::RNode pass_n
             xmin = vmin - pad;
             xmax = vmax + pad;
         }
-    }
-
-    const std::string tag = sanitise_(spec_.expr);
-    const std::string htot_name = "h_eff_total_" + tag;
-    const std::string hpas_name = "h_eff_passed_" + tag;
 
-    ROOT::RDF::RResultPtr<TH1D> htot_r;
-    ROOT::RDF::RResultPtr<TH1D> hpas_r;
+        // Put total and passed on one lattice so an event lands in the same
+        // output bin in both and passed <= total holds bin by bin.
+        if (tot.lattice() || pas.lattice())
+        {
+            const int exponent = std::max(tot.lattice() ? tot.exponent() : pas.exponent(),
+                                          pas.lattice() ? pas.exponent() : tot.exponent());
+            tot.to_lattice(exponent);
+            pas.to_lattice(exponent);
+            pas.to_lattice(tot.exponent());
+            tot.to_lattice(pas.exponent());
+        }
 
-    if (!spec_.weight.empty())
-    {
-        htot_r = denom_finite.Histo1D({htot_name.c_str(), "", nbins, xmin, xmax},
-                                      spec_.expr,
-                                      spec_.weight);
-        hpas_r = pass_finite.Histo1D({hpas_name.c_str(), "", nbins, xmin, xmax},
-                                     spec_.expr,
-                                     spec_.weight);
+        const bool weighted = !spec_.weight.empty();
+        auto fill = [&](const std::string &name, const AutoRangeValues &v)
+        {
+            auto h = std::make_unique<TH1D>((name + "_clone").c_str(), "", spec_.nbins, xmin, xmax);
+            h->SetDirectory(nullptr);
+            std::vector<double> sumw2(static_cast<std::size_t>(spec_.nbins) + 2, 0.0);
+            v.fill(*h, sumw2, tot.xmin(), tot.xmax());
+            if (weighted)
+            {
+                h->Sumw2();
+                for (int bin = 0; bin <= spec_.nbins + 1; ++bin)
+                {
+                    h->SetBinError(bin, std::sqrt(sumw2[static_cast<std::size_t>(bin)]));
+                }
+            }
+            h->ResetStats();
+            return h;
+        };
+        h_total_ = fill(htot_name, tot);
+        h_passed_ = fill(hpas_name, pas);
     }
     else
     {
-        htot_r = denom_finite.Histo1D({htot_name.c_str(), "", nbins, xmin, xmax},
-                                      spec_.expr);
-        hpas_r = pass_finite.Histo1D({hpas_name.c_str(), "", nbins, xmin, xmax},
-                                     spec_.expr);
-    }
+        TH1D *htot = booked->h_total.GetPtr();
+        TH1D *hpas = booked->h_passed.GetPtr();
+        if (htot == nullptr || hpas == nullptr)
+        {
+            std::cerr << "[EfficiencyPlot] null histogram pointer for " << spec_.expr
+                      << " (htot=" << htot << ", hpas=" << hpas << ")\n";
+            return 1;
+        }
 
-    TH1D *htot = htot_r.GetPtr();
-    TH1D *hpas = hpas_r.GetPtr();
-    if (htot == nullptr || hpas == nullptr)
-    {
-        std::cerr << "[EfficiencyPlot] null histogram pointer for " << spec_.expr
-                  << " (htot=" << htot << ", hpas=" << hpas << ")\n";
-        return 1;
+        h_total_.reset(static_cast<TH1D *>(htot->Clone((htot_name + "_clone").c_str())));
+        h_passed_.reset(static_cast<TH1D *>(hpas->Clone((hpas_name + "_clone").c_str())));
+        if (!h_total_ || !h_passed_)
+        {
+            std::cerr << "[EfficiencyPlot] failed to clone histograms for " << spec_.expr << "\n";
+            return 1;
+        }
     }
 
-    h_total_.reset(static_cast<TH1D *>(htot->Clone((htot_name + "_clone").c_str())));
-    h_passed_.reset(static_cast<TH1D *>(hpas->Clone((hpas_name + "_clone").c_str())));
-    if (!h_total_ || !h_passed_)
-    {
-        std::cerr << "[EfficiencyPlot] failed to clone histograms for " << spec_.expr << "\n";
-        return 1;
-    }
     h_total_->SetDirectory(nullptr);
     h_passed_->SetDirectory(nullptr);
 
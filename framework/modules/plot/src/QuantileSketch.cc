@@ -0,0 +1,236 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/QuantileSketch.cc
+ *
+ *  @brief Merging t-digest quantile sketch and its RDataFrame action.
+ */
+
+#include "QuantileSketch.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace nu
+{
+
+namespace
+{
+
+constexpr double kPi = 3.14159265358979323846;
+
+std::string unique_column(const std::string &stem)
+{
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+}
+
+/// Arcsine scale: k(q) = d / (2 pi) * asin(2q - 1), and its inverse.
+double k_of_q(double q, double compression)
+{
+    return compression / (2.0 * kPi) * std::asin(2.0 * std::clamp(q, 0.0, 1.0) - 1.0);
+}
+
+double q_of_k(double k, double compression)
+{
+    const double k_max = compression / 4.0;
+    return 0.5 * (std::sin(2.0 * kPi * std::clamp(k, -k_max, k_max) / compression) + 1.0);
+}
+
+} // namespace
+
+QuantileSketch::QuantileSketch(double compression)
+    : compression_(compression > 10.0 ? compression : 10.0)
+{
+}
+
+void QuantileSketch::add(double x, double w)
+{
+    ++entries_;
+    if (w < 0.0)
+        throw std::runtime_error("QuantileSketch: negative weight " + std::to_string(w) +
+                                 " cannot be summarised; sketch |w| or unit weights instead");
+    if (!std::isfinite(x) || !(w > 0.0) || !std::isfinite(w))
+        return;
+
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    buffer_.push_back(Centroid{x, w});
+    buffer_weight_ += w;
+    if (buffer_.size() >= static_cast<std::size_t>(8.0 * compression_))
+        compress();
+}
+
+void QuantileSketch::merge(const QuantileSketch &other)
+{
+    other.compress();
+    entries_ += other.entries_;
+    if (other.centroids_.empty())
+        return;
+
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_weight_ += other.total_weight_;
+    compress();
+}
+
+void QuantileSketch::compress() const
+{
+    if (buffer_.empty())
+        return;
+
+    std::vector<Centroid> all;
+    all.reserve(centroids_.size() + buffer_.size());
+    all.insert(all.end(), centroids_.begin(), centroids_.end());
+    all.insert(all.end(), buffer_.begin(), buffer_.end());
+    std::sort(all.begin(), all.end(), [](const Centroid &a, const Centroid &b) { return a.mean < b.mean; });
+
+    const double total = total_weight_ + buffer_weight_;
+    std::vector<Centroid> out;
+    out.reserve(static_cast<std::size_t>(compression_) + 8);
+
+    Centroid current = all.front();
+    double weight_before = 0.0;
+    double q_limit = q_of_k(k_of_q(0.0, compression_) + 1.0, compression_);
+    for (std::size_t i = 1; i < all.size(); ++i)
+    {
+        const double proposed = current.weight + all[i].weight;
+        if ((weight_before + proposed) / total <= q_limit)
+        {
+            current.mean += (all[i].mean - current.mean) * all[i].weight / proposed;
+            current.weight = proposed;
+            continue;
+        }
+        weight_before += current.weight;
+        out.push_back(current);
+        q_limit = q_of_k(k_of_q(weight_before / total, compression_) + 1.0, compression_);
+        current = all[i];
+    }
+    out.push_back(current);
+
+    centroids_.swap(out);
+    buffer_.clear();
+    total_weight_ = total;
+    buffer_weight_ = 0.0;
+}
+
+std::size_t QuantileSketch::size() const
+{
+    compress();
+    return centroids_.size();
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    compress();
+    if (centroids_.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+    if (q <= 0.0)
+        return min_;
+    if (q >= 1.0)
+        return max_;
+    if (centroids_.size() == 1)
+        return centroids_.front().mean;
+
+    // Centroid i covers cumulative weight [before_i, before_i + w_i] and sits
+    // at its midpoint; interpolate between neighbouring midpoints, and towards
+    // the exact extremes outside the first and last ones.
+    const double target = q * total_weight_;
+    double before = 0.0;
+    double prev_mid = 0.0;
+    double prev_x = min_;
+    for (const auto &c : centroids_)
+    {
+        const double mid = before + 0.5 * c.weight;
+        if (target < mid)
+        {
+            const double span = mid - prev_mid;
+            const double t = span > 0.0 ? (target - prev_mid) / span : 0.0;
+            return prev_x + t * (c.mean - prev_x);
+        }
+        before += c.weight;
+        prev_mid = mid;
+        prev_x = c.mean;
+    }
+    const double span = total_weight_ - prev_mid;
+    const double t = span > 0.0 ? (target - prev_mid) / span : 1.0;
+    return prev_x + t * (max_ - prev_x);
+}
+
+double QuantileSketch::cdf(double x) const
+{
+    compress();
+    if (centroids_.empty() || !(total_weight_ > 0.0))
+        return std::numeric_limits<double>::quiet_NaN();
+    if (x < min_)
+        return 0.0;
+    if (x >= max_)
+        return 1.0;
+
+    double before = 0.0;
+    double prev_mid = 0.0;
+    double prev_x = min_;
+    for (const auto &c : centroids_)
+    {
+        const double mid = before + 0.5 * c.weight;
+        if (x < c.mean)
+        {
+            const double span = c.mean - prev_x;
+            const double t = span > 0.0 ? (x - prev_x) / span : 1.0;
+            return (prev_mid + t * (mid - prev_mid)) / total_weight_;
+        }
+        before += c.weight;
+        prev_mid = mid;
+        prev_x = c.mean;
+    }
+    const double span = max_ - prev_x;
+    const double t = span > 0.0 ? (x - prev_x) / span : 1.0;
+    return (prev_mid + t * (total_weight_ - prev_mid)) / total_weight_;
+}
+
+std::pair<double, double> QuantileSketch::robust_range(double q_lo, double q_hi, double pad_fraction) const
+{
+    double lo = quantile(q_lo);
+    double hi = quantile(q_hi);
+    if (!(hi > lo))
+        return {lo, hi};
+    const double pad = pad_fraction * (hi - lo);
+    return {lo - pad, hi + pad};
+}
+
+QuantileSketchHelper::QuantileSketchHelper(double compression, unsigned int n_slots)
+    : result_(std::make_shared<Result_t>(compression)), slots_(n_slots, QuantileSketch(compression))
+{
+}
+
+void QuantileSketchHelper::Finalize()
+{
+    for (const auto &slot : slots_)
+        result_->merge(slot);
+    slots_.clear();
+}
+
+ROOT::RDF::RResultPtr<QuantileSketch> book_quantile_sketch(ROOT::RDF::RNode node,
+                                                           const std::string &expr,
+                                                           const std::string &weight,
+                                                           double compression)
+{
+    if (expr.empty())
+        throw std::runtime_error("book_quantile_sketch: value expression is required");
+
+    const std::string x_col = unique_column("__qs_x");
+    const std::string w_col = unique_column("__qs_w");
+    ROOT::RDF::RNode booked =
+        node.Define(x_col, "static_cast<double>(" + expr + ")")
+            .Define(w_col, weight.empty() ? std::string("1.0") : "static_cast<double>(" + weight + ")");
+
+    QuantileSketchHelper helper(compression, booked.GetNSlots());
+    return booked.Book<double, double>(std::move(helper), {x_col, w_col});
+}
+
+} // namespace nu
@@ -0,0 +1,478 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/ResponseMatrix.cc
+ *
+ *  @brief Implementation of the sparse multi-universe response matrix.
+ */
+
+#include "ResponseMatrix.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TemplateBinningBlock.hh"
+#include "UniverseHist.hh"
+#include "UniverseWeightCodec.hh"
+
+
+namespace nu
+{
+
+namespace
+{
+
+std::string unique_column(const std::string &stem)
+{
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+}
+
+bool has_column(ROOT::RDF::RNode node, const std::string &name)
+{
+    const auto names = node.GetColumnNames();
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+std::string as_double_expr(const std::string &expr, const std::string &fallback)
+{
+    if (expr.empty())
+        return fallback;
+    return "static_cast<double>(" + expr + ")";
+}
+
+std::string as_bool_expr(const std::string &expr)
+{
+    if (expr.empty())
+        return "true";
+    return "static_cast<bool>(" + expr + ")";
+}
+
+/// Define the flat bin index of @p block (-1 outside it or its selection).
+ROOT::RDF::RNode define_block_bin(ROOT::RDF::RNode node,
+                                  const std::string &bin_col,
+                                  const TemplateBinningBlock &block,
+                                  const std::string &x_expr,
+                                  const std::string &y_expr,
+                                  const std::string &axis)
+{
+    const BlockBinning binning(block);
+    if (x_expr.empty())
+        throw std::runtime_error("book_response_matrix: " + axis + " x expression is required");
+    if (binning.is_2d() && y_expr.empty())
+        throw std::runtime_error("book_response_matrix: " + axis + " block is 2D but has no y expression");
+
+    const std::string x_col = unique_column("__rm_" + axis + "_x");
+    const std::string y_col = unique_column("__rm_" + axis + "_y");
+    const std::string sel_col = unique_column("__rm_" + axis + "_sel");
+
+    return node.Define(x_col, as_double_expr(x_expr, "0.0"))
+        .Define(y_col, binning.is_2d() ? as_double_expr(y_expr, "0.0") : std::string("0.0"))
+        .Define(sel_col, as_bool_expr(block.GetSelection()))
+        .Define(bin_col,
+                [binning](double x, double y, bool pass) { return pass ? binning.find(x, y) : -1; },
+                {x_col, y_col, sel_col});
+}
+
+} // namespace
+
+BlockBinning::BlockBinning(const TemplateBinningBlock &block)
+    : x_edges_(block.GetVector())
+{
+    const int n_x = block.GetNBinsX();
+    if (block.Is2D())
+    {
+        for (int i = 0; i < n_x; ++i)
+        {
+            offsets_.push_back(n_bins_);
+            y_edges_.push_back(block.GetVector(i));
+            n_bins_ += block.GetNBinsY(i);
+        }
+    }
+    else
+    {
+        n_bins_ = n_x;
+    }
+}
+
+int BlockBinning::find(double x, double y) const
+{
+    if (x_edges_.size() < 2 || !(x >= x_edges_.front() && x < x_edges_.back()))
+        return -1;
+    const auto ix = static_cast<std::size_t>(std::upper_bound(x_edges_.begin(), x_edges_.end(), x) - x_edges_.begin() - 1);
+    if (y_edges_.empty())
+        return static_cast<int>(ix);
+
+    const std::vector<double> &ys = y_edges_[ix];
+    if (!(y >= ys.front() && y < ys.back()))
+        return -1;
+    const auto iy = std::upper_bound(ys.begin(), ys.end(), y) - ys.begin() - 1;
+    return offsets_[ix] + static_cast<int>(iy);
+}
+
+ResponseMatrix::ResponseMatrix(std::string name, int n_truth, int n_reco, int n_universes)
+    : name_(std::move(name)),
+      n_truth_(n_truth),
+      n_reco_(n_reco),
+      n_universes_(std::max(0, n_universes))
+{
+    if (n_truth_ <= 0 || n_reco_ <= 0)
+        throw std::runtime_error("ResponseMatrix: truth and reco binnings need at least one bin");
+}
+
+std::uint64_t ResponseMatrix::key(int truth, int reco) const
+{
+    return static_cast<std::uint64_t>(truth) * static_cast<std::uint64_t>(n_reco_ + 1) +
+           static_cast<std::uint64_t>(reco);
+}
+
+const double *ResponseMatrix::find_row(int truth, int reco) const
+{
+    if (truth < 0 || truth > n_truth_ || reco < 0 || reco > n_reco_)
+        throw std::out_of_range("ResponseMatrix: cell (" + std::to_string(truth) + ", " + std::to_string(reco) +
+                                ") out of range");
+    const auto it = index_.find(key(truth, reco));
+    return it == index_.end() ? nullptr : rows_.data() + it->second * stride();
+}
+
+double *ResponseMatrix::row(std::uint64_t k)
+{
+    const auto inserted = index_.emplace(k, keys_.size());
+    if (inserted.second)
+    {
+        keys_.push_back(k);
+        rows_.resize(rows_.size() + stride(), 0.0);
+    }
+    return rows_.data() + inserted.first->second * stride();
+}
+
+void ResponseMatrix::widen(int n_universes)
+{
+    if (n_universes <= n_universes_)
+        return;
+
+    const std::size_t old_stride = stride();
+    n_universes_ = n_universes;
+    const std::size_t new_stride = stride();
+
+    std::vector<double> wider(keys_.size() * new_stride, 0.0);
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+    {
+        const double *src = rows_.data() + i * old_stride;
+        double *dst = wider.data() + i * new_stride;
+        std::copy(src, src + old_stride, dst);
+        std::fill(dst + old_stride, dst + new_stride, src[0]);
+    }
+    rows_.swap(wider);
+}
+
+double ResponseMatrix::get(int truth, int reco, int u) const
+{
+    if (u >= n_universes_)
+        throw std::out_of_range("ResponseMatrix::get: universe index out of range");
+    const double *r = find_row(truth, reco);
+    if (r == nullptr)
+        return 0.0;
+    return u < 0 ? r[0] : r[2 + u];
+}
+
+double ResponseMatrix::sumw2(int truth, int reco) const
+{
+    const double *r = find_row(truth, reco);
+    return r == nullptr ? 0.0 : r[1];
+}
+
+std::vector<double> ResponseMatrix::truth_totals(int u) const
+{
+    const std::size_t col = u < 0 ? 0 : 2 + static_cast<std::size_t>(u);
+    std::vector<double> out(static_cast<std::size_t>(n_truth_), 0.0);
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+    {
+        const auto t = static_cast<int>(keys_[i] / static_cast<std::uint64_t>(n_reco_ + 1));
+        if (t < n_truth_)
+            out[static_cast<std::size_t>(t)] += rows_[i * stride() + col];
+    }
+    return out;
+}
+
+std::vector<double> ResponseMatrix::reco_totals(int u) const
+{
+    const std::size_t col = u < 0 ? 0 : 2 + static_cast<std::size_t>(u);
+    std::vector<double> out(static_cast<std::size_t>(n_reco_), 0.0);
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+    {
+        const auto r = static_cast<int>(keys_[i] % static_cast<std::uint64_t>(n_reco_ + 1));
+        if (r < n_reco_)
+            out[static_cast<std::size_t>(r)] += rows_[i * stride() + col];
+    }
+    return out;
+}
+
+std::vector<double> ResponseMatrix::background(int u) const
+{
+    std::vector<double> out(static_cast<std::size_t>(n_reco_), 0.0);
+    for (int r = 0; r < n_reco_; ++r)
+        out[static_cast<std::size_t>(r)] = get(n_truth_, r, u);
+    return out;
+}
+
+std::vector<double> ResponseMatrix::efficiency(int u) const
+{
+    const std::vector<double> totals = truth_totals(u);
+    std::vector<double> out(static_cast<std::size_t>(n_truth_), 0.0);
+    for (int t = 0; t < n_truth_; ++t)
+    {
+        const double total = totals[static_cast<std::size_t>(t)];
+        if (total > 0.0)
+            out[static_cast<std::size_t>(t)] = (total - get(t, n_reco_, u)) / total;
+    }
+    return out;
+}
+
+TMatrixD ResponseMatrix::smearing(int u) const
+{
+    const std::size_t col = u < 0 ? 0 : 2 + static_cast<std::size_t>(u);
+    const std::vector<double> totals = truth_totals(u);
+    TMatrixD out(n_reco_, n_truth_);
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+    {
+        const auto t = static_cast<int>(keys_[i] / static_cast<std::uint64_t>(n_reco_ + 1));
+        const auto r = static_cast<int>(keys_[i] % static_cast<std::uint64_t>(n_reco_ + 1));
+        const double total = (t < n_truth_) ? totals[static_cast<std::size_t>(t)] : 0.0;
+        if (r < n_reco_ && total > 0.0)
+            out(r, t) = rows_[i * stride() + col] / total;
+    }
+    return out;
+}
+
+std::unique_ptr<TH2D> ResponseMatrix::joint_hist(int u, const std::string &hist_name) const
+{
+    const std::string hname =
+        !hist_name.empty() ? hist_name : (name_ + (u < 0 ? std::string("_nominal") : "_u" + std::to_string(u)));
+    auto h = std::make_unique<TH2D>(hname.c_str(), ";truth bin;reco bin",
+                                    n_truth_ + 1, -0.5, n_truth_ + 0.5,
+                                    n_reco_ + 1, -0.5, n_reco_ + 0.5);
+    h->SetDirectory(nullptr);
+    if (u < 0)
+        h->Sumw2();
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+    {
+        const auto t = static_cast<int>(keys_[i] / static_cast<std::uint64_t>(n_reco_ + 1));
+        const auto r = static_cast<int>(keys_[i] % static_cast<std::uint64_t>(n_reco_ + 1));
+        const double *row = rows_.data() + i * stride();
+        h->SetBinContent(t + 1, r + 1, u < 0 ? row[0] : row[2 + u]);
+        if (u < 0)
+            h->SetBinError(t + 1, r + 1, std::sqrt(std::max(0.0, row[1])));
+    }
+    return h;
+}
+
+std::vector<std::pair<int, int>> ResponseMatrix::smearing_cells() const
+{
+    std::vector<std::pair<int, int>> out;
+    for (const std::uint64_t k : keys_)
+    {
+        const auto t = static_cast<int>(k / static_cast<std::uint64_t>(n_reco_ + 1));
+        const auto r = static_cast<int>(k % static_cast<std::uint64_t>(n_reco_ + 1));
+        if (t < n_truth_ && r < n_reco_)
+            out.emplace_back(t, r);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+CovarianceBuilder ResponseMatrix::covariance() const
+{
+    const std::vector<std::pair<int, int>> cells = smearing_cells();
+
+    CovarianceBuilder builder;
+    if (!cells.empty())
+        builder.add_block("smearing", static_cast<int>(cells.size()));
+    builder.add_block("efficiency", n_truth_);
+    builder.add_block("background", n_reco_);
+
+    // Universe u's joint vector: smearing cells, efficiency, background.
+    auto joint = [&](int u)
+    {
+        const std::vector<double> totals = truth_totals(u);
+        std::vector<double> out;
+        out.reserve(static_cast<std::size_t>(builder.n_bins()));
+        for (const auto &cell : cells)
+        {
+            const double total = totals[static_cast<std::size_t>(cell.first)];
+            out.push_back(total > 0.0 ? get(cell.first, cell.second, u) / total : 0.0);
+        }
+        const std::vector<double> eff = efficiency(u);
+        const std::vector<double> bkg = background(u);
+        out.insert(out.end(), eff.begin(), eff.end());
+        out.insert(out.end(), bkg.begin(), bkg.end());
+        return out;
+    };
+
+    builder.set_central_value(joint(-1));
+    for (int u = 0; u < n_universes_; ++u)
+        builder.add_universe(joint(u));
+    return builder;
+}
+
+void ResponseMatrix::add(const ResponseMatrix &other)
+{
+    if (other.n_truth_ != n_truth_ || other.n_reco_ != n_reco_ || other.n_universes_ != n_universes_)
+        throw std::runtime_error("ResponseMatrix::add: incompatible binning or universe count");
+
+    const std::size_t n = stride();
+    for (std::size_t i = 0; i < other.keys_.size(); ++i)
+    {
+        double *dst = row(other.keys_[i]);
+        const double *src = other.rows_.data() + i * n;
+        for (std::size_t c = 0; c < n; ++c)
+            dst[c] += src[c];
+    }
+}
+
+ResponseMatrixHelper::ResponseMatrixHelper(std::string name,
+                                           int n_truth,
+                                           int n_reco,
+                                           int n_universes,
+                                           unsigned int n_slots)
+    : result_(std::make_shared<ResponseMatrix>(name, n_truth, n_reco, n_universes)),
+      sized_by_data_(n_universes <= 0)
+{
+    const unsigned int slots = std::max(1u, n_slots);
+    slot_matrices_.assign(slots, ResponseMatrix(name, n_truth, n_reco, n_universes));
+    slot_decoded_.assign(slots, std::vector<unsigned short>{});
+}
+
+void ResponseMatrixHelper::Exec(unsigned int slot, int truth, int reco, double w)
+{
+    fill(slot, truth, reco, w, nullptr, 0, 1.0);
+}
+
+void ResponseMatrixHelper::Exec(unsigned int slot,
+                                int truth,
+                                int reco,
+                                double w,
+                                const ROOT::RVec<unsigned short> &packed,
+                                double cv)
+{
+    fill(slot, truth, reco, w, packed.data(), packed.size(), cv);
+}
+
+void ResponseMatrixHelper::Exec(unsigned int slot,
+                                int truth,
+                                int reco,
+                                double w,
+                                const ROOT::RVec<unsigned char> &encoded,
+                                double cv)
+{
+    std::vector<unsigned short> &buffer = slot_decoded_[slot];
+    buffer.resize(UniverseWeightCodec::decoded_size(encoded.data(), encoded.size()));
+    const std::size_t n = UniverseWeightCodec::decode(encoded.data(), encoded.size(), buffer.data(), buffer.size());
+    fill(slot, truth, reco, w, buffer.data(), n, cv);
+}
+
+void ResponseMatrixHelper::fill(unsigned int slot,
+                                int truth,
+                                int reco,
+                                double w,
+                                const unsigned short *packed,
+                                std::size_t n_packed,
+                                double cv)
+{
+    ResponseMatrix &m = slot_matrices_[slot];
+    const int t = (truth >= 0 && truth < m.n_truth_) ? truth : m.n_truth_;
+    const int r = (reco >= 0 && reco < m.n_reco_) ? reco : m.n_reco_;
+    if ((t == m.n_truth_ && r == m.n_reco_) || !std::isfinite(w))
+        return;
+
+    if (sized_by_data_ && n_packed > static_cast<std::size_t>(m.n_universes_))
+        m.widen(static_cast<int>(n_packed));
+
+    double *row = m.row(m.key(t, r));
+    row[0] += w;
+    row[1] += w * w;
+
+    const std::size_t n_universes = static_cast<std::size_t>(m.n_universes_);
+    if (n_universes == 0)
+        return;
+
+    const double cv_safe = (std::isfinite(cv) && cv > 0.0) ? cv : 1.0;
+    const double scale = w / (kUniversePackScale * cv_safe);
+    const std::size_t n_decoded = std::min(n_packed, n_universes);
+
+    double *universes = row + 2;
+    for (std::size_t u = 0; u < n_decoded; ++u)
+        universes[u] += scale * static_cast<double>(packed[u]);
+    for (std::size_t u = n_decoded; u < n_universes; ++u)
+        universes[u] += w;
+}
+
+void ResponseMatrixHelper::Finalize()
+{
+    if (sized_by_data_)
+    {
+        int n_universes = 0;
+        for (const auto &m : slot_matrices_)
+            n_universes = std::max(n_universes, m.n_universes_);
+        *result_ = ResponseMatrix(result_->name_, result_->n_truth_, result_->n_reco_, n_universes);
+        for (auto &m : slot_matrices_)
+            m.widen(n_universes);
+    }
+
+    for (const auto &m : slot_matrices_)
+        result_->add(m);
+
+    slot_matrices_.clear();
+    slot_decoded_.clear();
+}
+
+ROOT::RDF::RResultPtr<ResponseMatrix> book_response_matrix(ROOT::RDF::RNode node,
+                                                           const TemplateBinningBlock &truth,
+                                                           const TemplateBinningBlock &reco,
+                                                           const ResponseMatrixSpec &spec)
+{
+    const int n_truth = BlockBinning(truth).n_bins();
+    const int n_reco = BlockBinning(reco).n_bins();
+
+    const std::string t_col = unique_column("__rm_t");
+    const std::string r_col = unique_column("__rm_r");
+    const std::string w_col = unique_column("__rm_w");
+
+    ROOT::RDF::RNode booked = define_block_bin(node, t_col, truth, spec.truth_x, spec.truth_y, "truth");
+    booked = define_block_bin(booked, r_col, reco, spec.reco_x, spec.reco_y, "reco");
+    booked = booked.Define(w_col, as_double_expr(spec.weight, "1.0"));
+
+    const std::string name = !spec.name.empty()
+                                 ? spec.name
+                                 : (std::string(truth.GetName()) + "_" + reco.GetName() +
+                                    (spec.universe_column.empty() ? std::string() : "_" + spec.universe_column));
+
+    if (spec.universe_column.empty())
+    {
+        ResponseMatrixHelper helper(name, n_truth, n_reco, 0, booked.GetNSlots());
+        return booked.Book<int, int, double>(std::move(helper), {t_col, r_col, w_col});
+    }
+
+    const std::string cv_col = unique_column("__rm_cv");
+    booked = booked.Define(cv_col, as_double_expr(spec.cv_column, "1.0"));
+
+    ResponseMatrixHelper helper(name, n_truth, n_reco, spec.n_universes, booked.GetNSlots());
+
+    const std::string encoded = UniverseWeightCodec::encoded_column(spec.universe_column);
+    if (has_column(booked, encoded))
+    {
+        return booked.Book<int, int, double, ROOT::RVec<unsigned char>, double>(
+            std::move(helper),
+            {t_col, r_col, w_col, encoded, cv_col});
+    }
+
+    return booked.Book<int, int, double, ROOT::RVec<unsigned short>, double>(
+        std::move(helper),
+        {t_col, r_col, w_col, spec.universe_column, cv_col});
+}
+
+} // namespace nu
@@ -2,7 +2,7 @@
 /**
  *  @file framework/modules/plot/src/TemplateBinningBlock.cc
  *
- *  @brief Implementation of block-style 1D binning container.
+ *  @brief Implementation of block-style 1D/2D binning container.
  */
 
 #include "TemplateBinningBlock.hh"
@@ -25,6 +25,23 @@ TemplateBinningBlock::TemplateBinningBlock(const std::string &name,
     init();
 }
 
+TemplateBinningBlock::TemplateBinningBlock(const std::string &name,
+                                           const std::string &title,
+                                           const std::vector<double> &x_edges,
+                                           const std::vector<std::vector<double>> &y_edges,
+                                           const std::string &selection,
+                                           int bin_type)
+    : TNamed(name.c_str(), title.c_str()),
+      m_name(name),
+      m_title(title),
+      m_edges(x_edges),
+      m_y_edges(y_edges),
+      m_selection(selection),
+      m_bin_type(bin_type)
+{
+    init();
+}
+
 void TemplateBinningBlock::init()
 {
     if (m_edges.size() < 2)
@@ -38,25 +55,68 @@ void TemplateBinningBlock::init()
         m_bin_def.push_back(os.str());
     }
 
+    m_bin_def_y.clear();
+    if (!m_y_edges.empty())
+    {
+        if (m_y_edges.size() + 1 != m_edges.size())
+            throw std::runtime_error("TemplateBinningBlock requires one set of y edges per x bin");
+
+        for (size_t i = 0; i < m_y_edges.size(); ++i)
+        {
+            const auto &y = m_y_edges[i];
+            if (y.size() < 2)
+                throw std::runtime_error("TemplateBinningBlock requires at least two y edges per x bin");
+
+            std::vector<std::string> defs;
+            for (size_t j = 0; j + 1 < y.size(); ++j)
+            {
+                std::ostringstream os;
+                os << m_bin_def[i] << " x [" << y[j] << ", " << y[j + 1] << ")";
+                defs.push_back(os.str());
+            }
+            m_bin_def_y.push_back(std::move(defs));
+        }
+    }
+
     m_x_name = m_name;
     m_x_title = m_title;
     m_x_tex_title = m_title;
 }
 
 int TemplateBinningBlock::GetNBinsX() const { return static_cast<int>(m_edges.size()) - 1; }
-int TemplateBinningBlock::GetNBinsY(int) const { return 0; }
+int TemplateBinningBlock::GetNBinsY(int idx) const
+{
+    if (m_y_edges.empty())
+        return 0;
+    return static_cast<int>(m_y_edges.at(static_cast<size_t>(idx)).size()) - 1;
+}
 int TemplateBinningBlock::GetNBinsZ(int, int) const { return 0; }
 
 std::string TemplateBinningBlock::GetBinDef(int idx) const { return m_bin_def.at(static_cast<size_t>(idx)); }
-std::string TemplateBinningBlock::GetBinDef(int x, int) const { return GetBinDef(x); }
-std::string TemplateBinningBlock::GetBinDef(int x, int, int) const { return GetBinDef(x); }
+std::string TemplateBinningBlock::GetBinDef(int x, int y) const
+{
+    if (m_bin_def_y.empty())
+        return GetBinDef(x);
+    return m_bin_def_y.at(static_cast<size_t>(x)).at(static_cast<size_t>(y));
+}
+std::string TemplateBinningBlock::GetBinDef(int x, int y, int) const { return GetBinDef(x, y); }
 
 int TemplateBinningBlock::GetBinType() const { return m_bin_type; }
 
 Double_t TemplateBinningBlock::GetBinXLow(int i) const { return m_edges.at(static_cast<size_t>(i)); }
 Double_t TemplateBinningBlock::GetBinXHigh(int i) const { return m_edges.at(static_cast<size_t>(i + 1)); }
-Double_t TemplateBinningBlock::GetBinYLow(int, int) const { return -9999999; }
-Double_t TemplateBinningBlock::GetBinYHigh(int, int) const { return -9999999; }
+Double_t TemplateBinningBlock::GetBinYLow(int i, int j) const
+{
+    if (m_y_edges.empty())
+        return -9999999;
+    return m_y_edges.at(static_cast<size_t>(i)).at(static_cast<size_t>(j));
+}
+Double_t TemplateBinningBlock::GetBinYHigh(int i, int j) const
+{
+    if (m_y_edges.empty())
+        return -9999999;
+    return m_y_edges.at(static_cast<size_t>(i)).at(static_cast<size_t>(j + 1));
+}
 
 std::string TemplateBinningBlock::GetXName() const { return m_x_name; }
 std::string TemplateBinningBlock::GetXNameUnit() const { return m_x_name_unit; }
@@ -82,9 +142,14 @@ std::string TemplateBinningBlock::GetZTexTitleUnit() const { return m_z_tex_titl
 std::string TemplateBinningBlock::GetSelection() const { return m_selection; }
 
 std::vector<double> TemplateBinningBlock::GetVector() const { return m_edges; }
-std::vector<double> TemplateBinningBlock::GetVector(int) const { return m_edges; }
-std::vector<double> TemplateBinningBlock::GetVector(int, int) const { return m_edges; }
+std::vector<double> TemplateBinningBlock::GetVector(int x) const
+{
+    if (m_y_edges.empty())
+        return m_edges;
+    return m_y_edges.at(static_cast<size_t>(x));
+}
+std::vector<double> TemplateBinningBlock::GetVector(int x, int) const { return GetVector(x); }
 
-bool TemplateBinningBlock::Is1D() const { return true; }
-bool TemplateBinningBlock::Is2D() const { return false; }
+bool TemplateBinningBlock::Is1D() const { return m_y_edges.empty(); }
+bool TemplateBinningBlock::Is2D() const { return !m_y_edges.empty(); }
 bool TemplateBinningBlock::Is3D() const { return false; }
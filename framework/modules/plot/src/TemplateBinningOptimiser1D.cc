@@ -18,7 +18,9 @@
 #include <limits>
 #include <memory>
 #include <ostream>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 
 #include "TemplateBinningBlock.hh"
@@ -70,10 +72,11 @@ bool invert_symmetric_svd(const TMatrixDSym &a, TMatrixDSym &a_inverse)
     const int n = a.GetNrows();
     TMatrixD dense(n, n);
 
+    // Only the lower triangle is filled by the accumulators above.
     for (int i = 0; i < n; ++i)
     {
         for (int j = 0; j < n; ++j)
-            dense(i, j) = a(i, j);
+            dense(i, j) = (j <= i) ? a(i, j) : a(j, i);
     }
 
     TDecompSVD svd(dense);
@@ -104,21 +107,11 @@ struct ConstraintEval
     double rel_mc_worst = 0.0;
 };
 
-struct FineCache
+struct FineCache : TemplateBinningOptimizer1D::FineTemplates
 {
     int n_fine = 0;
-    int n_channel = 0;
     int n_parameter = 0;
 
-    std::vector<double> edges;
-    std::vector<std::string> parameter_names;
-    std::vector<double> prior_sigmas;
-    int poi_index = 0;
-
-    std::vector<double> mu;
-    std::vector<double> var;
-    std::vector<double> dmu;
-
     double get_mu(const int c, const int i) const { return mu[c * n_fine + i]; }
     double get_var(const int c, const int i) const { return var[c * n_fine + i]; }
     double get_dmu(const int c, const int p, const int i) const { return dmu[(c * n_parameter + p) * n_fine + i]; }
@@ -202,7 +195,8 @@ double sigma_poi_from_fisher(const TMatrixDSym &fisher_without_priors,
     return std::sqrt(variance);
 }
 
-ConstraintEval evaluate_constraints(const BinState &bin,
+ConstraintEval evaluate_constraints(const double *bin_mu,
+                                    const double *bin_var,
                                     const TemplateBinningOptimizer1D::Config &cfg,
                                     const int n_channel,
                                     const double mu_floor_for_rel)
@@ -217,9 +211,9 @@ ConstraintEval evaluate_constraints(const BinState &bin,
 
         for (int c = 0; c < n_channel; ++c)
         {
-            const double mu = bin.mu[c];
+            const double mu = bin_mu[c];
             const double rel = (mu > 0.0)
-                                   ? std::sqrt(std::max(bin.var[c], 0.0)) / std::max(mu, mu_floor_for_rel)
+                                   ? std::sqrt(std::max(bin_var[c], 0.0)) / std::max(mu, mu_floor_for_rel)
                                    : std::numeric_limits<double>::infinity();
 
             mu_sum += mu;
@@ -253,8 +247,8 @@ ConstraintEval evaluate_constraints(const BinState &bin,
     double var_sum = 0.0;
     for (int c = 0; c < n_channel; ++c)
     {
-        mu_sum += bin.mu[c];
-        var_sum += bin.var[c];
+        mu_sum += bin_mu[c];
+        var_sum += bin_var[c];
     }
 
     const double rel = (mu_sum > 0.0)
@@ -284,6 +278,14 @@ ConstraintEval evaluate_constraints(const BinState &bin,
     return out;
 }
 
+ConstraintEval evaluate_constraints(const BinState &bin,
+                                    const TemplateBinningOptimizer1D::Config &cfg,
+                                    const int n_channel,
+                                    const double mu_floor_for_rel)
+{
+    return evaluate_constraints(bin.mu.data(), bin.var.data(), cfg, n_channel, mu_floor_for_rel);
+}
+
 FineCache build_fine_cache(const std::vector<TemplateBinningOptimizer1D::Channel> &channels,
                            const TemplateBinningOptimizer1D::Config &cfg)
 {
@@ -418,6 +420,36 @@ FineCache build_fine_cache(const std::vector<TemplateBinningOptimizer1D::Channel
     return cache;
 }
 
+FineCache cache_from_templates(const TemplateBinningOptimizer1D::FineTemplates &templates,
+                               const TemplateBinningOptimizer1D::Config &cfg)
+{
+    FineCache cache;
+    static_cast<TemplateBinningOptimizer1D::FineTemplates &>(cache) = templates;
+    cache.n_fine = static_cast<int>(templates.edges.size()) - 1;
+    cache.n_parameter = static_cast<int>(templates.parameter_names.size());
+
+    if (cache.n_fine < 1 || cache.n_channel < 1 || cache.n_parameter < 1)
+        throw std::runtime_error("fine templates need at least one bin, channel and parameter");
+    if (static_cast<int>(cache.prior_sigmas.size()) != cache.n_parameter)
+        throw std::runtime_error("fine templates have inconsistent prior_sigmas size");
+    if (cache.poi_index < 0 || cache.poi_index >= cache.n_parameter)
+        throw std::runtime_error("fine templates have an out-of-range poi_index");
+
+    const std::size_t n_cells = static_cast<std::size_t>(cache.n_channel) * cache.n_fine;
+    if (cache.mu.size() != n_cells || cache.var.size() != n_cells || cache.dmu.size() != n_cells * cache.n_parameter)
+        throw std::runtime_error("fine templates have inconsistent mu/var/dmu sizes");
+
+    if (cfg.verbose && cfg.p_log)
+    {
+        (*cfg.p_log) << "[TemplateBinningOptimizer1D] fine bins=" << cache.n_fine
+                     << " channels=" << cache.n_channel
+                     << " parameters=" << cache.n_parameter
+                     << " POI=" << cache.parameter_names[cache.poi_index] << "\n";
+    }
+
+    return cache;
+}
+
 BinState make_fine_bin_state(const FineCache &cache,
                              const int i_fine,
                              const double mu_floor_for_objective)
@@ -442,13 +474,12 @@ BinState make_fine_bin_state(const FineCache &cache,
     return state;
 }
 
-BinState merge_bins(const BinState &left,
-                    const BinState &right,
-                    const int n_channel,
-                    const int n_parameter,
-                    const double mu_floor_for_objective)
+void merge_sums(const BinState &left,
+                const BinState &right,
+                const int n_channel,
+                const int n_parameter,
+                BinState &merged)
 {
-    BinState merged;
     merged.low = std::min(left.low, right.low);
     merged.high = std::max(left.high, right.high);
 
@@ -463,40 +494,970 @@ BinState merge_bins(const BinState &left,
         for (int p = 0; p < n_parameter; ++p)
             merged.dmu[c * n_parameter + p] = left.dmu[c * n_parameter + p] + right.dmu[c * n_parameter + p];
     }
+}
 
+BinState merge_bins(const BinState &left,
+                    const BinState &right,
+                    const int n_channel,
+                    const int n_parameter,
+                    const double mu_floor_for_objective)
+{
+    BinState merged;
+    merge_sums(left, right, n_channel, n_parameter, merged);
     merged.fisher = fisher_from_bin_sums(merged, n_channel, n_parameter, mu_floor_for_objective);
     return merged;
 }
 
-} // namespace
+TemplateBinningOptimizer1D::Result make_result(const FineCache &cache,
+                                               const std::vector<BinState> &bins,
+                                               const double expected_sigma_poi,
+                                               const TemplateBinningOptimizer1D::Config &cfg)
+{
+    TemplateBinningOptimizer1D::Result out;
+    out.edges.reserve(bins.size() + 1);
+    out.edges.push_back(cache.edges[bins.front().low]);
+    for (const auto &bin : bins)
+        out.edges.push_back(cache.edges[bin.high + 1]);
 
-TemplateBinningOptimizer1D::TemplateBinningOptimizer1D(Config cfg) : m_cfg(std::move(cfg)) {}
+    out.expected_sigma_poi = expected_sigma_poi;
 
-TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const Channel &channel) const
+    out.bins.reserve(bins.size());
+    for (const auto &bin : bins)
+    {
+        TemplateBinningOptimizer1D::BinReport report;
+        report.low = cache.edges[bin.low];
+        report.high = cache.edges[bin.high + 1];
+
+        const auto eval = evaluate_constraints(bin, cfg, cache.n_channel, cfg.mu_floor_for_objective);
+        report.mu_sum = eval.mu_sum;
+        report.rel_mc_worst = eval.rel_mc_worst;
+        report.passes_constraints = eval.passes;
+
+        out.bins.push_back(report);
+    }
+
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Incremental strategy
+// ---------------------------------------------------------------------------
+
+constexpr int kCovarianceRefreshInterval = 64;
+constexpr int kMinCandidatesPerThread = 16;
+
+int resolve_threads(const int n_threads)
 {
-    return optimise(std::vector<Channel>{channel});
+    if (n_threads > 0)
+        return n_threads;
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
 }
 
-TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const std::vector<Channel> &channels) const
+template <class Fn>
+void parallel_for(const int n, const int n_threads, Fn &&fn, const int min_per_thread = kMinCandidatesPerThread)
+{
+    const int workers = std::max(1, std::min(n_threads, n / min_per_thread));
+    if (workers <= 1)
+    {
+        for (int i = 0; i < n; ++i)
+            fn(i);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    const int chunk = (n + workers - 1) / workers;
+    for (int w = 0; w < workers; ++w)
+    {
+        const int begin = w * chunk;
+        const int end = std::min(n, begin + chunk);
+        pool.emplace_back([begin, end, &fn]() {
+            for (int i = begin; i < end; ++i)
+                fn(i);
+        });
+    }
+    for (auto &t : pool)
+        t.join();
+}
+
+/// Change of the Fisher matrix when two bins merge, as sum_r s_r u_r u_r^T.
+struct MergeUpdate
+{
+    int rank = 0;
+    std::vector<double> u; // column r at [r * n_parameter]
+    std::vector<double> s;
+};
+
+void merge_fisher_update(const BinState &left,
+                         const BinState &right,
+                         const int n_channel,
+                         const int n_parameter,
+                         const double mu_floor,
+                         MergeUpdate &out)
+{
+    out.rank = 0;
+    out.u.clear();
+    out.s.clear();
+
+    auto add_term = [&](const double scale, const double *x, const double *y, const double cx, const double cy) {
+        out.s.push_back(scale);
+        for (int p = 0; p < n_parameter; ++p)
+            out.u.push_back(cx * x[p] + cy * y[p]);
+        ++out.rank;
+    };
+
+    for (int c = 0; c < n_channel; ++c)
+    {
+        const double a = left.mu[c];
+        const double b = right.mu[c];
+        const double *da = &left.dmu[c * n_parameter];
+        const double *db = &right.dmu[c * n_parameter];
+
+        if (a > 0.0 && b > 0.0 && a >= mu_floor && b >= mu_floor)
+        {
+            // (da+db)(da+db)^T/(a+b) - da da^T/a - db db^T/b
+            //   = -ab/(a+b) (da/a - db/b)(da/a - db/b)^T
+            add_term(-a * b / (a + b), da, db, 1.0 / a, -1.0 / b);
+            continue;
+        }
+
+        // Floored denominators: keep the three rank-1 terms separately.
+        const double d_merged = std::max(a + b, mu_floor);
+        const double d_left = std::max(a, mu_floor);
+        const double d_right = std::max(b, mu_floor);
+        if (d_merged > 0.0)
+            add_term(1.0 / d_merged, da, db, 1.0, 1.0);
+        if (d_left > 0.0)
+            add_term(-1.0 / d_left, da, db, 1.0, 0.0);
+        if (d_right > 0.0)
+            add_term(-1.0 / d_right, da, db, 0.0, 1.0);
+    }
+}
+
+/// Solve m x = b in place (m is n x n, b is n x n_rhs, both row-major).
+bool solve_small(std::vector<double> &m, std::vector<double> &b, const int n, const int n_rhs)
+{
+    double scale = 0.0;
+    for (double v : m)
+        scale = std::max(scale, std::abs(v));
+    const double tiny = 1e-13 * std::max(scale, 1.0);
+
+    for (int k = 0; k < n; ++k)
+    {
+        int pivot = k;
+        for (int i = k + 1; i < n; ++i)
+        {
+            if (std::abs(m[i * n + k]) > std::abs(m[pivot * n + k]))
+                pivot = i;
+        }
+        if (!(std::abs(m[pivot * n + k]) > tiny))
+            return false;
+
+        if (pivot != k)
+        {
+            for (int j = 0; j < n; ++j)
+                std::swap(m[k * n + j], m[pivot * n + j]);
+            for (int j = 0; j < n_rhs; ++j)
+                std::swap(b[k * n_rhs + j], b[pivot * n_rhs + j]);
+        }
+
+        for (int i = k + 1; i < n; ++i)
+        {
+            const double f = m[i * n + k] / m[k * n + k];
+            if (f == 0.0)
+                continue;
+            for (int j = k; j < n; ++j)
+                m[i * n + j] -= f * m[k * n + j];
+            for (int j = 0; j < n_rhs; ++j)
+                b[i * n_rhs + j] -= f * b[k * n_rhs + j];
+        }
+    }
+
+    for (int k = n - 1; k >= 0; --k)
+    {
+        for (int j = 0; j < n_rhs; ++j)
+        {
+            double v = b[k * n_rhs + j];
+            for (int i = k + 1; i < n; ++i)
+                v -= m[k * n + i] * b[i * n_rhs + j];
+            b[k * n_rhs + j] = v / m[k * n + k];
+        }
+    }
+
+    return true;
+}
+
+/**
+ *  Posterior POI variance tracked under low-rank Fisher updates.
+ *
+ *  Profiled: the full covariance C = (F + priors)^-1 is kept and updated with
+ *  C' = C - W (I + S U^T W)^-1 S W^T, W = C U (Woodbury), so a candidate costs
+ *  O(p^2 r) instead of an O(p^3) inversion. Not profiled: only I_pp is needed.
+ */
+class PoiVariance
+{
+  public:
+    PoiVariance(const FineCache &cache, const bool profile) : m_n(cache.n_parameter), m_poi(cache.poi_index), m_profile(profile) {}
+
+    bool reset(const TMatrixDSym &fisher_without_priors, const std::vector<double> &prior_sigmas)
+    {
+        TMatrixDSym total(fisher_without_priors);
+        for (int a = 0; a < m_n; ++a)
+        {
+            if (prior_sigmas[a] > 0.0)
+                total(a, a) += 1.0 / (prior_sigmas[a] * prior_sigmas[a]);
+        }
+
+        if (!m_profile)
+        {
+            m_info_poi = total(m_poi, m_poi);
+            return true;
+        }
+
+        TMatrixDSym covariance(m_n);
+        if (!invert_symmetric_svd(total, covariance))
+            return false;
+
+        m_cov.assign(static_cast<std::size_t>(m_n) * m_n, 0.0);
+        for (int i = 0; i < m_n; ++i)
+        {
+            for (int j = 0; j <= i; ++j)
+            {
+                m_cov[i * m_n + j] = covariance(i, j);
+                m_cov[j * m_n + i] = covariance(i, j);
+            }
+        }
+        return true;
+    }
+
+    double sigma() const { return sigma_from_variance(variance()); }
+
+    /// POI sigma after applying @p up, without changing the state.
+    double sigma_after(const MergeUpdate &up) const
+    {
+        if (!m_profile)
+        {
+            double info = m_info_poi;
+            for (int r = 0; r < up.rank; ++r)
+            {
+                const double u_p = up.u[r * m_n + m_poi];
+                info += up.s[r] * u_p * u_p;
+            }
+            return (info > 0.0 && std::isfinite(info)) ? 1.0 / std::sqrt(info) : std::numeric_limits<double>::infinity();
+        }
+
+        if (up.rank == 0)
+            return sigma();
+
+        std::vector<double> w;
+        std::vector<double> m;
+        make_system(up, w, m);
+
+        // x solves M x = S w_poi; var' = var - w_poi . x
+        std::vector<double> x(up.rank);
+        for (int r = 0; r < up.rank; ++r)
+            x[r] = up.s[r] * w[r * m_n + m_poi];
+        if (!solve_small(m, x, up.rank, 1))
+            return std::numeric_limits<double>::infinity();
+
+        double variance = m_cov[m_poi * m_n + m_poi];
+        for (int r = 0; r < up.rank; ++r)
+            variance -= w[r * m_n + m_poi] * x[r];
+        return sigma_from_variance(variance);
+    }
+
+    /// Apply @p up; false if the updated matrix is singular (state unchanged).
+    bool apply(const MergeUpdate &up)
+    {
+        if (!m_profile)
+        {
+            for (int r = 0; r < up.rank; ++r)
+            {
+                const double u_p = up.u[r * m_n + m_poi];
+                m_info_poi += up.s[r] * u_p * u_p;
+            }
+            return true;
+        }
+
+        if (up.rank == 0)
+            return true;
+
+        std::vector<double> w;
+        std::vector<double> m;
+        make_system(up, w, m);
+
+        // X (rank x n) solves M X = S W^T.
+        std::vector<double> x(static_cast<std::size_t>(up.rank) * m_n);
+        for (int r = 0; r < up.rank; ++r)
+        {
+            for (int j = 0; j < m_n; ++j)
+                x[r * m_n + j] = up.s[r] * w[r * m_n + j];
+        }
+        if (!solve_small(m, x, up.rank, m_n))
+            return false;
+
+        for (int i = 0; i < m_n; ++i)
+        {
+            for (int j = 0; j <= i; ++j)
+            {
+                double v = 0.0;
+                for (int r = 0; r < up.rank; ++r)
+                    v += 0.5 * (w[r * m_n + i] * x[r * m_n + j] + w[r * m_n + j] * x[r * m_n + i]);
+                m_cov[i * m_n + j] -= v;
+                if (i != j)
+                    m_cov[j * m_n + i] -= v;
+            }
+        }
+        return true;
+    }
+
+  private:
+    double variance() const
+    {
+        if (!m_profile)
+            return (m_info_poi > 0.0) ? 1.0 / m_info_poi : std::numeric_limits<double>::infinity();
+        return m_cov[m_poi * m_n + m_poi];
+    }
+
+    static double sigma_from_variance(const double variance)
+    {
+        if (!(variance > 0.0) || !std::isfinite(variance))
+            return std::numeric_limits<double>::infinity();
+        return std::sqrt(variance);
+    }
+
+    // w: column r = C u_r; m = I + S U^T W (rank x rank, row-major).
+    void make_system(const MergeUpdate &up, std::vector<double> &w, std::vector<double> &m) const
+    {
+        w.assign(static_cast<std::size_t>(up.rank) * m_n, 0.0);
+        for (int r = 0; r < up.rank; ++r)
+        {
+            const double *u = &up.u[r * m_n];
+            double *wr = &w[r * m_n];
+            for (int i = 0; i < m_n; ++i)
+            {
+                const double *row = &m_cov[i * m_n];
+                double v = 0.0;
+                for (int j = 0; j < m_n; ++j)
+                    v += row[j] * u[j];
+                wr[i] = v;
+            }
+        }
+
+        m.assign(static_cast<std::size_t>(up.rank) * up.rank, 0.0);
+        for (int a = 0; a < up.rank; ++a)
+        {
+            for (int b = 0; b < up.rank; ++b)
+            {
+                double v = 0.0;
+                for (int i = 0; i < m_n; ++i)
+                    v += up.u[a * m_n + i] * w[b * m_n + i];
+                m[a * up.rank + b] = (a == b ? 1.0 : 0.0) + up.s[a] * v;
+            }
+        }
+    }
+
+    int m_n = 0;
+    int m_poi = 0;
+    bool m_profile = true;
+    double m_info_poi = 0.0;
+    std::vector<double> m_cov;
+};
+
+struct MergeCandidate
+{
+    int left = -1;
+    int right = -1;
+    unsigned left_version = 0;
+    unsigned right_version = 0;
+    unsigned epoch = 0;
+
+    // 0: touches a failing bin, 1: otherwise, 2: non-finite cost.
+    int tier = 2;
+    double cost = std::numeric_limits<double>::infinity();
+};
+
+struct CandidateAfter
+{
+    bool operator()(const MergeCandidate &a, const MergeCandidate &b) const
+    {
+        if (a.tier != b.tier)
+            return a.tier > b.tier;
+        if (a.cost != b.cost)
+            return a.cost > b.cost;
+        return a.left > b.left;
+    }
+};
+
+/// Greedy merging as in the exhaustive loop, with a cost queue and Woodbury
+/// updates. Returns false if the starting covariance cannot be formed.
+bool optimise_incremental(const FineCache &cache,
+                          const TemplateBinningOptimizer1D::Config &cfg,
+                          TemplateBinningOptimizer1D::Result &out)
+{
+    const int n_fine = cache.n_fine;
+    const int n_channel = cache.n_channel;
+    const int n_parameter = cache.n_parameter;
+    const double mu_floor = cfg.mu_floor_for_objective;
+    const int n_threads = resolve_threads(cfg.n_threads);
+
+    std::vector<BinState> bins;
+    bins.reserve(n_fine);
+    for (int i = 0; i < n_fine; ++i)
+        bins.push_back(make_fine_bin_state(cache, i, mu_floor));
+
+    auto total_fisher_of = [&](const std::vector<char> &alive) {
+        TMatrixDSym total(n_parameter);
+        for (int i = 0; i < n_fine; ++i)
+        {
+            if (alive[i])
+                add_sym_in_place(total, fisher_from_bin_sums(bins[i], n_channel, n_parameter, mu_floor), +1.0);
+        }
+        return total;
+    };
+
+    std::vector<char> alive(n_fine, 1);
+    std::vector<int> prev(n_fine);
+    std::vector<int> next(n_fine);
+    std::vector<unsigned> version(n_fine, 0);
+    std::vector<char> failing(n_fine, 0);
+    int n_alive = n_fine;
+    int n_failing = 0;
+    for (int i = 0; i < n_fine; ++i)
+    {
+        prev[i] = i - 1;
+        next[i] = (i + 1 < n_fine) ? i + 1 : -1;
+        failing[i] = !evaluate_constraints(bins[i], cfg, n_channel, mu_floor).passes;
+        n_failing += failing[i];
+    }
+
+    PoiVariance poi(cache, cfg.profile_nuisances);
+    if (!poi.reset(total_fisher_of(alive), cache.prior_sigmas))
+        return false;
+
+    double sigma_current = poi.sigma();
+    unsigned epoch = 0;
+
+    auto score = [&](MergeCandidate &cand) {
+        const BinState &left = bins[cand.left];
+        const BinState &right = bins[cand.right];
+
+        BinState merged;
+        merge_sums(left, right, n_channel, n_parameter, merged);
+
+        MergeUpdate up;
+        merge_fisher_update(left, right, n_channel, n_parameter, mu_floor, up);
+
+        const double sigma_candidate = poi.sigma_after(up);
+        const auto merged_eval = evaluate_constraints(merged, cfg, n_channel, mu_floor);
+        const double width = cache.edges[merged.high + 1] - cache.edges[merged.low];
+
+        cand.cost = (sigma_candidate - sigma_current) + merged_eval.penalty + cfg.width_penalty * width;
+        cand.epoch = epoch;
+        if (!(cand.cost < std::numeric_limits<double>::infinity()))
+            cand.tier = 2;
+        else
+            cand.tier = (failing[cand.left] || failing[cand.right]) ? 0 : 1;
+    };
+
+    auto make_candidate = [&](const int left) {
+        MergeCandidate cand;
+        cand.left = left;
+        cand.right = next[left];
+        cand.left_version = version[left];
+        cand.right_version = version[cand.right];
+        return cand;
+    };
+
+    auto is_valid = [&](const MergeCandidate &cand) {
+        return alive[cand.left] && alive[cand.right] && next[cand.left] == cand.right &&
+               version[cand.left] == cand.left_version && version[cand.right] == cand.right_version;
+    };
+
+    std::vector<MergeCandidate> batch;
+    batch.reserve(std::max(0, n_fine - 1));
+    for (int i = 0; i + 1 < n_fine; ++i)
+        batch.push_back(make_candidate(i));
+    parallel_for(static_cast<int>(batch.size()), n_threads, [&](int k) { score(batch[k]); });
+
+    std::priority_queue<MergeCandidate, std::vector<MergeCandidate>, CandidateAfter> queue(CandidateAfter{}, batch);
+
+    const std::size_t refresh_batch = (n_threads > 1) ? static_cast<std::size_t>(n_threads * kMinCandidatesPerThread) : 1;
+
+    auto need_more_merging = [&]() {
+        const bool too_many_bins = (cfg.max_bins > 0) && (n_alive > cfg.max_bins);
+        return n_alive > 1 && (n_failing > 0 || too_many_bins);
+    };
+
+    int iteration = 0;
+    int merges_since_refresh = 0;
+    while (need_more_merging())
+    {
+        ++iteration;
+
+        // Pop until the best valid candidate was scored against the current state.
+        bool found = false;
+        while (!queue.empty())
+        {
+            if (!is_valid(queue.top()))
+            {
+                queue.pop();
+                continue;
+            }
+            if (queue.top().epoch == epoch)
+            {
+                found = true;
+                break;
+            }
+
+            batch.clear();
+            while (!queue.empty() && batch.size() < refresh_batch)
+            {
+                const MergeCandidate &top = queue.top();
+                if (!is_valid(top))
+                {
+                    queue.pop();
+                    continue;
+                }
+                if (top.epoch == epoch)
+                    break;
+                batch.push_back(top);
+                queue.pop();
+            }
+            parallel_for(static_cast<int>(batch.size()), n_threads, [&](int k) { score(batch[k]); });
+            for (const auto &cand : batch)
+                queue.push(cand);
+        }
+
+        if (!found || queue.top().tier == 2)
+            break;
+
+        const MergeCandidate best = queue.top();
+        queue.pop();
+
+        const int l = best.left;
+        const int r = best.right;
+
+        MergeUpdate up;
+        merge_fisher_update(bins[l], bins[r], n_channel, n_parameter, mu_floor, up);
+
+        BinState merged;
+        merge_sums(bins[l], bins[r], n_channel, n_parameter, merged);
+        bins[l] = std::move(merged);
+        bins[r] = BinState{};
+
+        alive[r] = 0;
+        ++version[l];
+        ++version[r];
+        next[l] = next[r];
+        if (next[l] >= 0)
+            prev[next[l]] = l;
+        --n_alive;
+
+        n_failing -= failing[l] + failing[r];
+        failing[r] = 0;
+        failing[l] = !evaluate_constraints(bins[l], cfg, n_channel, mu_floor).passes;
+        n_failing += failing[l];
+
+        // Rebuild from scratch periodically (and on a singular update) to bound drift.
+        ++merges_since_refresh;
+        if (!poi.apply(up) || merges_since_refresh >= kCovarianceRefreshInterval)
+        {
+            if (!poi.reset(total_fisher_of(alive), cache.prior_sigmas))
+                return false;
+            merges_since_refresh = 0;
+        }
+
+        sigma_current = poi.sigma();
+        ++epoch;
+
+        batch.clear();
+        if (prev[l] >= 0)
+            batch.push_back(make_candidate(prev[l]));
+        if (next[l] >= 0)
+            batch.push_back(make_candidate(l));
+
+        if (cfg.rescore_interval > 0 && iteration % cfg.rescore_interval == 0)
+        {
+            // Every queued cost is relative to the old covariance: re-score them all.
+            while (!queue.empty())
+            {
+                if (is_valid(queue.top()))
+                    batch.push_back(queue.top());
+                queue.pop();
+            }
+            parallel_for(static_cast<int>(batch.size()), n_threads, [&](int k) { score(batch[k]); });
+            queue = decltype(queue)(CandidateAfter{}, batch);
+        }
+        else
+        {
+            for (auto &cand : batch)
+            {
+                score(cand);
+                queue.push(cand);
+            }
+        }
+
+        if (cfg.verbose && cfg.p_log)
+        {
+            (*cfg.p_log) << "[TemplateBinningOptimizer1D] iter=" << iteration
+                         << " bins=" << n_alive
+                         << " expected_sigma_poi=" << sigma_current
+                         << "\n";
+        }
+    }
+
+    const double sigma_final = sigma_poi_from_fisher(total_fisher_of(alive), cache.prior_sigmas, cache.poi_index, cfg.profile_nuisances);
+
+    std::vector<BinState> ordered;
+    ordered.reserve(n_alive);
+    for (int i = 0; i >= 0; i = next[i])
+        ordered.push_back(std::move(bins[i]));
+
+    out = make_result(cache, ordered, sigma_final, cfg);
+    return true;
+}
+
+
+// ---------------------------------------------------------------------------
+// Dynamic-programming strategy
+// ---------------------------------------------------------------------------
+
+/// Largest fine grid the DP accepts with dp_max_fine_per_bin = 0: the segment
+/// table holds n (n + 1) / 2 values, about 16 MB here.
+constexpr int kDpMaxUnboundedFine = 2048;
+
+/**
+ *  For a direction v with v_poi = 1, the profiled POI information obeys
+ *  1/sigma^2 = min_v v^T (F + P) v and v^T F v = sum_bins sum_c (v.dmu)^2 / mu
+ *  is additive over bins. Maximising it under the constraints is an exact DP
+ *  over fine-bin boundaries; its optimum bounds the reachable 1/sigma^2 from
+ *  above, and the v that attains the min is re-derived from each solution.
+ */
+struct PrefixSums
+{
+    int n = 0;
+    int n_channel = 0;
+
+    // [c * (n + 1) + k] = sum over fine bins < k
+    std::vector<double> mu;
+    std::vector<double> var;
+    std::vector<double> proj;
+
+    void build(const FineCache &cache)
+    {
+        n = cache.n_fine;
+        n_channel = cache.n_channel;
+        mu.assign(static_cast<std::size_t>(n_channel) * (n + 1), 0.0);
+        var.assign(mu.size(), 0.0);
+        proj.assign(mu.size(), 0.0);
+        for (int c = 0; c < n_channel; ++c)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                mu[c * (n + 1) + i + 1] = mu[c * (n + 1) + i] + cache.get_mu(c, i);
+                var[c * (n + 1) + i + 1] = var[c * (n + 1) + i] + cache.get_var(c, i);
+            }
+        }
+    }
+
+    void project(const FineCache &cache, const std::vector<double> &v)
+    {
+        for (int c = 0; c < n_channel; ++c)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                double d = 0.0;
+                for (int p = 0; p < cache.n_parameter; ++p)
+                    d += v[p] * cache.get_dmu(c, p, i);
+                proj[c * (n + 1) + i + 1] = proj[c * (n + 1) + i] + d;
+            }
+        }
+    }
+};
+
+/// Additive value of every feasible fine range [i, j); -inf where constraints fail.
+struct SegmentTable
 {
-    FineCache cache = build_fine_cache(channels, m_cfg);
+    int n = 0;
+    int max_span = 0;
+    std::vector<std::size_t> offset;
+    std::vector<double> value;
 
+    int last(const int i) const { return std::min(n, i + max_span); }
+    double at(const int i, const int j) const { return value[offset[i] + (j - i - 1)]; }
+};
+
+void fill_segment_table(const PrefixSums &sums,
+                        const TemplateBinningOptimizer1D::Config &cfg,
+                        const int n_threads,
+                        SegmentTable &table)
+{
+    const int n = sums.n;
+    const int n_channel = sums.n_channel;
+    const double mu_floor = cfg.mu_floor_for_objective;
+    const double minus_inf = -std::numeric_limits<double>::infinity();
+
+    table.n = n;
+    table.max_span = (cfg.dp_max_fine_per_bin > 0) ? std::min(cfg.dp_max_fine_per_bin, n) : n;
+    table.offset.assign(n + 1, 0);
+    for (int i = 0; i < n; ++i)
+        table.offset[i + 1] = table.offset[i] + static_cast<std::size_t>(table.last(i) - i);
+    table.value.assign(table.offset[n], minus_inf);
+
+    parallel_for(n, n_threads, [&](int i) {
+        std::vector<double> mu(n_channel);
+        std::vector<double> var(n_channel);
+        for (int j = i + 1; j <= table.last(i); ++j)
+        {
+            for (int c = 0; c < n_channel; ++c)
+            {
+                mu[c] = sums.mu[c * (n + 1) + j] - sums.mu[c * (n + 1) + i];
+                var[c] = sums.var[c * (n + 1) + j] - sums.var[c * (n + 1) + i];
+            }
+            if (!evaluate_constraints(mu.data(), var.data(), cfg, n_channel, mu_floor).passes)
+                continue;
+
+            double info = 0.0;
+            for (int c = 0; c < n_channel; ++c)
+            {
+                const double denom = std::max(mu[c], mu_floor);
+                if (denom <= 0.0)
+                    continue;
+                const double d = sums.proj[c * (n + 1) + j] - sums.proj[c * (n + 1) + i];
+                info += d * d / denom;
+            }
+            table.value[table.offset[i] + (j - i - 1)] = info;
+        }
+    });
+}
+
+/// Best partition of [0, n) into at most @p max_bins feasible ranges; returns
+/// the boundaries (empty if none exists) and the optimum in @p best_value.
+std::vector<int> solve_segments(const SegmentTable &table,
+                                const int max_bins,
+                                const int n_threads,
+                                double &best_value)
+{
+    const int n = table.n;
+    const double minus_inf = -std::numeric_limits<double>::infinity();
+    best_value = minus_inf;
+
+    auto best_ending_at = [&](const std::vector<double> &prev, const int j, int &arg) {
+        double best = minus_inf;
+        arg = -1;
+        for (int i = std::max(0, j - table.max_span); i < j; ++i)
+        {
+            if (prev[i] == minus_inf)
+                continue;
+            const double seg = table.at(i, j);
+            if (seg == minus_inf)
+                continue;
+            if (prev[i] + seg > best)
+            {
+                best = prev[i] + seg;
+                arg = i;
+            }
+        }
+        return best;
+    };
+
+    std::vector<int> cuts;
+    if (max_bins <= 0)
+    {
+        std::vector<double> best(n + 1, minus_inf);
+        std::vector<int> from(n + 1, -1);
+        best[0] = 0.0;
+        for (int j = 1; j <= n; ++j)
+            best[j] = best_ending_at(best, j, from[j]);
+
+        if (best[n] == minus_inf)
+            return cuts;
+        best_value = best[n];
+        for (int j = n; j > 0; j = from[j])
+            cuts.push_back(j);
+    }
+    else
+    {
+        // layer[k][j]: best value covering [0, j) with exactly k ranges.
+        const int n_layers = std::min(max_bins, n);
+        std::vector<std::vector<double>> layer(n_layers + 1, std::vector<double>(n + 1, minus_inf));
+        std::vector<std::vector<int>> from(n_layers + 1, std::vector<int>(n + 1, -1));
+        layer[0][0] = 0.0;
+
+        int best_k = -1;
+        for (int k = 1; k <= n_layers; ++k)
+        {
+            parallel_for(n, n_threads, [&](int jm1) {
+                const int j = jm1 + 1;
+                layer[k][j] = best_ending_at(layer[k - 1], j, from[k][j]);
+            });
+            if (layer[k][n] > best_value)
+            {
+                best_value = layer[k][n];
+                best_k = k;
+            }
+        }
+
+        if (best_k < 0)
+            return cuts;
+        for (int k = best_k, j = n; k > 0; j = from[k][j], --k)
+            cuts.push_back(j);
+    }
+
+    cuts.push_back(0);
+    std::reverse(cuts.begin(), cuts.end());
+    return cuts;
+}
+
+std::vector<BinState> bins_from_cuts(const FineCache &cache, const std::vector<int> &cuts, const double mu_floor)
+{
+    std::vector<BinState> bins;
+    bins.reserve(cuts.size() - 1);
+    for (std::size_t b = 0; b + 1 < cuts.size(); ++b)
+    {
+        BinState bin = make_fine_bin_state(cache, cuts[b], mu_floor);
+        for (int i = cuts[b] + 1; i < cuts[b + 1]; ++i)
+        {
+            BinState merged;
+            merge_sums(bin, make_fine_bin_state(cache, i, mu_floor), cache.n_channel, cache.n_parameter, merged);
+            bin = std::move(merged);
+        }
+        bin.fisher = fisher_from_bin_sums(bin, cache.n_channel, cache.n_parameter, mu_floor);
+        bins.push_back(std::move(bin));
+    }
+    return bins;
+}
+
+/// Direction v (v_poi = 1) minimising v^T (F + P) v, i.e. C e_poi / C_poi,poi.
+bool profiled_direction(const TMatrixDSym &fisher_without_priors,
+                        const FineCache &cache,
+                        std::vector<double> &v)
+{
+    const int n_parameter = cache.n_parameter;
+    TMatrixDSym total(fisher_without_priors);
+    for (int a = 0; a < n_parameter; ++a)
+    {
+        if (cache.prior_sigmas[a] > 0.0)
+            total(a, a) += 1.0 / (cache.prior_sigmas[a] * cache.prior_sigmas[a]);
+    }
+
+    TMatrixDSym covariance(n_parameter);
+    if (!invert_symmetric_svd(total, covariance))
+        return false;
+
+    const int poi = cache.poi_index;
+    const double c_pp = covariance(poi, poi);
+    if (!(c_pp > 0.0) || !std::isfinite(c_pp))
+        return false;
+
+    for (int a = 0; a < n_parameter; ++a)
+        v[a] = ((a >= poi) ? covariance(a, poi) : covariance(poi, a)) / c_pp;
+    return true;
+}
+
+bool optimise_dynamic(const FineCache &cache,
+                      const TemplateBinningOptimizer1D::Config &cfg,
+                      TemplateBinningOptimizer1D::Result &out)
+{
+    const int n_parameter = cache.n_parameter;
+    const double mu_floor = cfg.mu_floor_for_objective;
+    const int n_threads = resolve_threads(cfg.n_threads);
+
+    if (cfg.dp_max_fine_per_bin <= 0 && cache.n_fine > kDpMaxUnboundedFine)
+        throw std::runtime_error("kDynamicProgramming on " + std::to_string(cache.n_fine) +
+                                 " fine bins needs Config::dp_max_fine_per_bin (unbounded is O(n^2))");
+
+    PrefixSums sums;
+    sums.build(cache);
+
+    std::vector<double> v(n_parameter, 0.0);
+    v[cache.poi_index] = 1.0;
+    if (cfg.profile_nuisances)
+    {
+        TMatrixDSym fine_fisher(n_parameter);
+        for (int i = 0; i < cache.n_fine; ++i)
+            add_sym_in_place(fine_fisher, make_fine_bin_state(cache, i, mu_floor).fisher, +1.0);
+        profiled_direction(fine_fisher, cache, v);
+    }
+
+    const int n_iterations = cfg.profile_nuisances ? std::max(1, cfg.dp_iterations) : 1;
+
+    std::vector<int> best_cuts;
+    double best_sigma = std::numeric_limits<double>::infinity();
+    double sigma_lower_bound = 0.0;
+
+    SegmentTable table;
+    std::vector<int> last_cuts;
+    for (int iteration = 0; iteration < n_iterations; ++iteration)
+    {
+        sums.project(cache, v);
+        fill_segment_table(sums, cfg, n_threads, table);
+
+        double value = 0.0;
+        const std::vector<int> cuts = solve_segments(table, cfg.max_bins, n_threads, value);
+        if (cuts.empty())
+            return false;
+
+        double prior_info = 0.0;
+        for (int a = 0; a < n_parameter; ++a)
+        {
+            if (cache.prior_sigmas[a] > 0.0)
+                prior_info += v[a] * v[a] / (cache.prior_sigmas[a] * cache.prior_sigmas[a]);
+        }
+        if (value + prior_info > 0.0)
+            sigma_lower_bound = std::max(sigma_lower_bound, 1.0 / std::sqrt(value + prior_info));
+
+        const std::vector<BinState> bins = bins_from_cuts(cache, cuts, mu_floor);
+        TMatrixDSym total_fisher(n_parameter);
+        for (const auto &bin : bins)
+            add_sym_in_place(total_fisher, bin.fisher, +1.0);
+
+        const double sigma = sigma_poi_from_fisher(total_fisher, cache.prior_sigmas, cache.poi_index, cfg.profile_nuisances);
+        if (best_cuts.empty() || sigma < best_sigma)
+        {
+            best_sigma = sigma;
+            best_cuts = cuts;
+        }
+
+        if (cfg.verbose && cfg.p_log)
+        {
+            (*cfg.p_log) << "[TemplateBinningOptimizer1D] dp iter=" << iteration
+                         << " bins=" << bins.size()
+                         << " expected_sigma_poi=" << sigma
+                         << " sigma_lower_bound=" << sigma_lower_bound
+                         << "\n";
+        }
+
+        if (cuts == last_cuts || !profiled_direction(total_fisher, cache, v))
+            break;
+        last_cuts = cuts;
+    }
+
+    out = make_result(cache, bins_from_cuts(cache, best_cuts, mu_floor), best_sigma, cfg);
+    out.sigma_poi_lower_bound = std::min(sigma_lower_bound, best_sigma);
+    return true;
+}
+
+TemplateBinningOptimizer1D::Result optimise_exhaustive(const FineCache &cache,
+                                                       const TemplateBinningOptimizer1D::Config &cfg)
+{
     std::vector<BinState> bins;
     bins.reserve(cache.n_fine);
     for (int i = 0; i < cache.n_fine; ++i)
-        bins.push_back(make_fine_bin_state(cache, i, m_cfg.mu_floor_for_objective));
+        bins.push_back(make_fine_bin_state(cache, i, cfg.mu_floor_for_objective));
 
     TMatrixDSym total_fisher(cache.n_parameter);
     for (const auto &bin : bins)
         add_sym_in_place(total_fisher, bin.fisher, +1.0);
 
-    double sigma_current = sigma_poi_from_fisher(total_fisher, cache.prior_sigmas, cache.poi_index, m_cfg.profile_nuisances);
+    double sigma_current = sigma_poi_from_fisher(total_fisher, cache.prior_sigmas, cache.poi_index, cfg.profile_nuisances);
 
     auto need_more_merging = [&](const std::vector<BinState> &states) {
         bool any_failing = false;
         for (const auto &state : states)
         {
-            const auto eval = evaluate_constraints(state, m_cfg, cache.n_channel, m_cfg.mu_floor_for_objective);
+            const auto eval = evaluate_constraints(state, cfg, cache.n_channel, cfg.mu_floor_for_objective);
             if (!eval.passes)
             {
                 any_failing = true;
@@ -504,7 +1465,7 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
             }
         }
 
-        const bool too_many_bins = (m_cfg.max_bins > 0) && (static_cast<int>(states.size()) > m_cfg.max_bins);
+        const bool too_many_bins = (cfg.max_bins > 0) && (static_cast<int>(states.size()) > cfg.max_bins);
         return any_failing || too_many_bins;
     };
 
@@ -517,7 +1478,7 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
         bool any_failing = false;
         for (size_t i = 0; i < bins.size(); ++i)
         {
-            const auto eval = evaluate_constraints(bins[i], m_cfg, cache.n_channel, m_cfg.mu_floor_for_objective);
+            const auto eval = evaluate_constraints(bins[i], cfg, cache.n_channel, cfg.mu_floor_for_objective);
             fails[i] = !eval.passes;
             any_failing = any_failing || fails[i];
         }
@@ -533,7 +1494,7 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
             if (any_failing && !touches_failing_bin)
                 continue;
 
-            BinState merged = merge_bins(bins[k], bins[k + 1], cache.n_channel, cache.n_parameter, m_cfg.mu_floor_for_objective);
+            BinState merged = merge_bins(bins[k], bins[k + 1], cache.n_channel, cache.n_parameter, cfg.mu_floor_for_objective);
 
             TMatrixDSym candidate_fisher(total_fisher);
             add_sym_in_place(candidate_fisher, bins[k].fisher, -1.0);
@@ -541,15 +1502,15 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
             add_sym_in_place(candidate_fisher, merged.fisher, +1.0);
 
             const double sigma_candidate =
-                sigma_poi_from_fisher(candidate_fisher, cache.prior_sigmas, cache.poi_index, m_cfg.profile_nuisances);
+                sigma_poi_from_fisher(candidate_fisher, cache.prior_sigmas, cache.poi_index, cfg.profile_nuisances);
 
-            const auto merged_eval = evaluate_constraints(merged, m_cfg, cache.n_channel, m_cfg.mu_floor_for_objective);
+            const auto merged_eval = evaluate_constraints(merged, cfg, cache.n_channel, cfg.mu_floor_for_objective);
             const double width = cache.edges[merged.high + 1] - cache.edges[merged.low];
 
             const double cost =
                 (sigma_candidate - sigma_current) +
                 merged_eval.penalty +
-                m_cfg.width_penalty * width;
+                cfg.width_penalty * width;
 
             if (cost < best_cost)
             {
@@ -564,7 +1525,7 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
         {
             for (int k = 0; k < static_cast<int>(bins.size()) - 1; ++k)
             {
-                BinState merged = merge_bins(bins[k], bins[k + 1], cache.n_channel, cache.n_parameter, m_cfg.mu_floor_for_objective);
+                BinState merged = merge_bins(bins[k], bins[k + 1], cache.n_channel, cache.n_parameter, cfg.mu_floor_for_objective);
 
                 TMatrixDSym candidate_fisher(total_fisher);
                 add_sym_in_place(candidate_fisher, bins[k].fisher, -1.0);
@@ -572,14 +1533,14 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
                 add_sym_in_place(candidate_fisher, merged.fisher, +1.0);
 
                 const double sigma_candidate =
-                    sigma_poi_from_fisher(candidate_fisher, cache.prior_sigmas, cache.poi_index, m_cfg.profile_nuisances);
-                const auto merged_eval = evaluate_constraints(merged, m_cfg, cache.n_channel, m_cfg.mu_floor_for_objective);
+                    sigma_poi_from_fisher(candidate_fisher, cache.prior_sigmas, cache.poi_index, cfg.profile_nuisances);
+                const auto merged_eval = evaluate_constraints(merged, cfg, cache.n_channel, cfg.mu_floor_for_objective);
                 const double width = cache.edges[merged.high + 1] - cache.edges[merged.low];
 
                 const double cost =
                     (sigma_candidate - sigma_current) +
                     merged_eval.penalty +
-                    m_cfg.width_penalty * width;
+                    cfg.width_penalty * width;
 
                 if (cost < best_cost)
                 {
@@ -603,39 +1564,73 @@ TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const st
 
         sigma_current = best_sigma;
 
-        if (m_cfg.verbose && m_cfg.p_log)
+        if (cfg.verbose && cfg.p_log)
         {
-            (*m_cfg.p_log) << "[TemplateBinningOptimizer1D] iter=" << iteration
+            (*cfg.p_log) << "[TemplateBinningOptimizer1D] iter=" << iteration
                            << " bins=" << bins.size()
                            << " expected_sigma_poi=" << sigma_current
                            << "\n";
         }
     }
 
-    Result out;
-    out.edges.reserve(bins.size() + 1);
-    out.edges.push_back(cache.edges[bins.front().low]);
-    for (const auto &bin : bins)
-        out.edges.push_back(cache.edges[bin.high + 1]);
+    return make_result(cache, bins, sigma_current, cfg);
+}
 
-    out.expected_sigma_poi = sigma_current;
+TemplateBinningOptimizer1D::Result run_strategy(const FineCache &cache,
+                                                const TemplateBinningOptimizer1D::Config &cfg)
+{
+    using Strategy = TemplateBinningOptimizer1D::Strategy;
 
-    out.bins.reserve(bins.size());
-    for (const auto &bin : bins)
+    if (cfg.strategy == Strategy::kIncremental)
     {
-        BinReport report;
-        report.low = cache.edges[bin.low];
-        report.high = cache.edges[bin.high + 1];
+        TemplateBinningOptimizer1D::Result out;
+        if (optimise_incremental(cache, cfg, out))
+            return out;
 
-        const auto eval = evaluate_constraints(bin, m_cfg, cache.n_channel, m_cfg.mu_floor_for_objective);
-        report.mu_sum = eval.mu_sum;
-        report.rel_mc_worst = eval.rel_mc_worst;
-        report.passes_constraints = eval.passes;
+        if (cfg.verbose && cfg.p_log)
+            (*cfg.p_log) << "[TemplateBinningOptimizer1D] incremental start-up covariance is singular; using exhaustive search\n";
+    }
+    else if (cfg.strategy == Strategy::kDynamicProgramming)
+    {
+        TemplateBinningOptimizer1D::Result out;
+        if (optimise_dynamic(cache, cfg, out))
+            return out;
 
-        out.bins.push_back(report);
+        if (cfg.verbose && cfg.p_log)
+            (*cfg.p_log) << "[TemplateBinningOptimizer1D] no feasible partition within max_bins; using exhaustive search\n";
     }
 
-    return out;
+    return optimise_exhaustive(cache, cfg);
+}
+
+} // namespace
+
+TemplateBinningOptimizer1D::TemplateBinningOptimizer1D(Config cfg) : m_cfg(std::move(cfg)) {}
+
+TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const Channel &channel) const
+{
+    return optimise(std::vector<Channel>{channel});
+}
+
+TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const std::vector<Channel> &channels) const
+{
+    return run_strategy(build_fine_cache(channels, m_cfg), m_cfg);
+}
+
+TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const FineTemplates &templates) const
+{
+    return run_strategy(cache_from_templates(templates, m_cfg), m_cfg);
+}
+
+double TemplateBinningOptimizer1D::expected_sigma_poi(const FineTemplates &templates) const
+{
+    const FineCache cache = cache_from_templates(templates, m_cfg);
+
+    TMatrixDSym total_fisher(cache.n_parameter);
+    for (int i = 0; i < cache.n_fine; ++i)
+        add_sym_in_place(total_fisher, make_fine_bin_state(cache, i, m_cfg.mu_floor_for_objective).fisher, +1.0);
+
+    return sigma_poi_from_fisher(total_fisher, cache.prior_sigmas, cache.poi_index, m_cfg.profile_nuisances);
 }
 
 std::shared_ptr<TemplateBinningBlock> TemplateBinningOptimizer1D::Result::make_block(const std::string &name,
@@ -645,3 +1640,162 @@ std::shared_ptr<TemplateBinningBlock> TemplateBinningOptimizer1D::Result::make_b
 {
     return std::make_shared<TemplateBinningBlock>(name, title, edges, selection, bin_type);
 }
+
+TemplateBinningOptimizer1D::Result TemplateBinningOptimizer1D::optimise(const std::vector<EventChannel> &channels,
+                                                                        const std::vector<EventParameter> &parameters) const
+{
+    return optimise(tabulate_events(channels, parameters));
+}
+
+TemplateBinningOptimizer1D::FineTemplates TemplateBinningOptimizer1D::tabulate_events(const std::vector<EventChannel> &channels,
+                                                                                      const std::vector<EventParameter> &parameters) const
+{
+    if (channels.empty())
+        throw std::runtime_error("optimise() called with zero channels");
+    if (parameters.empty())
+        throw std::runtime_error("event input has no parameters; need at least a POI for objective");
+
+    const int n_channel = static_cast<int>(channels.size());
+    const int n_parameter = static_cast<int>(parameters.size());
+    const int n_threads = resolve_threads(m_cfg.n_threads);
+
+    FineTemplates out;
+    out.n_channel = n_channel;
+    int poi_index = -1;
+    for (int p = 0; p < n_parameter; ++p)
+    {
+        out.parameter_names.push_back(parameters[p].name);
+        out.prior_sigmas.push_back(parameters[p].prior_sigma);
+        if (parameters[p].is_poi)
+        {
+            if (poi_index >= 0)
+                throw std::runtime_error("multiple parameters marked is_poi=true; require exactly one");
+            poi_index = p;
+        }
+    }
+    out.poi_index = std::max(poi_index, 0);
+
+    auto usable = [](const EventChannel &channel, const std::size_t i) {
+        return std::isfinite(channel.value[i]) && std::isfinite(channel.weight[i]);
+    };
+
+    // Pool (value, |w|) over channels and sort once, chunk-parallel then merged.
+    std::vector<std::pair<double, double>> pooled;
+    for (const auto &channel : channels)
+    {
+        const std::size_t n = channel.value.size();
+        if (channel.weight.size() != n)
+            throw std::runtime_error("event channel '" + channel.name + "' has value/weight size mismatch");
+        if (static_cast<int>(channel.dweight.size()) != n_parameter)
+            throw std::runtime_error("event channel '" + channel.name + "' needs one weight derivative per parameter");
+        for (const auto &d : channel.dweight)
+        {
+            if (d.size() != n)
+                throw std::runtime_error("event channel '" + channel.name + "' has a weight derivative size mismatch");
+        }
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (usable(channel, i))
+                pooled.emplace_back(channel.value[i], std::abs(channel.weight[i]));
+        }
+    }
+    if (pooled.empty())
+        throw std::runtime_error("event input has no finite events");
+
+    const int n_chunks = std::max(1, std::min(n_threads, static_cast<int>(pooled.size() / 65536)));
+    std::vector<std::size_t> bounds(n_chunks + 1);
+    for (int k = 0; k <= n_chunks; ++k)
+        bounds[k] = pooled.size() * k / n_chunks;
+    auto sort_chunk = [&](int k) { std::sort(pooled.begin() + bounds[k], pooled.begin() + bounds[k + 1]); };
+    parallel_for(n_chunks, n_threads, sort_chunk, 1);
+    for (int width = 1; width < n_chunks; width *= 2)
+    {
+        for (int k = 0; k + width < n_chunks; k += 2 * width)
+        {
+            const std::size_t hi = bounds[std::min(k + 2 * width, n_chunks)];
+            std::inplace_merge(pooled.begin() + bounds[k], pooled.begin() + bounds[k + width], pooled.begin() + hi);
+        }
+    }
+
+    // Candidate edges at event values where the cumulative |w| crosses a quantile.
+    double total = 0.0;
+    for (const auto &e : pooled)
+        total += e.second;
+
+    std::vector<double> &edges = out.edges;
+    edges.push_back(pooled.front().first);
+    const int n_quantiles = m_cfg.n_event_quantiles;
+    double cumulative = 0.0;
+    int next_quantile = 1;
+    for (const auto &e : pooled)
+    {
+        const bool take = (n_quantiles <= 0) ||
+                          (total > 0.0 ? cumulative >= total * next_quantile / n_quantiles
+                                       : false);
+        if (take && e.first > edges.back())
+        {
+            edges.push_back(e.first);
+            if (n_quantiles > 0)
+            {
+                while (next_quantile < n_quantiles && cumulative >= total * next_quantile / n_quantiles)
+                    ++next_quantile;
+            }
+        }
+        cumulative += e.second;
+    }
+    edges.push_back(std::nextafter(pooled.back().first, std::numeric_limits<double>::infinity()));
+
+    const int n_fine = static_cast<int>(edges.size()) - 1;
+    out.mu.assign(static_cast<std::size_t>(n_channel) * n_fine, 0.0);
+    out.var.assign(out.mu.size(), 0.0);
+    out.dmu.assign(out.mu.size() * n_parameter, 0.0);
+
+    // Fill per event range, then reduce.
+    for (int c = 0; c < n_channel; ++c)
+    {
+        const EventChannel &channel = channels[c];
+        const std::size_t n = channel.value.size();
+        const int n_parts = std::max(1, std::min(n_threads, static_cast<int>(n / 65536)));
+        const std::size_t stride = static_cast<std::size_t>(n_fine) * (2 + n_parameter);
+        std::vector<double> partial(stride * n_parts, 0.0);
+
+        auto fill_part = [&](int part) {
+            double *acc = &partial[stride * part];
+            for (std::size_t i = n * part / n_parts; i < n * (part + 1) / n_parts; ++i)
+            {
+                if (!usable(channel, i))
+                    continue;
+                const int bin = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), channel.value[i]) - edges.begin()) - 1;
+                if (bin < 0 || bin >= n_fine)
+                    continue;
+                const double w = channel.weight[i];
+                acc[bin] += w;
+                acc[n_fine + bin] += w * w;
+                for (int p = 0; p < n_parameter; ++p)
+                    acc[(2 + p) * n_fine + bin] += channel.dweight[p][i];
+            }
+        };
+        parallel_for(n_parts, n_threads, fill_part, 1);
+
+        for (int part = 0; part < n_parts; ++part)
+        {
+            const double *acc = &partial[stride * part];
+            for (int i = 0; i < n_fine; ++i)
+            {
+                out.mu[c * n_fine + i] += acc[i];
+                out.var[c * n_fine + i] += acc[n_fine + i];
+                for (int p = 0; p < n_parameter; ++p)
+                    out.dmu[(c * n_parameter + p) * n_fine + i] += acc[(2 + p) * n_fine + i];
+            }
+        }
+    }
+
+    if (m_cfg.verbose && m_cfg.p_log)
+    {
+        (*m_cfg.p_log) << "[TemplateBinningOptimizer1D] events=" << pooled.size()
+                       << " candidate edges=" << edges.size() << "\n";
+    }
+
+    return out;
+}
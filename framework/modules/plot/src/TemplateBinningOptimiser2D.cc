@@ -0,0 +1,391 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/TemplateBinningOptimiser2D.cc
+ *
+ *  @brief Implementation for template-based 2D block binning optimisation.
+ */
+
+#include "TemplateBinningOptimizer2D.hh"
+
+#include <TAxis.h>
+#include <TH1.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "TemplateBinningBlock.hh"
+
+namespace
+{
+
+std::vector<double> extract_edges(const TAxis &axis, const int n)
+{
+    std::vector<double> edges(n + 1);
+    for (int i = 1; i <= n; ++i)
+        edges[i - 1] = axis.GetBinLowEdge(i);
+    edges[n] = axis.GetBinUpEdge(n);
+    return edges;
+}
+
+bool same_binning_xy(const TH1 &a, const TH1 &b, const double eps = 1e-12)
+{
+    if (a.GetNbinsX() != b.GetNbinsX() || a.GetNbinsY() != b.GetNbinsY())
+        return false;
+
+    const auto ax = extract_edges(*a.GetXaxis(), a.GetNbinsX());
+    const auto bx = extract_edges(*b.GetXaxis(), b.GetNbinsX());
+    const auto ay = extract_edges(*a.GetYaxis(), a.GetNbinsY());
+    const auto by = extract_edges(*b.GetYaxis(), b.GetNbinsY());
+    for (size_t i = 0; i < ax.size(); ++i)
+    {
+        if (std::abs(ax[i] - bx[i]) > eps)
+            return false;
+    }
+    for (size_t i = 0; i < ay.size(); ++i)
+    {
+        if (std::abs(ay[i] - by[i]) > eps)
+            return false;
+    }
+    return true;
+}
+
+struct FineCache2D
+{
+    int nx = 0;
+    int ny = 0;
+    int n_channel = 0;
+    int n_parameter = 0;
+
+    std::vector<double> x_edges;
+    std::vector<double> y_edges;
+    std::vector<std::string> parameter_names;
+    std::vector<double> prior_sigmas;
+    int poi_index = 0;
+
+    std::vector<double> mu;
+    std::vector<double> var;
+    std::vector<double> dmu;
+
+    std::size_t cell(const int c, const int ix, const int iy) const
+    {
+        return (static_cast<std::size_t>(c) * nx + ix) * ny + iy;
+    }
+    std::size_t dcell(const int c, const int p, const int ix, const int iy) const
+    {
+        return ((static_cast<std::size_t>(c) * n_parameter + p) * nx + ix) * ny + iy;
+    }
+};
+
+FineCache2D build_fine_cache_2d(const std::vector<TemplateBinningOptimizer2D::Channel> &channels)
+{
+    if (channels.empty())
+        throw std::runtime_error("optimise() called with zero channels");
+
+    const TH1 *p_histogram_0 = channels.front().p_nominal;
+    if (!p_histogram_0)
+        throw std::runtime_error("channel[0] has null nominal histogram");
+    if (p_histogram_0->GetNbinsY() < 1)
+        throw std::runtime_error("2D optimisation requires TH2 nominal histograms");
+
+    const auto &parameters_0 = channels.front().parameters;
+    if (parameters_0.empty())
+        throw std::runtime_error("channel[0] has no parameters; need at least a POI for objective");
+
+    FineCache2D cache;
+    cache.nx = p_histogram_0->GetNbinsX();
+    cache.ny = p_histogram_0->GetNbinsY();
+    cache.n_channel = static_cast<int>(channels.size());
+    cache.n_parameter = static_cast<int>(parameters_0.size());
+    cache.x_edges = extract_edges(*p_histogram_0->GetXaxis(), cache.nx);
+    cache.y_edges = extract_edges(*p_histogram_0->GetYaxis(), cache.ny);
+
+    int poi_index = -1;
+    for (int p = 0; p < cache.n_parameter; ++p)
+    {
+        cache.parameter_names.push_back(parameters_0[p].name);
+        cache.prior_sigmas.push_back(parameters_0[p].prior_sigma);
+        if (parameters_0[p].is_poi)
+        {
+            if (poi_index >= 0)
+                throw std::runtime_error("multiple parameters marked is_poi=true; require exactly one");
+            poi_index = p;
+        }
+    }
+    cache.poi_index = std::max(poi_index, 0);
+
+    for (const auto &channel : channels)
+    {
+        if (!channel.p_nominal)
+            throw std::runtime_error("a channel has null nominal histogram");
+        if (!same_binning_xy(*p_histogram_0, *channel.p_nominal))
+            throw std::runtime_error("channels have different nominal binnings; shared-edge optimisation requires identical fine binning");
+        if (channel.parameters.size() != parameters_0.size())
+            throw std::runtime_error("channels have different parameter counts");
+
+        for (size_t p = 0; p < parameters_0.size(); ++p)
+        {
+            const auto &parameter = channel.parameters[p];
+            if (parameter.name != parameters_0[p].name || parameter.is_poi != parameters_0[p].is_poi ||
+                parameter.prior_sigma != parameters_0[p].prior_sigma)
+                throw std::runtime_error("channels have inconsistent parameter definitions");
+
+            if (parameter.p_derivative)
+            {
+                if (!same_binning_xy(*channel.p_nominal, *parameter.p_derivative))
+                    throw std::runtime_error("derivative histogram has different binning than nominal");
+            }
+            else
+            {
+                if (!parameter.p_up || !parameter.p_down)
+                    throw std::runtime_error("parameter must provide either derivative or (up and down)");
+                if (!same_binning_xy(*channel.p_nominal, *parameter.p_up) ||
+                    !same_binning_xy(*channel.p_nominal, *parameter.p_down))
+                    throw std::runtime_error("up/down histogram has different binning than nominal");
+                if (!(parameter.step > 0.0))
+                    throw std::runtime_error("parameter step must be > 0 for up/down finite difference");
+            }
+        }
+    }
+
+    const std::size_t n_cells = static_cast<std::size_t>(cache.n_channel) * cache.nx * cache.ny;
+    cache.mu.assign(n_cells, 0.0);
+    cache.var.assign(n_cells, 0.0);
+    cache.dmu.assign(n_cells * cache.n_parameter, 0.0);
+
+    for (int c = 0; c < cache.n_channel; ++c)
+    {
+        const TH1 &nominal = *channels[c].p_nominal;
+        for (int ix = 0; ix < cache.nx; ++ix)
+        {
+            for (int iy = 0; iy < cache.ny; ++iy)
+            {
+                const double err = nominal.GetBinError(ix + 1, iy + 1);
+                cache.mu[cache.cell(c, ix, iy)] = nominal.GetBinContent(ix + 1, iy + 1);
+                cache.var[cache.cell(c, ix, iy)] = err * err;
+
+                for (int p = 0; p < cache.n_parameter; ++p)
+                {
+                    const auto &parameter = channels[c].parameters[p];
+                    double derivative = 0.0;
+                    if (parameter.p_derivative)
+                        derivative = parameter.p_derivative->GetBinContent(ix + 1, iy + 1);
+                    else
+                        derivative = (parameter.p_up->GetBinContent(ix + 1, iy + 1) -
+                                      parameter.p_down->GetBinContent(ix + 1, iy + 1)) /
+                                     (2.0 * parameter.step);
+                    cache.dmu[cache.dcell(c, p, ix, iy)] = derivative;
+                }
+            }
+        }
+    }
+
+    return cache;
+}
+
+TemplateBinningOptimizer1D::FineTemplates make_templates(const FineCache2D &cache, const std::vector<double> &edges)
+{
+    TemplateBinningOptimizer1D::FineTemplates t;
+    t.edges = edges;
+    t.parameter_names = cache.parameter_names;
+    t.prior_sigmas = cache.prior_sigmas;
+    t.poi_index = cache.poi_index;
+    t.n_channel = cache.n_channel;
+
+    const std::size_t n = edges.size() - 1;
+    t.mu.assign(cache.n_channel * n, 0.0);
+    t.var.assign(cache.n_channel * n, 0.0);
+    t.dmu.assign(cache.n_channel * cache.n_parameter * n, 0.0);
+    return t;
+}
+
+/// Projection onto x (summed over y), one fine bin per x column.
+TemplateBinningOptimizer1D::FineTemplates project_x(const FineCache2D &cache)
+{
+    auto t = make_templates(cache, cache.x_edges);
+    const int n = cache.nx;
+    for (int c = 0; c < cache.n_channel; ++c)
+    {
+        for (int ix = 0; ix < cache.nx; ++ix)
+        {
+            for (int iy = 0; iy < cache.ny; ++iy)
+            {
+                t.mu[c * n + ix] += cache.mu[cache.cell(c, ix, iy)];
+                t.var[c * n + ix] += cache.var[cache.cell(c, ix, iy)];
+                for (int p = 0; p < cache.n_parameter; ++p)
+                    t.dmu[(c * cache.n_parameter + p) * n + ix] += cache.dmu[cache.dcell(c, p, ix, iy)];
+            }
+        }
+    }
+    return t;
+}
+
+/// Fine y distribution of the x slice [x0, x1).
+TemplateBinningOptimizer1D::FineTemplates project_y(const FineCache2D &cache, const int x0, const int x1)
+{
+    auto t = make_templates(cache, cache.y_edges);
+    const int n = cache.ny;
+    for (int c = 0; c < cache.n_channel; ++c)
+    {
+        for (int ix = x0; ix < x1; ++ix)
+        {
+            for (int iy = 0; iy < cache.ny; ++iy)
+            {
+                t.mu[c * n + iy] += cache.mu[cache.cell(c, ix, iy)];
+                t.var[c * n + iy] += cache.var[cache.cell(c, ix, iy)];
+                for (int p = 0; p < cache.n_parameter; ++p)
+                    t.dmu[(c * cache.n_parameter + p) * n + iy] += cache.dmu[cache.dcell(c, p, ix, iy)];
+            }
+        }
+    }
+    return t;
+}
+
+/// Fine indices of optimised edges (which are copies of fine edges).
+std::vector<int> edge_indices(const std::vector<double> &fine, const std::vector<double> &edges)
+{
+    std::vector<int> out;
+    out.reserve(edges.size());
+    for (double e : edges)
+        out.push_back(static_cast<int>(std::lower_bound(fine.begin(), fine.end(), e) - fine.begin()));
+    return out;
+}
+
+} // namespace
+
+TemplateBinningOptimizer2D::TemplateBinningOptimizer2D(Config cfg) : m_cfg(std::move(cfg)) {}
+
+TemplateBinningOptimizer2D::Result TemplateBinningOptimizer2D::optimise(const Channel &channel) const
+{
+    return optimise(std::vector<Channel>{channel});
+}
+
+TemplateBinningOptimizer2D::Result TemplateBinningOptimizer2D::optimise(const std::vector<Channel> &channels) const
+{
+    const FineCache2D cache = build_fine_cache_2d(channels);
+
+    if (m_cfg.base.verbose && m_cfg.base.p_log)
+    {
+        (*m_cfg.base.p_log) << "[TemplateBinningOptimizer2D] fine bins=" << cache.nx << "x" << cache.ny
+                            << " channels=" << cache.n_channel
+                            << " parameters=" << cache.n_parameter
+                            << " POI=" << cache.parameter_names[cache.poi_index] << "\n";
+    }
+
+    Result out;
+
+    TemplateBinningOptimizer1D::Config x_cfg = m_cfg.base;
+    x_cfg.max_bins = m_cfg.max_bins_x;
+    out.x_partition = TemplateBinningOptimizer1D(x_cfg).optimise(project_x(cache));
+    out.x_edges = out.x_partition.edges;
+
+    const std::vector<int> x_cuts = edge_indices(cache.x_edges, out.x_edges);
+    const int n_slices = static_cast<int>(x_cuts.size()) - 1;
+
+    // Slices are independent; each runs its 1D search single-threaded.
+    TemplateBinningOptimizer1D::Config y_cfg = m_cfg.base;
+    y_cfg.max_bins = m_cfg.max_bins_y;
+    y_cfg.n_threads = 1;
+    y_cfg.verbose = false;
+    const TemplateBinningOptimizer1D y_optimiser(y_cfg);
+
+    out.slices.resize(n_slices);
+    std::vector<TemplateBinningOptimizer1D::FineTemplates> slice_templates(n_slices);
+
+    const int n_threads = (m_cfg.n_threads > 0)
+                              ? m_cfg.n_threads
+                              : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int workers = std::max(1, std::min(n_threads, n_slices));
+
+    std::atomic<int> next_slice{0};
+    std::vector<std::exception_ptr> errors(workers);
+    auto work = [&](const int w) {
+        try
+        {
+            for (int s = next_slice++; s < n_slices; s = next_slice++)
+            {
+                slice_templates[s] = project_y(cache, x_cuts[s], x_cuts[s + 1]);
+                out.slices[s] = y_optimiser.optimise(slice_templates[s]);
+            }
+        }
+        catch (...)
+        {
+            errors[w] = std::current_exception();
+        }
+    };
+
+    if (workers == 1)
+        work(0);
+    else
+    {
+        std::vector<std::thread> pool;
+        pool.reserve(workers);
+        for (int w = 0; w < workers; ++w)
+            pool.emplace_back(work, w);
+        for (auto &t : pool)
+            t.join();
+    }
+    for (const auto &error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Objective over the final block bins, one pseudo fine bin each.
+    int n_blocks = 0;
+    for (const auto &slice : out.slices)
+    {
+        out.y_edges.push_back(slice.edges);
+        n_blocks += static_cast<int>(slice.edges.size()) - 1;
+    }
+
+    std::vector<double> block_edges(n_blocks + 1);
+    for (int b = 0; b <= n_blocks; ++b)
+        block_edges[b] = b;
+    auto blocks = make_templates(cache, block_edges);
+
+    int b = 0;
+    for (int s = 0; s < n_slices; ++s)
+    {
+        const auto &t = slice_templates[s];
+        const std::vector<int> y_cuts = edge_indices(cache.y_edges, out.y_edges[s]);
+        for (size_t k = 0; k + 1 < y_cuts.size(); ++k, ++b)
+        {
+            for (int c = 0; c < cache.n_channel; ++c)
+            {
+                for (int iy = y_cuts[k]; iy < y_cuts[k + 1]; ++iy)
+                {
+                    blocks.mu[c * n_blocks + b] += t.mu[c * cache.ny + iy];
+                    blocks.var[c * n_blocks + b] += t.var[c * cache.ny + iy];
+                    for (int p = 0; p < cache.n_parameter; ++p)
+                        blocks.dmu[(c * cache.n_parameter + p) * n_blocks + b] +=
+                            t.dmu[(c * cache.n_parameter + p) * cache.ny + iy];
+                }
+            }
+        }
+    }
+
+    out.expected_sigma_poi = TemplateBinningOptimizer1D(m_cfg.base).expected_sigma_poi(blocks);
+
+    if (m_cfg.base.verbose && m_cfg.base.p_log)
+    {
+        (*m_cfg.base.p_log) << "[TemplateBinningOptimizer2D] x bins=" << n_slices
+                            << " block bins=" << n_blocks
+                            << " expected_sigma_poi=" << out.expected_sigma_poi << "\n";
+    }
+
+    return out;
+}
+
+std::shared_ptr<TemplateBinningBlock> TemplateBinningOptimizer2D::Result::make_block(const std::string &name,
+                                                                                      const std::string &title,
+                                                                                      const std::string &selection,
+                                                                                      int bin_type) const
+{
+    return std::make_shared<TemplateBinningBlock>(name, title, x_edges, y_edges, selection, bin_type);
+}
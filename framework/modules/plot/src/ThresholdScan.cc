@@ -0,0 +1,567 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/ThresholdScan.cc
+ *
+ *  @brief Implementation of the one-pass score threshold scan.
+ */
+
+#include "ThresholdScan.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UniverseHist.hh"
+#include "UniverseWeightCodec.hh"
+
+
+namespace nu
+{
+
+namespace
+{
+
+std::string unique_column(const std::string &stem)
+{
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+}
+
+// Delta-method variance of p = A / B where A is a subset of B (Cov(A, B) = Var(A)).
+double subset_fraction_error(double sumw_pass, double sumw_total, double sumw2_pass, double sumw2_total)
+{
+    if (!(sumw_total > 0.0))
+        return 0.0;
+
+    const double p = sumw_pass / sumw_total;
+    const double sumw2_fail = std::max(0.0, sumw2_total - sumw2_pass);
+    const double var = ((1.0 - p) * (1.0 - p) * sumw2_pass + p * p * sumw2_fail) / (sumw_total * sumw_total);
+    return std::sqrt(std::max(0.0, var));
+}
+
+double safe_ratio(double num, double den)
+{
+    return (den > 0.0) ? num / den : 0.0;
+}
+
+} // namespace
+
+ThresholdScan::ThresholdScan(std::string name, std::vector<double> edges, std::vector<int> channels, int n_universes)
+    : name_(std::move(name)),
+      edges_(std::move(edges)),
+      channels_(std::move(channels)),
+      n_universes_(std::max(0, n_universes))
+{
+    if (!std::is_sorted(edges_.begin(), edges_.end()))
+        throw std::runtime_error("ThresholdScan: cut edges must be sorted ascending");
+
+    const std::size_t cells = n_streams() * n_cells();
+    sumw_.assign(cells, 0.0);
+    sumw2_.assign(cells, 0.0);
+    raw_.assign(cells, 0.0);
+    universes_.assign(2 * n_cells() * static_cast<std::size_t>(n_universes_), 0.0);
+    build_prefix();
+}
+
+std::vector<double> ThresholdScan::uniform_grid(int n, double lo, double hi)
+{
+    n = std::max(2, n);
+    if (hi < lo)
+        std::swap(lo, hi);
+
+    std::vector<double> grid(static_cast<std::size_t>(n));
+    const double step = (hi - lo) / static_cast<double>(n - 1);
+    for (int i = 0; i < n; ++i)
+        grid[static_cast<std::size_t>(i)] = lo + static_cast<double>(i) * step;
+    grid.back() = hi;
+    return grid;
+}
+
+std::size_t ThresholdScan::channel_index(int channel) const
+{
+    for (std::size_t i = 0; i < channels_.size(); ++i)
+    {
+        if (channels_[i] == channel)
+            return i;
+    }
+    return channels_.size();
+}
+
+std::size_t ThresholdScan::find_cell(double score) const
+{
+    if (!std::isfinite(score))
+        return kNonFiniteCell;
+    if (edges_.empty() || score < edges_.front())
+        return kUnderflowCell;
+    return static_cast<std::size_t>(std::upper_bound(edges_.begin(), edges_.end(), score) - edges_.begin()) + 1;
+}
+
+std::size_t ThresholdScan::first_cell(double threshold) const
+{
+    if (std::isnan(threshold))
+        return n_cells();
+    if (edges_.empty() || threshold == -std::numeric_limits<double>::infinity())
+        return kUnderflowCell;
+    // A threshold below the grid resolves to edges_.front(), the first in-range cell.
+    return static_cast<std::size_t>(std::lower_bound(edges_.begin(), edges_.end(), threshold) - edges_.begin()) + 2;
+}
+
+bool ThresholdScan::stream_selected(std::size_t stream, Class cls, int channel) const
+{
+    const bool signal = (stream % 2) == 1;
+    if (cls == Class::kSignal && !signal)
+        return false;
+    if (cls == Class::kBackground && signal)
+        return false;
+    if (channel == kAllChannels)
+        return true;
+    return stream / 2 == channel_index(channel);
+}
+
+void ThresholdScan::fill(double score, double w, int channel, bool signal)
+{
+    if (!std::isfinite(w))
+        return;
+
+    const std::size_t stream = 2 * channel_index(channel) + (signal ? 1 : 0);
+    const std::size_t i = stream * n_cells() + find_cell(score);
+    sumw_[i] += w;
+    sumw2_[i] += w * w;
+    raw_[i] += 1.0;
+}
+
+void ThresholdScan::fill(double score,
+                         double w,
+                         int channel,
+                         bool signal,
+                         const unsigned short *packed,
+                         std::size_t n_packed,
+                         double cv)
+{
+    if (!std::isfinite(w))
+        return;
+
+    fill(score, w, channel, signal);
+    if (n_universes_ == 0)
+        return;
+
+    const std::size_t n_u = static_cast<std::size_t>(n_universes_);
+    const double cv_safe = (std::isfinite(cv) && cv > 0.0) ? cv : 1.0;
+    const double scale = w / (kUniversePackScale * cv_safe);
+
+    double *row = universes_.data() + ((signal ? n_cells() : 0) + find_cell(score)) * n_u;
+    const std::size_t n_decoded = std::min(n_packed, n_u);
+    for (std::size_t u = 0; u < n_decoded; ++u)
+        row[u] += scale * static_cast<double>(packed[u]);
+    for (std::size_t u = n_decoded; u < n_u; ++u)
+        row[u] += w;
+}
+
+void ThresholdScan::build_prefix()
+{
+    const std::size_t nc = n_cells();
+    const std::size_t stride = nc + 1;
+
+    tail_sumw_.assign(n_streams() * stride, 0.0);
+    tail_sumw2_.assign(n_streams() * stride, 0.0);
+    tail_raw_.assign(n_streams() * stride, 0.0);
+    for (std::size_t s = 0; s < n_streams(); ++s)
+    {
+        for (std::size_t c = nc; c-- > 0;)
+        {
+            tail_sumw_[s * stride + c] = tail_sumw_[s * stride + c + 1] + sumw_[s * nc + c];
+            tail_sumw2_[s * stride + c] = tail_sumw2_[s * stride + c + 1] + sumw2_[s * nc + c];
+            tail_raw_[s * stride + c] = tail_raw_[s * stride + c + 1] + raw_[s * nc + c];
+        }
+    }
+
+    const std::size_t n_u = static_cast<std::size_t>(n_universes_);
+    tail_universes_.assign(2 * stride * n_u, 0.0);
+    for (std::size_t flag = 0; flag < 2; ++flag)
+    {
+        for (std::size_t c = nc; c-- > 0;)
+        {
+            const double *cell = universes_.data() + (flag * nc + c) * n_u;
+            const double *next = tail_universes_.data() + (flag * stride + c + 1) * n_u;
+            double *tail = tail_universes_.data() + (flag * stride + c) * n_u;
+            for (std::size_t u = 0; u < n_u; ++u)
+                tail[u] = next[u] + cell[u];
+        }
+    }
+}
+
+void ThresholdScan::widen_universes(std::size_t n)
+{
+    const std::size_t old_n = static_cast<std::size_t>(n_universes_);
+    if (n <= old_n)
+        return;
+
+    // New universes are credited with the nominal weight filled so far, as
+    // for events whose universe vector is shorter than the universe count.
+    const std::size_t nc = n_cells();
+    const std::size_t n_channels = channels_.size() + 1;
+    std::vector<double> widened(2 * nc * n, 0.0);
+    for (std::size_t flag = 0; flag < 2; ++flag)
+    {
+        for (std::size_t c = 0; c < nc; ++c)
+        {
+            const double *old_row = universes_.data() + (flag * nc + c) * old_n;
+            double *row = widened.data() + (flag * nc + c) * n;
+            std::copy(old_row, old_row + old_n, row);
+
+            double nominal = 0.0;
+            for (std::size_t ch = 0; ch < n_channels; ++ch)
+                nominal += sumw_[(2 * ch + flag) * nc + c];
+            std::fill(row + old_n, row + n, nominal);
+        }
+    }
+    universes_ = std::move(widened);
+    n_universes_ = static_cast<int>(n);
+}
+
+ThresholdCount ThresholdScan::total(Class cls, int channel) const
+{
+    return tail(kNonFiniteCell, cls, channel);
+}
+
+ThresholdCount ThresholdScan::pass(double threshold, Class cls, int channel) const
+{
+    return tail(first_cell(threshold), cls, channel);
+}
+
+ThresholdCount ThresholdScan::tail(std::size_t cell, Class cls, int channel) const
+{
+    if (channel != kAllChannels && channel_index(channel) == channels_.size())
+        throw std::out_of_range("ThresholdScan: channel " + std::to_string(channel) + " was not declared");
+
+    const std::size_t stride = n_cells() + 1;
+
+    ThresholdCount out;
+    double raw = 0.0;
+    for (std::size_t s = 0; s < n_streams(); ++s)
+    {
+        if (!stream_selected(s, cls, channel))
+            continue;
+        out.sumw += tail_sumw_[s * stride + cell];
+        out.sumw2 += tail_sumw2_[s * stride + cell];
+        raw += tail_raw_[s * stride + cell];
+    }
+    out.raw = static_cast<ULong64_t>(std::llround(raw));
+    return out;
+}
+
+double ThresholdScan::efficiency(double threshold) const
+{
+    return safe_ratio(pass(threshold, Class::kSignal).sumw, total(Class::kSignal).sumw);
+}
+
+double ThresholdScan::efficiency_error(double threshold) const
+{
+    const ThresholdCount p = pass(threshold, Class::kSignal);
+    const ThresholdCount t = total(Class::kSignal);
+    return subset_fraction_error(p.sumw, t.sumw, p.sumw2, t.sumw2);
+}
+
+double ThresholdScan::purity(double threshold) const
+{
+    return safe_ratio(pass(threshold, Class::kSignal).sumw, pass(threshold, Class::kAll).sumw);
+}
+
+double ThresholdScan::purity_error(double threshold) const
+{
+    const ThresholdCount s = pass(threshold, Class::kSignal);
+    const ThresholdCount a = pass(threshold, Class::kAll);
+    return subset_fraction_error(s.sumw, a.sumw, s.sumw2, a.sumw2);
+}
+
+double ThresholdScan::rejection(double threshold, Class cls, int channel) const
+{
+    const ThresholdCount t = total(cls, channel);
+    if (!(t.sumw > 0.0))
+        return 0.0;
+    return 1.0 - pass(threshold, cls, channel).sumw / t.sumw;
+}
+
+double ThresholdScan::rejection_error(double threshold, Class cls, int channel) const
+{
+    const ThresholdCount p = pass(threshold, cls, channel);
+    const ThresholdCount t = total(cls, channel);
+    return subset_fraction_error(p.sumw, t.sumw, p.sumw2, t.sumw2);
+}
+
+std::vector<ThresholdScan::Point> ThresholdScan::scan(const std::vector<double> &thresholds, int channel) const
+{
+    const Class rej_cls = (channel == kAllChannels) ? Class::kBackground : Class::kAll;
+
+    std::vector<Point> out;
+    out.reserve(thresholds.size());
+    for (double t : thresholds)
+    {
+        Point p;
+        p.threshold = t;
+        p.efficiency = efficiency(t);
+        p.efficiency_err = efficiency_error(t);
+        p.purity = purity(t);
+        p.purity_err = purity_error(t);
+        p.rejection = rejection(t, rej_cls, channel);
+        p.rejection_err = rejection_error(t, rej_cls, channel);
+        out.push_back(p);
+    }
+    return out;
+}
+
+double ThresholdScan::universe_pass(int u, bool signal, std::size_t cell) const
+{
+    const std::size_t stride = n_cells() + 1;
+    const std::size_t n_u = static_cast<std::size_t>(n_universes_);
+    return tail_universes_[((signal ? stride : 0) + cell) * n_u + static_cast<std::size_t>(u)];
+}
+
+ThresholdScan::Band ThresholdScan::efficiency_band(double threshold) const
+{
+    if (n_universes_ == 0)
+        throw std::runtime_error("ThresholdScan: efficiency_band requires universes at booking");
+
+    Band band;
+    band.nominal = efficiency(threshold);
+    band.lo = std::numeric_limits<double>::infinity();
+    band.hi = -std::numeric_limits<double>::infinity();
+
+    const std::size_t cell = first_cell(threshold);
+    double sum_sq = 0.0;
+    for (int u = 0; u < n_universes_; ++u)
+    {
+        const double eff = safe_ratio(universe_pass(u, true, cell), universe_pass(u, true, kNonFiniteCell));
+        band.lo = std::min(band.lo, eff);
+        band.hi = std::max(band.hi, eff);
+        sum_sq += (eff - band.nominal) * (eff - band.nominal);
+    }
+    band.rms = std::sqrt(sum_sq / n_universes_);
+    return band;
+}
+
+ThresholdScan::Band ThresholdScan::purity_band(double threshold) const
+{
+    if (n_universes_ == 0)
+        throw std::runtime_error("ThresholdScan: purity_band requires universes at booking");
+
+    Band band;
+    band.nominal = purity(threshold);
+    band.lo = std::numeric_limits<double>::infinity();
+    band.hi = -std::numeric_limits<double>::infinity();
+
+    const std::size_t cell = first_cell(threshold);
+    double sum_sq = 0.0;
+    for (int u = 0; u < n_universes_; ++u)
+    {
+        const double sig = universe_pass(u, true, cell);
+        const double pur = safe_ratio(sig, sig + universe_pass(u, false, cell));
+        band.lo = std::min(band.lo, pur);
+        band.hi = std::max(band.hi, pur);
+        sum_sq += (pur - band.nominal) * (pur - band.nominal);
+    }
+    band.rms = std::sqrt(sum_sq / n_universes_);
+    return band;
+}
+
+void ThresholdScan::add(const ThresholdScan &other)
+{
+    if (other.edges_ != edges_ || other.channels_ != channels_ || other.n_universes_ != n_universes_)
+        throw std::runtime_error("ThresholdScan::add: incompatible grid, channels or universe count");
+
+    for (std::size_t i = 0; i < sumw_.size(); ++i)
+    {
+        sumw_[i] += other.sumw_[i];
+        sumw2_[i] += other.sumw2_[i];
+        raw_[i] += other.raw_[i];
+    }
+    for (std::size_t i = 0; i < universes_.size(); ++i)
+        universes_[i] += other.universes_[i];
+
+    build_prefix();
+}
+
+ThresholdScanHelper::ThresholdScanHelper(std::string name,
+                                         std::vector<double> edges,
+                                         std::vector<int> channels,
+                                         int n_universes,
+                                         unsigned int n_slots)
+    : result_(std::make_shared<ThresholdScan>(name, edges, channels, n_universes)),
+      name_(std::move(name)),
+      channels_(std::move(channels)),
+      unbinned_(edges.empty()),
+      sized_by_data_(n_universes < 0)
+{
+    if (unbinned_ && n_universes > 0)
+        throw std::runtime_error("ThresholdScanHelper: universe bands require a binned cut grid");
+
+    const unsigned int slots = std::max(1u, n_slots);
+    if (unbinned_)
+        slot_entries_.assign(slots, std::vector<Entry>{});
+    else
+        slot_scans_.assign(slots, ThresholdScan(name_, edges, channels_, n_universes));
+    slot_decoded_.assign(slots, std::vector<unsigned short>{});
+}
+
+void ThresholdScanHelper::Exec(unsigned int slot, double score, double w, int channel, bool signal)
+{
+    if (unbinned_)
+    {
+        if (std::isfinite(w))
+            slot_entries_[slot].push_back(Entry{score, w, channel, signal});
+        return;
+    }
+    slot_scans_[slot].fill(score, w, channel, signal);
+}
+
+void ThresholdScanHelper::Exec(unsigned int slot,
+                               double score,
+                               double w,
+                               int channel,
+                               bool signal,
+                               const ROOT::RVec<unsigned short> &packed,
+                               double cv)
+{
+    fill_packed(slot, score, w, channel, signal, packed.data(), packed.size(), cv);
+}
+
+void ThresholdScanHelper::Exec(unsigned int slot,
+                               double score,
+                               double w,
+                               int channel,
+                               bool signal,
+                               const ROOT::RVec<unsigned char> &encoded,
+                               double cv)
+{
+    std::vector<unsigned short> &buffer = slot_decoded_[slot];
+    buffer.resize(UniverseWeightCodec::decoded_size(encoded.data(), encoded.size()));
+    const std::size_t n = UniverseWeightCodec::decode(encoded.data(), encoded.size(), buffer.data(), buffer.size());
+    fill_packed(slot, score, w, channel, signal, buffer.data(), n, cv);
+}
+
+void ThresholdScanHelper::fill_packed(unsigned int slot,
+                                      double score,
+                                      double w,
+                                      int channel,
+                                      bool signal,
+                                      const unsigned short *packed,
+                                      std::size_t n_packed,
+                                      double cv)
+{
+    ThresholdScan &scan = slot_scans_[slot];
+    if (sized_by_data_ && n_packed > static_cast<std::size_t>(scan.n_universes_))
+        scan.widen_universes(n_packed);
+    scan.fill(score, w, channel, signal, packed, n_packed, cv);
+}
+
+void ThresholdScanHelper::Finalize()
+{
+    if (!unbinned_)
+    {
+        if (sized_by_data_)
+        {
+            std::size_t n_universes = 0;
+            for (const auto &scan : slot_scans_)
+                n_universes = std::max(n_universes, static_cast<std::size_t>(scan.n_universes_));
+            for (auto &scan : slot_scans_)
+                scan.widen_universes(n_universes);
+            *result_ = ThresholdScan(name_, result_->edges_, channels_, static_cast<int>(n_universes));
+        }
+
+        for (const auto &scan : slot_scans_)
+        {
+            for (std::size_t i = 0; i < result_->sumw_.size(); ++i)
+            {
+                result_->sumw_[i] += scan.sumw_[i];
+                result_->sumw2_[i] += scan.sumw2_[i];
+                result_->raw_[i] += scan.raw_[i];
+            }
+            for (std::size_t i = 0; i < result_->universes_.size(); ++i)
+                result_->universes_[i] += scan.universes_[i];
+        }
+        result_->build_prefix();
+        slot_scans_.clear();
+        slot_decoded_.clear();
+        return;
+    }
+
+    // Unbinned: every distinct finite score becomes a cut edge.
+    std::vector<double> edges;
+    for (const auto &entries : slot_entries_)
+    {
+        for (const auto &e : entries)
+        {
+            if (std::isfinite(e.score))
+                edges.push_back(e.score);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    ThresholdScan scan(name_, std::move(edges), channels_, 0);
+    for (auto &entries : slot_entries_)
+    {
+        for (const auto &e : entries)
+            scan.fill(e.score, e.w, e.channel, e.signal);
+        std::vector<Entry>().swap(entries);
+    }
+    scan.build_prefix();
+    *result_ = std::move(scan);
+    slot_entries_.clear();
+}
+
+ROOT::RDF::RResultPtr<ThresholdScan> book_threshold_scan(ROOT::RDF::RNode node, const ThresholdScanSpec &spec)
+{
+    if (spec.score.empty())
+        throw std::runtime_error("book_threshold_scan: score expression is required");
+    if (spec.channel_column.empty() && !spec.channels.empty())
+        throw std::runtime_error("book_threshold_scan: channels given without a channel_column");
+
+    const std::string score_col = unique_column("__ts_score");
+    const std::string w_col = unique_column("__ts_w");
+    const std::string ch_col = unique_column("__ts_ch");
+    const std::string sig_col = unique_column("__ts_sig");
+
+    ROOT::RDF::RNode booked =
+        node.Define(score_col, "static_cast<double>(" + spec.score + ")")
+            .Define(w_col, spec.weight.empty() ? std::string("1.0") : "static_cast<double>(" + spec.weight + ")")
+            .Define(ch_col, spec.channel_column.empty() ? std::string("0") : "static_cast<int>(" + spec.channel_column + ")")
+            .Define(sig_col, spec.signal.empty() ? std::string("false") : "static_cast<bool>(" + spec.signal + ")");
+
+    const std::string name = spec.name.empty() ? spec.score : spec.name;
+
+    if (spec.universe_column.empty())
+    {
+        ThresholdScanHelper helper(name, spec.edges, spec.channels, 0, booked.GetNSlots());
+        return booked.Book<double, double, int, bool>(std::move(helper), {score_col, w_col, ch_col, sig_col});
+    }
+
+    if (spec.edges.empty())
+        throw std::runtime_error("book_threshold_scan: universe bands require a binned cut grid");
+
+    const std::string cv_col = unique_column("__ts_cv");
+    booked = booked.Define(cv_col, spec.cv_column.empty() ? std::string("1.0") : "static_cast<double>(" + spec.cv_column + ")");
+
+    // n_universes <= 0: the count comes from the longest vector seen in the fill.
+    const int n_universes = (spec.n_universes > 0) ? spec.n_universes : -1;
+    ThresholdScanHelper helper(name, spec.edges, spec.channels, n_universes, booked.GetNSlots());
+
+    const std::string encoded = UniverseWeightCodec::encoded_column(spec.universe_column);
+    const auto names = booked.GetColumnNames();
+    if (std::find(names.begin(), names.end(), encoded) != names.end())
+    {
+        return booked.Book<double, double, int, bool, ROOT::RVec<unsigned char>, double>(
+            std::move(helper),
+            {score_col, w_col, ch_col, sig_col, encoded, cv_col});
+    }
+
+    return booked.Book<double, double, int, bool, ROOT::RVec<unsigned short>, double>(
+        std::move(helper),
+        {score_col, w_col, ch_col, sig_col, spec.universe_column, cv_col});
+}
+
+} // namespace nu
@@ -0,0 +1,311 @@
+/* -- C++ -- */
+/**
+ *  @file  framework/modules/plot/src/UniverseHist.cc
+ *
+ *  @brief Implementation of the single-pass multi-universe histogram fill.
+ */
+
+#include "UniverseHist.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UniverseWeightCodec.hh"
+
+
+namespace nu
+{
+
+namespace
+{
+
+std::string unique_column(const std::string &stem)
+{
+    static std::atomic<unsigned long long> counter{0ULL};
+    return stem + "_" + std::to_string(counter++);
+}
+
+std::vector<double> edges_from_spec(const TH1DModel &spec)
+{
+    if (spec.has_custom_bins())
+        return spec.bin_edges;
+
+    const int nbins = std::max(1, spec.nbins);
+    std::vector<double> edges(static_cast<std::size_t>(nbins) + 1);
+    const double width = (spec.xmax - spec.xmin) / nbins;
+    for (int i = 0; i <= nbins; ++i)
+        edges[static_cast<std::size_t>(i)] = spec.xmin + i * width;
+    edges.back() = spec.xmax;
+    return edges;
+}
+
+bool has_column(ROOT::RDF::RNode node, const std::string &name)
+{
+    const auto names = node.GetColumnNames();
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+std::string as_double_expr(const std::string &expr, const std::string &fallback)
+{
+    if (expr.empty())
+        return fallback;
+    return "static_cast<double>(" + expr + ")";
+}
+
+} // namespace
+
+UniverseHist::UniverseHist(std::string name, std::vector<double> edges, int n_universes)
+    : name_(std::move(name)), edges_(std::move(edges)), n_universes_(std::max(0, n_universes))
+{
+    if (edges_.size() < 2)
+        throw std::runtime_error("UniverseHist: need at least two bin edges");
+    if (!std::is_sorted(edges_.begin(), edges_.end()))
+        throw std::runtime_error("UniverseHist: bin edges must be sorted ascending");
+
+    const std::size_t n_cells = edges_.size() + 1;
+    nominal_.assign(n_cells, 0.0);
+    nominal_w2_.assign(n_cells, 0.0);
+    universes_.assign(n_cells * static_cast<std::size_t>(n_universes_), 0.0);
+}
+
+double UniverseHist::universe(int u, int bin) const
+{
+    if (u < 0 || u >= n_universes_)
+        throw std::out_of_range("UniverseHist::universe: universe index out of range");
+    return universes_.at(static_cast<std::size_t>(bin) * n_universes_ + u);
+}
+
+std::unique_ptr<TH1D> UniverseHist::nominal_hist(const std::string &hist_name) const
+{
+    const std::string hname = hist_name.empty() ? (name_ + "_nominal") : hist_name;
+    auto h = std::make_unique<TH1D>(hname.c_str(), "", n_bins(), edges_.data());
+    h->SetDirectory(nullptr);
+    h->Sumw2();
+    for (int i = 0; i <= n_bins() + 1; ++i)
+    {
+        h->SetBinContent(i, nominal_[static_cast<std::size_t>(i)]);
+        h->SetBinError(i, std::sqrt(std::max(0.0, nominal_w2_[static_cast<std::size_t>(i)])));
+    }
+    return h;
+}
+
+std::unique_ptr<TH1D> UniverseHist::universe_hist(int u, const std::string &hist_name) const
+{
+    const std::string hname = hist_name.empty() ? (name_ + "_u" + std::to_string(u)) : hist_name;
+    auto h = std::make_unique<TH1D>(hname.c_str(), "", n_bins(), edges_.data());
+    h->SetDirectory(nullptr);
+    for (int i = 0; i <= n_bins() + 1; ++i)
+        h->SetBinContent(i, universe(u, i));
+    return h;
+}
+
+void UniverseHist::add(const UniverseHist &other)
+{
+    if (other.edges_ != edges_ || other.n_universes_ != n_universes_)
+        throw std::runtime_error("UniverseHist::add: incompatible binning or universe count");
+
+    for (std::size_t i = 0; i < nominal_.size(); ++i)
+    {
+        nominal_[i] += other.nominal_[i];
+        nominal_w2_[i] += other.nominal_w2_[i];
+    }
+    for (std::size_t i = 0; i < universes_.size(); ++i)
+        universes_[i] += other.universes_[i];
+}
+
+UniverseFillHelper::UniverseFillHelper(std::string name,
+                                       std::vector<double> edges,
+                                       int n_universes,
+                                       unsigned int n_slots)
+    : result_(std::make_shared<UniverseHist>(std::move(name), edges, n_universes)),
+      edges_(std::move(edges)),
+      n_universes_(std::max(0, n_universes)),
+      sized_by_data_(n_universes <= 0)
+{
+    const unsigned int slots = std::max(1u, n_slots);
+    const std::size_t n_cells = edges_.size() + 1;
+    const std::size_t stride = static_cast<std::size_t>(n_universes_);
+
+    slot_stride_.assign(slots, stride);
+    slot_nominal_.assign(slots, std::vector<double>(n_cells, 0.0));
+    slot_nominal_w2_.assign(slots, std::vector<double>(n_cells, 0.0));
+    slot_universes_.assign(slots, std::vector<double>(n_cells * stride, 0.0));
+    slot_decoded_.assign(slots, std::vector<unsigned short>{});
+}
+
+int UniverseFillHelper::find_bin(double x) const
+{
+    if (x < edges_.front())
+        return 0;
+    if (x >= edges_.back())
+        return static_cast<int>(edges_.size());
+    return static_cast<int>(std::upper_bound(edges_.begin(), edges_.end(), x) - edges_.begin());
+}
+
+void UniverseFillHelper::widen(unsigned int slot, std::size_t stride)
+{
+    const std::size_t old_stride = slot_stride_[slot];
+    if (stride <= old_stride)
+        return;
+
+    const std::size_t n_cells = edges_.size() + 1;
+    const std::vector<double> &nominal = slot_nominal_[slot];
+    std::vector<double> wider(n_cells * stride, 0.0);
+    for (std::size_t bin = 0; bin < n_cells; ++bin)
+    {
+        const double *src = slot_universes_[slot].data() + bin * old_stride;
+        double *dst = wider.data() + bin * stride;
+        std::copy(src, src + old_stride, dst);
+        std::fill(dst + old_stride, dst + stride, nominal[bin]);
+    }
+    slot_universes_[slot].swap(wider);
+    slot_stride_[slot] = stride;
+}
+
+void UniverseFillHelper::Exec(unsigned int slot,
+                              double x,
+                              double w,
+                              const ROOT::RVec<unsigned short> &packed,
+                              double cv)
+{
+    fill_packed(slot, x, w, packed.data(), packed.size(), cv);
+}
+
+void UniverseFillHelper::Exec(unsigned int slot,
+                              double x,
+                              double w,
+                              const ROOT::RVec<unsigned char> &encoded,
+                              double cv)
+{
+    std::vector<unsigned short> &buffer = slot_decoded_[slot];
+    buffer.resize(UniverseWeightCodec::decoded_size(encoded.data(), encoded.size()));
+    const std::size_t n = UniverseWeightCodec::decode(encoded.data(), encoded.size(), buffer.data(), buffer.size());
+    fill_packed(slot, x, w, buffer.data(), n, cv);
+}
+
+void UniverseFillHelper::fill_packed(unsigned int slot,
+                                     double x,
+                                     double w,
+                                     const unsigned short *packed,
+                                     std::size_t n_packed,
+                                     double cv)
+{
+    if (!std::isfinite(x) || !std::isfinite(w))
+        return;
+
+    // Widen before filling so the new universes see only earlier events' nominal weight.
+    if (sized_by_data_ && n_packed > slot_stride_[slot])
+        widen(slot, n_packed);
+
+    const std::size_t bin = static_cast<std::size_t>(find_bin(x));
+    slot_nominal_[slot][bin] += w;
+    slot_nominal_w2_[slot][bin] += w * w;
+
+    const std::size_t stride = slot_stride_[slot];
+    if (stride == 0)
+        return;
+
+    const double cv_safe = (std::isfinite(cv) && cv > 0.0) ? cv : 1.0;
+    const double scale = w / (kUniversePackScale * cv_safe);
+
+    double *row = slot_universes_[slot].data() + bin * stride;
+    const std::size_t n_decoded = std::min(n_packed, stride);
+
+    // Contiguous ushort -> double multiply-add; the compiler vectorises this.
+    for (std::size_t u = 0; u < n_decoded; ++u)
+        row[u] += scale * static_cast<double>(packed[u]);
+    for (std::size_t u = n_decoded; u < stride; ++u)
+        row[u] += w;
+}
+
+void UniverseFillHelper::Finalize()
+{
+    if (sized_by_data_)
+    {
+        const std::size_t stride = *std::max_element(slot_stride_.begin(), slot_stride_.end());
+        *result_ = UniverseHist(result_->name_, edges_, static_cast<int>(stride));
+        for (unsigned int s = 0; s < slot_stride_.size(); ++s)
+            widen(s, stride);
+    }
+
+    for (std::size_t s = 0; s < slot_nominal_.size(); ++s)
+    {
+        for (std::size_t i = 0; i < result_->nominal_.size(); ++i)
+        {
+            result_->nominal_[i] += slot_nominal_[s][i];
+            result_->nominal_w2_[i] += slot_nominal_w2_[s][i];
+        }
+        for (std::size_t i = 0; i < result_->universes_.size(); ++i)
+            result_->universes_[i] += slot_universes_[s][i];
+    }
+
+    slot_stride_.clear();
+    slot_nominal_.clear();
+    slot_nominal_w2_.clear();
+    slot_universes_.clear();
+    slot_decoded_.clear();
+}
+
+int count_universes(ROOT::RDF::RNode node, const std::string &universe_column)
+{
+    const std::string size_col = unique_column("__uh_nuni");
+    const std::string encoded = UniverseWeightCodec::encoded_column(universe_column);
+    if (has_column(node, encoded))
+    {
+        auto n_max = node.Define(size_col,
+                                 [](const ROOT::RVec<unsigned char> &blob) {
+                                     return static_cast<int>(UniverseWeightCodec::decoded_size(blob.data(), blob.size()));
+                                 },
+                                 {encoded})
+                         .Max<int>(size_col);
+        return std::max(0, n_max.GetValue());
+    }
+
+    auto n_max = node.Define(size_col, "static_cast<int>(" + universe_column + ".size())").Max<int>(size_col);
+    return std::max(0, n_max.GetValue());
+}
+
+ROOT::RDF::RResultPtr<UniverseHist> book_universe_hist(ROOT::RDF::RNode node,
+                                                       const TH1DModel &spec,
+                                                       const UniverseHistSpec &universes)
+{
+    if (universes.universe_column.empty())
+        throw std::runtime_error("book_universe_hist: universe_column is required");
+
+    const std::string expr = spec.expr.empty() ? spec.id : spec.expr;
+    if (expr.empty())
+        throw std::runtime_error("book_universe_hist: spec has no expression");
+
+    const std::string x_col = unique_column("__uh_x");
+    const std::string w_col = unique_column("__uh_w");
+    const std::string cv_col = unique_column("__uh_cv");
+
+    ROOT::RDF::RNode booked = node.Define(x_col, as_double_expr(expr, "0.0"))
+                                  .Define(w_col, as_double_expr(spec.weight, "1.0"))
+                                  .Define(cv_col, as_double_expr(universes.cv_column, "1.0"));
+
+    const std::string name = !universes.name.empty()
+                                 ? universes.name
+                                 : ((!spec.id.empty() ? spec.id : expr) + "_" + universes.universe_column);
+
+    UniverseFillHelper helper(name, edges_from_spec(spec), universes.n_universes, booked.GetNSlots());
+
+    const std::string encoded = UniverseWeightCodec::encoded_column(universes.universe_column);
+    if (has_column(booked, encoded))
+    {
+        return booked.Book<double, double, ROOT::RVec<unsigned char>, double>(
+            std::move(helper),
+            {x_col, w_col, encoded, cv_col});
+    }
+
+    return booked.Book<double, double, ROOT::RVec<unsigned short>, double>(
+        std::move(helper),
+        {x_col, w_col, universes.universe_column, cv_col});
+}
+
+} // namespace nu
@@ -8,6 +8,8 @@
 #include <string>
 #include <vector>
 
+#include <TROOT.h>
+
 namespace heron {
 namespace macro {
 
@@ -31,6 +33,15 @@ inline bool env_truthy(const char *value)
           text == "on" || text == "ON");
 }
 
+// Implicit MT sized by HERON_RDF_THREADS (set per worker by
+// `heron macro --batch`); unset or <= 0 lets ROOT pick, capped by
+// ROOT_MAX_THREADS.
+inline void enable_implicit_mt()
+{
+  const int n = std::atoi(getenv_or("HERON_RDF_THREADS", "0").c_str());
+  ROOT::EnableImplicitMT(n > 0 ? static_cast<unsigned int>(n) : 0u);
+}
+
 inline std::string plot_out_dir()
 {
   return getenv_or("HERON_PLOT_DIR", "./scratch/plots");
@@ -7,7 +7,7 @@ _heron()
   cur="${COMP_WORDS[COMP_CWORD]}"
   prev="${COMP_WORDS[COMP_CWORD-1]}"
 
-  local commands="art sample event macro paths env help -h --help"
+  local commands="art sample event export-tensors split compact macro paths env help -h --help"
 
   _heron_find_root()
   {
@@ -88,7 +88,15 @@ _heron()
     local macros
     macros="$(_heron_list_macros)"
     if [[ ${COMP_CWORD} -eq 2 ]]; then
-      COMPREPLY=( $(compgen -W "${macros}" -- "${cur}") )
+      COMPREPLY=( $(compgen -W "${macros} list --batch" -- "${cur}") )
+      return 0
+    fi
+    if [[ "${COMP_WORDS[2]}" == "--batch" ]]; then
+      if [[ ${COMP_CWORD} -eq 3 ]]; then
+        COMPREPLY=( $(compgen -f -- "${cur}") )
+      else
+        COMPREPLY=( $(compgen -W "--jobs --threads-per-macro" -- "${cur}") )
+      fi
       return 0
     fi
   fi